@@ -0,0 +1,171 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_TEST_HISTOGRAM_HPP
+#define BEAST_TEST_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace beast {
+namespace test {
+
+/** A histogram of non-negative integer values.
+
+    Values are kept in log-linear buckets: every power of two
+    is split into 128 buckets of equal width, so any reported
+    value is within 1/128 of a recorded one, and the whole
+    range of a 64-bit value fits in a fixed table of counts.
+    Recording a value is a few shifts and an increment.
+
+    Histograms are recorded by one thread and combined with
+    @ref merge when the measurement is over.
+*/
+class histogram
+{
+    static unsigned constexpr sub_bits = 7;
+    static std::uint64_t constexpr sub = 1ULL << sub_bits;
+
+    std::vector<std::uint64_t> counts_;
+    std::uint64_t count_ = 0;
+    std::uint64_t min_ = (std::numeric_limits<std::uint64_t>::max)();
+    std::uint64_t max_ = 0;
+    double sum_ = 0;
+
+    static
+    unsigned
+    log2(std::uint64_t v)
+    {
+        unsigned n = 0;
+        for(unsigned s = 32; s > 0; s /= 2)
+        {
+            if(v >> s)
+            {
+                v >>= s;
+                n += s;
+            }
+        }
+        return n;
+    }
+
+    static
+    std::size_t
+    index(std::uint64_t v)
+    {
+        if(v < sub)
+            return static_cast<std::size_t>(v);
+        auto const shift = log2(v) - sub_bits;
+        return static_cast<std::size_t>(
+            (shift + 1) * sub + ((v >> shift) - sub));
+    }
+
+    // Returns the largest value which maps to bucket `i`
+    static
+    std::uint64_t
+    value(std::size_t i)
+    {
+        if(i < sub)
+            return i;
+        auto const shift = i / sub - 1;
+        auto const mant = i % sub;
+        return ((sub + mant) << shift) +
+            ((std::uint64_t{1} << shift) - 1);
+    }
+
+public:
+    histogram()
+        : counts_((64 - sub_bits + 1) * sub)
+    {
+    }
+
+    /// Record one occurrence of a value
+    void
+    record(std::uint64_t v)
+    {
+        ++counts_[index(v)];
+        ++count_;
+        sum_ += static_cast<double>(v);
+        if(v < min_)
+            min_ = v;
+        if(v > max_)
+            max_ = v;
+    }
+
+    /// Add the values recorded in another histogram
+    void
+    merge(histogram const& other)
+    {
+        for(std::size_t i = 0; i < counts_.size(); ++i)
+            counts_[i] += other.counts_[i];
+        count_ += other.count_;
+        sum_ += other.sum_;
+        min_ = (std::min)(min_, other.min_);
+        max_ = (std::max)(max_, other.max_);
+    }
+
+    /// Returns the number of values recorded
+    std::uint64_t
+    count() const
+    {
+        return count_;
+    }
+
+    /// Returns the smallest value recorded
+    std::uint64_t
+    min() const
+    {
+        return count_ ? min_ : 0;
+    }
+
+    /// Returns the largest value recorded
+    std::uint64_t
+    max() const
+    {
+        return max_;
+    }
+
+    /// Returns the mean of the values recorded
+    double
+    mean() const
+    {
+        return count_ ? sum_ / count_ : 0;
+    }
+
+    /** Returns the value at a percentile.
+
+        @param p The percentile, from 0 to 100.
+
+        @return A value no smaller than `p` percent of the
+        recorded values, and never above the largest one.
+    */
+    std::uint64_t
+    percentile(double p) const
+    {
+        if(count_ == 0)
+            return 0;
+        auto target = static_cast<std::uint64_t>(
+            std::ceil(p / 100 * count_));
+        if(target == 0)
+            target = 1;
+        std::uint64_t seen = 0;
+        for(std::size_t i = 0; i < counts_.size(); ++i)
+        {
+            seen += counts_[i];
+            if(seen >= target)
+                return (std::min)(value(i), max_);
+        }
+        return max_;
+    }
+};
+
+} // test
+} // beast
+
+#endif
@@ -0,0 +1,210 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_TEST_LOAD_TEST_HPP
+#define BEAST_TEST_LOAD_TEST_HPP
+
+#include <beast/test/histogram.hpp>
+#include <boost/asio/io_service.hpp>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <random>
+#include <thread>
+
+namespace beast {
+namespace test {
+
+/** Round trip latencies measured by a load generator.
+
+    The corrected histogram measures from the time a send was
+    scheduled, so that a stalled connection is charged for the
+    sends it could not make (coordinated omission). The
+    uncorrected histogram measures from the actual send.
+*/
+struct latency
+{
+    histogram corrected;
+    histogram uncorrected;
+
+    /// Add the latencies recorded in another object
+    void
+    merge(latency const& other)
+    {
+        corrected.merge(other.corrected);
+        uncorrected.merge(other.uncorrected);
+    }
+};
+
+/** The send schedule of one load generator connection.
+
+    Sends are made at a fixed interval from the time each was
+    intended, or back to back when no rate is given. Latency is
+    recorded only between the end of the warmup and the end of
+    the measurement.
+*/
+class schedule
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+
+private:
+    clock_type::duration interval_;
+    clock_type::time_point begin_;  // measurement starts
+    clock_type::time_point end_;    // measurement ends
+    clock_type::time_point next_;   // intended time of next send
+    clock_type::time_point sent_;   // actual time of last send
+
+public:
+    /** Constructor
+
+        @param rate The sends per second made by this
+        connection, or zero for as fast as possible.
+    */
+    explicit
+    schedule(double rate)
+        : interval_(rate > 0 ?
+            std::chrono::duration_cast<clock_type::duration>(
+                std::chrono::duration<double>(1 / rate)) :
+            clock_type::duration::zero())
+    {
+    }
+
+    /// Set the measurement window, relative to the start of the run
+    void
+    run(clock_type::time_point start,
+        clock_type::duration warmup,
+        clock_type::duration duration)
+    {
+        begin_ = start + warmup;
+        end_ = begin_ + duration;
+    }
+
+    /** Schedule the first send.
+
+        The first sends of the connections are spread over one
+        interval, so they do not all fire at the same moment.
+    */
+    template<class Generator>
+    void
+    first(Generator& g)
+    {
+        next_ = clock_type::now();
+        if(interval_ > clock_type::duration::zero())
+            next_ += std::uniform_int_distribution<
+                clock_type::rep>{0, interval_.count()}(g) *
+                    clock_type::duration{1};
+    }
+
+    /// Returns the intended time of the next send
+    clock_type::time_point
+    next() const
+    {
+        return next_;
+    }
+
+    /// Returns `true` if the next send is due
+    bool
+    due() const
+    {
+        return clock_type::now() >= next_;
+    }
+
+    /// Called when the send is made
+    void
+    send()
+    {
+        sent_ = clock_type::now();
+        if(interval_ == clock_type::duration::zero())
+            next_ = sent_;
+    }
+
+    /** Called when the reply arrives.
+
+        @return `true` if the latency was recorded.
+    */
+    bool
+    reply(latency& lat, clock_type::time_point now) const
+    {
+        using std::chrono::nanoseconds;
+        if(now < begin_)
+            return false;
+        lat.corrected.record(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<nanoseconds>(
+                now - next_).count()));
+        lat.uncorrected.record(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<nanoseconds>(
+                now - sent_).count()));
+        return true;
+    }
+
+    /// Returns `true` if the measurement is over
+    bool
+    done(clock_type::time_point now) const
+    {
+        return now >= end_;
+    }
+
+    /// Move on to the next send
+    void
+    advance()
+    {
+        next_ += interval_;
+    }
+};
+
+/// One client thread and the connections it runs
+template<class Report>
+struct worker
+{
+    Report rep;
+    boost::asio::io_service ios{1};
+    std::thread thread;
+};
+
+/** Print a table of latency percentiles in microseconds.
+
+    @param paced `true` if the sends followed a target rate.
+*/
+inline
+void
+print_latency(std::ostream& os, latency const& lat, bool paced)
+{
+    auto const row =
+        [&os](char const* what, histogram const& h)
+        {
+            auto const us =
+                [](std::uint64_t ns)
+                {
+                    return ns / 1000.;
+                };
+            os << std::fixed << std::setprecision(1) <<
+                std::setw(12) << what <<
+                std::setw(10) << us(h.min()) <<
+                std::setw(10) << us(h.percentile(50)) <<
+                std::setw(10) << us(h.percentile(90)) <<
+                std::setw(10) << us(h.percentile(99)) <<
+                std::setw(10) << us(h.percentile(99.9)) <<
+                std::setw(10) << us(h.percentile(99.99)) <<
+                std::setw(10) << us(h.max()) <<
+                std::setw(10) << us(static_cast<std::uint64_t>(h.mean())) <<
+                "\n";
+        };
+    os <<
+        "latency (us)       min       p50       p90       p99"
+            "     p99.9    p99.99       max      mean\n";
+    row("corrected", lat.corrected);
+    row("uncorrected", lat.uncorrected);
+    if(! paced)
+        os << "(no target rate: latency is measured from each send)\n";
+}
+
+} // test
+} // beast
+
+#endif
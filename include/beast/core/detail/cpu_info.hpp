@@ -26,6 +26,8 @@
 #include <cpuid.h>  // __get_cpuid
 #endif
 
+#include <cstdint>
+
 namespace beast {
 namespace detail {
 
@@ -53,9 +55,34 @@ cpuid(
 #endif
 }
 
+// Query a leaf which has sub-leaves
+template<class = void>
+void
+cpuid_count(
+    std::uint32_t id,
+    std::uint32_t sub,
+    std::uint32_t& eax,
+    std::uint32_t& ebx,
+    std::uint32_t& ecx,
+    std::uint32_t& edx)
+{
+#ifdef BOOST_MSVC
+    int regs[4];
+    __cpuidex(regs, id, sub);
+    eax = regs[0];
+    ebx = regs[1];
+    ecx = regs[2];
+    edx = regs[3];
+#else
+    __cpuid_count(id, sub, eax, ebx, ecx, edx);
+#endif
+}
+
 struct cpu_info
 {
+    bool ssse3 = false;
     bool sse42 = false;
+    bool sha = false;
 
     cpu_info();
 };
@@ -64,7 +91,9 @@ inline
 cpu_info::
 cpu_info()
 {
+    constexpr std::uint32_t SSSE3 = 1 << 9;
     constexpr std::uint32_t SSE42 = 1 << 20;
+    constexpr std::uint32_t SHA = 1 << 29;
 
     std::uint32_t eax = 0;
     std::uint32_t ebx = 0;
@@ -72,11 +101,18 @@ cpu_info()
     std::uint32_t edx = 0;
 
     cpuid(0, eax, ebx, ecx, edx);
-    if(eax >= 1)
+    auto const max_id = eax;
+    if(max_id >= 1)
     {
         cpuid(1, eax, ebx, ecx, edx);
+        ssse3 = (ecx & SSSE3) != 0;
         sse42 = (ecx & SSE42) != 0;
     }
+    if(max_id >= 7)
+    {
+        cpuid_count(7, 0, eax, ebx, ecx, edx);
+        sha = (ebx & SHA) != 0;
+    }
 }
 
 template<class = void>
@@ -8,10 +8,30 @@
 #ifndef BEAST_DETAIL_SHA1_HPP
 #define BEAST_DETAIL_SHA1_HPP
 
+#include <beast/core/detail/cpu_info.hpp>
 #include <algorithm>
 #include <cstdint>
 #include <cstring>
 
+#ifndef BEAST_NO_SHA_INTRINSICS
+# if ! BEAST_NO_INTRINSICS
+#  define BEAST_NO_SHA_INTRINSICS 0
+# else
+#  define BEAST_NO_SHA_INTRINSICS 1
+# endif
+#endif
+
+#if ! BEAST_NO_SHA_INTRINSICS
+#include <immintrin.h>
+// The SHA extensions are enabled for transform_shani
+// only, the processor is checked before calling it.
+# if defined(BOOST_GCC) || defined(BOOST_CLANG)
+#  define BEAST_SHA1_TARGET __attribute__((target("sha,sse4.1")))
+# else
+#  define BEAST_SHA1_TARGET
+# endif
+#endif
+
 // Based on https://github.com/vog/sha1
 /*
     Original authors:
@@ -214,6 +234,136 @@ transform(
     digest[4] += e;
 }
 
+#if ! BEAST_NO_SHA_INTRINSICS
+
+/*  Process one block using the SHA extensions.
+
+    Portions from the public domain sha1-x86.c by
+    Sean Gulley, Jeffrey Walton and others.
+*/
+template<class = void>
+BEAST_SHA1_TARGET
+void
+transform_shani(
+    std::uint32_t digest[], std::uint8_t const* p)
+{
+    __m128i const mask = _mm_set_epi64x(
+        0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(
+        reinterpret_cast<__m128i const*>(digest)), 0x1b);
+    __m128i e0 = _mm_set_epi32(
+        static_cast<int>(digest[4]), 0, 0, 0);
+    __m128i const abcd_save = abcd;
+    __m128i const e0_save = e0;
+    __m128i e1;
+    __m128i m0, m1, m2, m3;
+
+    // Rounds 0-3
+    m0 = _mm_shuffle_epi8(_mm_loadu_si128(
+        reinterpret_cast<__m128i const*>(p)), mask);
+    e0 = _mm_add_epi32(e0, m0);
+    e1 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+    // Rounds 4-7
+    m1 = _mm_shuffle_epi8(_mm_loadu_si128(
+        reinterpret_cast<__m128i const*>(p + 16)), mask);
+    e1 = _mm_sha1nexte_epu32(e1, m1);
+    e0 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+    m0 = _mm_sha1msg1_epu32(m0, m1);
+
+    // Rounds 8-11
+    m2 = _mm_shuffle_epi8(_mm_loadu_si128(
+        reinterpret_cast<__m128i const*>(p + 32)), mask);
+    e0 = _mm_sha1nexte_epu32(e0, m2);
+    e1 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+    m1 = _mm_sha1msg1_epu32(m1, m2);
+    m0 = _mm_xor_si128(m0, m2);
+
+    // Rounds 12-15
+    m3 = _mm_shuffle_epi8(_mm_loadu_si128(
+        reinterpret_cast<__m128i const*>(p + 48)), mask);
+    e1 = _mm_sha1nexte_epu32(e1, m3);
+    e0 = abcd;
+    m0 = _mm_sha1msg2_epu32(m0, m3);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+    m2 = _mm_sha1msg1_epu32(m2, m3);
+    m1 = _mm_xor_si128(m1, m3);
+
+    // Each group of four rounds from here to round 67
+    // takes the same form, with the message registers
+    // and the two E registers rotating through it.
+#define BEAST_SHA1_ROUNDS(ea, eb, ma, mb, mc, md, f) \
+    ea = _mm_sha1nexte_epu32(ea, ma); \
+    eb = abcd; \
+    mb = _mm_sha1msg2_epu32(mb, ma); \
+    abcd = _mm_sha1rnds4_epu32(abcd, ea, f); \
+    md = _mm_sha1msg1_epu32(md, ma); \
+    mc = _mm_xor_si128(mc, ma);
+
+    BEAST_SHA1_ROUNDS(e0, e1, m0, m1, m2, m3, 0) // 16-19
+    BEAST_SHA1_ROUNDS(e1, e0, m1, m2, m3, m0, 1) // 20-23
+    BEAST_SHA1_ROUNDS(e0, e1, m2, m3, m0, m1, 1) // 24-27
+    BEAST_SHA1_ROUNDS(e1, e0, m3, m0, m1, m2, 1) // 28-31
+    BEAST_SHA1_ROUNDS(e0, e1, m0, m1, m2, m3, 1) // 32-35
+    BEAST_SHA1_ROUNDS(e1, e0, m1, m2, m3, m0, 1) // 36-39
+    BEAST_SHA1_ROUNDS(e0, e1, m2, m3, m0, m1, 2) // 40-43
+    BEAST_SHA1_ROUNDS(e1, e0, m3, m0, m1, m2, 2) // 44-47
+    BEAST_SHA1_ROUNDS(e0, e1, m0, m1, m2, m3, 2) // 48-51
+    BEAST_SHA1_ROUNDS(e1, e0, m1, m2, m3, m0, 2) // 52-55
+    BEAST_SHA1_ROUNDS(e0, e1, m2, m3, m0, m1, 2) // 56-59
+    BEAST_SHA1_ROUNDS(e1, e0, m3, m0, m1, m2, 3) // 60-63
+    BEAST_SHA1_ROUNDS(e0, e1, m0, m1, m2, m3, 3) // 64-67
+
+#undef BEAST_SHA1_ROUNDS
+
+    // Rounds 68-71
+    e1 = _mm_sha1nexte_epu32(e1, m1);
+    e0 = abcd;
+    m2 = _mm_sha1msg2_epu32(m2, m1);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+    m3 = _mm_xor_si128(m3, m1);
+
+    // Rounds 72-75
+    e0 = _mm_sha1nexte_epu32(e0, m2);
+    e1 = abcd;
+    m3 = _mm_sha1msg2_epu32(m3, m2);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+
+    // Rounds 76-79
+    e1 = _mm_sha1nexte_epu32(e1, m3);
+    e0 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+    e0 = _mm_sha1nexte_epu32(e0, e0_save);
+    abcd = _mm_add_epi32(abcd, abcd_save);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(digest),
+        _mm_shuffle_epi32(abcd, 0x1b));
+    digest[4] = static_cast<std::uint32_t>(
+        _mm_extract_epi32(e0, 3));
+}
+
+#endif
+
+// Process one 64 byte block, using
+// the SHA extensions when available
+inline
+void
+process(std::uint32_t digest[], std::uint8_t const* p)
+{
+#if ! BEAST_NO_SHA_INTRINSICS
+    if(get_cpu_info().sha)
+        return transform_shani(digest, p);
+#endif
+    std::uint32_t block[BLOCK_INTS];
+    make_block(p, block);
+    transform(digest, block);
+}
+
 } // sha1
 
 struct sha1_context
@@ -258,9 +408,7 @@ update(sha1_context& ctx,
         p += n;
         size -= n;
         ctx.buflen = 0;
-        std::uint32_t block[sha1::BLOCK_INTS];
-        sha1::make_block(ctx.buf, block);
-        sha1::transform(ctx.digest, block);
+        sha1::process(ctx.digest, ctx.buf);
         ++ctx.blocks;
     }
 }
@@ -269,29 +417,27 @@ template<class = void>
 void
 finish(sha1_context& ctx, void* digest) noexcept
 {
-    using sha1::BLOCK_INTS;
     using sha1::BLOCK_BYTES;
 
     std::uint64_t total_bits =
         (ctx.blocks*64 + ctx.buflen) * 8;
     // pad
     ctx.buf[ctx.buflen++] = 0x80;
-    auto const buflen = ctx.buflen;
-    while(ctx.buflen < 64)
-        ctx.buf[ctx.buflen++] = 0x00;
-    std::uint32_t block[BLOCK_INTS];
-    sha1::make_block(ctx.buf, block);
-    if(buflen > BLOCK_BYTES - 8)
+    if(ctx.buflen > BLOCK_BYTES - 8)
     {
-        sha1::transform(ctx.digest, block);
-        for(size_t i = 0; i < BLOCK_INTS - 2; i++)
-            block[i] = 0;
+        while(ctx.buflen < BLOCK_BYTES)
+            ctx.buf[ctx.buflen++] = 0x00;
+        sha1::process(ctx.digest, ctx.buf);
+        ctx.buflen = 0;
     }
+    while(ctx.buflen < BLOCK_BYTES - 8)
+        ctx.buf[ctx.buflen++] = 0x00;
 
-    /* Append total_bits, split this uint64_t into two uint32_t */
-    block[BLOCK_INTS - 1] = total_bits & 0xffffffff;
-    block[BLOCK_INTS - 2] = (total_bits >> 32);
-    sha1::transform(ctx.digest, block);
+    /* Append total_bits, most significant byte first */
+    for(int i = 7; i >= 0; --i)
+        ctx.buf[ctx.buflen++] = static_cast<std::uint8_t>(
+            (total_bits >> (8 * i)) & 0xff);
+    sha1::process(ctx.digest, ctx.buf);
     for(std::size_t i = 0; i < sha1::DIGEST_BYTES/4; i++)
     {
         std::uint8_t* d =
@@ -12,8 +12,13 @@
 
 #include <beast/websocket/error.hpp>
 #include <beast/websocket/option.hpp>
+#include <beast/websocket/prepared_message.hpp>
 #include <beast/websocket/rfc6455.hpp>
+#include <beast/websocket/send_queue.hpp>
+#include <beast/websocket/split.hpp>
+#include <beast/websocket/stats.hpp>
 #include <beast/websocket/stream.hpp>
+#include <beast/websocket/stream_fwd.hpp>
 #include <beast/websocket/teardown.hpp>
 
 #endif
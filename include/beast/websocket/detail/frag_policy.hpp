@@ -0,0 +1,111 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_DETAIL_FRAG_POLICY_HPP
+#define BEAST_WEBSOCKET_DETAIL_FRAG_POLICY_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+/*  Chooses the payload size of auto-fragmented frames.
+
+    The time the next layer takes to accept each frame is
+    measured. While the socket send buffer has room a write
+    completes at once, and once it is full a write completes
+    only as fast as the peer acknowledges data, so the rate
+    observed approaches the rate at which the connection
+    drains. Frames are sized to take about the latency budget
+    to send, so that control frames and other operations
+    waiting on the stream do not wait much longer than that.
+*/
+class frag_policy
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+
+private:
+    // Smallest payload chosen
+    static std::size_t constexpr min_size = 512;
+
+    clock_type::duration budget_{}; // time to send one frame
+    std::size_t max_ = 0;           // largest payload
+    std::size_t size_ = 0;          // current payload
+
+public:
+    clock_type::duration
+    budget() const
+    {
+        return budget_;
+    }
+
+    void
+    budget(clock_type::duration d)
+    {
+        budget_ = d;
+        size_ = max_;
+    }
+
+    // Called at the start of each message
+    void
+    limit(std::size_t max)
+    {
+        max_ = max;
+        if(budget_ == clock_type::duration::zero() ||
+                size_ == 0 || size_ > max_)
+            size_ = max_;
+    }
+
+    // Returns the payload size of the next frame
+    std::size_t
+    size() const
+    {
+        return size_;
+    }
+
+    clock_type::time_point
+    start() const
+    {
+        if(budget_ == clock_type::duration::zero())
+            return {};
+        return clock_type::now();
+    }
+
+    // Record a frame carrying `n` payload
+    // bytes, whose write began at `when`
+    void
+    stop(clock_type::time_point when, std::size_t n)
+    {
+        if(budget_ == clock_type::duration::zero())
+            return;
+        auto const elapsed = clock_type::now() - when;
+        auto next = max_;
+        if(elapsed > clock_type::duration::zero())
+        {
+            auto const v = static_cast<double>(n) *
+                budget_.count() / elapsed.count();
+            if(v < static_cast<double>(max_))
+                next = static_cast<std::size_t>(v);
+        }
+        // Shrink at once, but grow by at most
+        // double so one quick write is not trusted.
+        if(next > size_)
+            next = (std::min)(next, 2 * size_);
+        size_ = (std::max)(next, (std::min)(
+            +min_size, max_));
+    }
+};
+
+} // detail
+} // websocket
+} // beast
+
+#endif
@@ -0,0 +1,474 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_DETAIL_KEEPALIVE_HPP
+#define BEAST_WEBSOCKET_DETAIL_KEEPALIVE_HPP
+
+#include <beast/core/error.hpp>
+#include <boost/asio/basic_waitable_timer.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/assert.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+template<class = void>
+class keepalive_service_impl;
+
+using keepalive_service = keepalive_service_impl<>;
+
+// Whether a read is pending on a stream checked by the
+// keepalive service, and whether a check was posted for it.
+// The timer moves it from reading to checking, the stream
+// moves it back. Unlike std::atomic, the state is movable
+// so that the stream stays movable. Moving is not thread
+// safe.
+//
+class keepalive_state
+{
+public:
+    enum value
+    {
+        idle,
+        reading,
+        checking
+    };
+
+private:
+    std::atomic<int> v_;
+
+public:
+    keepalive_state()
+        : v_(idle)
+    {
+    }
+
+    keepalive_state(keepalive_state&& other)
+        : v_(other.v_.load(std::memory_order_relaxed))
+    {
+    }
+
+    keepalive_state&
+    operator=(keepalive_state&& other)
+    {
+        v_.store(other.v_.load(std::memory_order_relaxed),
+            std::memory_order_relaxed);
+        return *this;
+    }
+
+    value
+    load() const
+    {
+        return static_cast<value>(
+            v_.load(std::memory_order_acquire));
+    }
+
+    void
+    store(value v)
+    {
+        v_.store(v, std::memory_order_release);
+    }
+
+    value
+    exchange(value v)
+    {
+        return static_cast<value>(
+            v_.exchange(v, std::memory_order_acq_rel));
+    }
+
+    // Returns `true` if the state was `from`
+    bool
+    transit(value from, value to)
+    {
+        int expected = from;
+        return v_.compare_exchange_strong(
+            expected, to, std::memory_order_acq_rel);
+    }
+};
+
+// Links a stream into the queues of streams checked by the
+// keepalive service of its io_service. Streams derive from
+// this, so that moving a stream moves its place in the queue.
+//
+class keepalive_hook
+{
+    template<class>
+    friend class keepalive_service_impl;
+
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    using check_fn =
+        void(*)(keepalive_hook&, clock_type::time_point);
+
+private:
+    keepalive_hook* prev_ = nullptr;
+    keepalive_hook* next_ = nullptr;
+    std::atomic<keepalive_service*> svc_{nullptr};
+    check_fn check_ = nullptr;
+    clock_type::duration period_{};     // time between checks
+    clock_type::time_point due_;        // time of the next check
+
+protected:
+    keepalive_hook() = default;
+
+    inline
+    keepalive_hook(keepalive_hook&& other);
+
+    inline
+    keepalive_hook&
+    operator=(keepalive_hook&& other);
+
+    inline
+    ~keepalive_hook();
+
+    bool
+    ka_linked() const
+    {
+        return svc_.load(std::memory_order_acquire) != nullptr;
+    }
+
+    inline
+    void
+    ka_link(keepalive_service& svc, check_fn check,
+        clock_type::duration period);
+
+    inline
+    void
+    ka_unlink();
+
+private:
+    inline
+    void
+    ka_take(keepalive_hook& other);
+};
+
+// Calls the check function of each linked stream every
+// quarter of the period it asked for, using one timer for
+// all the streams which use the same io_service.
+//
+// Streams checked at the same interval share a queue, which
+// stays in order of their next check since each check puts
+// the stream back at the end. A tick only visits the streams
+// which are due, and the timer waits for the earliest check
+// of any queue. There are as many queues as distinct
+// intervals, which is usually one or a few.
+//
+// The check functions are called with the mutex held, from
+// whichever thread runs the timer. They must not touch the
+// stream beyond posting the real check.
+//
+template<class>
+class keepalive_service_impl
+    : public boost::asio::io_service::service
+{
+    friend class keepalive_hook;
+
+    using clock_type = keepalive_hook::clock_type;
+
+    struct queue
+    {
+        clock_type::duration period;
+        keepalive_hook* head;
+        keepalive_hook* tail;
+    };
+
+    std::mutex m_;
+    std::vector<queue> queues_;
+    clock_type::time_point expiry_;     // when the timer fires
+    bool running_ = false;
+    boost::asio::basic_waitable_timer<clock_type> timer_;
+
+public:
+    static boost::asio::io_service::id id;
+
+    explicit
+    keepalive_service_impl(boost::asio::io_service& ios)
+        : boost::asio::io_service::service(ios)
+        , timer_(ios)
+    {
+    }
+
+    ~keepalive_service_impl()
+    {
+        clear();
+    }
+
+private:
+    void
+    shutdown_service() override
+    {
+        clear();
+        error_code ec;
+        timer_.cancel(ec);
+    }
+
+    void
+    clear()
+    {
+        std::lock_guard<std::mutex> lock{m_};
+        for(auto& q : queues_)
+        {
+            while(q.head)
+            {
+                auto const h = q.head;
+                q.head = h->next_;
+                h->prev_ = nullptr;
+                h->next_ = nullptr;
+                h->svc_.store(nullptr, std::memory_order_release);
+            }
+        }
+        queues_.clear();
+    }
+
+    // Called with the mutex held
+    queue&
+    find(clock_type::duration period)
+    {
+        for(auto& q : queues_)
+            if(q.period == period)
+                return q;
+        BOOST_ASSERT(false);
+        return queues_.front();
+    }
+
+    // Called with the mutex held
+    static
+    void
+    push(queue& q, keepalive_hook& h)
+    {
+        h.prev_ = q.tail;
+        h.next_ = nullptr;
+        if(q.tail)
+            q.tail->next_ = &h;
+        else
+            q.head = &h;
+        q.tail = &h;
+    }
+
+    // Called with the mutex held
+    static
+    void
+    pop(queue& q, keepalive_hook& h)
+    {
+        if(h.prev_)
+            h.prev_->next_ = h.next_;
+        else
+            q.head = h.next_;
+        if(h.next_)
+            h.next_->prev_ = h.prev_;
+        else
+            q.tail = h.prev_;
+        h.prev_ = nullptr;
+        h.next_ = nullptr;
+    }
+
+    // Called with the mutex held
+    void
+    insert(keepalive_hook& h, clock_type::duration period)
+    {
+        h.period_ = (std::max)(period / 4,
+            clock_type::duration{std::chrono::milliseconds(1)});
+        h.due_ = clock_type::now() + h.period_;
+        auto it = std::find_if(queues_.begin(), queues_.end(),
+            [&](queue const& q)
+            {
+                return q.period == h.period_;
+            });
+        if(it == queues_.end())
+            it = queues_.insert(queues_.end(),
+                queue{h.period_, nullptr, nullptr});
+        push(*it, h);
+        if(! running_ || h.due_ < expiry_)
+            start(h.due_);
+    }
+
+    // Called with the mutex held
+    void
+    remove(keepalive_hook& h)
+    {
+        auto& q = find(h.period_);
+        pop(q, h);
+        if(q.head)
+            return;
+        queues_.erase(queues_.begin() + (&q - queues_.data()));
+        if(! running_)
+            return;
+        // The timer may have been set for the queue
+        // which is gone, so wait for the next check
+        // that is actually due.
+        if(queues_.empty())
+        {
+            running_ = false;
+            error_code ec;
+            timer_.cancel(ec);
+            return;
+        }
+        auto const when = earliest();
+        if(when != expiry_)
+            start(when);
+    }
+
+    // Move the place of `from` in its queue to `to`.
+    // Called with the mutex held.
+    void
+    replace(keepalive_hook& from, keepalive_hook& to)
+    {
+        auto& q = find(from.period_);
+        to.prev_ = from.prev_;
+        to.next_ = from.next_;
+        if(to.prev_)
+            to.prev_->next_ = &to;
+        else
+            q.head = &to;
+        if(to.next_)
+            to.next_->prev_ = &to;
+        else
+            q.tail = &to;
+        from.prev_ = nullptr;
+        from.next_ = nullptr;
+    }
+
+    // Returns the time of the earliest check.
+    // Called with the mutex held.
+    clock_type::time_point
+    earliest() const
+    {
+        auto when = (clock_type::time_point::max)();
+        for(auto const& q : queues_)
+            if(q.head->due_ < when)
+                when = q.head->due_;
+        return when;
+    }
+
+    // Setting the expiry cancels a wait in progress,
+    // which then completes with operation_aborted.
+    // Called with the mutex held.
+    void
+    start(clock_type::time_point when)
+    {
+        running_ = true;
+        expiry_ = when;
+        timer_.expires_at(when);
+        timer_.async_wait(
+            [this](error_code ec)
+            {
+                on_timer(ec);
+            });
+    }
+
+    void
+    on_timer(error_code ec)
+    {
+        if(ec == boost::asio::error::operation_aborted)
+            return;
+        std::lock_guard<std::mutex> lock{m_};
+        if(queues_.empty())
+        {
+            running_ = false;
+            return;
+        }
+        auto const now = clock_type::now();
+        for(auto& q : queues_)
+        {
+            while(q.head->due_ <= now)
+            {
+                auto& h = *q.head;
+                pop(q, h);
+                h.due_ = now + q.period;
+                push(q, h);
+                h.check_(h, now);
+            }
+        }
+        start(earliest());
+    }
+};
+
+template<class _>
+boost::asio::io_service::id
+keepalive_service_impl<_>::id;
+
+keepalive_hook::
+keepalive_hook(keepalive_hook&& other)
+    : check_(other.check_)
+{
+    ka_take(other);
+}
+
+keepalive_hook&
+keepalive_hook::
+operator=(keepalive_hook&& other)
+{
+    ka_unlink();
+    check_ = other.check_;
+    ka_take(other);
+    return *this;
+}
+
+keepalive_hook::
+~keepalive_hook()
+{
+    ka_unlink();
+}
+
+void
+keepalive_hook::
+ka_link(keepalive_service& svc, check_fn check,
+    clock_type::duration period)
+{
+    ka_unlink();
+    std::lock_guard<std::mutex> lock{svc.m_};
+    svc_.store(&svc, std::memory_order_release);
+    check_ = check;
+    svc.insert(*this, period);
+}
+
+// The service clears `svc_` under its mutex when it shuts
+// down, so it is checked again once the mutex is held.
+//
+void
+keepalive_hook::
+ka_unlink()
+{
+    auto const svc = svc_.load(std::memory_order_acquire);
+    if(! svc)
+        return;
+    std::lock_guard<std::mutex> lock{svc->m_};
+    if(svc_.load(std::memory_order_relaxed) != svc)
+        return;
+    svc->remove(*this);
+    svc_.store(nullptr, std::memory_order_release);
+}
+
+void
+keepalive_hook::
+ka_take(keepalive_hook& other)
+{
+    auto const svc = other.svc_.load(std::memory_order_acquire);
+    if(! svc)
+        return;
+    std::lock_guard<std::mutex> lock{svc->m_};
+    if(other.svc_.load(std::memory_order_relaxed) != svc)
+        return;
+    period_ = other.period_;
+    due_ = other.due_;
+    svc->replace(other, *this);
+    svc_.store(svc, std::memory_order_release);
+    other.svc_.store(nullptr, std::memory_order_release);
+}
+
+} // detail
+} // websocket
+} // beast
+
+#endif
@@ -118,7 +118,7 @@ class pausation
         saved_op(Op&& op)
         {
             using boost::asio::asio_handler_allocate;
-            new(asio_handler_allocate(sizeof(Op),
+            op_ = new(asio_handler_allocate(sizeof(Op),
                 std::addressof(op.handler()))) Op{
                     std::move(op)};
         }
@@ -128,9 +128,10 @@ class pausation
         {
             BOOST_ASSERT(op_);
             Op op{std::move(*op_)};
+            op_->~Op();
             using boost::asio::asio_handler_deallocate;
             asio_handler_deallocate(op_,
-                sizeof(*op_), std::addressof(op_->handler()));
+                sizeof(*op_), std::addressof(op.handler()));
             op_ = nullptr;
             op();
         }
@@ -16,6 +16,13 @@
 #include <beast/websocket/option.hpp>
 #include <beast/http/rfc7230.hpp>
 #include <boost/asio/buffer.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <new>
 #include <utility>
 
 namespace beast {
@@ -64,12 +71,11 @@ parse_bits(string_view s)
     return i;
 }
 
-// Parse permessage-deflate request fields
+// Parse a permessage-deflate extensions field value
 //
-template<class Allocator>
+template<class = void>
 void
-pmd_read(pmd_offer& offer,
-    http::basic_fields<Allocator> const& fields)
+pmd_read(pmd_offer& offer, string_view value)
 {
     offer.accept = false;
     offer.server_max_window_bits= 0;
@@ -77,8 +83,7 @@ pmd_read(pmd_offer& offer,
     offer.server_no_context_takeover = false;
     offer.client_no_context_takeover = false;
 
-    http::ext_list list{
-        fields["Sec-WebSocket-Extensions"]};
+    http::ext_list list{value};
     for(auto const& ext : list)
     {
         if(iequals(ext.first, "permessage-deflate"))
@@ -193,6 +198,16 @@ pmd_read(pmd_offer& offer,
     }
 }
 
+// Parse permessage-deflate request fields
+//
+template<class Allocator>
+void
+pmd_read(pmd_offer& offer,
+    http::basic_fields<Allocator> const& fields)
+{
+    pmd_read(offer, fields["Sec-WebSocket-Extensions"]);
+}
+
 // Set permessage-deflate fields for a client offer
 //
 template<class Allocator>
@@ -239,16 +254,18 @@ pmd_write(http::basic_fields<Allocator>& fields,
     fields.set(http::field::sec_websocket_extensions, s);
 }
 
-// Negotiate a permessage-deflate client offer
+// Negotiate a permessage-deflate client offer,
+// producing the extensions field value in `s`
 //
-template<class Allocator>
+template<class = void>
 void
 pmd_negotiate(
-    http::basic_fields<Allocator>& fields,
+    static_string<512>& s,
     pmd_offer& config,
     pmd_offer const& offer,
     permessage_deflate const& o)
 {
+    s.clear();
     if(! (offer.accept && o.server_enable))
     {
         config.accept = false;
@@ -256,7 +273,7 @@ pmd_negotiate(
     }
     config.accept = true;
 
-    static_string<512> s = "permessage-deflate";
+    s = "permessage-deflate";
 
     config.server_no_context_takeover =
         offer.server_no_context_takeover ||
@@ -279,12 +296,6 @@ pmd_negotiate(
             o.server_max_window_bits;
     if(config.server_max_window_bits < 15)
     {
-        // ZLib's deflateInit silently treats 8 as
-        // 9 due to a bug, so prevent 8 from being used.
-        //
-        if(config.server_max_window_bits < 9)
-            config.server_max_window_bits = 9;
-
         s += "; server_max_window_bits=";
         s += to_static_string(
             config.server_max_window_bits);
@@ -328,6 +339,22 @@ pmd_negotiate(
             config.client_max_window_bits);
         break;
     }
+    if(! config.accept)
+        s.clear();
+}
+
+// Negotiate a permessage-deflate client offer
+//
+template<class Allocator>
+void
+pmd_negotiate(
+    http::basic_fields<Allocator>& fields,
+    pmd_offer& config,
+    pmd_offer const& offer,
+    permessage_deflate const& o)
+{
+    static_string<512> s;
+    pmd_negotiate(s, config, offer, o);
     if(config.accept)
         fields.set(http::field::sec_websocket_extensions, s);
 }
@@ -351,6 +378,332 @@ pmd_normalize(pmd_offer& offer)
 
 //--------------------------------------------------------------------
 
+/*  A per-thread cache of compressor and decompressor storage.
+
+    When context takeover is disabled, the streams give their
+    buffers back at the end of each message and lease them again
+    from here for the next one, so idle connections hold no
+    window or hash tables. A few blocks are retained per thread.
+
+    Storage may be given back on a different thread than the one
+    it came from, and after the pool of the current thread is
+    destroyed at thread exit, for example by a stream owned by a
+    static or thread_local object. Once the pool is gone, storage
+    goes directly to and from the global heap.
+*/
+class pmd_pool
+{
+    struct block
+    {
+        void* p = nullptr;
+        std::size_t n = 0;
+    };
+
+    block v_[8];
+
+    pmd_pool() = default;
+
+    ~pmd_pool()
+    {
+        for(auto const& b : v_)
+            if(b.p)
+                ::operator delete(b.p);
+        destroyed() = true;
+    }
+
+    // Trivially destructible, so it may be
+    // read after the pool itself is destroyed.
+    static
+    bool&
+    destroyed()
+    {
+        static thread_local bool b = false;
+        return b;
+    }
+
+    static
+    pmd_pool*
+    get()
+    {
+        if(destroyed())
+            return nullptr;
+        static thread_local pmd_pool pool;
+        return &pool;
+    }
+
+public:
+    static
+    void*
+    allocate(std::size_t n)
+    {
+        if(auto const pool = get())
+        {
+            for(auto& b : pool->v_)
+            {
+                if(b.p && b.n == n)
+                {
+                    auto const p = b.p;
+                    b.p = nullptr;
+                    return p;
+                }
+            }
+        }
+        return ::operator new(n);
+    }
+
+    static
+    void
+    deallocate(void* p, std::size_t n)
+    {
+        if(auto const pool = get())
+        {
+            for(auto& b : pool->v_)
+            {
+                if(! b.p)
+                {
+                    b.p = p;
+                    b.n = n;
+                    return;
+                }
+            }
+        }
+        ::operator delete(p);
+    }
+};
+
+// Allocator for the permessage-deflate streams
+template<class T>
+struct pmd_allocator
+{
+    using value_type = T;
+
+    pmd_allocator() = default;
+
+    template<class U>
+    pmd_allocator(pmd_allocator<U> const&)
+    {
+    }
+
+    T*
+    allocate(std::size_t n)
+    {
+        return static_cast<T*>(
+            pmd_pool::allocate(n * sizeof(T)));
+    }
+
+    void
+    deallocate(T* p, std::size_t n)
+    {
+        pmd_pool::deallocate(p, n * sizeof(T));
+    }
+
+    friend
+    bool
+    operator==(pmd_allocator const&, pmd_allocator const&)
+    {
+        return true;
+    }
+
+    friend
+    bool
+    operator!=(pmd_allocator const&, pmd_allocator const&)
+    {
+        return false;
+    }
+};
+
+/*  Adapts compression to the results achieved on a connection.
+
+    The ratio and the time spent compressing are measured for each
+    message. The level is lowered when each byte saved costs too
+    much time, and raised back towards the configured level when it
+    is cheap. After several messages in a row which do not shrink,
+    compression is paused for a while.
+*/
+class pmd_policy
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+
+private:
+    // Nanoseconds spent per byte saved
+    static std::size_t constexpr max_cost = 50;
+    static std::size_t constexpr min_cost = 20;
+
+    // Messages which do not shrink before pausing, and
+    // the number of messages to send uncompressed
+    static unsigned constexpr max_misses = 4;
+    static unsigned constexpr pause = 16;
+
+    bool enabled_ = false;
+    int level_ = 8;                 // current level
+    int max_level_ = 8;             // configured level
+    unsigned misses_ = 0;           // messages which did not shrink
+    unsigned skip_ = 0;             // messages left to skip
+    std::size_t in_ = 0;            // input bytes this message
+    std::size_t out_ = 0;           // output bytes this message
+    clock_type::duration elapsed_{};
+
+public:
+    void
+    reset(bool enabled, int level)
+    {
+        enabled_ = enabled;
+        level_ = level;
+        max_level_ = level;
+        misses_ = 0;
+        skip_ = 0;
+        in_ = 0;
+        out_ = 0;
+        elapsed_ = {};
+    }
+
+    int
+    level() const
+    {
+        return level_;
+    }
+
+    // Returns `false` if the next message should not be compressed
+    bool
+    begin()
+    {
+        if(skip_ == 0)
+            return true;
+        --skip_;
+        return false;
+    }
+
+    clock_type::time_point
+    start() const
+    {
+        if(! enabled_)
+            return {};
+        return clock_type::now();
+    }
+
+    // Record a call to deflate which began at `when`
+    void
+    stop(clock_type::time_point when,
+        std::size_t in, std::size_t out)
+    {
+        in_ += in;
+        out_ += out;
+        if(enabled_)
+            elapsed_ += clock_type::now() - when;
+    }
+
+    // Called when a compressed message is complete
+    template<class DeflateStream>
+    void
+    end(DeflateStream& zo)
+    {
+        auto const in = in_;
+        auto const out = out_;
+        auto const ns = std::chrono::duration_cast<
+            std::chrono::nanoseconds>(elapsed_).count();
+        in_ = 0;
+        out_ = 0;
+        elapsed_ = {};
+        if(! enabled_ || in < 64)
+            return;
+        if(out * 100 >= in * 95)
+        {
+            if(++misses_ >= max_misses)
+            {
+                misses_ = 0;
+                skip_ = pause;
+            }
+            return;
+        }
+        misses_ = 0;
+        auto const cost =
+            static_cast<std::size_t>(ns) / (in - out);
+        auto level = level_;
+        if(cost > max_cost && level_ > 1)
+            --level;
+        else if(cost < min_cost && level_ < max_level_)
+            ++level;
+        if(level == level_)
+            return;
+        level_ = level;
+        zlib::z_params zs;
+        error_code ec;
+        zo.params(zs, level_, zlib::Strategy::normal, ec);
+    }
+};
+
+/*  Predicts the inflated size of received compressed messages.
+
+    The ratio of inflated to compressed bytes and the inflated
+    size of messages are averaged over recent messages, so that
+    the buffer receiving a message can be sized once instead of
+    growing as the message is inflated.
+*/
+class pmd_predictor
+{
+    // Ratios are in sixteenths, deflate
+    // cannot expand by more than 1032:1.
+    static std::size_t constexpr min_ratio = 16;
+    static std::size_t constexpr max_ratio = 1032 * 16;
+
+    std::size_t ratio_ = 4 * 16;    // average ratio
+    std::size_t size_ = 0;          // average inflated size
+    std::uint64_t in_ = 0;          // compressed bytes this message
+
+public:
+    // Record compressed bytes inflated
+    void
+    consume(std::size_t n)
+    {
+        in_ += n;
+    }
+
+    // Called when a compressed message is complete
+    void
+    end(std::uint64_t out)
+    {
+        auto const in = in_;
+        in_ = 0;
+        auto const n = (std::min)(out,
+            std::uint64_t{(std::numeric_limits<
+                std::size_t>::max)() / 4});
+        size_ = (size_ * 3 + static_cast<std::size_t>(n)) / 4;
+        if(in < 64)
+            return;
+        auto const r = (std::max)(+min_ratio,
+            static_cast<std::size_t>((std::min)(
+                out / in * 16 + out % in * 16 / in,
+                    std::uint64_t{max_ratio})));
+        // Rise quickly, fall slowly, so that the buffer is
+        // rarely too small. One highly compressible message
+        // at most doubles the ratio, so that it cannot make
+        // the next buffers huge.
+        if(r > ratio_)
+            ratio_ = (std::min)(r, ratio_ * 2);
+        else
+            ratio_ = (ratio_ * 3 + r) / 4;
+    }
+
+    // Returns the expected size of `n` compressed bytes once inflated
+    std::size_t
+    expect(std::uint64_t n) const
+    {
+        auto const limit = (std::numeric_limits<
+            std::size_t>::max)() / max_ratio;
+        if(n >= limit)
+            return (std::numeric_limits<std::size_t>::max)();
+        return static_cast<std::size_t>(n) * ratio_ / 16;
+    }
+
+    // Returns the expected inflated size of a message
+    std::size_t
+    size() const
+    {
+        return size_;
+    }
+};
+
 // Decompress into a DynamicBuffer
 //
 template<class InflateStream, class DynamicBuffer>
@@ -467,6 +820,62 @@ deflate(
     return true;
 }
 
+// Returns `false` if the sample predicts that deflate
+// will not make the message smaller, for example when
+// the payload is already compressed or encrypted.
+//
+template<class = void>
+bool
+is_compressible(std::uint8_t const* p, std::size_t n)
+{
+    // Too small to judge, and cheap to compress anyway
+    if(n < 512)
+        return true;
+
+    // Count three byte strings seen earlier in the sample,
+    // a rough measure of what the string matcher will find.
+    std::uint16_t head[1024] = {};
+    std::uint16_t freq[256] = {};
+    std::size_t matches = 0;
+    for(std::size_t i = 0; i < n; ++i)
+    {
+        ++freq[p[i]];
+        if(i + 3 > n)
+            continue;
+        auto const h = ((
+            (std::uint32_t{p[i]} << 16) |
+            (std::uint32_t{p[i + 1]} << 8) |
+             std::uint32_t{p[i + 2]}) * 2654435761U) >> 22;
+        auto const j = head[h];
+        if(j != 0 && std::memcmp(p + j - 1, p + i, 3) == 0)
+            ++matches;
+        head[h] = static_cast<std::uint16_t>(i + 1);
+    }
+    if(matches * 8 > n)
+        return true;
+
+    // Without matches only Huffman coding can help, which
+    // depends on the order-0 entropy of the bytes.
+    double bits = 0;
+    for(auto const f : freq)
+        if(f != 0)
+            bits -= f * std::log2(
+                static_cast<double>(f) / n);
+    return bits < 7.5 * n;
+}
+
+// Probe the first kilobyte of a message
+//
+template<class ConstBufferSequence>
+bool
+is_compressible(ConstBufferSequence const& buffers)
+{
+    std::uint8_t buf[1024];
+    auto const n = boost::asio::buffer_copy(
+        boost::asio::buffer(buf), buffers);
+    return is_compressible(buf, n);
+}
+
 } // detail
 } // websocket
 } // beast
@@ -0,0 +1,133 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_DETAIL_POOLED_BUFFER_HPP
+#define BEAST_WEBSOCKET_DETAIL_POOLED_BUFFER_HPP
+
+#include <beast/websocket/detail/pmd_extension.hpp>
+#include <beast/core/static_buffer.hpp>
+#include <boost/asio/buffer.hpp>
+#include <cstddef>
+#include <cstdint>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+// Returns storage to the per-thread pool
+//
+struct pool_deleter
+{
+    std::size_t n = 0;
+
+    void
+    operator()(std::uint8_t* p) const
+    {
+        pmd_pool::deallocate(p, n);
+    }
+};
+
+/*  A circular buffer of N bytes whose storage is leased from
+    the per-thread pool on the first call to prepare, and which
+    may be given back when the buffer is empty. Until storage is
+    leased the buffer is empty, and it reports a capacity of N.
+*/
+template<std::size_t N>
+class pooled_buffer : public static_buffer_base
+{
+    void* p_ = nullptr;
+
+public:
+    pooled_buffer()
+        : static_buffer_base(nullptr, 0)
+    {
+    }
+
+    pooled_buffer(pooled_buffer&& other)
+        : static_buffer_base(nullptr, 0)
+    {
+        using boost::asio::buffer_copy;
+        if(other.size() > 0)
+            this->commit(buffer_copy(
+                this->prepare(other.size()), other.data()));
+        other.consume(other.size());
+        other.release();
+    }
+
+    pooled_buffer&
+    operator=(pooled_buffer&& other)
+    {
+        using boost::asio::buffer_copy;
+        if(this == &other)
+            return *this;
+        this->consume(this->size());
+        if(other.size() > 0)
+            this->commit(buffer_copy(
+                this->prepare(other.size()), other.data()));
+        other.consume(other.size());
+        other.release();
+        return *this;
+    }
+
+    ~pooled_buffer()
+    {
+        if(p_)
+            pmd_pool::deallocate(p_, N);
+    }
+
+    std::size_t
+    max_size() const
+    {
+        return N;
+    }
+
+    std::size_t
+    capacity() const
+    {
+        return N;
+    }
+
+    mutable_buffers_type
+    prepare(std::size_t n)
+    {
+        lease();
+        return static_buffer_base::prepare(n);
+    }
+
+    // Returns `true` if storage is leased
+    bool
+    leased() const
+    {
+        return p_ != nullptr;
+    }
+
+    void
+    lease()
+    {
+        if(p_)
+            return;
+        p_ = pmd_pool::allocate(N);
+        this->reset(p_, N);
+    }
+
+    // Give the storage back if the buffer is empty
+    void
+    release()
+    {
+        if(! p_ || this->size() > 0)
+            return;
+        pmd_pool::deallocate(p_, N);
+        p_ = nullptr;
+        this->reset(nullptr, 0);
+    }
+};
+
+} // detail
+} // websocket
+} // beast
+
+#endif
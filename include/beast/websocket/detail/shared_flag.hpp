@@ -0,0 +1,62 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_DETAIL_SHARED_FLAG_HPP
+#define BEAST_WEBSOCKET_DETAIL_SHARED_FLAG_HPP
+
+#include <atomic>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+// A boolean which may be set by the read half of a split
+// stream while the write half reads it, or the other way
+// around. Unlike std::atomic, the flag is movable so that
+// the stream stays movable. Moving is not thread safe.
+//
+class shared_flag
+{
+    std::atomic<bool> v_;
+
+public:
+    shared_flag(bool v = false)
+        : v_(v)
+    {
+    }
+
+    shared_flag(shared_flag&& other)
+        : v_(other.v_.load(std::memory_order_relaxed))
+    {
+    }
+
+    shared_flag&
+    operator=(shared_flag&& other)
+    {
+        v_.store(other.v_.load(std::memory_order_relaxed),
+            std::memory_order_relaxed);
+        return *this;
+    }
+
+    shared_flag&
+    operator=(bool v)
+    {
+        v_.store(v, std::memory_order_relaxed);
+        return *this;
+    }
+
+    operator bool() const
+    {
+        return v_.load(std::memory_order_relaxed);
+    }
+};
+
+} // detail
+} // websocket
+} // beast
+
+#endif
@@ -0,0 +1,352 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_DETAIL_STATS_HPP
+#define BEAST_WEBSOCKET_DETAIL_STATS_HPP
+
+#include <beast/websocket/stats.hpp>
+#include <beast/websocket/detail/frame.hpp>
+#include <beast/websocket/detail/shared_flag.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+// Accumulates the statistics of a stream.
+//
+// The values live in a block which is only allocated when
+// statistics are first turned on, so a stream which never
+// collects them carries a pointer and a flag. Every update
+// starts with a test of the flag, so that such a stream pays
+// for one predictable branch and never reads the clock.
+//
+// Each value is a relaxed atomic, since the read half and the
+// write half of a split stream both send frames and both
+// apply the mask, and stats() may be called from any thread.
+// Relaxed operations are enough, as no other memory is
+// published through them.
+//
+class stats_collector
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+
+private:
+    using count = std::atomic<std::uint64_t>;
+    using time_count = std::atomic<stream_stats::duration::rep>;
+
+    struct values
+    {
+        count messages_in{0};
+        count messages_out{0};
+        count frames_in{0};
+        count frames_out{0};
+        count wire_bytes_in{0};
+        count wire_bytes_out{0};
+        count payload_bytes_in{0};
+        count payload_bytes_out{0};
+        count inflate_bytes_in{0};
+        count inflate_bytes_out{0};
+        count deflate_bytes_in{0};
+        count deflate_bytes_out{0};
+        count pings_in{0};
+        count pings_out{0};
+        count pongs_in{0};
+        count pongs_out{0};
+        time_count inflate_time{0};
+        time_count deflate_time{0};
+        time_count mask_time{0};
+        time_count read_wait_time{0};
+        time_count write_wait_time{0};
+
+        // When the suspended read or write was
+        // suspended. Each is only touched by the
+        // operation which is suspended.
+        clock_type::time_point read_since{};
+        clock_type::time_point write_since{};
+    };
+
+    std::unique_ptr<values> v_;
+    shared_flag on_;
+
+    static
+    void
+    add(count& c, std::uint64_t n)
+    {
+        c.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    static
+    void
+    add(time_count& c, clock_type::time_point since)
+    {
+        c.fetch_add((clock_type::now() - since).count(),
+            std::memory_order_relaxed);
+    }
+
+    template<class T>
+    static
+    T
+    load(std::atomic<T> const& c)
+    {
+        return c.load(std::memory_order_relaxed);
+    }
+
+public:
+    // Adds the time from construction to
+    // destruction, if statistics are enabled.
+    class scoped_timer
+    {
+        time_count* d_;
+        clock_type::time_point when_;
+
+    public:
+        scoped_timer(scoped_timer&& other)
+            : d_(other.d_)
+            , when_(other.when_)
+        {
+            other.d_ = nullptr;
+        }
+
+        explicit
+        scoped_timer(time_count* d)
+            : d_(d)
+        {
+            if(d_)
+                when_ = clock_type::now();
+        }
+
+        ~scoped_timer()
+        {
+            if(d_)
+                add(*d_, when_);
+        }
+    };
+
+    bool
+    enabled() const
+    {
+        return on_;
+    }
+
+    void
+    enable(bool value)
+    {
+        if(value && ! v_)
+            v_.reset(new values);
+        on_ = value;
+    }
+
+    stream_stats
+    get() const
+    {
+        using duration = stream_stats::duration;
+        stream_stats s;
+        if(! v_)
+            return s;
+        auto const& v = *v_;
+        s.messages_in = load(v.messages_in);
+        s.messages_out = load(v.messages_out);
+        s.frames_in = load(v.frames_in);
+        s.frames_out = load(v.frames_out);
+        s.wire_bytes_in = load(v.wire_bytes_in);
+        s.wire_bytes_out = load(v.wire_bytes_out);
+        s.payload_bytes_in = load(v.payload_bytes_in);
+        s.payload_bytes_out = load(v.payload_bytes_out);
+        s.inflate_bytes_in = load(v.inflate_bytes_in);
+        s.inflate_bytes_out = load(v.inflate_bytes_out);
+        s.deflate_bytes_in = load(v.deflate_bytes_in);
+        s.deflate_bytes_out = load(v.deflate_bytes_out);
+        s.pings_in = load(v.pings_in);
+        s.pings_out = load(v.pings_out);
+        s.pongs_in = load(v.pongs_in);
+        s.pongs_out = load(v.pongs_out);
+        s.inflate_time = duration{load(v.inflate_time)};
+        s.deflate_time = duration{load(v.deflate_time)};
+        s.mask_time = duration{load(v.mask_time)};
+        s.read_wait_time = duration{load(v.read_wait_time)};
+        s.write_wait_time = duration{load(v.write_wait_time)};
+        return s;
+    }
+
+    void
+    reset()
+    {
+        if(! v_)
+            return;
+        auto& v = *v_;
+        for(auto c : {
+            &v.messages_in, &v.messages_out,
+            &v.frames_in, &v.frames_out,
+            &v.wire_bytes_in, &v.wire_bytes_out,
+            &v.payload_bytes_in, &v.payload_bytes_out,
+            &v.inflate_bytes_in, &v.inflate_bytes_out,
+            &v.deflate_bytes_in, &v.deflate_bytes_out,
+            &v.pings_in, &v.pings_out,
+            &v.pongs_in, &v.pongs_out})
+            c->store(0, std::memory_order_relaxed);
+        for(auto c : {
+            &v.inflate_time, &v.deflate_time, &v.mask_time,
+            &v.read_wait_time, &v.write_wait_time})
+            c->store(0, std::memory_order_relaxed);
+    }
+
+    // Time the enclosing scope
+    scoped_timer
+    time_inflate()
+    {
+        return scoped_timer{on_ ? &v_->inflate_time : nullptr};
+    }
+
+    // Time the enclosing scope
+    scoped_timer
+    time_deflate()
+    {
+        return scoped_timer{on_ ? &v_->deflate_time : nullptr};
+    }
+
+    // Time the enclosing scope
+    scoped_timer
+    time_mask()
+    {
+        return scoped_timer{on_ ? &v_->mask_time : nullptr};
+    }
+
+    // Called when a read suspends behind a write
+    void
+    on_read_suspend()
+    {
+        if(! on_)
+            return;
+        v_->read_since = clock_type::now();
+    }
+
+    // Called when the suspended read resumes
+    void
+    on_read_resume()
+    {
+        if(! on_ || v_->read_since == clock_type::time_point{})
+            return;
+        add(v_->read_wait_time, v_->read_since);
+        v_->read_since = {};
+    }
+
+    // Called when a write suspends behind another write
+    void
+    on_write_suspend()
+    {
+        if(! on_)
+            return;
+        v_->write_since = clock_type::now();
+    }
+
+    // Called when the suspended write resumes
+    void
+    on_write_resume()
+    {
+        if(! on_ || v_->write_since == clock_type::time_point{})
+            return;
+        add(v_->write_wait_time, v_->write_since);
+        v_->write_since = {};
+    }
+
+    // Called when a frame header is received
+    void
+    on_frame_in(frame_header const& fh, std::size_t header)
+    {
+        if(! on_)
+            return;
+        add(v_->frames_in, 1);
+        add(v_->wire_bytes_in, header + fh.len);
+        if(fh.op == opcode::ping)
+            add(v_->pings_in, 1);
+        else if(fh.op == opcode::pong)
+            add(v_->pongs_in, 1);
+    }
+
+    // Called when a frame header is prepared for sending
+    void
+    on_frame_out(frame_header const& fh)
+    {
+        if(! on_)
+            return;
+        std::size_t header = 2;
+        if(fh.len > 65535)
+            header += 8;
+        else if(fh.len > 125)
+            header += 2;
+        if(fh.mask)
+            header += 4;
+        on_frame_out(header + fh.len, fh.op);
+    }
+
+    // Called when a frame of a prepared message is sent
+    void
+    on_frame_out(std::uint64_t bytes, opcode op)
+    {
+        if(! on_)
+            return;
+        add(v_->frames_out, 1);
+        add(v_->wire_bytes_out, bytes);
+        if(op == opcode::ping)
+            add(v_->pings_out, 1);
+        else if(op == opcode::pong)
+            add(v_->pongs_out, 1);
+    }
+
+    // Called when a read delivers message payload
+    void
+    on_read(std::size_t bytes, bool done)
+    {
+        if(! on_)
+            return;
+        add(v_->payload_bytes_in, bytes);
+        if(done)
+            add(v_->messages_in, 1);
+    }
+
+    // Called when a write finishes sending message payload
+    void
+    on_write(std::uint64_t bytes, bool fin)
+    {
+        if(! on_)
+            return;
+        add(v_->payload_bytes_out, bytes);
+        if(fin)
+            add(v_->messages_out, 1);
+    }
+
+    // Called after the decompressor runs
+    void
+    on_inflate(std::size_t in, std::size_t out)
+    {
+        if(! on_)
+            return;
+        add(v_->inflate_bytes_in, in);
+        add(v_->inflate_bytes_out, out);
+    }
+
+    // Called after the compressor runs
+    void
+    on_deflate(std::size_t in, std::size_t out)
+    {
+        if(! on_)
+            return;
+        add(v_->deflate_bytes_in, in);
+        add(v_->deflate_bytes_out, out);
+    }
+};
+
+} // detail
+} // websocket
+} // beast
+
+#endif
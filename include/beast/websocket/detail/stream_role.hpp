@@ -0,0 +1,123 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_DETAIL_STREAM_ROLE_HPP
+#define BEAST_WEBSOCKET_DETAIL_STREAM_ROLE_HPP
+
+#include <beast/websocket/stream_fwd.hpp>
+#include <beast/websocket/detail/mask.hpp>
+#include <boost/assert.hpp>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+// Holds the role dependent state of a stream. When the
+// role is fixed at compile time, is_client() is a constant
+// and the branches which test it fold away. A server holds
+// nothing, so it costs nothing as an empty base.
+//
+template<class Role>
+class stream_role;
+
+template<>
+class stream_role<any_role>
+{
+    maskgen maskgen_;
+    bool client_ = false;
+
+protected:
+    bool
+    is_client() const
+    {
+        return client_;
+    }
+
+    void
+    set_client(bool client)
+    {
+        client_ = client;
+    }
+
+    maskgen::result_type
+    mask_key()
+    {
+        return maskgen_();
+    }
+
+    maskgen&
+    mask_gen()
+    {
+        return maskgen_;
+    }
+};
+
+template<>
+class stream_role<client_role>
+{
+    maskgen maskgen_;
+
+protected:
+    static constexpr
+    bool
+    is_client()
+    {
+        return true;
+    }
+
+    void
+    set_client(bool client)
+    {
+        BOOST_ASSERT(client);
+        (void)client;
+    }
+
+    maskgen::result_type
+    mask_key()
+    {
+        return maskgen_();
+    }
+
+    maskgen&
+    mask_gen()
+    {
+        return maskgen_;
+    }
+};
+
+template<>
+class stream_role<server_role>
+{
+protected:
+    static constexpr
+    bool
+    is_client()
+    {
+        return false;
+    }
+
+    void
+    set_client(bool client)
+    {
+        BOOST_ASSERT(! client);
+        (void)client;
+    }
+
+    // Never called, since servers do not mask
+    maskgen::result_type
+    mask_key()
+    {
+        BOOST_ASSERT(false);
+        return 0;
+    }
+};
+
+} // detail
+} // websocket
+} // beast
+
+#endif
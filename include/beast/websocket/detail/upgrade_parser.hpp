@@ -0,0 +1,267 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_DETAIL_UPGRADE_PARSER_HPP
+#define BEAST_WEBSOCKET_DETAIL_UPGRADE_PARSER_HPP
+
+#include <beast/websocket/detail/hybi13.hpp>
+#include <beast/websocket/detail/pmd_extension.hpp>
+#include <beast/core/static_string.hpp>
+#include <beast/core/string.hpp>
+#include <beast/http/basic_parser.hpp>
+#include <beast/http/empty_body.hpp>
+#include <beast/http/message.hpp>
+#include <beast/http/rfc7230.hpp>
+#include <boost/optional.hpp>
+#include <cstdint>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+// Holds a complete 101 response produced without a message
+using upgrade_response_buffer = static_string<768>;
+
+/*  A parser for the WebSocket Upgrade request which does not allocate.
+
+    Instead of storing the fields in a container, each field which
+    the handshake depends on is inspected as it arrives and only the
+    outcome is kept, in fixed storage. As with `fields::operator[]`,
+    only the first occurrence of each field is considered.
+
+    A request which is not acceptable, or which must be given to a
+    decorator, is turned back into a message with make_request.
+    The message carries everything the response depends on.
+*/
+class upgrade_parser
+    : public http::basic_parser<true, upgrade_parser>
+{
+    friend class http::basic_parser<true, upgrade_parser>;
+
+    enum : unsigned
+    {
+        seen_host       = 1,
+        seen_connection = 2,
+        seen_upgrade    = 4,
+        seen_key        = 8,
+        seen_version    = 16,
+        seen_extensions = 32
+    };
+
+    unsigned seen_ = 0;
+
+public:
+    http::verb method = http::verb::unknown;
+    int version = 0;
+
+    // `true` if the Connection field has the "upgrade" token
+    bool connection_upgrade = false;
+
+    // `true` if the Upgrade field has the "websocket" token
+    bool upgrade_websocket = false;
+
+    // Sec-WebSocket-Key, one character longer than
+    // the largest valid key so that a key which is
+    // too long can still be told apart.
+    static_string<sec_ws_key_type::max_size_n + 1> key;
+
+    // Sec-WebSocket-Version, truncated the same way
+    static_string<3> ws_version;
+
+    // The permessage-deflate offer, if any
+    pmd_offer offer;
+
+    upgrade_parser()
+    {
+        pmd_read(offer, string_view{});
+    }
+
+    // Returns `true` if the Host field is present
+    bool
+    has_host() const
+    {
+        return (seen_ & seen_host) != 0;
+    }
+
+    // Returns `true` if the Sec-WebSocket-Key field is present
+    bool
+    has_key() const
+    {
+        return (seen_ & seen_key) != 0;
+    }
+
+    // Returns `true` if the Sec-WebSocket-Version field is present
+    bool
+    has_ws_version() const
+    {
+        return (seen_ & seen_version) != 0;
+    }
+
+    /** Returns `true` if the request may be accepted.
+
+        This performs the same checks as building the response
+        from a message, and additionally requires HTTP/1.1 so
+        that the response can be written from a template.
+    */
+    bool
+    acceptable() const
+    {
+        return
+            version == 11 &&
+            method == http::verb::get &&
+            connection_upgrade &&
+            upgrade_websocket &&
+            has_host() &&
+            has_key() &&
+            key.size() <= sec_ws_key_type::max_size_n &&
+            has_ws_version() &&
+            ws_version == "13";
+    }
+
+    // Returns the request as a message
+    http::request<http::empty_body>
+    make_request() const
+    {
+        http::request<http::empty_body> req;
+        req.version = version;
+        if(method != http::verb::unknown)
+            req.method(method);
+        else
+            // Only the absence of GET matters to the response
+            req.method_string("UNKNOWN");
+        if(connection_upgrade)
+            req.set(http::field::connection, "upgrade");
+        if(upgrade_websocket)
+            req.set(http::field::upgrade, "websocket");
+        if(has_host())
+            req.set(http::field::host, "");
+        if(has_key())
+            req.set(http::field::sec_websocket_key, key);
+        if(has_ws_version())
+            req.set(http::field::sec_websocket_version, ws_version);
+        if(offer.accept)
+            pmd_write(req, offer);
+        return req;
+    }
+
+private:
+    bool
+    first(unsigned f)
+    {
+        if(seen_ & f)
+            return false;
+        seen_ |= f;
+        return true;
+    }
+
+    void
+    on_request_impl(http::verb method_, string_view,
+        string_view, int version_, error_code& ec)
+    {
+        method = method_;
+        version = version_;
+        ec.assign(0, ec.category());
+    }
+
+    void
+    on_response_impl(int, string_view, int, error_code& ec)
+    {
+        ec.assign(0, ec.category());
+    }
+
+    void
+    on_field_impl(http::field name, string_view,
+        string_view value, error_code& ec)
+    {
+        switch(name)
+        {
+        case http::field::host:
+            first(seen_host);
+            break;
+
+        case http::field::connection:
+            if(first(seen_connection))
+                connection_upgrade = http::token_list{
+                    value}.exists("upgrade");
+            break;
+
+        case http::field::upgrade:
+            if(first(seen_upgrade))
+                upgrade_websocket = http::token_list{
+                    value}.exists("websocket");
+            break;
+
+        case http::field::sec_websocket_key:
+            if(first(seen_key))
+                key = value.substr(0, key.max_size());
+            break;
+
+        case http::field::sec_websocket_version:
+            if(first(seen_version))
+                ws_version = value.substr(
+                    0, ws_version.max_size());
+            break;
+
+        case http::field::sec_websocket_extensions:
+            if(first(seen_extensions))
+                pmd_read(offer, value);
+            break;
+
+        default:
+            break;
+        }
+        ec.assign(0, ec.category());
+    }
+
+    void
+    on_header_impl(error_code& ec)
+    {
+        ec.assign(0, ec.category());
+    }
+
+    void
+    on_body_init_impl(
+        boost::optional<std::uint64_t> const&,
+        error_code& ec)
+    {
+        ec.assign(0, ec.category());
+    }
+
+    std::size_t
+    on_body_impl(string_view s, error_code& ec)
+    {
+        ec.assign(0, ec.category());
+        return s.size();
+    }
+
+    void
+    on_chunk_header_impl(std::uint64_t,
+        string_view, error_code& ec)
+    {
+        ec.assign(0, ec.category());
+    }
+
+    std::size_t
+    on_chunk_body_impl(std::uint64_t,
+        string_view s, error_code& ec)
+    {
+        ec.assign(0, ec.category());
+        return s.size();
+    }
+
+    void
+    on_finish_impl(error_code& ec)
+    {
+        ec.assign(0, ec.category());
+    }
+};
+
+} // detail
+} // websocket
+} // beast
+
+#endif
@@ -27,7 +27,10 @@ enum class error
     handshake_failed,
 
     /// buffer overflow
-    buffer_overflow
+    buffer_overflow,
+
+    /// The connection was idle, or the peer did not respond, for too long
+    timeout
 };
 
 } // websocket
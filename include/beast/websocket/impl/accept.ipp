@@ -9,6 +9,7 @@
 #define BEAST_WEBSOCKET_IMPL_ACCEPT_IPP
 
 #include <beast/websocket/detail/type_traits.hpp>
+#include <beast/websocket/detail/upgrade_parser.hpp>
 #include <beast/http/empty_body.hpp>
 #include <beast/http/parser.hpp>
 #include <beast/http/read.hpp>
@@ -20,6 +21,7 @@
 #include <boost/asio/handler_alloc_hook.hpp>
 #include <boost/asio/handler_continuation_hook.hpp>
 #include <boost/asio/handler_invoke_hook.hpp>
+#include <boost/asio/write.hpp>
 #include <boost/assert.hpp>
 #include <boost/throw_exception.hpp>
 #include <memory>
@@ -29,19 +31,36 @@ namespace beast {
 namespace websocket {
 
 // Respond to an upgrade HTTP request
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Handler>
-class stream<NextLayer>::response_op
+class stream<NextLayer, Role>::response_op
 {
     struct data
     {
         bool cont;
-        stream<NextLayer>& ws;
+        stream<NextLayer, Role>& ws;
         response_type res;
+        detail::upgrade_response_buffer fast;
+        detail::pmd_offer config;
+        bool is_fast = false;
         int state = 0;
 
+        template<class Decorator>
+        data(Handler&, stream<NextLayer, Role>& ws_,
+            detail::upgrade_parser const& p,
+                Decorator const& decorator, bool cont_)
+            : cont(cont_)
+            , ws(ws_)
+        {
+            is_fast = ws.build_response(
+                fast, config, p, decorator);
+            if(! is_fast)
+                res = ws.build_response(
+                    p.make_request(), decorator);
+        }
+
         template<class Body, class Allocator, class Decorator>
-        data(Handler&, stream<NextLayer>& ws_, http::request<
+        data(Handler&, stream<NextLayer, Role>& ws_, http::request<
             Body, http::basic_fields<Allocator>> const& req,
                 Decorator const& decorator, bool cont_)
             : cont(cont_)
@@ -52,7 +71,7 @@ class stream<NextLayer>::response_op
 
         template<class Body, class Allocator,
             class Buffers, class Decorator>
-        data(Handler&, stream<NextLayer>& ws_, http::request<
+        data(Handler&, stream<NextLayer, Role>& ws_, http::request<
             Body, http::basic_fields<Allocator>> const& req,
                 Buffers const& buffers, Decorator const& decorator,
                     bool cont_)
@@ -77,7 +96,7 @@ public:
 
     template<class DeducedHandler, class... Args>
     response_op(DeducedHandler&& h,
-            stream<NextLayer>& ws, Args&&... args)
+            stream<NextLayer, Role>& ws, Args&&... args)
         : d_(std::forward<DeducedHandler>(h),
             ws, std::forward<Args>(args)...)
     {
@@ -87,6 +106,11 @@ public:
     void operator()(
         error_code ec, bool again = true);
 
+    void operator()(error_code ec, std::size_t)
+    {
+        (*this)(ec);
+    }
+
     friend
     void* asio_handler_allocate(
         std::size_t size, response_op* op)
@@ -121,10 +145,10 @@ public:
     }
 };
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Handler>
 void
-stream<NextLayer>::response_op<Handler>::
+stream<NextLayer, Role>::response_op<Handler>::
 operator()(error_code ec, bool again)
 {
     auto& d = *d_;
@@ -136,6 +160,13 @@ operator()(error_code ec, bool again)
         case 0:
             // send response
             d.state = 1;
+            if(d.is_fast)
+            {
+                boost::asio::async_write(d.ws.next_layer(),
+                    boost::asio::buffer(d.fast.data(),
+                        d.fast.size()), std::move(*this));
+                return;
+            }
             http::async_write(d.ws.next_layer(),
                 d.res, std::move(*this));
             return;
@@ -143,6 +174,12 @@ operator()(error_code ec, bool again)
         // sent response
         case 1:
             d.state = 99;
+            if(d.is_fast)
+            {
+                d.ws.pmd_config_ = d.config;
+                d.ws.open(role_type::server);
+                break;
+            }
             if(d.res.result() !=
                     http::status::switching_protocols)
                 ec = error::handshake_failed;
@@ -161,17 +198,17 @@ operator()(error_code ec, bool again)
 
 // read and respond to an upgrade request
 //
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Decorator, class Handler>
-class stream<NextLayer>::accept_op
+class stream<NextLayer, Role>::accept_op
 {
     struct data
     {
-        stream<NextLayer>& ws;
+        stream<NextLayer, Role>& ws;
         Decorator decorator;
-        http::request_parser<http::empty_body> p;
+        detail::upgrade_parser p;
 
-        data(Handler&, stream<NextLayer>& ws_,
+        data(Handler&, stream<NextLayer, Role>& ws_,
                 Decorator const& decorator_)
             : ws(ws_)
             , decorator(decorator_)
@@ -179,7 +216,7 @@ class stream<NextLayer>::accept_op
         }
 
         template<class Buffers>
-        data(Handler&, stream<NextLayer>& ws_,
+        data(Handler&, stream<NextLayer, Role>& ws_,
             Buffers const& buffers,
                 Decorator const& decorator_)
             : ws(ws_)
@@ -202,7 +239,7 @@ public:
 
     template<class DeducedHandler, class... Args>
     accept_op(DeducedHandler&& h,
-            stream<NextLayer>& ws, Args&&... args)
+            stream<NextLayer, Role>& ws, Args&&... args)
         : d_(std::forward<DeducedHandler>(h),
             ws, std::forward<Args>(args)...)
     {
@@ -248,10 +285,10 @@ public:
     }
 };
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Decorator, class Handler>
 void
-stream<NextLayer>::accept_op<Decorator, Handler>::
+stream<NextLayer, Role>::accept_op<Decorator, Handler>::
 operator()()
 {
     auto& d = *d_;
@@ -260,10 +297,10 @@ operator()()
             std::move(*this));
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Decorator, class Handler>
 void
-stream<NextLayer>::accept_op<Decorator, Handler>::
+stream<NextLayer, Role>::accept_op<Decorator, Handler>::
 operator()(error_code ec)
 {
     auto& d = *d_;
@@ -274,12 +311,12 @@ operator()(error_code ec)
         // moved to the stack before releasing
         // the handler.
         auto& ws = d.ws;
-        auto const req = d.p.release();
+        auto const p = std::move(d.p);
         auto const decorator = d.decorator;
     #if 1
         response_op<Handler>{
             d_.release_handler(),
-                ws, req, decorator, true};
+                ws, p, decorator, true};
     #else
         // VFALCO This *should* work but breaks
         //        coroutine invariants in the unit test.
@@ -294,9 +331,9 @@ operator()(error_code ec)
 
 //------------------------------------------------------------------------------
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 accept()
 {
     static_assert(is_sync_stream<next_layer_type>::value,
@@ -307,10 +344,10 @@ accept()
         BOOST_THROW_EXCEPTION(system_error{ec});
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class ResponseDecorator>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 accept_ex(ResponseDecorator const& decorator)
 {
     static_assert(is_sync_stream<next_layer_type>::value,
@@ -324,9 +361,9 @@ accept_ex(ResponseDecorator const& decorator)
         BOOST_THROW_EXCEPTION(system_error{ec});
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 accept(error_code& ec)
 {
     static_assert(is_sync_stream<next_layer_type>::value,
@@ -335,10 +372,10 @@ accept(error_code& ec)
     do_accept(&default_decorate_res, ec);
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class ResponseDecorator>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 accept_ex(ResponseDecorator const& decorator, error_code& ec)
 {
     static_assert(is_sync_stream<next_layer_type>::value,
@@ -350,11 +387,11 @@ accept_ex(ResponseDecorator const& decorator, error_code& ec)
     do_accept(decorator, ec);
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class ConstBufferSequence>
 typename std::enable_if<! http::detail::is_header<
     ConstBufferSequence>::value>::type
-stream<NextLayer>::
+stream<NextLayer, Role>::
 accept(ConstBufferSequence const& buffers)
 {
     static_assert(is_sync_stream<next_layer_type>::value,
@@ -368,12 +405,12 @@ accept(ConstBufferSequence const& buffers)
         BOOST_THROW_EXCEPTION(system_error{ec});
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<
     class ConstBufferSequence, class ResponseDecorator>
 typename std::enable_if<! http::detail::is_header<
     ConstBufferSequence>::value>::type
-stream<NextLayer>::
+stream<NextLayer, Role>::
 accept_ex(ConstBufferSequence const& buffers,
     ResponseDecorator const &decorator)
 {
@@ -391,11 +428,11 @@ accept_ex(ConstBufferSequence const& buffers,
         BOOST_THROW_EXCEPTION(system_error{ec});
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class ConstBufferSequence>
 typename std::enable_if<! http::detail::is_header<
     ConstBufferSequence>::value>::type
-stream<NextLayer>::
+stream<NextLayer, Role>::
 accept(ConstBufferSequence const& buffers, error_code& ec)
 {
     static_assert(is_sync_stream<next_layer_type>::value,
@@ -412,12 +449,12 @@ accept(ConstBufferSequence const& buffers, error_code& ec)
     do_accept(&default_decorate_res, ec);
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<
     class ConstBufferSequence, class ResponseDecorator>
 typename std::enable_if<! http::detail::is_header<
     ConstBufferSequence>::value>::type
-stream<NextLayer>::
+stream<NextLayer, Role>::
 accept_ex(ConstBufferSequence const& buffers,
     ResponseDecorator const& decorator, error_code& ec)
 {
@@ -438,10 +475,10 @@ accept_ex(ConstBufferSequence const& buffers,
     do_accept(decorator, ec);
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Body, class Allocator>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 accept(http::request<Body,
     http::basic_fields<Allocator>> const& req)
 {
@@ -453,11 +490,11 @@ accept(http::request<Body,
         BOOST_THROW_EXCEPTION(system_error{ec});
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Body,
     class Allocator, class ResponseDecorator>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 accept_ex(http::request<Body,
     http::basic_fields<Allocator>> const& req,
     ResponseDecorator const& decorator)
@@ -473,10 +510,10 @@ accept_ex(http::request<Body,
         BOOST_THROW_EXCEPTION(system_error{ec});
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Body, class Allocator>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 accept(http::request<Body,
     http::basic_fields<Allocator>> const& req,
         error_code& ec)
@@ -487,11 +524,11 @@ accept(http::request<Body,
     do_accept(req, &default_decorate_res, ec);
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Body, class Allocator,
     class ResponseDecorator>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 accept_ex(http::request<Body,
     http::basic_fields<Allocator>> const& req,
         ResponseDecorator const& decorator, error_code& ec)
@@ -505,11 +542,11 @@ accept_ex(http::request<Body,
     do_accept(req, decorator, ec);
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Body, class Allocator,
     class ConstBufferSequence>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 accept(http::request<Body,
     http::basic_fields<Allocator>> const& req,
         ConstBufferSequence const& buffers)
@@ -525,11 +562,11 @@ accept(http::request<Body,
         BOOST_THROW_EXCEPTION(system_error{ec});
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Body, class Allocator,
     class ConstBufferSequence, class ResponseDecorator>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 accept_ex(http::request<Body,
     http::basic_fields<Allocator>> const& req,
         ConstBufferSequence const& buffers,
@@ -549,11 +586,11 @@ accept_ex(http::request<Body,
         BOOST_THROW_EXCEPTION(system_error{ec});
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Body, class Allocator,
     class ConstBufferSequence>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 accept(http::request<Body,
     http::basic_fields<Allocator>> const& req,
         ConstBufferSequence const& buffers, error_code& ec)
@@ -572,11 +609,11 @@ accept(http::request<Body,
     do_accept(req, &default_decorate_res, ec);
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Body, class Allocator,
     class ConstBufferSequence, class ResponseDecorator>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 accept_ex(http::request<Body,
     http::basic_fields<Allocator>> const& req,
         ConstBufferSequence const& buffers,
@@ -602,11 +639,11 @@ accept_ex(http::request<Body,
 
 //------------------------------------------------------------------------------
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class AcceptHandler>
 async_return_type<
     AcceptHandler, void(error_code)>
-stream<NextLayer>::
+stream<NextLayer, Role>::
 async_accept(AcceptHandler&& handler)
 {
     static_assert(is_async_stream<next_layer_type>::value,
@@ -620,11 +657,11 @@ async_accept(AcceptHandler&& handler)
     return init.result.get();
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class ResponseDecorator, class AcceptHandler>
 async_return_type<
     AcceptHandler, void(error_code)>
-stream<NextLayer>::
+stream<NextLayer, Role>::
 async_accept_ex(ResponseDecorator const& decorator,
     AcceptHandler&& handler)
 {
@@ -642,12 +679,12 @@ async_accept_ex(ResponseDecorator const& decorator,
     return init.result.get();
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class ConstBufferSequence, class AcceptHandler>
 typename std::enable_if<
     ! http::detail::is_header<ConstBufferSequence>::value,
     async_return_type<AcceptHandler, void(error_code)>>::type
-stream<NextLayer>::
+stream<NextLayer, Role>::
 async_accept(ConstBufferSequence const& buffers,
     AcceptHandler&& handler)
 {
@@ -666,13 +703,13 @@ async_accept(ConstBufferSequence const& buffers,
     return init.result.get();
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class ConstBufferSequence,
     class ResponseDecorator, class AcceptHandler>
 typename std::enable_if<
     ! http::detail::is_header<ConstBufferSequence>::value,
     async_return_type<AcceptHandler, void(error_code)>>::type
-stream<NextLayer>::
+stream<NextLayer, Role>::
 async_accept_ex(ConstBufferSequence const& buffers,
     ResponseDecorator const& decorator,
         AcceptHandler&& handler)
@@ -695,12 +732,12 @@ async_accept_ex(ConstBufferSequence const& buffers,
     return init.result.get();
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Body, class Allocator,
     class AcceptHandler>
 async_return_type<
     AcceptHandler, void(error_code)>
-stream<NextLayer>::
+stream<NextLayer, Role>::
 async_accept(http::request<Body,
     http::basic_fields<Allocator>> const& req,
         AcceptHandler&& handler)
@@ -719,12 +756,12 @@ async_accept(http::request<Body,
     return init.result.get();
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Body, class Allocator,
     class ResponseDecorator, class AcceptHandler>
 async_return_type<
     AcceptHandler, void(error_code)>
-stream<NextLayer>::
+stream<NextLayer, Role>::
 async_accept_ex(http::request<Body,
     http::basic_fields<Allocator>> const& req,
         ResponseDecorator const& decorator, AcceptHandler&& handler)
@@ -746,12 +783,12 @@ async_accept_ex(http::request<Body,
     return init.result.get();
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Body, class Allocator,
     class ConstBufferSequence, class AcceptHandler>
 async_return_type<
     AcceptHandler, void(error_code)>
-stream<NextLayer>::
+stream<NextLayer, Role>::
 async_accept(http::request<Body,
     http::basic_fields<Allocator>> const& req,
         ConstBufferSequence const& buffers,
@@ -774,13 +811,13 @@ async_accept(http::request<Body,
     return init.result.get();
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Body, class Allocator,
     class ConstBufferSequence, class ResponseDecorator,
         class AcceptHandler>
 async_return_type<
     AcceptHandler, void(error_code)>
-stream<NextLayer>::
+stream<NextLayer, Role>::
 async_accept_ex(http::request<Body,
     http::basic_fields<Allocator>> const& req,
         ConstBufferSequence const& buffers,
@@ -25,19 +25,19 @@ namespace websocket {
 
 // send the close message and wait for the response
 //
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Handler>
-class stream<NextLayer>::close_op
+class stream<NextLayer, Role>::close_op
 {
     struct data : op
     {
-        stream<NextLayer>& ws;
+        stream<NextLayer, Role>& ws;
         close_reason cr;
         detail::frame_streambuf fb;
         int state = 0;
         token tok;
 
-        data(Handler&, stream<NextLayer>& ws_,
+        data(Handler&, stream<NextLayer, Role>& ws_,
                 close_reason const& cr_)
             : ws(ws_)
             , cr(cr_)
@@ -56,7 +56,7 @@ public:
 
     template<class DeducedHandler, class... Args>
     close_op(DeducedHandler&& h,
-            stream<NextLayer>& ws, Args&&... args)
+            stream<NextLayer, Role>& ws, Args&&... args)
         : d_(std::forward<DeducedHandler>(h),
             ws, std::forward<Args>(args)...)
     {
@@ -107,10 +107,10 @@ public:
     }
 };
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Handler>
 void
-stream<NextLayer>::close_op<Handler>::
+stream<NextLayer, Role>::close_op<Handler>::
 operator()(error_code ec, std::size_t)
 {
     auto& d = *d_;
@@ -186,9 +186,9 @@ upcall:
 
 //------------------------------------------------------------------------------
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 close(close_reason const& cr)
 {
     static_assert(is_sync_stream<next_layer_type>::value,
@@ -199,19 +199,21 @@ close(close_reason const& cr)
         BOOST_THROW_EXCEPTION(system_error{ec});
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 close(close_reason const& cr, error_code& ec)
 {
     static_assert(is_sync_stream<next_layer_type>::value,
         "SyncStream requirements not met");
-    // If rd_close_ is set then we already sent a close
-    BOOST_ASSERT(! rd_close_);
+    auto lock = wr_lock();
+    // If rd_close_ is set then we already sent a close,
+    // unless the read half of a split stream sent it.
+    BOOST_ASSERT(wr_mutex_ || ! rd_close_);
     if(wr_close_)
     {
         // Can't call close twice, abort operation
-        BOOST_ASSERT(! wr_close_);
+        BOOST_ASSERT(wr_mutex_ != nullptr);
         ec = boost::asio::error::operation_aborted;
         return;
     }
@@ -224,11 +226,11 @@ close(close_reason const& cr, error_code& ec)
         return;
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class CloseHandler>
 async_return_type<
     CloseHandler, void(error_code)>
-stream<NextLayer>::
+stream<NextLayer, Role>::
 async_close(close_reason const& cr, CloseHandler&& handler)
 {
     static_assert(is_async_stream<next_layer_type>::value,
@@ -40,6 +40,7 @@ public:
         case error::failed: return "WebSocket connection failed due to a protocol violation";
         case error::handshake_failed: return "WebSocket Upgrade handshake failed";
         case error::buffer_overflow: return "buffer overflow";
+        case error::timeout: return "WebSocket connection timed out";
 
         default:
             return "beast.websocket error";
@@ -28,12 +28,12 @@ namespace websocket {
 
 // _Fail the WebSocket Connection_
 //
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Handler>
-class stream<NextLayer>::fail_op
+class stream<NextLayer, Role>::fail_op
 {
     Handler h_;
-    stream<NextLayer>& ws_;
+    stream<NextLayer, Role>& ws_;
     int step_ = 0;
     bool dispatched_ = false;
     fail_how how_;
@@ -47,7 +47,7 @@ public:
     template<class DeducedHandler>
     fail_op(
         DeducedHandler&& h,
-        stream<NextLayer>& ws,
+        stream<NextLayer, Role>& ws,
         close_code code)
         : h_(std::forward<DeducedHandler>(h))
         , ws_(ws)
@@ -64,7 +64,7 @@ public:
     template<class DeducedHandler>
     fail_op(
         DeducedHandler&& h,
-        stream<NextLayer>& ws,
+        stream<NextLayer, Role>& ws,
         fail_how how)
         : h_(std::forward<DeducedHandler>(h))
         , ws_(ws)
@@ -119,10 +119,10 @@ public:
     }
 };
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Handler>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 fail_op<Handler>::
 operator()(error_code ec, std::size_t)
 {
@@ -140,6 +140,7 @@ operator()(error_code ec, std::size_t)
         {
             // suspend
             BOOST_ASSERT(ws_.wr_block_ != tok_);
+            ws_.st_.on_read_suspend();
             step_ = do_resume;
             ws_.rd_op_.save(std::move(*this));
             return;
@@ -148,6 +149,7 @@ operator()(error_code ec, std::size_t)
         goto go_write;
 
     case do_resume:
+        ws_.st_.on_read_resume();
         BOOST_ASSERT(! ws_.wr_block_);
         ws_.wr_block_ = tok_;
         step_ = do_resume + 1;
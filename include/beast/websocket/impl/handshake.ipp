@@ -29,14 +29,14 @@ namespace websocket {
 
 // send the upgrade request and process the response
 //
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Handler>
-class stream<NextLayer>::handshake_op
+class stream<NextLayer, Role>::handshake_op
 {
     struct data
     {
         bool cont;
-        stream<NextLayer>& ws;
+        stream<NextLayer, Role>& ws;
         response_type* res_p;
         detail::sec_ws_key_type key;
         http::request<http::empty_body> req;
@@ -44,7 +44,7 @@ class stream<NextLayer>::handshake_op
         int state = 0;
 
         template<class Decorator>
-        data(Handler& handler, stream<NextLayer>& ws_,
+        data(Handler& handler, stream<NextLayer, Role>& ws_,
             response_type* res_p_,
                 string_view host,
                     string_view target,
@@ -68,7 +68,7 @@ public:
 
     template<class DeducedHandler, class... Args>
     handshake_op(DeducedHandler&& h,
-            stream<NextLayer>& ws, Args&&... args)
+            stream<NextLayer, Role>& ws, Args&&... args)
         : d_(std::forward<DeducedHandler>(h),
             ws, std::forward<Args>(args)...)
     {
@@ -112,10 +112,10 @@ public:
     }
 };
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Handler>
 void
-stream<NextLayer>::handshake_op<Handler>::
+stream<NextLayer, Role>::handshake_op<Handler>::
 operator()(error_code ec, bool again)
 {
     auto& d = *d_;
@@ -164,11 +164,11 @@ operator()(error_code ec, bool again)
     d_.invoke(ec);
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class HandshakeHandler>
 async_return_type<
     HandshakeHandler, void(error_code)>
-stream<NextLayer>::
+stream<NextLayer, Role>::
 async_handshake(string_view host,
     string_view target,
         HandshakeHandler&& handler)
@@ -184,11 +184,11 @@ async_handshake(string_view host,
     return init.result.get();
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class HandshakeHandler>
 async_return_type<
     HandshakeHandler, void(error_code)>
-stream<NextLayer>::
+stream<NextLayer, Role>::
 async_handshake(response_type& res,
     string_view host,
         string_view target,
@@ -205,11 +205,11 @@ async_handshake(response_type& res,
     return init.result.get();
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class RequestDecorator, class HandshakeHandler>
 async_return_type<
     HandshakeHandler, void(error_code)>
-stream<NextLayer>::
+stream<NextLayer, Role>::
 async_handshake_ex(string_view host,
     string_view target,
         RequestDecorator const& decorator,
@@ -229,11 +229,11 @@ async_handshake_ex(string_view host,
     return init.result.get();
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class RequestDecorator, class HandshakeHandler>
 async_return_type<
     HandshakeHandler, void(error_code)>
-stream<NextLayer>::
+stream<NextLayer, Role>::
 async_handshake_ex(response_type& res,
     string_view host,
         string_view target,
@@ -254,9 +254,9 @@ async_handshake_ex(response_type& res,
     return init.result.get();
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 handshake(string_view host,
     string_view target)
 {
@@ -269,9 +269,9 @@ handshake(string_view host,
         BOOST_THROW_EXCEPTION(system_error{ec});
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 handshake(response_type& res,
     string_view host,
         string_view target)
@@ -284,10 +284,10 @@ handshake(response_type& res,
         BOOST_THROW_EXCEPTION(system_error{ec});
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class RequestDecorator>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 handshake_ex(string_view host,
     string_view target,
         RequestDecorator const& decorator)
@@ -303,10 +303,10 @@ handshake_ex(string_view host,
         BOOST_THROW_EXCEPTION(system_error{ec});
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class RequestDecorator>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 handshake_ex(response_type& res,
     string_view host,
         string_view target,
@@ -323,9 +323,9 @@ handshake_ex(response_type& res,
         BOOST_THROW_EXCEPTION(system_error{ec});
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 handshake(string_view host,
     string_view target, error_code& ec)
 {
@@ -335,9 +335,9 @@ handshake(string_view host,
         host, target, &default_decorate_req, ec);
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 handshake(response_type& res,
     string_view host,
         string_view target,
@@ -349,10 +349,10 @@ handshake(response_type& res,
         host, target, &default_decorate_req, ec);
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class RequestDecorator>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 handshake_ex(string_view host,
     string_view target,
         RequestDecorator const& decorator,
@@ -367,10 +367,10 @@ handshake_ex(string_view host,
         host, target, decorator, ec);
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class RequestDecorator>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 handshake_ex(response_type& res,
     string_view host,
         string_view target,
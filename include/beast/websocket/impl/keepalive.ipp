@@ -0,0 +1,295 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_IMPL_KEEPALIVE_IPP
+#define BEAST_WEBSOCKET_IMPL_KEEPALIVE_IPP
+
+#include <beast/core/bind_handler.hpp>
+#include <boost/asio/handler_alloc_hook.hpp>
+#include <boost/asio/handler_continuation_hook.hpp>
+#include <boost/asio/handler_invoke_hook.hpp>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace beast {
+namespace websocket {
+
+//------------------------------------------------------------------------------
+
+// Completes a read on the next layer. While an automatic ping
+// is being sent the completion is held back, so that the ping
+// finishes before the handler of the read can be invoked, and
+// the stream is not destroyed with the ping outstanding.
+//
+template<class NextLayer, class Role>
+template<class Handler>
+class stream<NextLayer, Role>::ka_read_op
+{
+    Handler h_;
+    stream<NextLayer, Role>& ws_;
+    error_code ec_;
+    std::size_t bytes_transferred_ = 0;
+
+public:
+    ka_read_op(ka_read_op&&) = default;
+    ka_read_op(ka_read_op const&) = default;
+
+    template<class DeducedHandler>
+    ka_read_op(
+        DeducedHandler&& h,
+        stream<NextLayer, Role>& ws)
+        : h_(std::forward<DeducedHandler>(h))
+        , ws_(ws)
+    {
+    }
+
+    Handler&
+    handler()
+    {
+        return h_;
+    }
+
+    void operator()(error_code ec,
+        std::size_t bytes_transferred);
+
+    void operator()();
+
+    friend
+    void* asio_handler_allocate(
+        std::size_t size, ka_read_op* op)
+    {
+        using boost::asio::asio_handler_allocate;
+        return asio_handler_allocate(
+            size, std::addressof(op->h_));
+    }
+
+    friend
+    void asio_handler_deallocate(
+        void* p, std::size_t size, ka_read_op* op)
+    {
+        using boost::asio::asio_handler_deallocate;
+        asio_handler_deallocate(
+            p, size, std::addressof(op->h_));
+    }
+
+    friend
+    bool asio_handler_is_continuation(ka_read_op* op)
+    {
+        using boost::asio::asio_handler_is_continuation;
+        return asio_handler_is_continuation(
+            std::addressof(op->h_));
+    }
+
+    template<class Function>
+    friend
+    void asio_handler_invoke(Function&& f, ka_read_op* op)
+    {
+        using boost::asio::asio_handler_invoke;
+        asio_handler_invoke(f, std::addressof(op->h_));
+    }
+};
+
+template<class NextLayer, class Role>
+template<class Handler>
+void
+stream<NextLayer, Role>::
+ka_read_op<Handler>::
+operator()(error_code ec, std::size_t bytes_transferred)
+{
+    using state = detail::keepalive_state;
+    if(ws_.ka_.state.exchange(state::idle) == state::checking)
+        ws_.ka_.queued = true;
+    if(bytes_transferred > 0)
+        ws_.ka_.recv = true;
+    if(ec && ws_.ka_.timed_out)
+        ec = error::timeout;
+    if(ws_.ka_.pinging || ws_.ka_.queued)
+    {
+        // suspend
+        ec_ = ec;
+        bytes_transferred_ = bytes_transferred;
+        ws_.ka_.rd_op.save(std::move(*this));
+        return;
+    }
+    h_(ec, bytes_transferred);
+}
+
+template<class NextLayer, class Role>
+template<class Handler>
+void
+stream<NextLayer, Role>::
+ka_read_op<Handler>::
+operator()()
+{
+    // We are being called from the completion of the
+    // ping or of the check. Call post to make sure we are invoked the
+    // same way as the final handler for this operation.
+    ws_.get_io_service().post(bind_handler(
+        std::move(h_), ec_, bytes_transferred_));
+}
+
+// Called when an automatic ping finishes sending
+//
+template<class NextLayer, class Role>
+struct stream<NextLayer, Role>::ka_ping_handler
+{
+    stream<NextLayer, Role>& ws;
+
+    void
+    operator()(error_code const&) const
+    {
+        ws.ka_.pinging = false;
+        if(! ws.ka_.queued)
+            ws.ka_.rd_op.maybe_invoke();
+    }
+};
+
+//------------------------------------------------------------------------------
+
+template<class NextLayer, class Role>
+template<class MutableBufferSequence, class Handler>
+void
+stream<NextLayer, Role>::
+ka_read_some(MutableBufferSequence const& buffers,
+    Handler&& handler)
+{
+    if(! this->ka_linked())
+        return stream_.async_read_some(
+            buffers, std::forward<Handler>(handler));
+    ka_.state.store(detail::keepalive_state::reading);
+    stream_.async_read_some(buffers,
+        ka_read_op<typename std::decay<Handler>::type>{
+            std::forward<Handler>(handler), *this});
+}
+
+// Called by the keepalive service at regular intervals, with
+// the service's mutex held, from any thread running the
+// io_service. The check is posted to run where the handlers
+// of the stream run. Until it has run, the completion of the
+// pending read is held back, which keeps the stream alive.
+//
+template<class NextLayer, class Role>
+void
+stream<NextLayer, Role>::
+ka_check(detail::keepalive_hook& h,
+    detail::keepalive_hook::clock_type::time_point now)
+{
+    using state = detail::keepalive_state;
+    auto& ws = static_cast<stream&>(h);
+    if(! ws.ka_.state.transit(state::reading, state::checking))
+    {
+        // Only the time spent waiting for the
+        // peer, with a read pending, is counted.
+        ws.ka_.gap = true;
+        return;
+    }
+    if(ws.ka_.opt.strand)
+        ws.ka_.opt.strand->post(
+            [&ws, now]
+            {
+                ws.ka_run(now);
+            });
+    else
+        ws.get_io_service().post(
+            [&ws, now]
+            {
+                ws.ka_run(now);
+            });
+}
+
+template<class NextLayer, class Role>
+void
+stream<NextLayer, Role>::
+ka_run(detail::keepalive_hook::clock_type::time_point now)
+{
+    using state = detail::keepalive_state;
+    if(ka_.queued)
+    {
+        // The read completed while the check was posted
+        ka_.queued = false;
+        if(! ka_.pinging)
+            ka_.rd_op.maybe_invoke();
+        return;
+    }
+    ka_update(now);
+    BOOST_ASSERT(ka_.state.load() == state::checking);
+    ka_.state.store(state::reading);
+}
+
+template<class NextLayer, class Role>
+void
+stream<NextLayer, Role>::
+ka_update(detail::keepalive_hook::clock_type::time_point now)
+{
+    using duration =
+        detail::keepalive_hook::clock_type::duration;
+    auto& ka = ka_;
+    auto const& opt = ka.opt;
+    if(ka.gap || failed_)
+    {
+        ka.gap = false;
+        ka.recv_at = now;
+        ka.msg_at = now;
+        ka.recv = false;
+        ka.msg = false;
+        ka.awaiting = false;
+        return;
+    }
+    if(ka.recv)
+    {
+        ka.recv = false;
+        ka.recv_at = now;
+        ka.awaiting = false;
+    }
+    if(ka.msg)
+    {
+        ka.msg = false;
+        ka.msg_at = now;
+    }
+    if(opt.idle_timeout > duration::zero() &&
+        now - ka.msg_at >= opt.idle_timeout)
+        return ka_timeout();
+    if(ka.awaiting)
+    {
+        if(opt.pong_timeout > duration::zero() &&
+                now - ka.ping_at >= opt.pong_timeout)
+            ka_timeout();
+        return;
+    }
+    if(opt.ping_interval > duration::zero() &&
+        now - ka.recv_at >= opt.ping_interval &&
+        ! wr_block_ && ! wr_close_ && ! ka.pinging)
+    {
+        ka.awaiting = true;
+        ka.ping_at = now;
+        ka.pinging = true;
+        if(opt.strand)
+            async_ping({}, opt.strand->wrap(
+                ka_ping_handler{*this}));
+        else
+            async_ping({}, ka_ping_handler{*this});
+    }
+}
+
+template<class NextLayer, class Role>
+void
+stream<NextLayer, Role>::
+ka_timeout()
+{
+    // Closing the lowest layer cancels the pending
+    // operations, the read completes with error::timeout.
+    ka_.timed_out = true;
+    failed_ = true;
+    error_code ec;
+    lowest_layer().close(ec);
+}
+
+} // websocket
+} // beast
+
+#endif
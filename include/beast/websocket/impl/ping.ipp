@@ -26,18 +26,18 @@ namespace websocket {
 
 // write a ping frame
 //
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Handler>
-class stream<NextLayer>::ping_op
+class stream<NextLayer, Role>::ping_op
 {
     struct data : op
     {
-        stream<NextLayer>& ws;
+        stream<NextLayer, Role>& ws;
         detail::frame_streambuf fb;
         int state = 0;
         token tok;
 
-        data(Handler&, stream<NextLayer>& ws_,
+        data(Handler&, stream<NextLayer, Role>& ws_,
                 detail::opcode op_, ping_data const& payload)
             : ws(ws_)
             , tok(ws.t_.unique())
@@ -57,7 +57,7 @@ public:
 
     template<class DeducedHandler, class... Args>
     ping_op(DeducedHandler&& h,
-            stream<NextLayer>& ws, Args&&... args)
+            stream<NextLayer, Role>& ws, Args&&... args)
         : d_(std::forward<DeducedHandler>(h),
             ws, std::forward<Args>(args)...)
     {
@@ -107,10 +107,10 @@ public:
     }
 };
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Handler>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 ping_op<Handler>::
 operator()(error_code ec, std::size_t)
 {
@@ -183,11 +183,11 @@ upcall:
     d_.invoke(ec);
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class WriteHandler>
 async_return_type<
     WriteHandler, void(error_code)>
-stream<NextLayer>::
+stream<NextLayer, Role>::
 async_ping(ping_data const& payload, WriteHandler&& handler)
 {
     static_assert(is_async_stream<next_layer_type>::value,
@@ -201,11 +201,11 @@ async_ping(ping_data const& payload, WriteHandler&& handler)
     return init.result.get();
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class WriteHandler>
 async_return_type<
     WriteHandler, void(error_code)>
-stream<NextLayer>::
+stream<NextLayer, Role>::
 async_pong(ping_data const& payload, WriteHandler&& handler)
 {
     static_assert(is_async_stream<next_layer_type>::value,
@@ -219,9 +219,9 @@ async_pong(ping_data const& payload, WriteHandler&& handler)
     return init.result.get();
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 ping(ping_data const& payload)
 {
     error_code ec;
@@ -230,20 +230,23 @@ ping(ping_data const& payload)
         BOOST_THROW_EXCEPTION(system_error{ec});
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 ping(ping_data const& payload, error_code& ec)
 {
+    auto lock = wr_lock();
+    if(wr_aborted(lock, ec))
+        return;
     detail::frame_streambuf db;
     write_ping<flat_static_buffer_base>(
         db, detail::opcode::ping, payload);
     boost::asio::write(stream_, db.data(), ec);
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 pong(ping_data const& payload)
 {
     error_code ec;
@@ -252,11 +255,14 @@ pong(ping_data const& payload)
         BOOST_THROW_EXCEPTION(system_error{ec});
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 pong(ping_data const& payload, error_code& ec)
 {
+    auto lock = wr_lock();
+    if(wr_aborted(lock, ec))
+        return;
     detail::frame_streambuf db;
     write_ping<flat_static_buffer_base>(
         db, detail::opcode::pong, payload);
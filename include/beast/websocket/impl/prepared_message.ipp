@@ -0,0 +1,119 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_IMPL_PREPARED_MESSAGE_IPP
+#define BEAST_WEBSOCKET_IMPL_PREPARED_MESSAGE_IPP
+
+#include <beast/core/consuming_buffers.hpp>
+#include <beast/core/flat_buffer.hpp>
+#include <beast/core/type_traits.hpp>
+#include <beast/websocket/detail/frame.hpp>
+#include <beast/websocket/detail/pmd_extension.hpp>
+#include <beast/zlib/deflate_stream.hpp>
+#include <boost/throw_exception.hpp>
+#include <algorithm>
+
+namespace beast {
+namespace websocket {
+
+template<class ConstBufferSequence>
+auto
+prepared_message::
+make_frame(bool binary, bool rsv1,
+    ConstBufferSequence const& buffers) ->
+        frame
+{
+    using boost::asio::buffer;
+    using boost::asio::buffer_copy;
+    using boost::asio::buffer_size;
+    detail::frame_header fh;
+    fh.op = binary ?
+        detail::opcode::binary : detail::opcode::text;
+    fh.fin = true;
+    fh.mask = false;
+    fh.rsv1 = rsv1;
+    fh.rsv2 = false;
+    fh.rsv3 = false;
+    fh.len = buffer_size(buffers);
+    detail::fh_streambuf fh_buf;
+    detail::write<flat_static_buffer_base>(fh_buf, fh);
+    frame f;
+    f.size = fh_buf.size() + fh.len;
+    f.p.reset(new std::uint8_t[f.size]);
+    auto const n = buffer_copy(
+        buffer(f.p.get(), f.size), fh_buf.data());
+    buffer_copy(buffer(f.p.get() + n, f.size - n), buffers);
+    return f;
+}
+
+inline
+boost::asio::const_buffers_1
+prepared_message::
+get(bool deflate, int window_bits) const
+{
+    BOOST_ASSERT(impl_);
+    auto const& f = (deflate &&
+        impl_->deflated.size != 0 &&
+        window_bits >= impl_->window_bits) ?
+            impl_->deflated : impl_->plain;
+    return boost::asio::const_buffers_1{f.p.get(), f.size};
+}
+
+template<class ConstBufferSequence>
+prepared_message::
+prepared_message(ConstBufferSequence const& buffers,
+    bool binary)
+    : prepared_message(buffers, binary, permessage_deflate{})
+{
+}
+
+template<class ConstBufferSequence>
+prepared_message::
+prepared_message(ConstBufferSequence const& buffers,
+    bool binary, permessage_deflate const& opts)
+{
+    static_assert(beast::is_const_buffer_sequence<
+        ConstBufferSequence>::value,
+            "ConstBufferSequence requirements not met");
+    using boost::asio::buffer;
+    using boost::asio::buffer_size;
+    auto p = std::make_shared<impl>();
+    p->binary = binary;
+    p->payload_size = buffer_size(buffers);
+    p->window_bits = opts.server_max_window_bits;
+    p->plain = make_frame(binary, false, buffers);
+    if(opts.server_enable && p->payload_size > 0)
+    {
+        zlib::deflate_stream zo;
+        zo.reset(opts.compLevel, opts.server_max_window_bits,
+            opts.memLevel, zlib::Strategy::normal);
+        consuming_buffers<ConstBufferSequence> cb{buffers};
+        flat_buffer b;
+        for(;;)
+        {
+            auto out = *b.prepare(
+                (std::max<std::size_t>)(
+                    zo.upper_bound(p->payload_size), 64)).begin();
+            error_code ec;
+            auto const more =
+                detail::deflate(zo, out, cb, true, ec);
+            if(ec)
+                BOOST_THROW_EXCEPTION(system_error{ec});
+            b.commit(buffer_size(out));
+            if(! more)
+                break;
+        }
+        if(b.size() < p->payload_size)
+            p->deflated = make_frame(binary, true, b.data());
+    }
+    impl_ = std::move(p);
+}
+
+} // websocket
+} // beast
+
+#endif
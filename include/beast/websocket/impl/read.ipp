@@ -33,12 +33,12 @@ namespace websocket {
 //------------------------------------------------------------------------------
 
 // read a frame header, process control frames
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Handler>
-class stream<NextLayer>::read_fh_op
+class stream<NextLayer, Role>::read_fh_op
 {
     Handler h_;
-    stream<NextLayer>& ws_;
+    stream<NextLayer, Role>& ws_;
     int step_ = 0;
     bool dispatched_ = false;
     token tok_;
@@ -50,7 +50,7 @@ public:
     template<class DeducedHandler>
     read_fh_op(
         DeducedHandler&& h,
-        stream<NextLayer>& ws)
+        stream<NextLayer, Role>& ws)
         : h_(std::forward<DeducedHandler>(h))
         , ws_(ws)
         , tok_(ws_.t_.unique())
@@ -102,10 +102,10 @@ public:
     }
 };
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Handler>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 read_fh_op<Handler>::
 operator()(
     error_code ec,
@@ -141,8 +141,16 @@ operator()(
                 return fail_op<Handler>{
                     std::move(h_), ws_, code}();
             }
+            if(ws_.lean_ && ! ws_.rd_.buf.leased())
+            {
+                // Wait for the frame without a read buffer
+                step_ = do_loop + 2;
+                return ws_.ka_read_some(
+                    boost::asio::buffer(&ws_.rd_.peek, 1),
+                        std::move(*this));
+            }
             step_ = do_loop + 1;
-            return ws_.stream_.async_read_some(
+            return ws_.ka_read_some(
                 ws_.rd_.buf.prepare(read_size(
                     ws_.rd_.buf, ws_.rd_.buf.max_size())),
                         std::move(*this));
@@ -150,7 +158,7 @@ operator()(
         // Immediately apply the mask to the portion
         // of the buffer holding payload data.
         if(ws_.rd_.fh.len > 0 && ws_.rd_.fh.mask)
-            detail::mask_inplace(buffer_prefix(
+            ws_.mask_inplace(buffer_prefix(
                 clamp(ws_.rd_.fh.len),
                     ws_.rd_.buf.mutable_data()),
                         ws_.rd_.key);
@@ -225,6 +233,7 @@ operator()(
                     std::move(h_), ws_, fail_how::close}();
             }
         }
+        ws_.ka_.msg = true;
         if(ws_.rd_.fh.len == 0 && ! ws_.rd_.fh.fin)
         {
             // Empty non-final frame
@@ -242,11 +251,22 @@ operator()(
         ws_.rd_.buf.commit(bytes_transferred);
         goto go_loop;
 
+    case do_loop + 2:
+        dispatched_ = true;
+        ws_.failed_ = !!ec;
+        if(ws_.failed_)
+            break;
+        ws_.rd_.buf.commit(boost::asio::buffer_copy(
+            ws_.rd_.buf.prepare(bytes_transferred),
+                boost::asio::buffer(&ws_.rd_.peek, 1)));
+        goto go_loop;
+
     go_pong:
         if(ws_.wr_block_)
         {
             // suspend
             BOOST_ASSERT(ws_.wr_block_ != tok_);
+            ws_.st_.on_read_suspend();
             step_ = do_pong;
             ws_.rd_op_.save(std::move(*this));
             return;
@@ -255,6 +275,7 @@ operator()(
         goto go_pong_send;
 
     case do_pong:
+        ws_.st_.on_read_resume();
         BOOST_ASSERT(! ws_.wr_block_);
         ws_.wr_block_ = tok_;
         step_ = do_pong + 1;
@@ -319,14 +340,14 @@ operator()(
 // Reads a single message frame,
 // processes any received control frames.
 //
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<
     class MutableBufferSequence,
     class Handler>
-class stream<NextLayer>::read_some_op
+class stream<NextLayer, Role>::read_some_op
 {
     Handler h_;
-    stream<NextLayer>& ws_;
+    stream<NextLayer, Role>& ws_;
     consuming_buffers<MutableBufferSequence> cb_;
     std::size_t bytes_written_ = 0;
     int step_ = 0;
@@ -340,7 +361,7 @@ public:
     template<class DeducedHandler>
     read_some_op(
         DeducedHandler&& h,
-        stream<NextLayer>& ws,
+        stream<NextLayer, Role>& ws,
         MutableBufferSequence const& bs)
         : h_(std::forward<DeducedHandler>(h))
         , ws_(ws)
@@ -388,10 +409,10 @@ public:
     }
 };
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class MutableBufferSequence, class Handler>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 read_some_op<MutableBufferSequence, Handler>::
 operator()(
     error_code ec,
@@ -438,9 +459,9 @@ operator()(
     go_maybe_fill:
         if(ws_.pmd_ && ws_.pmd_->rd_set)
             goto go_inflate;
-        if(ws_.rd_.buf.size() == 0 && ws_.rd_.buf.max_size() >
-            (std::min)(clamp(ws_.rd_.remain),
-                buffer_size(cb_)))
+        if(ws_.rd_.buf.size() == 0 && ! ws_.rd_direct_ &&
+            ws_.rd_.buf.max_size() > (std::min)(
+                clamp(ws_.rd_.remain), buffer_size(cb_)))
         {
             // Fill the read buffer first, otherwise we
             // get fewer bytes at the cost of one I/O.
@@ -448,7 +469,7 @@ operator()(
                 read_size(ws_.rd_.buf,
                     ws_.rd_.buf.max_size()));
             step_ = do_maybe_fill + 1;
-            return ws_.stream_.async_read_some(
+            return ws_.ka_read_some(
                 mb, std::move(*this));
         }
         goto go_rd_buf;
@@ -460,7 +481,7 @@ operator()(
             break;
         ws_.rd_.buf.commit(bytes_transferred);
         if(ws_.rd_.fh.mask)
-            detail::mask_inplace(buffer_prefix(clamp(
+            ws_.mask_inplace(buffer_prefix(clamp(
                 ws_.rd_.remain), ws_.rd_.buf.mutable_data()),
                     ws_.rd_.key);
 
@@ -492,7 +513,7 @@ operator()(
         }
         // Read into caller's buffer
         step_ = do_read;
-        return ws_.stream_.async_read_some(buffer_prefix(
+        return ws_.ka_read_some(buffer_prefix(
             clamp(ws_.rd_.remain), cb_), std::move(*this));
 
     case do_read:
@@ -506,7 +527,7 @@ operator()(
             bytes_transferred, cb_);
         ws_.rd_.remain -= bytes_transferred;
         if(ws_.rd_.fh.mask)
-            detail::mask_inplace(mb, ws_.rd_.key);
+            ws_.mask_inplace(mb, ws_.rd_.key);
         if(ws_.rd_.op == detail::opcode::text)
         {
             if(! ws_.rd_.utf8.write(mb) ||
@@ -547,6 +568,7 @@ operator()(
                 if(ws_.rd_.buf.size() > 0)
                 {
                     // use what's there
+                    ws_.rd_append_tail();
                     auto const in = buffer_prefix(
                         clamp(ws_.rd_.remain), buffer_front(
                             ws_.rd_.buf.data()));
@@ -557,7 +579,7 @@ operator()(
                 {
                     // read new
                     step_ = do_inflate + 1;
-                    return ws_.stream_.async_read_some(
+                    return ws_.ka_read_some(
                         ws_.rd_.buf.prepare(read_size(
                             ws_.rd_.buf, ws_.rd_.buf.max_size())),
                                 std::move(*this));
@@ -569,29 +591,34 @@ operator()(
             }
             else if(ws_.rd_.fh.fin)
             {
-                // append the empty block codes
-                static std::uint8_t constexpr
-                    empty_block[4] = {
-                        0x00, 0x00, 0xff, 0xff };
-                zs.next_in = empty_block;
-                zs.avail_in = sizeof(empty_block);
-                ws_.pmd_->zi.write(zs, zlib::Flush::sync, ec);
-                BOOST_ASSERT(! ec);
-                ws_.failed_ = !!ec;
-                if(ws_.failed_)
-                    break;
-                // VFALCO See:
-                // https://github.com/madler/zlib/issues/280
-                BOOST_ASSERT(zs.total_out == 0);
-                cb_.consume(zs.total_out);
-                ws_.rd_.size += zs.total_out;
-                bytes_written_ += zs.total_out;
+                if(! ws_.pmd_->rd_tail)
+                {
+                    // append the empty block codes
+                    static std::uint8_t constexpr
+                        empty_block[4] = {
+                            0x00, 0x00, 0xff, 0xff };
+                    zs.next_in = empty_block;
+                    zs.avail_in = sizeof(empty_block);
+                    ws_.pmd_->zi.write(zs, zlib::Flush::sync, ec);
+                    BOOST_ASSERT(! ec);
+                    ws_.failed_ = !!ec;
+                    if(ws_.failed_)
+                        break;
+                    // VFALCO See:
+                    // https://github.com/madler/zlib/issues/280
+                    BOOST_ASSERT(zs.total_out == 0);
+                    cb_.consume(zs.total_out);
+                    ws_.rd_.size += zs.total_out;
+                    bytes_written_ += zs.total_out;
+                }
+                ws_.pmd_->rd_tail = false;
+                ws_.pmd_->predictor.end(ws_.rd_.size);
                 if(
-                    (ws_.role_ == role_type::client &&
+                    (ws_.is_client() &&
                         ws_.pmd_config_.server_no_context_takeover) ||
-                    (ws_.role_ == role_type::server &&
+                    (! ws_.is_client() &&
                         ws_.pmd_config_.client_no_context_takeover))
-                    ws_.pmd_->zi.reset();
+                    ws_.pmd_->zi.clear();
                 ws_.rd_.done = true;
                 break;
             }
@@ -599,11 +626,15 @@ operator()(
             {
                 break;
             }
-            ws_.pmd_->zi.write(zs, zlib::Flush::sync, ec);
+            {
+                auto const st = ws_.st_.time_inflate();
+                ws_.pmd_->zi.write(zs, zlib::Flush::sync, ec);
+            }
             BOOST_ASSERT(ec != zlib::error::end_of_stream);
             ws_.failed_ = !!ec;
             if(ws_.failed_)
                 break;
+            ws_.st_.on_inflate(zs.total_in, zs.total_out);
             if(ws_.rd_msg_max_ && beast::detail::sum_exceeds(
                 ws_.rd_.size, zs.total_out, ws_.rd_msg_max_))
             {
@@ -615,6 +646,7 @@ operator()(
             ws_.rd_.size += zs.total_out;
             ws_.rd_.remain -= zs.total_in;
             ws_.rd_.buf.consume(zs.total_in);
+            ws_.pmd_->predictor.consume(zs.total_in);
             bytes_written_ += zs.total_out;
         }
         if(ws_.rd_.op == detail::opcode::text)
@@ -641,13 +673,16 @@ operator()(
         BOOST_ASSERT(bytes_transferred > 0);
         ws_.rd_.buf.commit(bytes_transferred);
         if(ws_.rd_.fh.mask)
-            detail::mask_inplace(
+            ws_.mask_inplace(
                 buffer_prefix(clamp(ws_.rd_.remain),
                     ws_.rd_.buf.mutable_data()), ws_.rd_.key);
         did_read_ = true;
         goto go_inflate;
     }
     }
+    if(! ec)
+        ws_.st_.on_read(bytes_written_, ws_.rd_.done);
+    ws_.rd_release();
     // upcall
     if(! dispatched_)
     {
@@ -663,14 +698,14 @@ operator()(
 
 //------------------------------------------------------------------------------
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<
     class DynamicBuffer,
     class Handler>
-class stream<NextLayer>::read_op
+class stream<NextLayer, Role>::read_op
 {
     Handler h_;
-    stream<NextLayer>& ws_;
+    stream<NextLayer, Role>& ws_;
     DynamicBuffer& b_;
     std::size_t limit_;
     std::size_t bytes_written_ = 0;
@@ -684,7 +719,7 @@ public:
     template<class DeducedHandler>
     read_op(
         DeducedHandler&& h,
-        stream<NextLayer>& ws,
+        stream<NextLayer, Role>& ws,
         DynamicBuffer& b,
         std::size_t limit,
         bool some)
@@ -737,10 +772,10 @@ public:
     }
 };
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class DynamicBuffer, class Handler>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 read_op<DynamicBuffer, Handler>::
 operator()(
     error_code ec,
@@ -799,10 +834,10 @@ operator()(
 
 //------------------------------------------------------------------------------
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class DynamicBuffer>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 read(DynamicBuffer& buffer)
 {
     static_assert(is_sync_stream<next_layer_type>::value,
@@ -815,10 +850,10 @@ read(DynamicBuffer& buffer)
         BOOST_THROW_EXCEPTION(system_error{ec});
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class DynamicBuffer>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 read(DynamicBuffer& buffer, error_code& ec)
 {
     static_assert(is_sync_stream<next_layer_type>::value,
@@ -834,10 +869,10 @@ read(DynamicBuffer& buffer, error_code& ec)
     while(! is_message_done());
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class DynamicBuffer, class ReadHandler>
 async_return_type<ReadHandler, void(error_code)>
-stream<NextLayer>::
+stream<NextLayer, Role>::
 async_read(DynamicBuffer& buffer, ReadHandler&& handler)
 {
     static_assert(is_async_stream<next_layer_type>::value,
@@ -863,10 +898,10 @@ async_read(DynamicBuffer& buffer, ReadHandler&& handler)
 
 //------------------------------------------------------------------------------
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class DynamicBuffer>
 std::size_t
-stream<NextLayer>::
+stream<NextLayer, Role>::
 read_some(
     DynamicBuffer& buffer,
     std::size_t limit)
@@ -883,10 +918,10 @@ read_some(
     return bytes_written;
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class DynamicBuffer>
 std::size_t
-stream<NextLayer>::
+stream<NextLayer, Role>::
 read_some(
     DynamicBuffer& buffer,
     std::size_t limit,
@@ -918,11 +953,11 @@ read_some(
     return bytes_written;
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class DynamicBuffer, class ReadHandler>
 async_return_type<ReadHandler,
     void(error_code, std::size_t)>
-stream<NextLayer>::
+stream<NextLayer, Role>::
 async_read_some(
     DynamicBuffer& buffer,
     std::size_t limit,
@@ -948,10 +983,10 @@ async_read_some(
 
 //------------------------------------------------------------------------------
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class MutableBufferSequence>
 std::size_t
-stream<NextLayer>::
+stream<NextLayer, Role>::
 read_some(
     MutableBufferSequence const& buffers)
 {
@@ -967,10 +1002,10 @@ read_some(
     return bytes_written;
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class MutableBufferSequence>
 std::size_t
-stream<NextLayer>::
+stream<NextLayer, Role>::
 read_some(
     MutableBufferSequence const& buffers,
     error_code& ec)
@@ -998,6 +1033,19 @@ loop:
         {
             if(code != close_code::none)
                 goto do_close;
+            if(lean_ && ! rd_.buf.leased())
+            {
+                // Wait for the frame without a read buffer
+                auto const bytes_transferred =
+                    stream_.read_some(buffer(&rd_.peek, 1), ec);
+                failed_ = !!ec;
+                if(failed_)
+                    return bytes_written;
+                rd_.buf.commit(boost::asio::buffer_copy(
+                    rd_.buf.prepare(bytes_transferred),
+                        buffer(&rd_.peek, 1)));
+                continue;
+            }
             auto const bytes_transferred =
                 stream_.read_some(
                     rd_.buf.prepare(read_size(
@@ -1011,7 +1059,7 @@ loop:
         // Immediately apply the mask to the portion
         // of the buffer holding payload data.
         if(rd_.fh.len > 0 && rd_.fh.mask)
-            detail::mask_inplace(buffer_prefix(
+            mask_inplace(buffer_prefix(
                 clamp(rd_.fh.len), rd_.buf.mutable_data()),
                     rd_.key);
         if(detail::is_control(rd_.fh.op))
@@ -1034,10 +1082,18 @@ loop:
                 }
                 if(ctrl_cb_)
                     ctrl_cb_(frame_type::ping, payload);
-                detail::frame_streambuf fb;
-                write_ping<flat_static_buffer_base>(fb,
-                    detail::opcode::pong, payload);
-                boost::asio::write(stream_, fb.data(), ec);
+                {
+                    auto lock = wr_lock();
+                    if(wr_close_)
+                    {
+                        // The write half sent a close
+                        goto loop;
+                    }
+                    detail::frame_streambuf fb;
+                    write_ping<flat_static_buffer_base>(fb,
+                        detail::opcode::pong, payload);
+                    boost::asio::write(stream_, fb.data(), ec);
+                }
                 failed_ = !!ec;
                 if(failed_)
                     return bytes_written;
@@ -1062,6 +1118,7 @@ loop:
                 rd_.buf.consume(len);
                 if(ctrl_cb_)
                     ctrl_cb_(frame_type::close, cr_.reason);
+                auto lock = wr_lock();
                 if(! wr_close_)
                 {
                     auto cr = cr_;
@@ -1093,9 +1150,9 @@ loop:
     }
     if(! pmd_ || ! pmd_->rd_set)
     {
-        if(rd_.buf.size() == 0 && rd_.buf.max_size() >
-            (std::min)(clamp(rd_.remain),
-                buffer_size(buffers)))
+        if(rd_.buf.size() == 0 && ! rd_direct_ &&
+            rd_.buf.max_size() > (std::min)(
+                clamp(rd_.remain), buffer_size(buffers)))
         {
             // Fill the read buffer first, otherwise we
             // get fewer bytes at the cost of one I/O.
@@ -1107,7 +1164,7 @@ loop:
             if(failed_)
                 return bytes_written;
             if(rd_.fh.mask)
-                detail::mask_inplace(buffer_prefix(
+                mask_inplace(buffer_prefix(
                     clamp(rd_.remain), mb), rd_.key);
             rd_.buf.commit(bytes_transferred);
         }
@@ -1149,7 +1206,7 @@ loop:
                 bytes_transferred, buffers);
             rd_.remain -= bytes_transferred;
             if(rd_.fh.mask)
-                detail::mask_inplace(mb, rd_.key);
+                mask_inplace(mb, rd_.key);
             if(rd_.op == detail::opcode::text)
             {
                 if(! rd_.utf8.write(mb) ||
@@ -1188,6 +1245,7 @@ loop:
                 if(rd_.buf.size() > 0)
                 {
                     // use what's there
+                    rd_append_tail();
                     auto const in = buffer_prefix(
                         clamp(rd_.remain), buffer_front(
                             rd_.buf.data()));
@@ -1208,9 +1266,10 @@ loop:
                     BOOST_ASSERT(bytes_transferred > 0);
                     rd_.buf.commit(bytes_transferred);
                     if(rd_.fh.mask)
-                        detail::mask_inplace(
+                        mask_inplace(
                             buffer_prefix(clamp(rd_.remain),
                                 rd_.buf.mutable_data()), rd_.key);
+                    rd_append_tail();
                     auto const in = buffer_prefix(
                         clamp(rd_.remain), buffer_front(
                             rd_.buf.data()));
@@ -1225,29 +1284,34 @@ loop:
             }
             else if(rd_.fh.fin)
             {
-                // append the empty block codes
-                static std::uint8_t constexpr
-                    empty_block[4] = {
-                        0x00, 0x00, 0xff, 0xff };
-                zs.next_in = empty_block;
-                zs.avail_in = sizeof(empty_block);
-                pmd_->zi.write(zs, zlib::Flush::sync, ec);
-                BOOST_ASSERT(! ec);
-                failed_ = !!ec;
-                if(failed_)
-                    return bytes_written;
-                // VFALCO See:
-                // https://github.com/madler/zlib/issues/280
-                BOOST_ASSERT(zs.total_out == 0);
-                cb.consume(zs.total_out);
-                rd_.size += zs.total_out;
-                bytes_written += zs.total_out;
+                if(! pmd_->rd_tail)
+                {
+                    // append the empty block codes
+                    static std::uint8_t constexpr
+                        empty_block[4] = {
+                            0x00, 0x00, 0xff, 0xff };
+                    zs.next_in = empty_block;
+                    zs.avail_in = sizeof(empty_block);
+                    pmd_->zi.write(zs, zlib::Flush::sync, ec);
+                    BOOST_ASSERT(! ec);
+                    failed_ = !!ec;
+                    if(failed_)
+                        return bytes_written;
+                    // VFALCO See:
+                    // https://github.com/madler/zlib/issues/280
+                    BOOST_ASSERT(zs.total_out == 0);
+                    cb.consume(zs.total_out);
+                    rd_.size += zs.total_out;
+                    bytes_written += zs.total_out;
+                }
+                pmd_->rd_tail = false;
+                pmd_->predictor.end(rd_.size);
                 if(
-                    (role_ == role_type::client &&
+                    (this->is_client() &&
                         pmd_config_.server_no_context_takeover) ||
-                    (role_ == role_type::server &&
+                    (! this->is_client() &&
                         pmd_config_.client_no_context_takeover))
-                    pmd_->zi.reset();
+                    pmd_->zi.clear();
                 rd_.done = true;
                 break;
             }
@@ -1255,11 +1319,15 @@ loop:
             {
                 break;
             }
-            pmd_->zi.write(zs, zlib::Flush::sync, ec);
+            {
+                auto const st = st_.time_inflate();
+                pmd_->zi.write(zs, zlib::Flush::sync, ec);
+            }
             BOOST_ASSERT(ec != zlib::error::end_of_stream);
             failed_ = !!ec;
             if(failed_)
                 return bytes_written;
+            st_.on_inflate(zs.total_in, zs.total_out);
             if(rd_msg_max_ && beast::detail::sum_exceeds(
                 rd_.size, zs.total_out, rd_msg_max_))
             {
@@ -1270,6 +1338,7 @@ loop:
             rd_.size += zs.total_out;
             rd_.remain -= zs.total_in;
             rd_.buf.consume(zs.total_in);
+            pmd_->predictor.consume(zs.total_in);
             bytes_written += zs.total_out;
         }
         if(rd_.op == detail::opcode::text)
@@ -1285,10 +1354,13 @@ loop:
             }
         }
     }
+    st_.on_read(bytes_written, rd_.done);
+    rd_release();
     return bytes_written;
 do_close:
     if(code != close_code::none)
     {
+        auto lock = wr_lock();
         // Fail the connection (per rfc6455)
         if(! wr_close_)
         {
@@ -1316,6 +1388,7 @@ do_close:
     }
     if(! ec)
     {
+        auto lock = wr_lock();
         websocket_helpers::call_teardown(next_layer(), ec);
         if(ec == boost::asio::error::eof)
         {
@@ -1329,10 +1402,10 @@ do_close:
     return bytes_written;
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class MutableBufferSequence, class ReadHandler>
 async_return_type<ReadHandler, void(error_code, std::size_t)>
-stream<NextLayer>::
+stream<NextLayer, Role>::
 async_read_some(
     MutableBufferSequence const& buffers,
     ReadHandler&& handler)
@@ -0,0 +1,376 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_IMPL_RELAY_IPP
+#define BEAST_WEBSOCKET_IMPL_RELAY_IPP
+
+#include <beast/websocket/teardown.hpp>
+#include <beast/core/buffer_cat.hpp>
+#include <beast/core/buffer_prefix.hpp>
+#include <beast/core/flat_static_buffer.hpp>
+#include <beast/core/type_traits.hpp>
+#include <beast/core/detail/clamp.hpp>
+#include <boost/assert.hpp>
+#include <boost/throw_exception.hpp>
+#include <cstdint>
+
+namespace beast {
+namespace websocket {
+
+// Returns `true` if compressed messages received on this
+// stream may be sent unchanged on `dest`. The peer of `dest`
+// must have a window at least as large as the one used by
+// our peer, and must not discard its window between messages
+// unless our peer does too.
+//
+template<class NextLayer, class Role>
+template<class OtherLayer, class OtherRole>
+bool
+stream<NextLayer, Role>::
+rd_passthrough(stream<OtherLayer, OtherRole> const& dest) const
+{
+    if(! pmd_ || ! dest.pmd_)
+        return false;
+    auto const& in = pmd_config_;
+    auto const& out = dest.pmd_config_;
+    auto const bits = this->is_client() ?
+        in.server_max_window_bits : in.client_max_window_bits;
+    auto const reset = this->is_client() ?
+        in.server_no_context_takeover :
+        in.client_no_context_takeover;
+    auto const dest_bits = dest.is_client() ?
+        out.client_max_window_bits : out.server_max_window_bits;
+    auto const dest_reset = dest.is_client() ?
+        out.client_no_context_takeover :
+        out.server_no_context_takeover;
+    return bits <= dest_bits && (reset || ! dest_reset);
+}
+
+template<class NextLayer, class Role>
+template<class OtherLayer, class OtherRole>
+void
+stream<NextLayer, Role>::
+relay(stream<OtherLayer, OtherRole>& dest)
+{
+    static_assert(is_sync_stream<next_layer_type>::value,
+        "SyncStream requirements not met");
+    error_code ec;
+    relay(dest, ec);
+    if(ec)
+        BOOST_THROW_EXCEPTION(system_error{ec});
+}
+
+template<class NextLayer, class Role>
+template<class OtherLayer, class OtherRole>
+void
+stream<NextLayer, Role>::
+relay(stream<OtherLayer, OtherRole>& dest, error_code& ec)
+{
+    static_assert(is_sync_stream<next_layer_type>::value,
+        "SyncStream requirements not met");
+    do
+    {
+        relay_some(dest, ec);
+        if(ec)
+            return;
+    }
+    while(! is_message_done());
+}
+
+template<class NextLayer, class Role>
+template<class OtherLayer, class OtherRole>
+void
+stream<NextLayer, Role>::
+relay_some(stream<OtherLayer, OtherRole>& dest)
+{
+    static_assert(is_sync_stream<next_layer_type>::value,
+        "SyncStream requirements not met");
+    error_code ec;
+    relay_some(dest, ec);
+    if(ec)
+        BOOST_THROW_EXCEPTION(system_error{ec});
+}
+
+template<class NextLayer, class Role>
+template<class OtherLayer, class OtherRole>
+void
+stream<NextLayer, Role>::
+relay_some(stream<OtherLayer, OtherRole>& dest, error_code& ec)
+{
+    static_assert(is_sync_stream<next_layer_type>::value,
+        "SyncStream requirements not met");
+    static_assert(is_sync_stream<typename stream<
+        OtherLayer, OtherRole>::next_layer_type>::value,
+            "SyncStream requirements not met");
+    using beast::detail::clamp;
+    using boost::asio::buffer_size;
+    close_code code{};
+    if(! rd_.done && pmd_ && pmd_->rd_set &&
+        ! rd_passthrough(dest))
+    {
+        // Continue re-compressing the current message
+        relay_inflated(dest, ec);
+        return;
+    }
+    BOOST_ASSERT(rd_.remain == 0);
+loop:
+    // Read frame header
+    while(! parse_fh(rd_.fh, rd_.buf, code))
+    {
+        if(code != close_code::none)
+            goto do_close;
+        auto const bytes_transferred =
+            stream_.read_some(
+                rd_.buf.prepare(read_size(
+                    rd_.buf, rd_.buf.max_size())),
+                ec);
+        failed_ = !!ec;
+        if(failed_)
+            return;
+        rd_.buf.commit(bytes_transferred);
+    }
+    if(detail::is_control(rd_.fh.op))
+    {
+        // Control frames are answered locally,
+        // they are not forwarded.
+        if(rd_.fh.len > 0 && rd_.fh.mask)
+            mask_inplace(buffer_prefix(
+                clamp(rd_.fh.len), rd_.buf.mutable_data()),
+                    rd_.key);
+        auto const cb = buffer_prefix(
+            clamp(rd_.fh.len), rd_.buf.data());
+        auto const len = buffer_size(cb);
+        BOOST_ASSERT(len == rd_.fh.len);
+        if(rd_.fh.op == detail::opcode::ping)
+        {
+            ping_data payload;
+            detail::read_ping(payload, cb);
+            rd_.buf.consume(len);
+            if(wr_close_)
+            {
+                // Ignore ping when closing
+                goto loop;
+            }
+            if(ctrl_cb_)
+                ctrl_cb_(frame_type::ping, payload);
+            {
+                auto lock = wr_lock();
+                if(wr_close_)
+                    goto loop;
+                detail::frame_streambuf fb;
+                write_ping<flat_static_buffer_base>(fb,
+                    detail::opcode::pong, payload);
+                boost::asio::write(stream_, fb.data(), ec);
+            }
+            failed_ = !!ec;
+            if(failed_)
+                return;
+            goto loop;
+        }
+        else if(rd_.fh.op == detail::opcode::pong)
+        {
+            ping_data payload;
+            detail::read_ping(payload, cb);
+            rd_.buf.consume(len);
+            if(ctrl_cb_)
+                ctrl_cb_(frame_type::pong, payload);
+            goto loop;
+        }
+        BOOST_ASSERT(rd_.fh.op == detail::opcode::close);
+        {
+            BOOST_ASSERT(! rd_close_);
+            rd_close_ = true;
+            detail::read_close(cr_, cb, code);
+            if(code != close_code::none)
+                goto do_close;
+            rd_.buf.consume(len);
+            if(ctrl_cb_)
+                ctrl_cb_(frame_type::close, cr_.reason);
+            auto lock = wr_lock();
+            if(! wr_close_)
+            {
+                auto cr = cr_;
+                if(cr.code == close_code::none)
+                    cr.code = close_code::normal;
+                cr.reason = "";
+                detail::frame_streambuf fb;
+                wr_close_ = true;
+                write_close<
+                    flat_static_buffer_base>(fb, cr);
+                boost::asio::write(stream_, fb.data(), ec);
+                failed_ = !!ec;
+                if(failed_)
+                    return;
+            }
+            goto do_close;
+        }
+    }
+    rd_.done = false;
+    if(pmd_ && pmd_->rd_set && ! rd_passthrough(dest))
+    {
+        // The peer of `dest` could not decompress the
+        // payload, so inflate it here and let `dest`
+        // compress it again, if it can.
+        if(rd_.fh.len > 0 && rd_.fh.mask)
+            mask_inplace(buffer_prefix(
+                clamp(rd_.fh.len), rd_.buf.mutable_data()),
+                    rd_.key);
+        relay_inflated(dest, ec);
+        return;
+    }
+    relay_frame(dest, ec);
+    return;
+
+do_close:
+    if(code != close_code::none)
+    {
+        auto lock = wr_lock();
+        // Fail the connection (per rfc6455)
+        if(! wr_close_)
+        {
+            wr_close_ = true;
+            detail::frame_streambuf fb;
+            write_close<flat_static_buffer_base>(fb, code);
+            boost::asio::write(stream_, fb.data(), ec);
+            failed_ = !!ec;
+            if(failed_)
+                return;
+        }
+        websocket_helpers::call_teardown(next_layer(), ec);
+        if(ec == boost::asio::error::eof)
+        {
+            // Rationale:
+            // http://stackoverflow.com/questions/25587403/boost-asio-ssl-async-shutdown-always-finishes-with-an-error
+            ec.assign(0, ec.category());
+        }
+        failed_ = !!ec;
+        if(failed_)
+            return;
+        ec = error::failed;
+        failed_ = true;
+        return;
+    }
+    {
+        auto lock = wr_lock();
+        websocket_helpers::call_teardown(next_layer(), ec);
+        if(ec == boost::asio::error::eof)
+        {
+            // (See above)
+            ec.assign(0, ec.category());
+        }
+    }
+    if(! ec)
+        ec = error::closed;
+    failed_ = !!ec;
+}
+
+// Forward the data frame whose header was just read,
+// applying the change of mask in a single pass.
+//
+template<class NextLayer, class Role>
+template<class OtherLayer, class OtherRole>
+void
+stream<NextLayer, Role>::
+relay_frame(stream<OtherLayer, OtherRole>& dest, error_code& ec)
+{
+    using beast::detail::clamp;
+    auto lock = dest.wr_lock();
+    if(dest.wr_aborted(lock, ec))
+        return;
+    // `dest` must not be in the middle of another message
+    BOOST_ASSERT(dest.wr_.cont ==
+        (rd_.fh.op == detail::opcode::cont));
+    detail::frame_header fh;
+    fh.op = rd_.fh.op;
+    fh.fin = rd_.fh.fin;
+    fh.rsv1 = rd_.fh.rsv1;
+    fh.rsv2 = false;
+    fh.rsv3 = false;
+    fh.len = rd_.fh.len;
+    fh.mask = dest.is_client();
+    fh.key = fh.mask ? dest.mask_key() : 0;
+    // The keys are zero when the frames are unmasked
+    auto const remask = rd_.fh.mask || fh.mask;
+    detail::prepared_key key;
+    if(remask)
+        detail::prepare_key(key, rd_.fh.key ^ fh.key);
+    detail::fh_streambuf fh_buf;
+    detail::write<flat_static_buffer_base>(fh_buf, fh);
+    dest.st_.on_frame_out(fh);
+    dest.wr_.cont = ! fh.fin;
+    bool first = true;
+    for(;;)
+    {
+        if(rd_.buf.size() == 0 && rd_.remain > 0)
+        {
+            auto const bytes_transferred =
+                stream_.read_some(
+                    rd_.buf.prepare(read_size(
+                        rd_.buf, rd_.buf.max_size())),
+                    ec);
+            failed_ = !!ec;
+            if(failed_)
+                return;
+            rd_.buf.commit(bytes_transferred);
+        }
+        auto const n = clamp(rd_.remain, rd_.buf.size());
+        if(remask)
+            mask_inplace(buffer_prefix(
+                n, rd_.buf.mutable_data()), key);
+        if(first)
+            boost::asio::write(dest.stream_, buffer_cat(
+                fh_buf.data(), buffer_prefix(
+                    n, rd_.buf.data())), ec);
+        else
+            boost::asio::write(dest.stream_,
+                buffer_prefix(n, rd_.buf.data()), ec);
+        dest.failed_ = !!ec;
+        if(dest.failed_)
+            return;
+        first = false;
+        rd_.buf.consume(n);
+        rd_.remain -= n;
+        if(rd_.remain == 0)
+            break;
+    }
+    if(rd_.fh.fin)
+        rd_.done = true;
+}
+
+// Relay some of a compressed message which the peer of
+// `dest` could not decompress, through the message interface.
+//
+template<class NextLayer, class Role>
+template<class OtherLayer, class OtherRole>
+void
+stream<NextLayer, Role>::
+relay_inflated(stream<OtherLayer, OtherRole>& dest, error_code& ec)
+{
+    using boost::asio::buffer;
+    std::uint8_t buf[4096];
+    auto const n = read_some(buffer(buf), ec);
+    if(ec)
+        return;
+    auto const fin = is_message_done();
+    if(n == 0 && ! fin)
+        return;
+    if(dest.wr_.cont)
+    {
+        dest.write_some(fin, buffer(buf, n), ec);
+        return;
+    }
+    // Start the message with the received opcode
+    auto const op = dest.wr_opcode_;
+    dest.wr_opcode_ = rd_.op;
+    dest.write_some(fin, buffer(buf, n), ec);
+    dest.wr_opcode_ = op;
+}
+
+} // websocket
+} // beast
+
+#endif
@@ -0,0 +1,208 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_IMPL_SEND_QUEUE_IPP
+#define BEAST_WEBSOCKET_IMPL_SEND_QUEUE_IPP
+
+#include <beast/core/type_traits.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/assert.hpp>
+
+namespace beast {
+namespace websocket {
+
+/*  The queue is the intrusive multi-producer, single consumer
+    design by Dmitry Vyukov. Producers swap themselves in at the
+    head and then link the previous head to themselves. Between
+    those two steps the list is briefly disconnected, which the
+    consumer sees as an empty queue while the count says otherwise.
+    The writer then posts itself and tries again.
+*/
+
+template<class NextLayer, class Role, class Executor>
+send_queue<NextLayer, Role, Executor>::
+send_queue(stream<NextLayer, Role>& ws, Executor& ex,
+        std::size_t high, std::size_t low)
+    : ws_(ws)
+    , ex_(ex)
+    , high_(high)
+    , low_(low)
+    , head_(&stub_)
+    , tail_(&stub_)
+{
+    BOOST_ASSERT(low_ <= high_);
+    stub_.next.store(nullptr, std::memory_order_relaxed);
+}
+
+template<class NextLayer, class Role, class Executor>
+send_queue<NextLayer, Role, Executor>::
+~send_queue()
+{
+    delete cur_;
+    while(auto const n = dequeue())
+        delete n;
+}
+
+template<class NextLayer, class Role, class Executor>
+void
+send_queue<NextLayer, Role, Executor>::
+enqueue(node* n)
+{
+    n->next.store(nullptr, std::memory_order_relaxed);
+    auto const prev =
+        head_.exchange(n, std::memory_order_acq_rel);
+    prev->next.store(n, std::memory_order_release);
+}
+
+template<class NextLayer, class Role, class Executor>
+auto
+send_queue<NextLayer, Role, Executor>::
+dequeue() ->
+    node*
+{
+    auto tail = tail_;
+    auto next = tail->next.load(std::memory_order_acquire);
+    if(tail == &stub_)
+    {
+        if(! next)
+            return nullptr;
+        tail_ = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if(next)
+    {
+        tail_ = next;
+        return tail;
+    }
+    if(tail != head_.load(std::memory_order_acquire))
+        return nullptr;
+    enqueue(&stub_);
+    next = tail->next.load(std::memory_order_acquire);
+    if(next)
+    {
+        tail_ = next;
+        return tail;
+    }
+    return nullptr;
+}
+
+template<class NextLayer, class Role, class Executor>
+void
+send_queue<NextLayer, Role, Executor>::
+check_low()
+{
+    if(bytes_.load(std::memory_order_acquire) <= low_ &&
+        full_.exchange(false, std::memory_order_acq_rel) &&
+            on_low_)
+        on_low_();
+}
+
+template<class NextLayer, class Role, class Executor>
+void
+send_queue<NextLayer, Role, Executor>::
+discard()
+{
+    while(auto const n = dequeue())
+    {
+        bytes_.fetch_sub(n->payload.size(),
+            std::memory_order_acq_rel);
+        delete n;
+    }
+    count_.store(0, std::memory_order_release);
+}
+
+template<class NextLayer, class Role, class Executor>
+void
+send_queue<NextLayer, Role, Executor>::
+drain()
+{
+    BOOST_ASSERT(! cur_);
+    if(failed_.load(std::memory_order_acquire))
+    {
+        // A producer got past the check in
+        // push before the write failed
+        discard();
+        return;
+    }
+    cur_ = dequeue();
+    if(! cur_)
+    {
+        // A producer is between its two steps
+        ex_.post([this]{ drain(); });
+        return;
+    }
+    ws_.binary(cur_->binary);
+    ws_.async_write(boost::asio::buffer(cur_->payload),
+        ex_.wrap([this](error_code const& ec)
+        {
+            on_write(ec);
+        }));
+}
+
+template<class NextLayer, class Role, class Executor>
+void
+send_queue<NextLayer, Role, Executor>::
+on_write(error_code const& ec)
+{
+    auto const n = cur_->payload.size();
+    delete cur_;
+    cur_ = nullptr;
+    bytes_.fetch_sub(n, std::memory_order_acq_rel);
+    if(ec)
+    {
+        failed_.store(true, std::memory_order_release);
+        discard();
+        if(on_error_)
+            on_error_(ec);
+        return;
+    }
+    check_low();
+    if(count_.fetch_sub(1, std::memory_order_acq_rel) > 1)
+        drain();
+}
+
+template<class NextLayer, class Role, class Executor>
+template<class ConstBufferSequence>
+bool
+send_queue<NextLayer, Role, Executor>::
+push(ConstBufferSequence const& buffers, bool binary)
+{
+    static_assert(beast::is_const_buffer_sequence<
+        ConstBufferSequence>::value,
+            "ConstBufferSequence requirements not met");
+    using boost::asio::buffer;
+    using boost::asio::buffer_copy;
+    using boost::asio::buffer_size;
+    if(failed_.load(std::memory_order_acquire))
+        return false;
+    auto n = new node;
+    n->payload.resize(buffer_size(buffers));
+    buffer_copy(buffer(&n->payload[0], n->payload.size()), buffers);
+    n->binary = binary;
+    auto const size = n->payload.size();
+    auto const bytes = size +
+        bytes_.fetch_add(size, std::memory_order_acq_rel);
+    enqueue(n);
+    if(count_.fetch_add(1, std::memory_order_acq_rel) == 0)
+        ex_.post([this]{ drain(); });
+    if(bytes > high_ &&
+        ! full_.exchange(true, std::memory_order_acq_rel))
+    {
+        if(on_high_)
+            on_high_();
+        // The writer may have drained
+        // before the flag was set
+        check_low();
+    }
+    return true;
+}
+
+} // websocket
+} // beast
+
+#endif
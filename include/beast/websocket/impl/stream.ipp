@@ -23,9 +23,9 @@
 #include <beast/core/type_traits.hpp>
 #include <beast/core/detail/clamp.hpp>
 #include <beast/core/detail/type_traits.hpp>
+#include <boost/asio/write.hpp>
 #include <boost/assert.hpp>
 #include <boost/endian/buffers.hpp>
-#include <boost/make_unique.hpp>
 #include <boost/throw_exception.hpp>
 #include <algorithm>
 #include <memory>
@@ -37,9 +37,9 @@
 namespace beast {
 namespace websocket {
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class... Args>
-stream<NextLayer>::
+stream<NextLayer, Role>::
 stream(Args&&... args)
     : stream_(std::forward<Args>(args)...)
 {
@@ -47,9 +47,22 @@ stream(Args&&... args)
         max_control_frame_size);
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
+auto
+stream<NextLayer, Role>::
+split() ->
+    std::pair<read_half<NextLayer, Role>,
+        write_half<NextLayer, Role>>
+{
+    if(! wr_mutex_)
+        wr_mutex_.reset(new std::mutex);
+    return {read_half<NextLayer, Role>{*this},
+        write_half<NextLayer, Role>{*this}};
+}
+
+template<class NextLayer, class Role>
 std::size_t
-stream<NextLayer>::
+stream<NextLayer, Role>::
 read_size_hint(
     std::size_t initial_size) const
 {
@@ -63,15 +76,17 @@ read_size_hint(
 
         if(rd_.fh.fin)
             return clamp(rd_.remain);
+        return (std::max)(
+            initial_size, clamp(rd_.remain));
     }
     return (std::max)(
-        initial_size, clamp(rd_.remain));
+        initial_size, rd_inflated_size());
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class DynamicBuffer, class>
 std::size_t
-stream<NextLayer>::
+stream<NextLayer, Role>::
 read_size_hint(
     DynamicBuffer& buffer) const
 {
@@ -94,23 +109,56 @@ read_size_hint(
             return (std::min)(
                 buffer.max_size(), clamp(rd_.remain));
         }
+        return (std::min)(buffer.max_size(), (std::max)(
+            (std::max)(+tcp_frame_size, clamp(rd_.remain)),
+                buffer.capacity() - buffer.size()));
     }
     return (std::min)(buffer.max_size(), (std::max)(
-        (std::max)(+tcp_frame_size, clamp(rd_.remain)),
+        (std::max)(+tcp_frame_size, rd_inflated_size()),
             buffer.capacity() - buffer.size()));
 }
 
-template<class NextLayer>
+// Returns the expected size of the rest of the
+// message, or the next message, once inflated.
+template<class NextLayer, class Role>
+std::size_t
+stream<NextLayer, Role>::
+rd_inflated_size() const
+{
+    BOOST_ASSERT(pmd_);
+    auto const& p = pmd_->predictor;
+    std::uint64_t size = 0;
+    std::size_t n;
+    if(rd_.done)
+    {
+        n = p.size();
+    }
+    else
+    {
+        size = rd_.size;
+        n = p.expect(rd_.remain);
+        if(! rd_.fh.fin && p.size() > size)
+            n = (std::max)(n, p.size() -
+                static_cast<std::size_t>(size));
+    }
+    if(rd_msg_max_)
+        n = (std::min<std::size_t>)(n,
+            rd_msg_max_ - (std::min<std::uint64_t>)(
+                size, rd_msg_max_));
+    return n;
+}
+
+template<class NextLayer, class Role>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 set_option(permessage_deflate const& o)
 {
     if( o.server_max_window_bits > 15 ||
-        o.server_max_window_bits < 9)
+        o.server_max_window_bits < 8)
         BOOST_THROW_EXCEPTION(std::invalid_argument{
             "invalid server_max_window_bits"});
     if( o.client_max_window_bits > 15 ||
-        o.client_max_window_bits < 9)
+        o.client_max_window_bits < 8)
         BOOST_THROW_EXCEPTION(std::invalid_argument{
             "invalid client_max_window_bits"});
     if( o.compLevel < 0 ||
@@ -124,15 +172,44 @@ set_option(permessage_deflate const& o)
     pmd_opts_ = o;
 }
 
+template<class NextLayer, class Role>
+void
+stream<NextLayer, Role>::
+set_option(keepalive const& o)
+{
+    using duration = detail::keepalive_hook::clock_type::duration;
+    if( o.idle_timeout < duration::zero() ||
+        o.ping_interval < duration::zero() ||
+        o.pong_timeout < duration::zero())
+        BOOST_THROW_EXCEPTION(std::invalid_argument{
+            "invalid keepalive duration"});
+    // Unlinking first keeps the timer from
+    // seeing the settings while they change.
+    this->ka_unlink();
+    ka_.opt = o;
+    auto period = (duration::max)();
+    for(auto const d : {
+        o.idle_timeout, o.ping_interval, o.pong_timeout})
+        if(d > duration::zero() && d < period)
+            period = d;
+    if(period == (duration::max)())
+        return;
+    ka_.recv_at = detail::keepalive_hook::clock_type::now();
+    ka_.msg_at = ka_.recv_at;
+    this->ka_link(boost::asio::use_service<
+        detail::keepalive_service>(get_io_service()),
+            &stream::ka_check, period);
+}
+
 //------------------------------------------------------------------------------
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 open(role_type role)
 {
     // VFALCO TODO analyze and remove dupe code in reset()
-    role_ = role;
+    this->set_client(role == role_type::client);
     failed_ = false;
     rd_.remain = 0;
     rd_.cont = false;
@@ -146,13 +223,18 @@ open(role_type role)
     wr_.cont = false;
     wr_.buf_size = 0;
 
-    if(((role_ == role_type::client && pmd_opts_.client_enable) ||
-        (role_ == role_type::server && pmd_opts_.server_enable)) &&
+    ka_.recv = false;
+    ka_.msg = false;
+    ka_.awaiting = false;
+    ka_.timed_out = false;
+
+    if(((this->is_client() && pmd_opts_.client_enable) ||
+        (! this->is_client() && pmd_opts_.server_enable)) &&
             pmd_config_.accept)
     {
         pmd_normalize(pmd_config_);
         pmd_.reset(new pmd_t);
-        if(role_ == role_type::client)
+        if(this->is_client())
         {
             pmd_->zi.reset(
                 pmd_config_.server_max_window_bits);
@@ -172,21 +254,23 @@ open(role_type role)
                 pmd_opts_.memLevel,
                 zlib::Strategy::normal);
         }
+        pmd_->policy.reset(
+            pmd_opts_.adaptive, pmd_opts_.compLevel);
     }
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 close()
 {
     wr_.buf.reset();
     pmd_.reset();
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 reset()
 {
     failed_ = false;
@@ -205,9 +289,9 @@ reset()
 }
 
 // Called before each write frame
-template<class NextLayer>
+template<class NextLayer, class Role>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 wr_begin()
 {
     wr_.autofrag = wr_autofrag_;
@@ -215,13 +299,16 @@ wr_begin()
 
     // Maintain the write buffer
     if( wr_.compress ||
-        role_ == role_type::client)
+        this->is_client())
     {
         if(! wr_.buf || wr_.buf_size != wr_buf_size_)
         {
             wr_.buf_size = wr_buf_size_;
-            wr_.buf = boost::make_unique_noinit<
-                std::uint8_t[]>(wr_.buf_size);
+            wr_.buf.reset();
+            wr_.buf.get_deleter().n = wr_.buf_size;
+            wr_.buf.reset(static_cast<std::uint8_t*>(
+                detail::pmd_pool::allocate(
+                    wr_.buf_size)));
         }
     }
     else
@@ -229,16 +316,194 @@ wr_begin()
         wr_.buf_size = wr_buf_size_;
         wr_.buf.reset();
     }
+    wr_frag_.limit(wr_.buf_size);
+}
+
+// Called when a read completes, to give back
+// the read buffers if the lean option is set
+template<class NextLayer, class Role>
+void
+stream<NextLayer, Role>::
+rd_release()
+{
+    if(! lean_)
+        return;
+    rd_.buf.release();
+    if(stream_.buffer().size() == 0)
+        stream_.buffer().shrink_to_fit();
+}
+
+// Called when a write completes, to give back
+// the write buffer if the lean option is set
+template<class NextLayer, class Role>
+void
+stream<NextLayer, Role>::
+wr_release()
+{
+    if(! lean_ || wr_.cont)
+        return;
+    wr_.buf.reset();
+}
+
+// Append the empty block codes to a compressed final frame
+// which was received completely, so that the codes do not need
+// an inflate call of their own after the payload. The payload
+// is still inflated incrementally by the same inflate_stream.
+template<class NextLayer, class Role>
+void
+stream<NextLayer, Role>::
+rd_append_tail()
+{
+    using boost::asio::buffer;
+    using boost::asio::buffer_copy;
+    static std::uint8_t constexpr
+        empty_block[4] = {
+            0x00, 0x00, 0xff, 0xff };
+    BOOST_ASSERT(pmd_ && pmd_->rd_set);
+    if(pmd_->rd_tail || ! rd_.fh.fin ||
+            rd_.buf.size() != rd_.remain ||
+            rd_.buf.max_size() - rd_.buf.size() <
+                sizeof(empty_block))
+        return;
+    rd_.buf.commit(buffer_copy(rd_.buf.prepare(
+        sizeof(empty_block)), buffer(empty_block)));
+    rd_.remain += sizeof(empty_block);
+    pmd_->rd_tail = true;
+}
+
+// Returns the frame of `msg` to send on this connection
+template<class NextLayer, class Role>
+boost::asio::const_buffers_1
+stream<NextLayer, Role>::
+wr_prepared(prepared_message const& msg)
+{
+    BOOST_ASSERT(msg);
+    BOOST_ASSERT(! this->is_client());
+    BOOST_ASSERT(! wr_.cont);
+    auto const b =
+        (! pmd_ || ! pmd_config_.server_no_context_takeover) ?
+            msg.get(false, 0) :
+            msg.get(true, pmd_config_.server_max_window_bits);
+    st_.on_frame_out(boost::asio::buffer_size(b), msg.binary() ?
+        detail::opcode::binary : detail::opcode::text);
+    st_.on_write(msg.size(), true);
+    return b;
+}
+
+// Prepare the header of a single frame holding
+// `buffers`, and apply the mask to `buffers` in place.
+// A message in progress is finished by the frame.
+template<class NextLayer, class Role>
+template<class MutableBufferSequence>
+void
+stream<NextLayer, Role>::
+wr_inplace(detail::fh_streambuf& fh_buf,
+    MutableBufferSequence const& buffers)
+{
+    BOOST_ASSERT(this->is_client());
+    detail::frame_header fh;
+    fh.op = wr_.cont ?
+        detail::opcode::cont : wr_opcode_;
+    wr_.cont = false;
+    fh.fin = true;
+    fh.mask = true;
+    fh.rsv1 = false;
+    fh.rsv2 = false;
+    fh.rsv3 = false;
+    fh.len = boost::asio::buffer_size(buffers);
+    fh.key = this->mask_key();
+    detail::write<flat_static_buffer_base>(fh_buf, fh);
+    st_.on_frame_out(fh);
+    st_.on_write(fh.len, true);
+    detail::prepared_key key;
+    detail::prepare_key(key, fh.key);
+    mask_inplace(buffers, key);
+}
+
+// Append a single frame holding `buffers` to the messages
+// waiting to be coalesced, and return its size
+template<class NextLayer, class Role>
+template<class ConstBufferSequence>
+std::size_t
+stream<NextLayer, Role>::
+wr_batch_frame(ConstBufferSequence const& buffers)
+{
+    using boost::asio::buffer_copy;
+    using boost::asio::buffer_size;
+    detail::frame_header fh;
+    fh.op = wr_opcode_;
+    fh.fin = true;
+    fh.mask = this->is_client();
+    fh.rsv1 = false;
+    fh.rsv2 = false;
+    fh.rsv3 = false;
+    fh.len = buffer_size(buffers);
+    if(fh.mask)
+        fh.key = this->mask_key();
+    auto& b = wr_batch_.buf;
+    auto const size = b.size();
+    detail::write(b, fh);
+    st_.on_frame_out(fh);
+    st_.on_write(fh.len, true);
+    auto const mb = b.prepare(
+        static_cast<std::size_t>(fh.len));
+    buffer_copy(mb, buffers);
+    if(fh.mask)
+    {
+        detail::prepared_key key;
+        detail::prepare_key(key, fh.key);
+        mask_inplace(mb, key);
+    }
+    b.commit(static_cast<std::size_t>(fh.len));
+    return b.size() - size;
+}
+
+// Called when a coalesced write completes
+template<class NextLayer, class Role>
+void
+stream<NextLayer, Role>::
+wr_batch_next()
+{
+    auto const n = wr_batch_.head;
+    if(! n)
+    {
+        // The batch was sent or abandoned
+        wr_batch_.busy = false;
+        wr_batch_.last = 0;
+        wr_batch_.buf.consume(wr_batch_.buf.size());
+        return;
+    }
+    wr_batch_.head = n->next;
+    if(! wr_batch_.head)
+        wr_batch_.tail = nullptr;
+    n->lead(*this);
+}
+
+// Decide whether to compress the message
+// whose first frame is `buffers`
+template<class NextLayer, class Role>
+template<class ConstBufferSequence>
+void
+stream<NextLayer, Role>::
+wr_compress(ConstBufferSequence const& buffers)
+{
+    if(! wr_.compress)
+        return;
+    if(boost::asio::buffer_size(buffers) <
+            pmd_opts_.msg_size_threshold ||
+        ! pmd_->policy.begin() ||
+        ! detail::is_compressible(buffers))
+        wr_.compress = false;
 }
 
 //------------------------------------------------------------------------------
 
 // Attempt to read a complete frame header.
 // Returns `false` if more bytes are needed
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class DynamicBuffer>
 bool
-stream<NextLayer>::
+stream<NextLayer, Role>::
 parse_fh(
     detail::frame_header& fh,
     DynamicBuffer& b,
@@ -304,7 +569,10 @@ parse_fh(
             return err(close_code::protocol_error);
         }
         if(pmd_)
+        {
             pmd_->rd_set = fh.rsv1;
+            pmd_->rd_tail = false;
+        }
         break;
 
     case detail::opcode::cont:
@@ -344,10 +612,10 @@ parse_fh(
         break;
     }
     // unmasked frame from client
-    if(role_ == role_type::server && ! fh.mask)
+    if(! this->is_client() && ! fh.mask)
         return err(close_code::protocol_error);
     // masked frame from server
-    if(role_ == role_type::client && fh.mask)
+    if(this->is_client() && fh.mask)
         return err(close_code::protocol_error);
     if(detail::is_control(fh.op) &&
         buffer_size(cb) < fh.len)
@@ -416,6 +684,7 @@ parse_fh(
         rd_.cont = ! fh.fin;
         rd_.remain = fh.len;
     }
+    st_.on_frame_in(fh, b.size() - buffer_size(cb));
     b.consume(b.size() - buffer_size(cb));
     code = close_code::none;
     return true;
@@ -424,10 +693,10 @@ parse_fh(
 // Read fixed frame header from buffer
 // Requires at least 2 bytes
 //
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class DynamicBuffer>
 std::size_t
-stream<NextLayer>::
+stream<NextLayer, Role>::
 read_fh1(detail::frame_header& fh,
     DynamicBuffer& db, close_code& code)
 {
@@ -477,7 +746,10 @@ read_fh1(detail::frame_header& fh,
             return err(close_code::protocol_error);
         }
         if(pmd_)
+        {
             pmd_->rd_set = fh.rsv1;
+            pmd_->rd_tail = false;
+        }
         break;
 
     case detail::opcode::cont:
@@ -517,13 +789,13 @@ read_fh1(detail::frame_header& fh,
         break;
     }
     // unmasked frame from client
-    if(role_ == role_type::server && ! fh.mask)
+    if(! this->is_client() && ! fh.mask)
     {
         code = close_code::protocol_error;
         return 0;
     }
     // masked frame from server
-    if(role_ == role_type::client && fh.mask)
+    if(this->is_client() && fh.mask)
     {
         code = close_code::protocol_error;
         return 0;
@@ -534,10 +806,10 @@ read_fh1(detail::frame_header& fh,
 
 // Decode variable frame header from buffer
 //
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class DynamicBuffer>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 read_fh2(detail::frame_header& fh,
     DynamicBuffer& db, close_code& code)
 {
@@ -609,10 +881,10 @@ read_fh2(detail::frame_header& fh,
     code = close_code::none;
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class DynamicBuffer>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 write_close(DynamicBuffer& db, close_reason const& cr)
 {
     using namespace boost::endian;
@@ -624,10 +896,11 @@ write_close(DynamicBuffer& db, close_reason const& cr)
     fh.rsv3 = false;
     fh.len = cr.code == close_code::none ?
         0 : 2 + cr.reason.size();
-    fh.mask = role_ == role_type::client;
+    fh.mask = this->is_client();
     if(fh.mask)
-        fh.key = maskgen_();
+        fh.key = this->mask_key();
     detail::write(db, fh);
+    st_.on_frame_out(fh);
     if(cr.code != close_code::none)
     {
         detail::prepared_key key;
@@ -641,7 +914,7 @@ write_close(DynamicBuffer& db, close_reason const& cr)
             boost::asio::buffer_copy(d,
                 boost::asio::buffer(b));
             if(fh.mask)
-                detail::mask_inplace(d, key);
+                mask_inplace(d, key);
             db.commit(2);
         }
         if(! cr.reason.empty())
@@ -651,16 +924,16 @@ write_close(DynamicBuffer& db, close_reason const& cr)
                 boost::asio::const_buffer(
                     cr.reason.data(), cr.reason.size()));
             if(fh.mask)
-                detail::mask_inplace(d, key);
+                mask_inplace(d, key);
             db.commit(cr.reason.size());
         }
     }
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class DynamicBuffer>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 write_ping(DynamicBuffer& db,
     detail::opcode code, ping_data const& data)
 {
@@ -671,10 +944,11 @@ write_ping(DynamicBuffer& db,
     fh.rsv2 = false;
     fh.rsv3 = false;
     fh.len = data.size();
-    fh.mask = role_ == role_type::client;
+    fh.mask = this->is_client();
     if(fh.mask)
-        fh.key = maskgen_();
+        fh.key = this->mask_key();
     detail::write(db, fh);
+    st_.on_frame_out(fh);
     if(data.empty())
         return;
     detail::prepared_key key;
@@ -685,21 +959,23 @@ write_ping(DynamicBuffer& db,
         boost::asio::const_buffers_1(
             data.data(), data.size()));
     if(fh.mask)
-        detail::mask_inplace(d, key);
+        mask_inplace(d, key);
     db.commit(data.size());
 }
 
 //------------------------------------------------------------------------------
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Decorator>
 request_type
-stream<NextLayer>::
+stream<NextLayer, Role>::
 build_request(detail::sec_ws_key_type& key,
     string_view host,
         string_view target,
             Decorator const& decorator)
 {
+    static_assert(! std::is_same<Role, server_role>::value,
+        "A server_stream cannot perform the client handshake");
     request_type req;
     req.target(target);
     req.version = 11;
@@ -707,7 +983,7 @@ build_request(detail::sec_ws_key_type& key,
     req.set(http::field::host, host);
     req.set(http::field::upgrade, "websocket");
     req.set(http::field::connection, "upgrade");
-    detail::make_sec_ws_key(key, maskgen_);
+    detail::make_sec_ws_key(key, this->mask_gen());
     req.set(http::field::sec_websocket_key, key);
     req.set(http::field::sec_websocket_version, "13");
     if(pmd_opts_.client_enable)
@@ -731,14 +1007,16 @@ build_request(detail::sec_ws_key_type& key,
     return req;
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Body, class Allocator, class Decorator>
 response_type
-stream<NextLayer>::
+stream<NextLayer, Role>::
 build_response(http::request<Body,
     http::basic_fields<Allocator>> const& req,
         Decorator const& decorator)
 {
+    static_assert(! std::is_same<Role, client_role>::value,
+        "A client_stream cannot accept connections");
     auto const decorate =
         [&decorator](response_type& res)
         {
@@ -813,26 +1091,85 @@ build_response(http::request<Body,
     return res;
 }
 
-template<class NextLayer>
+// Build the response to an acceptable upgrade request
+// directly into a buffer, using a template for the
+// fields which do not change. Returns `false` if the
+// response must be built as a message instead.
+template<class NextLayer, class Role>
+template<class Decorator>
+bool
+stream<NextLayer, Role>::
+build_response(detail::upgrade_response_buffer& b,
+    detail::pmd_offer& config,
+        detail::upgrade_parser const& p,
+            Decorator const& decorator)
+{
+    static_assert(! std::is_same<Role, client_role>::value,
+        "A client_stream cannot accept connections");
+    if(! is_default_decorator(decorator) || ! p.acceptable())
+        return false;
+    static_string<512> ext;
+    pmd_negotiate(ext, config, p.offer, pmd_opts_);
+    detail::sec_ws_accept_type acc;
+    detail::make_sec_ws_accept(acc, p.key);
+    b = "HTTP/1.1 101 Switching Protocols\r\n";
+    if(config.accept)
+    {
+        b += "Sec-WebSocket-Extensions: ";
+        b += ext;
+        b += "\r\n";
+    }
+    b +=
+        "Upgrade: websocket\r\n"
+        "Connection: upgrade\r\n"
+        "Sec-WebSocket-Accept: ";
+    b += acc;
+    b +=
+        "\r\n"
+        "Server: " BEAST_VERSION_STRING "\r\n"
+        "\r\n";
+    return true;
+}
+
+template<class NextLayer, class Role>
 template<class Decorator>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 do_accept(
     Decorator const& decorator, error_code& ec)
 {
-    http::request_parser<http::empty_body> p;
+    detail::upgrade_parser p;
     http::read_header(next_layer(),
         stream_.buffer(), p, ec);
     if(ec)
         return;
-    do_accept(p.get(), decorator, ec);
+    do_accept(p, decorator, ec);
+}
+
+template<class NextLayer, class Role>
+template<class Decorator>
+void
+stream<NextLayer, Role>::
+do_accept(detail::upgrade_parser const& p,
+    Decorator const& decorator, error_code& ec)
+{
+    detail::upgrade_response_buffer b;
+    detail::pmd_offer config;
+    if(! build_response(b, config, p, decorator))
+        return do_accept(p.make_request(), decorator, ec);
+    boost::asio::write(stream_,
+        boost::asio::buffer(b.data(), b.size()), ec);
+    if(ec)
+        return;
+    pmd_config_ = config;
+    open(role_type::server);
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Body, class Allocator,
     class Decorator>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 do_accept(http::request<Body,
     http::basic_fields<Allocator>> const& req,
         Decorator const& decorator, error_code& ec)
@@ -852,10 +1189,10 @@ do_accept(http::request<Body,
     open(role_type::server);
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class RequestDecorator>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 do_handshake(response_type* res_p,
     string_view host,
         string_view target,
@@ -881,9 +1218,9 @@ do_handshake(response_type* res_p,
         *res_p = std::move(res);
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 do_response(response_type const& res,
     detail::sec_ws_key_type const& key, error_code& ec)
 {
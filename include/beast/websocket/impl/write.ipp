@@ -30,25 +30,26 @@
 namespace beast {
 namespace websocket {
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Buffers, class Handler>
-class stream<NextLayer>::write_some_op
+class stream<NextLayer, Role>::write_some_op
 {
     struct data : op
     {
         bool cont;
-        stream<NextLayer>& ws;
+        stream<NextLayer, Role>& ws;
         consuming_buffers<Buffers> cb;
         bool fin;
         detail::frame_header fh;
         detail::fh_streambuf fh_buf;
         detail::prepared_key key;
         std::uint64_t remain;
+        detail::frag_policy::clock_type::time_point when;
         int step = 0;
         int entry_state;
         token tok;
 
-        data(Handler& handler, stream<NextLayer>& ws_,
+        data(Handler& handler, stream<NextLayer, Role>& ws_,
                 bool fin_, Buffers const& bs)
             : ws(ws_)
             , cb(bs)
@@ -68,7 +69,7 @@ public:
 
     template<class DeducedHandler, class... Args>
     write_some_op(DeducedHandler&& h,
-            stream<NextLayer>& ws, Args&&... args)
+            stream<NextLayer, Role>& ws, Args&&... args)
         : d_(std::forward<DeducedHandler>(h),
             ws, std::forward<Args>(args)...)
     {
@@ -117,10 +118,10 @@ public:
     }
 };
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Buffers, class Handler>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 write_some_op<Buffers, Handler>::
 operator()(error_code ec,
     std::size_t bytes_transferred, bool again)
@@ -152,9 +153,11 @@ loop:
     switch(d.step)
     {
     case do_init:
+        d.ws.st_.on_write(buffer_size(d.cb), d.fin);
         if(! d.ws.wr_.cont)
         {
             d.ws.wr_begin();
+            d.ws.wr_compress(d.cb);
             d.fh.rsv1 = d.ws.wr_.compress;
         }
         else
@@ -166,7 +169,7 @@ loop:
         d.fh.op = d.ws.wr_.cont ?
             detail::opcode::cont : d.ws.wr_opcode_;
         d.fh.mask =
-            d.ws.role_ == role_type::client;
+            d.ws.is_client();
 
         // entry_state determines which algorithm
         // we will use to send. If we suspend, we
@@ -184,9 +187,9 @@ loop:
             }
             else
             {
-                BOOST_ASSERT(d.ws.wr_.buf_size != 0);
+                BOOST_ASSERT(d.ws.wr_frag_.size() != 0);
                 d.remain = buffer_size(d.cb);
-                if(d.remain > d.ws.wr_.buf_size)
+                if(d.remain > d.ws.wr_frag_.size())
                     d.entry_state = do_nomask_frag;
                 else
                     d.entry_state = do_nomask_nofrag;
@@ -200,9 +203,9 @@ loop:
             }
             else
             {
-                BOOST_ASSERT(d.ws.wr_.buf_size != 0);
+                BOOST_ASSERT(d.ws.wr_frag_.size() != 0);
                 d.remain = buffer_size(d.cb);
-                if(d.remain > d.ws.wr_.buf_size)
+                if(d.remain > d.ws.wr_frag_.size())
                     d.entry_state = do_mask_frag;
                 else
                     d.entry_state = do_mask_nofrag;
@@ -219,6 +222,7 @@ loop:
         d.fh.len = buffer_size(d.cb);
         detail::write<flat_static_buffer_base>(
             d.fh_buf, d.fh);
+        d.ws.st_.on_frame_out(d.fh);
         d.ws.wr_.cont = ! d.fin;
         // Send frame
         d.step = do_upcall;
@@ -233,16 +237,18 @@ loop:
     {
         BOOST_ASSERT(d.ws.wr_block_ == d.tok);
         auto const n = clamp(
-            d.remain, d.ws.wr_.buf_size);
+            d.remain, d.ws.wr_frag_.size());
         d.remain -= n;
         d.fh.len = n;
         d.fh.fin = d.fin ? d.remain == 0 : false;
         detail::write<flat_static_buffer_base>(
             d.fh_buf, d.fh);
+        d.ws.st_.on_frame_out(d.fh);
         d.ws.wr_.cont = ! d.fin;
         // Send frame
         d.step = d.remain == 0 ?
             do_upcall : do_nomask_frag + 1;
+        d.when = d.ws.wr_frag_.start();
         return boost::asio::async_write(
             d.ws.stream_, buffer_cat(
                 d.fh_buf.data(), buffer_prefix(
@@ -252,6 +258,8 @@ loop:
     case do_nomask_frag + 1:
         BOOST_ASSERT(d.ws.wr_block_ == d.tok);
         d.ws.wr_block_.reset();
+        d.ws.wr_frag_.stop(d.when,
+            bytes_transferred - d.fh_buf.size());
         d.cb.consume(
             bytes_transferred - d.fh_buf.size());
         d.fh_buf.consume(d.fh_buf.size());
@@ -277,16 +285,17 @@ loop:
         d.remain = buffer_size(d.cb);
         d.fh.fin = d.fin;
         d.fh.len = d.remain;
-        d.fh.key = d.ws.maskgen_();
+        d.fh.key = d.ws.mask_key();
         detail::prepare_key(d.key, d.fh.key);
         detail::write<flat_static_buffer_base>(
             d.fh_buf, d.fh);
+        d.ws.st_.on_frame_out(d.fh);
         auto const n =
             clamp(d.remain, d.ws.wr_.buf_size);
         auto const b =
             buffer(d.ws.wr_.buf.get(), n);
         buffer_copy(b, d.cb);
-        detail::mask_inplace(b, d.key);
+        d.ws.mask_inplace(b, d.key);
         d.remain -= n;
         d.ws.wr_.cont = ! d.fin;
         // Send frame header and partial payload
@@ -305,7 +314,7 @@ loop:
         auto const b =
             buffer(d.ws.wr_.buf.get(), n);
         buffer_copy(b, d.cb);
-        detail::mask_inplace(b, d.key);
+        d.ws.mask_inplace(b, d.key);
         d.remain -= n;
         // Send partial payload
         if(d.remain == 0)
@@ -321,22 +330,24 @@ loop:
     {
         BOOST_ASSERT(d.ws.wr_block_ == d.tok);
         auto const n = clamp(
-            d.remain, d.ws.wr_.buf_size);
+            d.remain, d.ws.wr_frag_.size());
         d.remain -= n;
         d.fh.len = n;
-        d.fh.key = d.ws.maskgen_();
+        d.fh.key = d.ws.mask_key();
         d.fh.fin = d.fin ? d.remain == 0 : false;
         detail::prepare_key(d.key, d.fh.key);
         auto const b = buffer(
             d.ws.wr_.buf.get(), n);
         buffer_copy(b, d.cb);
-        detail::mask_inplace(b, d.key);
+        d.ws.mask_inplace(b, d.key);
         detail::write<flat_static_buffer_base>(
             d.fh_buf, d.fh);
+        d.ws.st_.on_frame_out(d.fh);
         d.ws.wr_.cont = ! d.fin;
         // Send frame
         d.step = d.remain == 0 ?
             do_upcall : do_mask_frag + 1;
+        d.when = d.ws.wr_frag_.start();
         return boost::asio::async_write(
             d.ws.stream_, buffer_cat(
                 d.fh_buf.data(), b),
@@ -346,6 +357,8 @@ loop:
     case do_mask_frag + 1:
         BOOST_ASSERT(d.ws.wr_block_ == d.tok);
         d.ws.wr_block_.reset();
+        d.ws.wr_frag_.stop(d.when,
+            bytes_transferred - d.fh_buf.size());
         d.cb.consume(
             bytes_transferred - d.fh_buf.size());
         d.fh_buf.consume(d.fh_buf.size());
@@ -371,13 +384,23 @@ loop:
     {
         BOOST_ASSERT(d.ws.wr_block_ == d.tok);
         auto b = buffer(d.ws.wr_.buf.get(),
-            d.ws.wr_.buf_size);
-        auto const more = detail::deflate(
-            d.ws.pmd_->zo, b, d.cb, d.fin, ec);
+            d.ws.wr_.autofrag ? d.ws.wr_frag_.size() :
+                d.ws.wr_.buf_size);
+        auto& policy = d.ws.pmd_->policy;
+        auto const in = buffer_size(d.cb);
+        auto const t = policy.start();
+        bool more;
+        {
+            auto const st = d.ws.st_.time_deflate();
+            more = detail::deflate(
+                d.ws.pmd_->zo, b, d.cb, d.fin, ec);
+        }
         d.ws.failed_ = !!ec;
         if(d.ws.failed_)
             goto upcall;
         auto const n = buffer_size(b);
+        policy.stop(t, in - buffer_size(d.cb), n);
+        d.ws.st_.on_deflate(in - buffer_size(d.cb), n);
         if(n == 0)
         {
             // The input was consumed, but there
@@ -396,19 +419,21 @@ loop:
         }
         if(d.fh.mask)
         {
-            d.fh.key = d.ws.maskgen_();
+            d.fh.key = d.ws.mask_key();
             detail::prepared_key key;
             detail::prepare_key(key, d.fh.key);
-            detail::mask_inplace(b, key);
+            d.ws.mask_inplace(b, key);
         }
         d.fh.fin = ! more;
         d.fh.len = n;
         detail::write<
             flat_static_buffer_base>(d.fh_buf, d.fh);
+        d.ws.st_.on_frame_out(d.fh);
         d.ws.wr_.cont = ! d.fin;
         // Send frame
         d.step = more ?
             do_deflate + 1 : do_deflate + 2;
+        d.when = d.ws.wr_frag_.start();
         boost::asio::async_write(d.ws.stream_,
             buffer_cat(d.fh_buf.data(), b),
                 std::move(*this));
@@ -417,6 +442,8 @@ loop:
 
     case do_deflate + 1:
         BOOST_ASSERT(d.ws.wr_block_ == d.tok);
+        d.ws.wr_frag_.stop(d.when,
+            bytes_transferred - d.fh_buf.size());
         d.fh_buf.consume(d.fh_buf.size());
         d.ws.wr_block_.reset();
         d.fh.op = detail::opcode::cont;
@@ -437,12 +464,14 @@ loop:
 
     case do_deflate + 2:
         BOOST_ASSERT(d.ws.wr_block_ == d.tok);
+        if(d.fh.fin)
+            d.ws.pmd_->policy.end(d.ws.pmd_->zo);
         if(d.fh.fin && (
-            (d.ws.role_ == role_type::client &&
+            (d.ws.is_client() &&
                 d.ws.pmd_config_.client_no_context_takeover) ||
-            (d.ws.role_ == role_type::server &&
+            (! d.ws.is_client() &&
                 d.ws.pmd_config_.server_no_context_takeover)))
-            d.ws.pmd_->zo.reset();
+            d.ws.pmd_->zo.clear();
         goto upcall;
 
     //----------------------------------------------------------------------
@@ -452,6 +481,7 @@ loop:
         {
             // suspend
             BOOST_ASSERT(d.ws.wr_block_ != d.tok);
+            d.ws.st_.on_write_suspend();
             d.step = do_maybe_suspend + 1;
             d.ws.wr_op_.emplace(std::move(*this));
             return;
@@ -468,6 +498,7 @@ loop:
         goto loop;
 
     case do_maybe_suspend + 1:
+        d.ws.st_.on_write_resume();
         BOOST_ASSERT(! d.ws.wr_block_);
         d.ws.wr_block_ = d.tok;
         d.step = do_maybe_suspend + 2;
@@ -498,7 +529,10 @@ loop:
     }
 upcall:
     if(d.ws.wr_block_ == d.tok)
+    {
         d.ws.wr_block_.reset();
+        d.ws.wr_release();
+    }
     d.ws.close_op_.maybe_invoke() ||
         d.ws.rd_op_.maybe_invoke() ||
         d.ws.ping_op_.maybe_invoke();
@@ -507,24 +541,26 @@ upcall:
 
 //------------------------------------------------------------------------------
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Buffers, class Handler>
-class stream<NextLayer>::write_op
+class stream<NextLayer, Role>::write_op
 {
     struct data : op
     {
         int step = 0;
-        stream<NextLayer>& ws;
+        stream<NextLayer, Role>& ws;
         consuming_buffers<Buffers> cb;
         std::size_t remain;
         token tok;
+        bool batch;
 
-        data(Handler&, stream<NextLayer>& ws_,
-                Buffers const& bs)
+        data(Handler&, stream<NextLayer, Role>& ws_,
+                Buffers const& bs, bool batch_ = false)
             : ws(ws_)
             , cb(bs)
             , remain(boost::asio::buffer_size(cb))
             , tok(ws.t_.unique())
+            , batch(batch_)
         {
         }
     };
@@ -538,7 +574,7 @@ public:
     template<class DeducedHandler, class... Args>
     explicit
     write_op(DeducedHandler&& h,
-            stream<NextLayer>& ws, Args&&... args)
+            stream<NextLayer, Role>& ws, Args&&... args)
         : d_(std::forward<DeducedHandler>(h),
             ws, std::forward<Args>(args)...)
     {
@@ -583,10 +619,10 @@ public:
     }
 };
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class Buffers, class Handler>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 write_op<Buffers, Handler>::
 operator()(error_code ec)
 {
@@ -616,245 +652,1041 @@ operator()(error_code ec)
     case 4:
         break;
     }
+    if(d.batch)
+        d.ws.wr_batch_next();
     d_.invoke(ec);
 }
 
 //------------------------------------------------------------------------------
 
-template<class NextLayer>
-template<class ConstBufferSequence>
-void
-stream<NextLayer>::
-write_some(bool fin, ConstBufferSequence const& buffers)
+template<class NextLayer, class Role>
+template<class Handler>
+class stream<NextLayer, Role>::write_prepared_op
 {
-    static_assert(is_sync_stream<next_layer_type>::value,
-        "SyncStream requirements not met");
-    static_assert(beast::is_const_buffer_sequence<
-        ConstBufferSequence>::value,
-            "ConstBufferSequence requirements not met");
-    error_code ec;
-    write_some(fin, buffers, ec);
-    if(ec)
-        BOOST_THROW_EXCEPTION(system_error{ec});
-}
+    struct data : op
+    {
+        bool cont;
+        stream<NextLayer, Role>& ws;
+        prepared_message msg;
+        int step = 0;
+        token tok;
 
-template<class NextLayer>
-template<class ConstBufferSequence>
-void
-stream<NextLayer>::
-write_some(bool fin,
-    ConstBufferSequence const& buffers, error_code& ec)
-{
-    static_assert(is_sync_stream<next_layer_type>::value,
-        "SyncStream requirements not met");
-    static_assert(beast::is_const_buffer_sequence<
-        ConstBufferSequence>::value,
-            "ConstBufferSequence requirements not met");
-    using beast::detail::clamp;
-    using boost::asio::buffer;
-    using boost::asio::buffer_copy;
-    using boost::asio::buffer_size;
-    detail::frame_header fh;
-    if(! wr_.cont)
+        data(Handler& handler, stream<NextLayer, Role>& ws_,
+                prepared_message const& msg_)
+            : ws(ws_)
+            , msg(msg_)
+            , tok(ws.t_.unique())
+        {
+            using boost::asio::asio_handler_is_continuation;
+            cont = asio_handler_is_continuation(std::addressof(handler));
+        }
+    };
+
+    handler_ptr<data, Handler> d_;
+
+public:
+    write_prepared_op(write_prepared_op&&) = default;
+    write_prepared_op(write_prepared_op const&) = default;
+
+    template<class DeducedHandler, class... Args>
+    write_prepared_op(DeducedHandler&& h,
+            stream<NextLayer, Role>& ws, Args&&... args)
+        : d_(std::forward<DeducedHandler>(h),
+            ws, std::forward<Args>(args)...)
     {
-        wr_begin();
-        fh.rsv1 = wr_.compress;
     }
-    else
+
+    void operator()()
     {
-        fh.rsv1 = false;
+        (*this)({}, 0, true);
     }
-    fh.rsv2 = false;
-    fh.rsv3 = false;
-    fh.op = wr_.cont ?
-        detail::opcode::cont : wr_opcode_;
-    fh.mask = role_ == role_type::client;
-    auto remain = buffer_size(buffers);
-    if(wr_.compress)
+
+    void operator()(error_code ec,
+        std::size_t bytes_transferred,
+            bool again = true);
+
+    friend
+    void* asio_handler_allocate(
+        std::size_t size, write_prepared_op* op)
     {
-        consuming_buffers<
-            ConstBufferSequence> cb{buffers};
-        for(;;)
-        {
-            auto b = buffer(
-                wr_.buf.get(), wr_.buf_size);
-            auto const more = detail::deflate(
-                pmd_->zo, b, cb, fin, ec);
-            failed_ = !!ec;
-            if(failed_)
-                return;
-            auto const n = buffer_size(b);
-            if(n == 0)
-            {
-                // The input was consumed, but there
-                // is no output due to compression
-                // latency.
-                BOOST_ASSERT(! fin);
-                BOOST_ASSERT(buffer_size(cb) == 0);
-                fh.fin = false;
-                break;
-            }
-            if(fh.mask)
-            {
-                fh.key = maskgen_();
-                detail::prepared_key key;
-                detail::prepare_key(key, fh.key);
-                detail::mask_inplace(b, key);
-            }
-            fh.fin = ! more;
-            fh.len = n;
-            detail::fh_streambuf fh_buf;
-            detail::write<flat_static_buffer_base>(fh_buf, fh);
-            wr_.cont = ! fin;
-            boost::asio::write(stream_,
-                buffer_cat(fh_buf.data(), b), ec);
-            failed_ = !!ec;
-            if(failed_)
-                return;
-            if(! more)
-                break;
-            fh.op = detail::opcode::cont;
-            fh.rsv1 = false;
-        }
-        if(fh.fin && (
-            (role_ == role_type::client &&
-                pmd_config_.client_no_context_takeover) ||
-            (role_ == role_type::server &&
-                pmd_config_.server_no_context_takeover)))
-            pmd_->zo.reset();
-        return;
+        using boost::asio::asio_handler_allocate;
+        return asio_handler_allocate(
+            size, std::addressof(op->d_.handler()));
     }
-    if(! fh.mask)
+
+    friend
+    void asio_handler_deallocate(
+        void* p, std::size_t size, write_prepared_op* op)
     {
-        if(! wr_.autofrag)
-        {
-            // no mask, no autofrag
-            fh.fin = fin;
-            fh.len = remain;
-            detail::fh_streambuf fh_buf;
-            detail::write<flat_static_buffer_base>(fh_buf, fh);
-            wr_.cont = ! fin;
-            boost::asio::write(stream_,
-                buffer_cat(fh_buf.data(), buffers), ec);
-            failed_ = !!ec;
-            if(failed_)
-                return;
-        }
-        else
-        {
-            // no mask, autofrag
-            BOOST_ASSERT(wr_.buf_size != 0);
-            consuming_buffers<
-                ConstBufferSequence> cb{buffers};
-            for(;;)
-            {
-                auto const n = clamp(remain, wr_.buf_size);
-                remain -= n;
-                fh.len = n;
-                fh.fin = fin ? remain == 0 : false;
-                detail::fh_streambuf fh_buf;
-                detail::write<flat_static_buffer_base>(fh_buf, fh);
-                wr_.cont = ! fin;
-                boost::asio::write(stream_,
-                    buffer_cat(fh_buf.data(),
-                        buffer_prefix(n, cb)), ec);
-                failed_ = !!ec;
-                if(failed_)
-                    return;
-                if(remain == 0)
-                    break;
-                fh.op = detail::opcode::cont;
-                cb.consume(n);
-            }
-        }
-        return;
+        using boost::asio::asio_handler_deallocate;
+        asio_handler_deallocate(
+            p, size, std::addressof(op->d_.handler()));
     }
-    if(! wr_.autofrag)
+
+    friend
+    bool asio_handler_is_continuation(write_prepared_op* op)
     {
-        // mask, no autofrag
-        fh.fin = fin;
-        fh.len = remain;
-        fh.key = maskgen_();
-        detail::prepared_key key;
-        detail::prepare_key(key, fh.key);
-        detail::fh_streambuf fh_buf;
-        detail::write<flat_static_buffer_base>(fh_buf, fh);
-        consuming_buffers<
-            ConstBufferSequence> cb{buffers};
-        {
-            auto const n = clamp(remain, wr_.buf_size);
-            auto const b = buffer(wr_.buf.get(), n);
-            buffer_copy(b, cb);
-            cb.consume(n);
-            remain -= n;
-            detail::mask_inplace(b, key);
-            wr_.cont = ! fin;
-            boost::asio::write(stream_,
-                buffer_cat(fh_buf.data(), b), ec);
-            failed_ = !!ec;
-            if(failed_)
-                return;
-        }
-        while(remain > 0)
-        {
-            auto const n = clamp(remain, wr_.buf_size);
-            auto const b = buffer(wr_.buf.get(), n);
-            buffer_copy(b, cb);
-            cb.consume(n);
-            remain -= n;
-            detail::mask_inplace(b, key);
-            boost::asio::write(stream_, b, ec);
-            failed_ = !!ec;
-            if(failed_)
-                return;
-        }
-        return;
+        return op->d_->cont;
     }
+
+    template<class Function>
+    friend
+    void asio_handler_invoke(Function&& f, write_prepared_op* op)
     {
-        // mask, autofrag
-        BOOST_ASSERT(wr_.buf_size != 0);
-        consuming_buffers<
-            ConstBufferSequence> cb{buffers};
-        for(;;)
-        {
-            fh.key = maskgen_();
-            detail::prepared_key key;
-            detail::prepare_key(key, fh.key);
-            auto const n = clamp(remain, wr_.buf_size);
-            auto const b = buffer(wr_.buf.get(), n);
-            buffer_copy(b, cb);
-            detail::mask_inplace(b, key);
-            fh.len = n;
-            remain -= n;
-            fh.fin = fin ? remain == 0 : false;
-            wr_.cont = ! fh.fin;
-            detail::fh_streambuf fh_buf;
-            detail::write<flat_static_buffer_base>(fh_buf, fh);
-            boost::asio::write(stream_,
-                buffer_cat(fh_buf.data(), b), ec);
-            failed_ = !!ec;
-            if(failed_)
-                return;
-            if(remain == 0)
-                break;
-            fh.op = detail::opcode::cont;
-            cb.consume(n);
-        }
-        return;
+        using boost::asio::asio_handler_invoke;
+        asio_handler_invoke(
+            f, std::addressof(op->d_.handler()));
     }
-}
+};
 
-template<class NextLayer>
-template<class ConstBufferSequence, class WriteHandler>
-async_return_type<
-    WriteHandler, void(error_code)>
-stream<NextLayer>::
-async_write_some(bool fin,
-    ConstBufferSequence const& bs, WriteHandler&& handler)
+template<class NextLayer, class Role>
+template<class Handler>
+void
+stream<NextLayer, Role>::
+write_prepared_op<Handler>::
+operator()(error_code ec, std::size_t, bool again)
 {
-    static_assert(is_async_stream<next_layer_type>::value,
-        "AsyncStream requirements not met");
-    static_assert(beast::is_const_buffer_sequence<
+    enum
+    {
+        do_init = 0,
+        do_resume = 10,
+        do_write = 20,
+        do_upcall = 99
+    };
+    auto& d = *d_;
+    d.cont = d.cont || again;
+    switch(d.step)
+    {
+    case do_init:
+        if(d.ws.wr_block_)
+        {
+            // suspend
+            d.ws.st_.on_write_suspend();
+            d.step = do_resume;
+            d.ws.wr_op_.emplace(std::move(*this));
+            return;
+        }
+        d.ws.wr_block_ = d.tok;
+        if(d.ws.failed_ || d.ws.wr_close_)
+        {
+            // call handler
+            d.step = do_upcall;
+            return d.ws.get_io_service().post(
+                bind_handler(std::move(*this),
+                    boost::asio::error::operation_aborted, 0));
+        }
+        goto go_write;
+
+    case do_resume:
+        d.ws.st_.on_write_resume();
+        BOOST_ASSERT(! d.ws.wr_block_);
+        d.ws.wr_block_ = d.tok;
+        d.step = do_resume + 1;
+        // The current context is safe but might not be
+        // the same as the one for this operation (since
+        // we are being called from a write operation).
+        // Call post to make sure we are invoked the same
+        // way as the final handler for this operation.
+        d.ws.get_io_service().post(bind_handler(
+            std::move(*this), ec, 0));
+        return;
+
+    case do_resume + 1:
+        BOOST_ASSERT(d.ws.wr_block_ == d.tok);
+        if(d.ws.failed_ || d.ws.wr_close_)
+        {
+            // call handler
+            ec = boost::asio::error::operation_aborted;
+            goto upcall;
+        }
+        goto go_write;
+
+    go_write:
+    {
+        BOOST_ASSERT(d.ws.wr_block_ == d.tok);
+        d.step = do_write;
+        // The frame is sent straight from shared storage
+        boost::asio::async_write(d.ws.stream_,
+            d.ws.wr_prepared(d.msg), std::move(*this));
+        return;
+    }
+
+    case do_write:
+        d.ws.failed_ = !!ec;
+        goto upcall;
+
+    case do_upcall:
+        goto upcall;
+    }
+upcall:
+    if(d.ws.wr_block_ == d.tok)
+        d.ws.wr_block_.reset();
+    d.ws.close_op_.maybe_invoke() ||
+        d.ws.rd_op_.maybe_invoke() ||
+        d.ws.ping_op_.maybe_invoke();
+    d_.invoke(ec);
+}
+
+//------------------------------------------------------------------------------
+
+template<class NextLayer, class Role>
+template<class Buffers, class Handler>
+class stream<NextLayer, Role>::write_inplace_op
+{
+    struct data : op
+    {
+        bool cont;
+        stream<NextLayer, Role>& ws;
+        Buffers bs;
+        detail::fh_streambuf fh_buf;
+        int step = 0;
+        token tok;
+
+        data(Handler& handler, stream<NextLayer, Role>& ws_,
+                Buffers const& bs_)
+            : ws(ws_)
+            , bs(bs_)
+            , tok(ws.t_.unique())
+        {
+            using boost::asio::asio_handler_is_continuation;
+            cont = asio_handler_is_continuation(std::addressof(handler));
+        }
+    };
+
+    handler_ptr<data, Handler> d_;
+
+public:
+    write_inplace_op(write_inplace_op&&) = default;
+    write_inplace_op(write_inplace_op const&) = default;
+
+    template<class DeducedHandler, class... Args>
+    write_inplace_op(DeducedHandler&& h,
+            stream<NextLayer, Role>& ws, Args&&... args)
+        : d_(std::forward<DeducedHandler>(h),
+            ws, std::forward<Args>(args)...)
+    {
+    }
+
+    void operator()()
+    {
+        (*this)({}, 0, true);
+    }
+
+    void operator()(error_code ec,
+        std::size_t bytes_transferred,
+            bool again = true);
+
+    friend
+    void* asio_handler_allocate(
+        std::size_t size, write_inplace_op* op)
+    {
+        using boost::asio::asio_handler_allocate;
+        return asio_handler_allocate(
+            size, std::addressof(op->d_.handler()));
+    }
+
+    friend
+    void asio_handler_deallocate(
+        void* p, std::size_t size, write_inplace_op* op)
+    {
+        using boost::asio::asio_handler_deallocate;
+        asio_handler_deallocate(
+            p, size, std::addressof(op->d_.handler()));
+    }
+
+    friend
+    bool asio_handler_is_continuation(write_inplace_op* op)
+    {
+        return op->d_->cont;
+    }
+
+    template<class Function>
+    friend
+    void asio_handler_invoke(Function&& f, write_inplace_op* op)
+    {
+        using boost::asio::asio_handler_invoke;
+        asio_handler_invoke(
+            f, std::addressof(op->d_.handler()));
+    }
+};
+
+template<class NextLayer, class Role>
+template<class Buffers, class Handler>
+void
+stream<NextLayer, Role>::
+write_inplace_op<Buffers, Handler>::
+operator()(error_code ec, std::size_t, bool again)
+{
+    enum
+    {
+        do_init = 0,
+        do_resume = 10,
+        do_write = 20,
+        do_upcall = 99
+    };
+    auto& d = *d_;
+    d.cont = d.cont || again;
+    switch(d.step)
+    {
+    case do_init:
+        if(d.ws.wr_block_)
+        {
+            // suspend
+            d.ws.st_.on_write_suspend();
+            d.step = do_resume;
+            d.ws.wr_op_.emplace(std::move(*this));
+            return;
+        }
+        d.ws.wr_block_ = d.tok;
+        if(d.ws.failed_ || d.ws.wr_close_)
+        {
+            // call handler
+            d.step = do_upcall;
+            return d.ws.get_io_service().post(
+                bind_handler(std::move(*this),
+                    boost::asio::error::operation_aborted, 0));
+        }
+        goto go_write;
+
+    case do_resume:
+        d.ws.st_.on_write_resume();
+        BOOST_ASSERT(! d.ws.wr_block_);
+        d.ws.wr_block_ = d.tok;
+        d.step = do_resume + 1;
+        // The current context is safe but might not be
+        // the same as the one for this operation (since
+        // we are being called from a write operation).
+        // Call post to make sure we are invoked the same
+        // way as the final handler for this operation.
+        d.ws.get_io_service().post(bind_handler(
+            std::move(*this), ec, 0));
+        return;
+
+    case do_resume + 1:
+        BOOST_ASSERT(d.ws.wr_block_ == d.tok);
+        if(d.ws.failed_ || d.ws.wr_close_)
+        {
+            // call handler
+            ec = boost::asio::error::operation_aborted;
+            goto upcall;
+        }
+        goto go_write;
+
+    go_write:
+        BOOST_ASSERT(d.ws.wr_block_ == d.tok);
+        // Mask only once the stream is ours, so
+        // the caller's buffers are masked once.
+        d.ws.wr_inplace(d.fh_buf, d.bs);
+        d.step = do_write;
+        boost::asio::async_write(d.ws.stream_,
+            buffer_cat(d.fh_buf.data(), d.bs),
+                std::move(*this));
+        return;
+
+    case do_write:
+        d.ws.failed_ = !!ec;
+        goto upcall;
+
+    case do_upcall:
+        goto upcall;
+    }
+upcall:
+    if(d.ws.wr_block_ == d.tok)
+        d.ws.wr_block_.reset();
+    d.ws.close_op_.maybe_invoke() ||
+        d.ws.rd_op_.maybe_invoke() ||
+        d.ws.ping_op_.maybe_invoke();
+    d_.invoke(ec);
+}
+
+//------------------------------------------------------------------------------
+
+// The handler of a message queued behind an outstanding write,
+// either coalesced or sent later from the caller's memory.
+//
+template<class NextLayer, class Role>
+class stream<NextLayer, Role>::batch_node
+{
+public:
+    batch_node* next = nullptr;
+
+    // Bytes of the framed message in the batch buffer,
+    // or zero if the message is sent from the caller's memory.
+    std::size_t size = 0;
+
+    // Destroy without invoking
+    virtual void destroy() = 0;
+
+    // Post the handler with the result
+    virtual void complete(
+        stream<NextLayer, Role>& ws, error_code ec) = 0;
+
+    // Send the batch or message starting with this node
+    virtual void lead(stream<NextLayer, Role>& ws) = 0;
+
+protected:
+    ~batch_node() = default;
+};
+
+template<class NextLayer, class Role>
+template<class Handler>
+class stream<NextLayer, Role>::batch_holder
+    : public batch_node
+{
+    Handler h_;
+
+    batch_holder(Handler&& h, std::size_t size)
+        : h_(std::move(h))
+    {
+        this->size = size;
+    }
+
+    Handler
+    release()
+    {
+        using boost::asio::asio_handler_deallocate;
+        auto h = std::move(h_);
+        this->~batch_holder();
+        asio_handler_deallocate(
+            this, sizeof(batch_holder), std::addressof(h));
+        return h;
+    }
+
+public:
+    static
+    batch_node*
+    make(Handler&& h, std::size_t size)
+    {
+        using boost::asio::asio_handler_allocate;
+        return ::new(asio_handler_allocate(
+            sizeof(batch_holder), std::addressof(h)))
+                batch_holder(std::move(h), size);
+    }
+
+    void
+    destroy() override
+    {
+        release();
+    }
+
+    void
+    complete(stream<NextLayer, Role>& ws, error_code ec) override
+    {
+        ws.get_io_service().post(
+            bind_handler(release(), ec));
+    }
+
+    void
+    lead(stream<NextLayer, Role>& ws) override
+    {
+        auto const n = this->size;
+        write_batch_op<Handler>{release(), ws, n}();
+    }
+};
+
+template<class NextLayer, class Role>
+template<class Buffers, class Handler>
+class stream<NextLayer, Role>::direct_holder
+    : public batch_node
+{
+    Handler h_;
+    Buffers bs_;
+
+    direct_holder(Handler&& h, Buffers const& bs)
+        : h_(std::move(h))
+        , bs_(bs)
+    {
+    }
+
+    Handler
+    release()
+    {
+        using boost::asio::asio_handler_deallocate;
+        auto h = std::move(h_);
+        this->~direct_holder();
+        asio_handler_deallocate(
+            this, sizeof(direct_holder), std::addressof(h));
+        return h;
+    }
+
+public:
+    static
+    batch_node*
+    make(Handler&& h, Buffers const& bs)
+    {
+        using boost::asio::asio_handler_allocate;
+        return ::new(asio_handler_allocate(
+            sizeof(direct_holder), std::addressof(h)))
+                direct_holder(std::move(h), bs);
+    }
+
+    void
+    destroy() override
+    {
+        release();
+    }
+
+    void
+    complete(stream<NextLayer, Role>& ws, error_code ec) override
+    {
+        ws.get_io_service().post(
+            bind_handler(release(), ec));
+    }
+
+    void
+    lead(stream<NextLayer, Role>& ws) override
+    {
+        auto const bs = bs_;
+        write_op<Buffers, Handler>{
+            release(), ws, bs, true}(error_code{});
+    }
+};
+
+template<class NextLayer, class Role>
+stream<NextLayer, Role>::
+wr_batch_t::
+wr_batch_t(wr_batch_t&& other)
+    : limit(other.limit)
+    , max_bytes(other.max_bytes)
+    , last(other.last)
+    , busy(other.busy)
+    , buf(std::move(other.buf))
+    , head(other.head)
+    , tail(other.tail)
+{
+    other.head = nullptr;
+    other.tail = nullptr;
+}
+
+template<class NextLayer, class Role>
+auto
+stream<NextLayer, Role>::
+wr_batch_t::
+operator=(wr_batch_t&& other) ->
+    wr_batch_t&
+{
+    clear();
+    limit = other.limit;
+    max_bytes = other.max_bytes;
+    last = other.last;
+    busy = other.busy;
+    buf = std::move(other.buf);
+    head = other.head;
+    tail = other.tail;
+    other.head = nullptr;
+    other.tail = nullptr;
+    return *this;
+}
+
+template<class NextLayer, class Role>
+stream<NextLayer, Role>::
+wr_batch_t::
+~wr_batch_t()
+{
+    clear();
+}
+
+template<class NextLayer, class Role>
+void
+stream<NextLayer, Role>::
+wr_batch_t::
+push(batch_node* n)
+{
+    if(tail)
+        tail->next = n;
+    else
+        head = n;
+    tail = n;
+}
+
+template<class NextLayer, class Role>
+void
+stream<NextLayer, Role>::
+wr_batch_t::
+clear()
+{
+    while(head)
+    {
+        auto const n = head;
+        head = n->next;
+        n->destroy();
+    }
+    tail = nullptr;
+    last = 0;
+    buf.consume(buf.size());
+}
+
+// Sends a batch of coalesced messages with one write. The first
+// message belongs to this operation's handler, the handlers of
+// the rest are posted when the write completes. The batch ends
+// at the first message queued to be sent from the caller's memory.
+//
+template<class NextLayer, class Role>
+template<class Handler>
+class stream<NextLayer, Role>::write_batch_op
+{
+    struct data : op
+    {
+        bool cont;
+        stream<NextLayer, Role>& ws;
+        flat_buffer buf;
+        batch_node* head = nullptr;
+        std::size_t size;
+        int step = 0;
+        token tok;
+
+        data(Handler& handler, stream<NextLayer, Role>& ws_,
+                std::size_t size_)
+            : ws(ws_)
+            , size(size_)
+            , tok(ws.t_.unique())
+        {
+            using boost::asio::asio_handler_is_continuation;
+            cont = asio_handler_is_continuation(std::addressof(handler));
+        }
+    };
+
+    handler_ptr<data, Handler> d_;
+
+public:
+    write_batch_op(write_batch_op&&) = default;
+    write_batch_op(write_batch_op const&) = default;
+
+    template<class DeducedHandler>
+    write_batch_op(DeducedHandler&& h,
+            stream<NextLayer, Role>& ws, std::size_t size)
+        : d_(std::forward<DeducedHandler>(h), ws, size)
+    {
+    }
+
+    void operator()()
+    {
+        (*this)({}, 0, true);
+    }
+
+    void operator()(error_code ec,
+        std::size_t bytes_transferred,
+            bool again = true);
+
+    friend
+    void* asio_handler_allocate(
+        std::size_t size, write_batch_op* op)
+    {
+        using boost::asio::asio_handler_allocate;
+        return asio_handler_allocate(
+            size, std::addressof(op->d_.handler()));
+    }
+
+    friend
+    void asio_handler_deallocate(
+        void* p, std::size_t size, write_batch_op* op)
+    {
+        using boost::asio::asio_handler_deallocate;
+        asio_handler_deallocate(
+            p, size, std::addressof(op->d_.handler()));
+    }
+
+    friend
+    bool asio_handler_is_continuation(write_batch_op* op)
+    {
+        return op->d_->cont;
+    }
+
+    template<class Function>
+    friend
+    void asio_handler_invoke(Function&& f, write_batch_op* op)
+    {
+        using boost::asio::asio_handler_invoke;
+        asio_handler_invoke(
+            f, std::addressof(op->d_.handler()));
+    }
+};
+
+template<class NextLayer, class Role>
+template<class Handler>
+void
+stream<NextLayer, Role>::
+write_batch_op<Handler>::
+operator()(error_code ec, std::size_t, bool again)
+{
+    enum
+    {
+        do_init = 0,
+        do_resume = 10,
+        do_write = 20,
+        do_upcall = 99
+    };
+    auto& d = *d_;
+    d.cont = d.cont || again;
+    switch(d.step)
+    {
+    case do_init:
+        if(d.ws.wr_block_)
+        {
+            // suspend
+            d.ws.st_.on_write_suspend();
+            d.step = do_resume;
+            d.ws.wr_op_.emplace(std::move(*this));
+            return;
+        }
+        d.ws.wr_block_ = d.tok;
+        if(d.ws.failed_ || d.ws.wr_close_)
+        {
+            // call handler
+            d.step = do_upcall;
+            return d.ws.get_io_service().post(
+                bind_handler(std::move(*this),
+                    boost::asio::error::operation_aborted, 0));
+        }
+        goto go_write;
+
+    case do_resume:
+        d.ws.st_.on_write_resume();
+        BOOST_ASSERT(! d.ws.wr_block_);
+        d.ws.wr_block_ = d.tok;
+        d.step = do_resume + 1;
+        // The current context is safe but might not be
+        // the same as the one for this operation (since
+        // we are being called from a write operation).
+        // Call post to make sure we are invoked the same
+        // way as the final handler for this operation.
+        d.ws.get_io_service().post(bind_handler(
+            std::move(*this), ec, 0));
+        return;
+
+    case do_resume + 1:
+        BOOST_ASSERT(d.ws.wr_block_ == d.tok);
+        if(d.ws.failed_ || d.ws.wr_close_)
+        {
+            // call handler
+            ec = boost::asio::error::operation_aborted;
+            goto upcall;
+        }
+        goto go_write;
+
+    go_write:
+    {
+        BOOST_ASSERT(d.ws.wr_block_ == d.tok);
+        // Take the messages coalesced up to now, stopping
+        // at a message sent from the caller's memory.
+        auto& b = d.ws.wr_batch_;
+        auto n = d.size;
+        batch_node* end = nullptr;
+        for(auto p = b.head; p && p->size > 0; p = p->next)
+        {
+            n += p->size;
+            end = p;
+        }
+        if(end)
+        {
+            d.head = b.head;
+            b.head = end->next;
+            end->next = nullptr;
+            if(! b.head)
+                b.tail = nullptr;
+        }
+        if(! b.head)
+        {
+            // Later messages start the next batch
+            BOOST_ASSERT(n == b.buf.size());
+            d.buf = std::move(b.buf);
+            b.last = 0;
+        }
+        else
+        {
+            d.buf.commit(boost::asio::buffer_copy(
+                d.buf.prepare(n), b.buf.data()));
+            b.buf.consume(n);
+        }
+        d.step = do_write;
+        boost::asio::async_write(d.ws.stream_,
+            d.buf.data(), std::move(*this));
+        return;
+    }
+
+    case do_write:
+        d.ws.failed_ = !!ec;
+        goto upcall;
+
+    case do_upcall:
+        goto upcall;
+    }
+upcall:
+    if(d.ws.wr_block_ == d.tok)
+        d.ws.wr_block_.reset();
+    while(d.head)
+    {
+        auto const n = d.head;
+        d.head = n->next;
+        n->complete(d.ws, ec);
+    }
+    d.ws.close_op_.maybe_invoke() ||
+        d.ws.rd_op_.maybe_invoke() ||
+        d.ws.ping_op_.maybe_invoke();
+    d.ws.wr_batch_next();
+    d_.invoke(ec);
+}
+
+//------------------------------------------------------------------------------
+
+template<class NextLayer, class Role>
+template<class ConstBufferSequence>
+void
+stream<NextLayer, Role>::
+write_some(bool fin, ConstBufferSequence const& buffers)
+{
+    static_assert(is_sync_stream<next_layer_type>::value,
+        "SyncStream requirements not met");
+    static_assert(beast::is_const_buffer_sequence<
+        ConstBufferSequence>::value,
+            "ConstBufferSequence requirements not met");
+    error_code ec;
+    write_some(fin, buffers, ec);
+    if(ec)
+        BOOST_THROW_EXCEPTION(system_error{ec});
+}
+
+template<class NextLayer, class Role>
+template<class ConstBufferSequence>
+void
+stream<NextLayer, Role>::
+write_some(bool fin,
+    ConstBufferSequence const& buffers, error_code& ec)
+{
+    static_assert(is_sync_stream<next_layer_type>::value,
+        "SyncStream requirements not met");
+    static_assert(beast::is_const_buffer_sequence<
+        ConstBufferSequence>::value,
+            "ConstBufferSequence requirements not met");
+    using beast::detail::clamp;
+    using boost::asio::buffer;
+    using boost::asio::buffer_copy;
+    using boost::asio::buffer_size;
+    auto lock = wr_lock();
+    if(wr_aborted(lock, ec))
+        return;
+    st_.on_write(buffer_size(buffers), fin);
+    detail::frame_header fh;
+    if(! wr_.cont)
+    {
+        wr_begin();
+        wr_compress(buffers);
+        fh.rsv1 = wr_.compress;
+    }
+    else
+    {
+        fh.rsv1 = false;
+    }
+    fh.rsv2 = false;
+    fh.rsv3 = false;
+    fh.op = wr_.cont ?
+        detail::opcode::cont : wr_opcode_;
+    fh.mask = this->is_client();
+    auto remain = buffer_size(buffers);
+    if(wr_.compress)
+    {
+        consuming_buffers<
+            ConstBufferSequence> cb{buffers};
+        for(;;)
+        {
+            auto b = buffer(
+                wr_.buf.get(), wr_.buf_size);
+            auto const in = buffer_size(cb);
+            auto const t = pmd_->policy.start();
+            bool more;
+            {
+                auto const st = st_.time_deflate();
+                more = detail::deflate(
+                    pmd_->zo, b, cb, fin, ec);
+            }
+            failed_ = !!ec;
+            if(failed_)
+                return;
+            auto const n = buffer_size(b);
+            pmd_->policy.stop(t, in - buffer_size(cb), n);
+            st_.on_deflate(in - buffer_size(cb), n);
+            if(n == 0)
+            {
+                // The input was consumed, but there
+                // is no output due to compression
+                // latency.
+                BOOST_ASSERT(! fin);
+                BOOST_ASSERT(buffer_size(cb) == 0);
+                fh.fin = false;
+                break;
+            }
+            if(fh.mask)
+            {
+                fh.key = this->mask_key();
+                detail::prepared_key key;
+                detail::prepare_key(key, fh.key);
+                mask_inplace(b, key);
+            }
+            fh.fin = ! more;
+            fh.len = n;
+            detail::fh_streambuf fh_buf;
+            detail::write<flat_static_buffer_base>(fh_buf, fh);
+            st_.on_frame_out(fh);
+            wr_.cont = ! fin;
+            boost::asio::write(stream_,
+                buffer_cat(fh_buf.data(), b), ec);
+            failed_ = !!ec;
+            if(failed_)
+                return;
+            if(! more)
+                break;
+            fh.op = detail::opcode::cont;
+            fh.rsv1 = false;
+        }
+        if(fh.fin)
+            pmd_->policy.end(pmd_->zo);
+        if(fh.fin && (
+            (this->is_client() &&
+                pmd_config_.client_no_context_takeover) ||
+            (! this->is_client() &&
+                pmd_config_.server_no_context_takeover)))
+            pmd_->zo.clear();
+        wr_release();
+        return;
+    }
+    if(! fh.mask)
+    {
+        if(! wr_.autofrag)
+        {
+            // no mask, no autofrag
+            fh.fin = fin;
+            fh.len = remain;
+            detail::fh_streambuf fh_buf;
+            detail::write<flat_static_buffer_base>(fh_buf, fh);
+            st_.on_frame_out(fh);
+            wr_.cont = ! fin;
+            boost::asio::write(stream_,
+                buffer_cat(fh_buf.data(), buffers), ec);
+            failed_ = !!ec;
+            if(failed_)
+                return;
+        }
+        else
+        {
+            // no mask, autofrag
+            BOOST_ASSERT(wr_.buf_size != 0);
+            consuming_buffers<
+                ConstBufferSequence> cb{buffers};
+            for(;;)
+            {
+                auto const n = clamp(remain, wr_.buf_size);
+                remain -= n;
+                fh.len = n;
+                fh.fin = fin ? remain == 0 : false;
+                detail::fh_streambuf fh_buf;
+                detail::write<flat_static_buffer_base>(fh_buf, fh);
+                st_.on_frame_out(fh);
+                wr_.cont = ! fin;
+                boost::asio::write(stream_,
+                    buffer_cat(fh_buf.data(),
+                        buffer_prefix(n, cb)), ec);
+                failed_ = !!ec;
+                if(failed_)
+                    return;
+                if(remain == 0)
+                    break;
+                fh.op = detail::opcode::cont;
+                cb.consume(n);
+            }
+        }
+        wr_release();
+        return;
+    }
+    if(! wr_.autofrag)
+    {
+        // mask, no autofrag
+        fh.fin = fin;
+        fh.len = remain;
+        fh.key = this->mask_key();
+        detail::prepared_key key;
+        detail::prepare_key(key, fh.key);
+        detail::fh_streambuf fh_buf;
+        detail::write<flat_static_buffer_base>(fh_buf, fh);
+        st_.on_frame_out(fh);
+        consuming_buffers<
+            ConstBufferSequence> cb{buffers};
+        {
+            auto const n = clamp(remain, wr_.buf_size);
+            auto const b = buffer(wr_.buf.get(), n);
+            buffer_copy(b, cb);
+            cb.consume(n);
+            remain -= n;
+            mask_inplace(b, key);
+            wr_.cont = ! fin;
+            boost::asio::write(stream_,
+                buffer_cat(fh_buf.data(), b), ec);
+            failed_ = !!ec;
+            if(failed_)
+                return;
+        }
+        while(remain > 0)
+        {
+            auto const n = clamp(remain, wr_.buf_size);
+            auto const b = buffer(wr_.buf.get(), n);
+            buffer_copy(b, cb);
+            cb.consume(n);
+            remain -= n;
+            mask_inplace(b, key);
+            boost::asio::write(stream_, b, ec);
+            failed_ = !!ec;
+            if(failed_)
+                return;
+        }
+        wr_release();
+        return;
+    }
+    {
+        // mask, autofrag
+        BOOST_ASSERT(wr_.buf_size != 0);
+        consuming_buffers<
+            ConstBufferSequence> cb{buffers};
+        for(;;)
+        {
+            fh.key = this->mask_key();
+            detail::prepared_key key;
+            detail::prepare_key(key, fh.key);
+            auto const n = clamp(remain, wr_.buf_size);
+            auto const b = buffer(wr_.buf.get(), n);
+            buffer_copy(b, cb);
+            mask_inplace(b, key);
+            fh.len = n;
+            remain -= n;
+            fh.fin = fin ? remain == 0 : false;
+            wr_.cont = ! fh.fin;
+            detail::fh_streambuf fh_buf;
+            detail::write<flat_static_buffer_base>(fh_buf, fh);
+            st_.on_frame_out(fh);
+            boost::asio::write(stream_,
+                buffer_cat(fh_buf.data(), b), ec);
+            failed_ = !!ec;
+            if(failed_)
+                return;
+            if(remain == 0)
+                break;
+            fh.op = detail::opcode::cont;
+            cb.consume(n);
+        }
+        wr_release();
+        return;
+    }
+}
+
+template<class NextLayer, class Role>
+template<class ConstBufferSequence, class WriteHandler>
+async_return_type<
+    WriteHandler, void(error_code)>
+stream<NextLayer, Role>::
+async_write_some(bool fin,
+    ConstBufferSequence const& bs, WriteHandler&& handler)
+{
+    static_assert(is_async_stream<next_layer_type>::value,
+        "AsyncStream requirements not met");
+    static_assert(beast::is_const_buffer_sequence<
         ConstBufferSequence>::value,
             "ConstBufferSequence requirements not met");
     async_completion<WriteHandler,
@@ -867,10 +1699,10 @@ async_write_some(bool fin,
 
 //------------------------------------------------------------------------------
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class ConstBufferSequence>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 write(ConstBufferSequence const& buffers)
 {
     static_assert(is_sync_stream<next_layer_type>::value,
@@ -884,10 +1716,10 @@ write(ConstBufferSequence const& buffers)
         BOOST_THROW_EXCEPTION(system_error{ec});
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class ConstBufferSequence>
 void
-stream<NextLayer>::
+stream<NextLayer, Role>::
 write(ConstBufferSequence const& buffers, error_code& ec)
 {
     static_assert(is_sync_stream<next_layer_type>::value,
@@ -898,11 +1730,11 @@ write(ConstBufferSequence const& buffers, error_code& ec)
     write_some(true, buffers, ec);
 }
 
-template<class NextLayer>
+template<class NextLayer, class Role>
 template<class ConstBufferSequence, class WriteHandler>
 async_return_type<
     WriteHandler, void(error_code)>
-stream<NextLayer>::
+stream<NextLayer, Role>::
 async_write(
     ConstBufferSequence const& bs, WriteHandler&& handler)
 {
@@ -911,12 +1743,168 @@ async_write(
     static_assert(beast::is_const_buffer_sequence<
         ConstBufferSequence>::value,
             "ConstBufferSequence requirements not met");
+    using handler_type = beast::handler_type<
+        WriteHandler, void(error_code)>;
     async_completion<WriteHandler,
         void(error_code)> init{handler};
-    write_op<ConstBufferSequence, handler_type<
-        WriteHandler, void(error_code)>>{
+    if(wr_batch_.limit == 0 || pmd_)
+    {
+        write_op<ConstBufferSequence, handler_type>{
             init.completion_handler, *this, bs}(
                 error_code{});
+        return init.result.get();
+    }
+    auto const n = boost::asio::buffer_size(bs);
+    auto const fits = n <= wr_batch_.limit &&
+        wr_batch_.last + n <= wr_batch_.max_bytes;
+    if(! wr_batch_.busy)
+    {
+        wr_batch_.busy = true;
+        if(fits)
+        {
+            wr_batch_.last = n;
+            write_batch_op<handler_type>{
+                init.completion_handler, *this,
+                    wr_batch_frame(bs)}({}, 0, false);
+        }
+        else
+        {
+            // Too big to coalesce, send it from the caller's memory
+            write_op<ConstBufferSequence, handler_type>{
+                init.completion_handler, *this, bs, true}(
+                    error_code{});
+        }
+    }
+    else if(fits)
+    {
+        wr_batch_.last += n;
+        wr_batch_.push(batch_holder<handler_type>::make(
+            std::move(init.completion_handler),
+                wr_batch_frame(bs)));
+    }
+    else
+    {
+        // End the batch, this message is sent
+        // from the caller's memory after it.
+        wr_batch_.last = 0;
+        wr_batch_.push(direct_holder<
+            ConstBufferSequence, handler_type>::make(
+                std::move(init.completion_handler), bs));
+    }
+    return init.result.get();
+}
+
+//------------------------------------------------------------------------------
+
+template<class NextLayer, class Role>
+void
+stream<NextLayer, Role>::
+write(prepared_message const& msg)
+{
+    static_assert(is_sync_stream<next_layer_type>::value,
+        "SyncStream requirements not met");
+    error_code ec;
+    write(msg, ec);
+    if(ec)
+        BOOST_THROW_EXCEPTION(system_error{ec});
+}
+
+template<class NextLayer, class Role>
+void
+stream<NextLayer, Role>::
+write(prepared_message const& msg, error_code& ec)
+{
+    static_assert(is_sync_stream<next_layer_type>::value,
+        "SyncStream requirements not met");
+    auto lock = wr_lock();
+    if(wr_aborted(lock, ec))
+        return;
+    boost::asio::write(stream_, wr_prepared(msg), ec);
+    failed_ = !!ec;
+}
+
+template<class NextLayer, class Role>
+template<class WriteHandler>
+async_return_type<
+    WriteHandler, void(error_code)>
+stream<NextLayer, Role>::
+async_write(
+    prepared_message const& msg, WriteHandler&& handler)
+{
+    static_assert(is_async_stream<next_layer_type>::value,
+        "AsyncStream requirements not met");
+    async_completion<WriteHandler,
+        void(error_code)> init{handler};
+    write_prepared_op<handler_type<
+        WriteHandler, void(error_code)>>{
+            init.completion_handler, *this, msg}({}, 0, false);
+    return init.result.get();
+}
+
+//------------------------------------------------------------------------------
+
+template<class NextLayer, class Role>
+template<class MutableBufferSequence>
+void
+stream<NextLayer, Role>::
+write_inplace(MutableBufferSequence const& buffers)
+{
+    static_assert(is_sync_stream<next_layer_type>::value,
+        "SyncStream requirements not met");
+    static_assert(beast::is_mutable_buffer_sequence<
+        MutableBufferSequence>::value,
+            "MutableBufferSequence requirements not met");
+    error_code ec;
+    write_inplace(buffers, ec);
+    if(ec)
+        BOOST_THROW_EXCEPTION(system_error{ec});
+}
+
+template<class NextLayer, class Role>
+template<class MutableBufferSequence>
+void
+stream<NextLayer, Role>::
+write_inplace(
+    MutableBufferSequence const& buffers, error_code& ec)
+{
+    static_assert(is_sync_stream<next_layer_type>::value,
+        "SyncStream requirements not met");
+    static_assert(beast::is_mutable_buffer_sequence<
+        MutableBufferSequence>::value,
+            "MutableBufferSequence requirements not met");
+    if(! this->is_client() || pmd_)
+        return write(buffers, ec);
+    auto lock = wr_lock();
+    if(wr_aborted(lock, ec))
+        return;
+    detail::fh_streambuf fh_buf;
+    wr_inplace(fh_buf, buffers);
+    boost::asio::write(stream_,
+        buffer_cat(fh_buf.data(), buffers), ec);
+    failed_ = !!ec;
+}
+
+template<class NextLayer, class Role>
+template<class MutableBufferSequence, class WriteHandler>
+async_return_type<
+    WriteHandler, void(error_code)>
+stream<NextLayer, Role>::
+async_write_inplace(
+    MutableBufferSequence const& bs, WriteHandler&& handler)
+{
+    static_assert(is_async_stream<next_layer_type>::value,
+        "AsyncStream requirements not met");
+    static_assert(beast::is_mutable_buffer_sequence<
+        MutableBufferSequence>::value,
+            "MutableBufferSequence requirements not met");
+    if(! this->is_client() || pmd_)
+        return async_write(bs,
+            std::forward<WriteHandler>(handler));
+    async_completion<WriteHandler,
+        void(error_code)> init{handler};
+    write_inplace_op<MutableBufferSequence, handler_type<
+        WriteHandler, void(error_code)>>{
+            init.completion_handler, *this, bs}({}, 0, false);
     return init.result.get();
 }
 
@@ -11,8 +11,11 @@
 #include <beast/config.hpp>
 #include <beast/websocket/rfc6455.hpp>
 #include <beast/core/detail/type_traits.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/throw_exception.hpp>
 #include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <stdexcept>
@@ -40,13 +43,13 @@ struct permessage_deflate
 
     /** Maximum server window bits to offer
 
-        @note Due to a bug in ZLib, this value must be greater than 8.
+        The value must be between 8 and 15 inclusive.
     */
     int server_max_window_bits = 15;
 
     /** Maximum client window bits to offer
 
-        @note Due to a bug in ZLib, this value must be greater than 8.
+        The value must be between 8 and 15 inclusive.
     */
     int client_max_window_bits = 15;
 
@@ -61,6 +64,72 @@ struct permessage_deflate
 
     /// Deflate memory level, 1..9
     int memLevel = 4;
+
+    /** Minimum message size to compress.
+
+        Messages whose first frame has fewer payload bytes than
+        this are sent uncompressed. Zero compresses every message.
+    */
+    std::size_t msg_size_threshold = 0;
+
+    /** `true` to adapt compression to the results achieved.
+
+        When set, the time spent and the space saved are measured
+        for each message. The compression level is lowered when
+        compressing costs too much time for the bytes saved, and
+        raised back towards `compLevel` when it is cheap. When
+        several messages in a row do not shrink, compression is
+        paused for the next few messages.
+    */
+    bool adaptive = false;
+};
+
+/** Keepalive options.
+
+    These settings detect connections which have gone quiet
+    and peers which have stopped responding. They apply while
+    an asynchronous read is pending on an open stream. A zero
+    duration disables the corresponding setting.
+
+    The checks are made by a single timer shared by all of the
+    streams which use the same `io_service`, with a granularity
+    of about a quarter of the shortest duration set. When a
+    timeout occurs, the lowest layer is closed and the pending
+    read completes with @ref error::timeout.
+
+    @note Objects of this type are used with
+          @ref beast::websocket::stream::set_option.
+*/
+struct keepalive
+{
+    /** Time without a message after which the connection fails.
+
+        Only message frames are counted. Control frames, such
+        as the pongs sent in reply to automatic pings, keep the
+        peer alive without keeping the connection busy.
+    */
+    std::chrono::steady_clock::duration idle_timeout{};
+
+    /** Time without receiving data after which a ping is sent.
+
+        Another ping is not sent until something is received.
+    */
+    std::chrono::steady_clock::duration ping_interval{};
+
+    /** Time after an automatic ping within which data must arrive.
+
+        Any data received from the peer, not only the pong,
+        satisfies this deadline.
+    */
+    std::chrono::steady_clock::duration pong_timeout{};
+
+    /** The strand which invokes the handlers of the stream.
+
+        When set, each check is posted to this strand. It must
+        be set when the `io_service` is run by more than one
+        thread, and must outlive the stream.
+    */
+    boost::asio::io_service::strand* strand = nullptr;
 };
 
 } // websocket
@@ -0,0 +1,156 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_PREPARED_MESSAGE_HPP
+#define BEAST_WEBSOCKET_PREPARED_MESSAGE_HPP
+
+#include <beast/config.hpp>
+#include <beast/websocket/option.hpp>
+#include <beast/websocket/stream_fwd.hpp>
+#include <boost/asio/buffer.hpp>
+#include <cstdint>
+#include <memory>
+
+namespace beast {
+namespace websocket {
+
+/** A message framed once, for sending to many streams.
+
+    Objects of this type hold a complete WebSocket message,
+    already framed for the server role. When permessage-deflate
+    settings are provided, a compressed frame is also built,
+    once. Writing the message to a @ref stream sends the stored
+    frame as-is, with no copying and no compression performed
+    on a per-connection basis.
+
+    The stored frames are immutable and reference counted.
+    Copies of a prepared message share the same storage, which
+    remains valid until the last copy is destroyed and every
+    pending asynchronous write of the message completes.
+
+    The compressed frame is only used on connections which
+    negotiated `server_no_context_takeover`, and a window at
+    least as large as the one used to build the message. Other
+    connections are sent the uncompressed frame.
+
+    @note A prepared message is always sent as a single frame,
+    regardless of the @ref stream::auto_fragment setting. Only
+    streams operating in the server role can send a prepared
+    message, since frames sent by clients must be masked with
+    a unique key.
+*/
+class prepared_message
+{
+    template<class NextLayer, class Role>
+    friend class stream;
+
+    struct frame
+    {
+        std::unique_ptr<std::uint8_t[]> p;
+        std::size_t size = 0;
+    };
+
+    struct impl
+    {
+        bool binary;
+        std::size_t payload_size;
+        int window_bits;
+        frame plain;
+        frame deflated;
+    };
+
+    std::shared_ptr<impl const> impl_;
+
+    template<class ConstBufferSequence>
+    static
+    frame
+    make_frame(bool binary, bool rsv1,
+        ConstBufferSequence const& buffers);
+
+    boost::asio::const_buffers_1
+    get(bool deflate, int window_bits) const;
+
+public:
+    /** Constructor
+
+        The default constructed object does not hold a message,
+        and may not be written to a stream.
+    */
+    prepared_message() = default;
+
+    /** Constructor
+
+        The payload is copied and framed as a single uncompressed
+        message.
+
+        @param buffers The buffers containing the entire message
+        payload.
+
+        @param binary `true` to send the message with the binary
+        opcode, otherwise the message is sent as text.
+    */
+    template<class ConstBufferSequence>
+    explicit
+    prepared_message(ConstBufferSequence const& buffers,
+        bool binary = false);
+
+    /** Constructor
+
+        The payload is copied and framed as a single uncompressed
+        message. Unless `opts.server_enable` is `false`, the payload
+        is also compressed using `opts.server_max_window_bits`,
+        `opts.compLevel`, and `opts.memLevel`, and framed as a
+        single compressed message. The compressed frame is not
+        kept when it would be no smaller than the uncompressed one.
+
+        @param buffers The buffers containing the entire message
+        payload.
+
+        @param binary `true` to send the message with the binary
+        opcode, otherwise the message is sent as text.
+
+        @param opts The settings to use for compression.
+    */
+    template<class ConstBufferSequence>
+    prepared_message(ConstBufferSequence const& buffers,
+        bool binary, permessage_deflate const& opts);
+
+    /// Returns `true` if this object holds a message
+    explicit
+    operator bool() const
+    {
+        return impl_ != nullptr;
+    }
+
+    /// Returns `true` if the message is sent with the binary opcode
+    bool
+    binary() const
+    {
+        return impl_->binary;
+    }
+
+    /// Returns the size of the uncompressed payload
+    std::size_t
+    size() const
+    {
+        return impl_->payload_size;
+    }
+
+    /// Returns `true` if a compressed frame is available
+    bool
+    compressed() const
+    {
+        return impl_->deflated.size != 0;
+    }
+};
+
+} // websocket
+} // beast
+
+#include <beast/websocket/impl/prepared_message.ipp>
+
+#endif
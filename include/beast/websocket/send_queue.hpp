@@ -0,0 +1,179 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_SEND_QUEUE_HPP
+#define BEAST_WEBSOCKET_SEND_QUEUE_HPP
+
+#include <beast/config.hpp>
+#include <beast/websocket/stream.hpp>
+#include <beast/core/error.hpp>
+#include <boost/asio/io_service.hpp>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace beast {
+namespace websocket {
+
+/** A thread-safe queue of outgoing messages for a stream.
+
+    Any thread may call @ref push to enqueue a message, without
+    first dispatching to the thread or strand which owns the
+    stream. The queue is lock-free. A single writer, running
+    through the executor supplied on construction, drains the
+    queue by calling @ref stream::async_write for each message
+    in turn. Messages pushed by one thread are sent in the order
+    they were pushed.
+
+    The number of payload bytes waiting in the queue is tracked
+    to provide backpressure. The high watermark callback is
+    invoked when a push brings the total above the high
+    watermark, and the low watermark callback is invoked once
+    the total drains back to the low watermark. The callbacks
+    alternate, and may be invoked from any thread which calls
+    @ref push, or from the writer.
+
+    While the queue holds messages, the application must not
+    perform other write operations on the stream.
+
+    @tparam NextLayer The type of the stream's next layer.
+
+    @tparam Role The role of the stream, one of @ref any_role,
+    @ref client_role or @ref server_role.
+
+    @tparam Executor The type of object used to run the writer.
+    This may be `boost::asio::io_service`, or a strand such as
+    `boost::asio::io_service::strand` when the stream is used
+    from more than one thread. The type must provide the member
+    functions `post` and `wrap`.
+
+    @note The queue must not be destroyed while a write is
+    outstanding. The callbacks must be set before the first call
+    to @ref push.
+*/
+template<class NextLayer,
+    class Role = any_role,
+    class Executor = boost::asio::io_service>
+class send_queue
+{
+    struct node
+    {
+        std::atomic<node*> next;
+        std::string payload;
+        bool binary;
+    };
+
+    stream<NextLayer, Role>& ws_;
+    Executor& ex_;
+    std::size_t high_;
+    std::size_t low_;
+    std::function<void()> on_high_;
+    std::function<void()> on_low_;
+    std::function<void(error_code)> on_error_;
+
+    // Producers push at head_, the writer pops at tail_
+    std::atomic<node*> head_;
+    node* tail_;
+    node stub_;
+
+    std::atomic<std::size_t> count_{0};     // messages not yet sent
+    std::atomic<std::size_t> bytes_{0};     // payload bytes not yet sent
+    std::atomic<bool> full_{false};         // above the high watermark
+    std::atomic<bool> failed_{false};       // a write failed
+    node* cur_ = nullptr;                   // message being sent
+
+    void enqueue(node* n);
+    node* dequeue();
+    void check_low();
+    void discard();
+    void drain();
+    void on_write(error_code const& ec);
+
+public:
+    /** Constructor
+
+        @param ws The stream to write to. The stream must remain
+        valid for the lifetime of the queue.
+
+        @param ex The executor used to run the writer. It must
+        remain valid for the lifetime of the queue.
+
+        @param high The high watermark, in payload bytes.
+
+        @param low The low watermark, in payload bytes. This
+        must not be greater than `high`.
+    */
+    send_queue(stream<NextLayer, Role>& ws, Executor& ex,
+        std::size_t high = 1024 * 1024,
+            std::size_t low = 256 * 1024);
+
+    /// Destructor. Messages not yet sent are discarded.
+    ~send_queue();
+
+    send_queue(send_queue const&) = delete;
+    send_queue& operator=(send_queue const&) = delete;
+
+    /// Set the callback invoked on rising above the high watermark
+    void
+    on_high(std::function<void()> f)
+    {
+        on_high_ = std::move(f);
+    }
+
+    /// Set the callback invoked on draining to the low watermark
+    void
+    on_low(std::function<void()> f)
+    {
+        on_low_ = std::move(f);
+    }
+
+    /** Set the callback invoked when a write fails.
+
+        After a failure, the remaining messages are discarded
+        before the callback is invoked, so @ref size returns
+        zero, and subsequent calls to @ref push return `false`.
+    */
+    void
+    on_error(std::function<void(error_code)> f)
+    {
+        on_error_ = std::move(f);
+    }
+
+    /// Returns the number of payload bytes not yet sent
+    std::size_t
+    size() const
+    {
+        return bytes_.load(std::memory_order_relaxed);
+    }
+
+    /** Enqueue a message.
+
+        This function may be called from any thread. The payload
+        is copied.
+
+        @param buffers The buffers containing the entire message
+        payload.
+
+        @param binary `true` to send the message with the binary
+        opcode, otherwise the message is sent as text.
+
+        @return `false` if the queue has failed and the message
+        was discarded.
+    */
+    template<class ConstBufferSequence>
+    bool
+    push(ConstBufferSequence const& buffers,
+        bool binary = false);
+};
+
+} // websocket
+} // beast
+
+#include <beast/websocket/impl/send_queue.ipp>
+
+#endif
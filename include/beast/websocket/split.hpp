@@ -0,0 +1,246 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_SPLIT_HPP
+#define BEAST_WEBSOCKET_SPLIT_HPP
+
+#include <beast/config.hpp>
+#include <beast/websocket/rfc6455.hpp>
+#include <beast/websocket/stream_fwd.hpp>
+#include <beast/core/error.hpp>
+#include <cstddef>
+
+namespace beast {
+namespace websocket {
+
+/** The reading half of a split stream.
+
+    Objects of this type are returned by @ref stream::split.
+    The read half may be used on one thread while the matching
+    @ref write_half is used on another. Only the synchronous
+    read interface is provided.
+
+    Pings received by the read half are answered, and close
+    frames are replied to, by writing on the stream between
+    the frames sent by the write half.
+
+    @note The read half refers to the stream, which must
+    remain valid while the half is in use.
+*/
+template<class NextLayer, class Role = any_role>
+class read_half
+{
+    stream<NextLayer, Role>* ws_;
+
+    friend class stream<NextLayer, Role>;
+
+    explicit
+    read_half(stream<NextLayer, Role>& ws)
+        : ws_(&ws)
+    {
+    }
+
+public:
+    /// Copy constructor
+    read_half(read_half const&) = default;
+
+    /// Copy assignment
+    read_half& operator=(read_half const&) = default;
+
+    /// Returns `true` if the latest message data indicates binary.
+    bool
+    got_binary() const
+    {
+        return ws_->got_binary();
+    }
+
+    /// Returns `true` if the latest message data indicates text.
+    bool
+    got_text() const
+    {
+        return ws_->got_text();
+    }
+
+    /// Returns `true` if the last completed read finished the current message.
+    bool
+    is_message_done() const
+    {
+        return ws_->is_message_done();
+    }
+
+    /// Returns the close reason received from the peer.
+    close_reason const&
+    reason() const
+    {
+        return ws_->reason();
+    }
+
+    /// Read a complete message. See @ref stream::read
+    template<class DynamicBuffer>
+    void
+    read(DynamicBuffer& buffer)
+    {
+        ws_->read(buffer);
+    }
+
+    /// Read a complete message. See @ref stream::read
+    template<class DynamicBuffer>
+    void
+    read(DynamicBuffer& buffer, error_code& ec)
+    {
+        ws_->read(buffer, ec);
+    }
+
+    /// Read some message data. See @ref stream::read_some
+    template<class DynamicBuffer>
+    std::size_t
+    read_some(DynamicBuffer& buffer, std::size_t limit)
+    {
+        return ws_->read_some(buffer, limit);
+    }
+
+    /// Read some message data. See @ref stream::read_some
+    template<class DynamicBuffer>
+    std::size_t
+    read_some(DynamicBuffer& buffer,
+        std::size_t limit, error_code& ec)
+    {
+        return ws_->read_some(buffer, limit, ec);
+    }
+
+    /// Read some message data. See @ref stream::read_some
+    template<class MutableBufferSequence>
+    std::size_t
+    read_some(MutableBufferSequence const& buffers)
+    {
+        return ws_->read_some(buffers);
+    }
+
+    /// Read some message data. See @ref stream::read_some
+    template<class MutableBufferSequence>
+    std::size_t
+    read_some(MutableBufferSequence const& buffers,
+        error_code& ec)
+    {
+        return ws_->read_some(buffers, ec);
+    }
+};
+
+/** The writing half of a split stream.
+
+    Objects of this type are returned by @ref stream::split.
+    The write half may be used on one thread while the matching
+    @ref read_half is used on another. Only the synchronous
+    write interface is provided.
+
+    Once the read half has replied to a close frame from the
+    peer, operations on the write half fail with the error
+    `boost::asio::error::operation_aborted`.
+
+    @note The write half refers to the stream, which must
+    remain valid while the half is in use.
+*/
+template<class NextLayer, class Role = any_role>
+class write_half
+{
+    stream<NextLayer, Role>* ws_;
+
+    friend class stream<NextLayer, Role>;
+
+    explicit
+    write_half(stream<NextLayer, Role>& ws)
+        : ws_(&ws)
+    {
+    }
+
+public:
+    /// Copy constructor
+    write_half(write_half const&) = default;
+
+    /// Copy assignment
+    write_half& operator=(write_half const&) = default;
+
+    /// Set the binary message option. See @ref stream::binary
+    void
+    binary(bool value)
+    {
+        ws_->binary(value);
+    }
+
+    /// Returns `true` if the binary message option is set.
+    bool
+    binary() const
+    {
+        return ws_->binary();
+    }
+
+    /// Write a complete message. See @ref stream::write
+    template<class ConstBufferSequence>
+    void
+    write(ConstBufferSequence const& buffers)
+    {
+        ws_->write(buffers);
+    }
+
+    /// Write a complete message. See @ref stream::write
+    template<class ConstBufferSequence>
+    void
+    write(ConstBufferSequence const& buffers, error_code& ec)
+    {
+        ws_->write(buffers, ec);
+    }
+
+    /// Write partial message data. See @ref stream::write_some
+    template<class ConstBufferSequence>
+    void
+    write_some(bool fin, ConstBufferSequence const& buffers)
+    {
+        ws_->write_some(fin, buffers);
+    }
+
+    /// Write partial message data. See @ref stream::write_some
+    template<class ConstBufferSequence>
+    void
+    write_some(bool fin,
+        ConstBufferSequence const& buffers, error_code& ec)
+    {
+        ws_->write_some(fin, buffers, ec);
+    }
+
+    /// Send a ping. See @ref stream::ping
+    void
+    ping(ping_data const& payload)
+    {
+        ws_->ping(payload);
+    }
+
+    /// Send a ping. See @ref stream::ping
+    void
+    ping(ping_data const& payload, error_code& ec)
+    {
+        ws_->ping(payload, ec);
+    }
+
+    /// Send a close frame. See @ref stream::close
+    void
+    close(close_reason const& cr)
+    {
+        ws_->close(cr);
+    }
+
+    /// Send a close frame. See @ref stream::close
+    void
+    close(close_reason const& cr, error_code& ec)
+    {
+        ws_->close(cr, ec);
+    }
+};
+
+} // websocket
+} // beast
+
+#endif
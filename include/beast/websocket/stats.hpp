@@ -0,0 +1,136 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_STATS_HPP
+#define BEAST_WEBSOCKET_STATS_HPP
+
+#include <beast/config.hpp>
+#include <chrono>
+#include <cstdint>
+
+namespace beast {
+namespace websocket {
+
+/** A snapshot of the statistics of a @ref stream.
+
+    Values are only accumulated while the stream is collecting
+    statistics, see @ref stream::collect_stats. Byte and frame
+    counts for outgoing data are taken when a frame is prepared
+    for sending, before the next layer accepts it.
+
+    The wait times measure how long asynchronous operations
+    spend suspended inside the stream, behind another operation
+    of the stream itself. A large write wait time means writes
+    are queued behind pings, pongs or close frames; a large read
+    wait time means a read had to reply to a control frame while
+    a write was in progress.
+
+    @see stream::stats
+*/
+struct stream_stats
+{
+    /// The type used to report measured time
+    using duration = std::chrono::steady_clock::duration;
+
+    /// Messages read to completion
+    std::uint64_t messages_in = 0;
+
+    /// Messages whose final part was provided to a write
+    std::uint64_t messages_out = 0;
+
+    /// Frames received, including control frames
+    std::uint64_t frames_in = 0;
+
+    /// Frames sent, including control frames
+    std::uint64_t frames_out = 0;
+
+    /// Bytes received in frames, including frame headers
+    std::uint64_t wire_bytes_in = 0;
+
+    /// Bytes sent in frames, including frame headers
+    std::uint64_t wire_bytes_out = 0;
+
+    /// Message payload bytes delivered to the caller
+    std::uint64_t payload_bytes_in = 0;
+
+    /// Message payload bytes provided by the caller
+    std::uint64_t payload_bytes_out = 0;
+
+    /// Compressed bytes consumed by the decompressor
+    std::uint64_t inflate_bytes_in = 0;
+
+    /// Bytes produced by the decompressor
+    std::uint64_t inflate_bytes_out = 0;
+
+    /// Bytes consumed by the compressor
+    std::uint64_t deflate_bytes_in = 0;
+
+    /// Compressed bytes produced by the compressor
+    std::uint64_t deflate_bytes_out = 0;
+
+    /// Ping frames received
+    std::uint64_t pings_in = 0;
+
+    /// Ping frames sent
+    std::uint64_t pings_out = 0;
+
+    /// Pong frames received
+    std::uint64_t pongs_in = 0;
+
+    /// Pong frames sent
+    std::uint64_t pongs_out = 0;
+
+    /// Time spent decompressing
+    duration inflate_time{};
+
+    /// Time spent compressing
+    duration deflate_time{};
+
+    /// Time spent applying and removing the mask
+    duration mask_time{};
+
+    /// Time reads spent waiting for a write to finish
+    duration read_wait_time{};
+
+    /// Time writes spent waiting for another write to finish
+    duration write_wait_time{};
+
+    /** Returns the compression ratio of received messages.
+
+        This is the number of bytes produced by the decompressor
+        for each compressed byte, or zero if nothing was
+        decompressed.
+    */
+    double
+    inflate_ratio() const
+    {
+        if(inflate_bytes_in == 0)
+            return 0;
+        return static_cast<double>(inflate_bytes_out) /
+            inflate_bytes_in;
+    }
+
+    /** Returns the compression ratio of sent messages.
+
+        This is the number of bytes consumed by the compressor
+        for each compressed byte produced, or zero if nothing
+        was compressed.
+    */
+    double
+    deflate_ratio() const
+    {
+        if(deflate_bytes_out == 0)
+            return 0;
+        return static_cast<double>(deflate_bytes_in) /
+            deflate_bytes_out;
+    }
+};
+
+} // websocket
+} // beast
+
+#endif
@@ -11,12 +11,23 @@
 #include <beast/config.hpp>
 #include <beast/websocket/error.hpp>
 #include <beast/websocket/option.hpp>
+#include <beast/websocket/prepared_message.hpp>
 #include <beast/websocket/rfc6455.hpp>
+#include <beast/websocket/split.hpp>
+#include <beast/websocket/stats.hpp>
+#include <beast/websocket/stream_fwd.hpp>
+#include <beast/websocket/detail/frag_policy.hpp>
 #include <beast/websocket/detail/frame.hpp>
 #include <beast/websocket/detail/hybi13.hpp>
+#include <beast/websocket/detail/keepalive.hpp>
 #include <beast/websocket/detail/mask.hpp>
 #include <beast/websocket/detail/pausation.hpp>
 #include <beast/websocket/detail/pmd_extension.hpp>
+#include <beast/websocket/detail/pooled_buffer.hpp>
+#include <beast/websocket/detail/shared_flag.hpp>
+#include <beast/websocket/detail/stats.hpp>
+#include <beast/websocket/detail/stream_role.hpp>
+#include <beast/websocket/detail/upgrade_parser.hpp>
 #include <beast/websocket/detail/utf8_checker.hpp>
 #include <beast/core/async_result.hpp>
 #include <beast/core/buffered_read_stream.hpp>
@@ -31,10 +42,14 @@
 #include <beast/zlib/deflate_stream.hpp>
 #include <beast/zlib/inflate_stream.hpp>
 #include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <type_traits>
+#include <utility>
 
 namespace beast {
 namespace websocket {
@@ -102,6 +117,14 @@ enum class frame_type
     For asynchronous operations, the type must support the
     @b AsyncStream concept.
 
+    @tparam Role One of @ref any_role, @ref client_role or
+    @ref server_role. When the role is fixed at compile time, the
+    stream does not test the role at run time, and a server stream
+    holds no mask key generator. A stream which may only act as a
+    client cannot accept connections, and a stream which may only
+    act as a server cannot perform the client handshake. The aliases
+    @ref client_stream and @ref server_stream select these roles.
+
     @note A stream object must not be moved or destroyed while there
     are pending asynchronous operations associated with it.
 
@@ -110,8 +133,10 @@ enum class frame_type
         @b DynamicBuffer,
         @b SyncStream
 */
-template<class NextLayer>
+template<class NextLayer, class Role>
 class stream
+    : private detail::stream_role<Role>
+    , private detail::keepalive_hook
 {
     friend class detail::frame_test;
     friend class stream_test;
@@ -167,7 +192,12 @@ class stream
 
         // A small, circular buffer to read frame headers.
         // This improves performance by avoiding small reads.
-        static_buffer<+tcp_frame_size> buf;
+        // The storage comes from a per-thread pool.
+        detail::pooled_buffer<+tcp_frame_size> buf;
+
+        // Receives the first byte of a frame while the
+        // buffer is given back, see @ref stream::lean.
+        std::uint8_t peek;
 
         // opcode of current message being read
         detail::opcode op;
@@ -195,7 +225,8 @@ class stream
         // `true` if this message should be compressed.
         // This gets set to the compress option at the beginning of
         // of sending a message, so that the option can be changed
-        // mid-send without affecting the current message.
+        // mid-send without affecting the current message. It is
+        // cleared if the start of the message looks incompressible.
         bool compress;
 
         // Size of the write buffer.
@@ -206,8 +237,8 @@ class stream
 
         // The write buffer. Used for compression and masking.
         // The buffer is allocated or reallocated at the beginning of
-        // sending a message.
-        std::unique_ptr<std::uint8_t[]> buf;
+        // sending a message, from a per-thread pool.
+        std::unique_ptr<std::uint8_t[], detail::pool_deleter> buf;
     };
 
     // State information for the permessage-deflate extension
@@ -216,26 +247,97 @@ class stream
         // `true` if current read message is compressed
         bool rd_set;
 
-        zlib::deflate_stream zo;
-        zlib::inflate_stream zi;
+        // `true` if the empty block codes were appended to
+        // the final frame of the message in the read buffer
+        bool rd_tail;
+
+        // Buffers come from a per-thread pool, and are returned
+        // after each message when context takeover is disabled.
+        zlib::basic_deflate_stream<
+            detail::pmd_allocator<std::uint8_t>> zo;
+        zlib::basic_inflate_stream<
+            detail::pmd_allocator<std::uint8_t>> zi;
+
+        // Decides when and how hard to compress
+        detail::pmd_policy policy;
+
+        // Sizes the buffers receiving inflated messages
+        detail::pmd_predictor predictor;
+    };
+
+    class batch_node;
+    template<class> class batch_holder;
+    template<class, class> class direct_holder;
+
+    // Messages coalesced while a write is outstanding
+    struct wr_batch_t
+    {
+        // Largest payload to coalesce, or zero if disabled
+        std::size_t limit = 0;
+
+        // Largest total payload of one batch
+        std::size_t max_bytes = 64 * 1024;
+
+        // Payload bytes in the last batch of the queue
+        std::size_t last = 0;
+
+        // `true` if a message or batch is being sent
+        bool busy = false;
+
+        // Framed messages waiting to be sent, and the queue of
+        // handlers in the order of the calls. A batch is sent
+        // with the handler of its first message, and ends at a
+        // direct node, a message sent from the caller's memory.
+        flat_buffer buf;
+        batch_node* head = nullptr;
+        batch_node* tail = nullptr;
+
+        wr_batch_t() = default;
+        wr_batch_t(wr_batch_t&& other);
+        wr_batch_t& operator=(wr_batch_t&& other);
+        ~wr_batch_t();
+
+        void push(batch_node* n);
+        void clear();
+    };
+
+    // State information for the keepalive option
+    struct ka_t
+    {
+        using time_point =
+            detail::keepalive_hook::clock_type::time_point;
+
+        keepalive opt;                  // the settings
+        time_point recv_at;             // when data was last received
+        time_point msg_at;              // when a message was last received
+        time_point ping_at;             // when the unanswered ping was sent
+        detail::pausation rd_op;        // read waiting for the ping or check
+        detail::keepalive_state state;  // read pending, check posted
+        detail::shared_flag gap;        // seen with no read pending
+        bool queued = false;            // a check is posted for a done read
+        bool recv = false;              // data received since the last check
+        bool msg = false;               // message received since the last check
+        bool pinging = false;           // an automatic ping is being sent
+        bool awaiting = false;          // the automatic ping is unanswered
+        bool timed_out = false;         // a timeout closed the connection
     };
 
     buffered_read_stream<
         NextLayer, flat_buffer> stream_;    // the wrapped stream
-    detail::maskgen maskgen_;               // source of mask keys
     std::size_t rd_msg_max_ =
         16 * 1024 * 1024;                   // max message size
-    bool wr_autofrag_ = true;               // auto fragment
     std::size_t wr_buf_size_ = 4096;        // write buffer size
     std::size_t rd_buf_size_ = 4096;        // read buffer size
     detail::opcode wr_opcode_ =
         detail::opcode::text;               // outgoing message type
+    bool wr_autofrag_ = true;               // auto fragment
+    bool rd_direct_ = false;                // read into caller memory
+    bool lean_ = false;                     // give back buffers when idle
     control_cb_type ctrl_cb_;               // control callback
-    role_type role_;                        // server or client
-    bool failed_;                           // the connection failed
+    detail::shared_flag failed_;            // the connection failed
 
-    bool rd_close_;                         // read close frame
-    bool wr_close_;                         // sent close frame
+    detail::shared_flag rd_close_;          // read close frame
+    detail::shared_flag wr_close_;          // sent close frame
     token wr_block_;                        // op currenly writing
 
     ping_data* ping_data_;                  // where to put the payload
@@ -246,6 +348,15 @@ class stream
     close_reason cr_;                       // set from received close frame
     rd_t rd_;                               // read state
     wr_t wr_;                               // write state
+    wr_batch_t wr_batch_;                   // write coalescing
+    detail::frag_policy wr_frag_;           // auto fragment sizing
+    ka_t ka_;                               // keepalive state
+    detail::stats_collector st_;            // statistics
+
+    // Engaged once the stream is split. Held while
+    // writing frames, so the read half can reply
+    // to control frames between them.
+    std::unique_ptr<std::mutex> wr_mutex_;
 
     // If not engaged, then permessage-deflate is not
     // enabled for the currently active session.
@@ -385,6 +496,36 @@ public:
         return stream_.lowest_layer();
     }
 
+    /** Split the stream into a reading half and a writing half.
+
+        This function returns a @ref read_half and a @ref write_half
+        which refer to the stream. The read half may be used on one
+        thread while the write half is used on another, allowing a
+        connection to read and write at the same time without
+        serializing both directions on one strand.
+
+        After the call, each synchronous write operation holds a
+        lock on the stream while it sends its frames. When the read
+        half receives a ping or a close frame, it acquires the same
+        lock to send the pong or the close reply, so replies are
+        never interleaved with the bytes of a frame. A reply may
+        wait for the message being written to finish. Once the read
+        half has replied to a close frame, operations on the write
+        half fail with `boost::asio::error::operation_aborted`.
+
+        The halves provide only the synchronous interface.
+        Asynchronous operations must not be performed on a split
+        stream. The next layer must allow a read and a write to
+        proceed concurrently from different threads, as a TCP
+        socket does. Options should be set before splitting.
+
+        This function must be called after the WebSocket handshake
+        completes, and before any other thread uses the stream.
+    */
+    std::pair<read_half<NextLayer, Role>,
+        write_half<NextLayer, Role>>
+    split();
+
     //--------------------------------------------------------------------------
     //
     // Observers
@@ -444,7 +585,8 @@ public:
         of bytes for the size of the buffer passed in the next call
         to read. The number is determined by the state of the current
         frame and whether or not the permessage-deflate extension is
-        enabled.
+        enabled. For compressed messages, the inflated size is
+        predicted from the messages received recently.
 
         @param initial_size A size representing the caller's desired
         buffer size for when there is no information which may be used
@@ -461,7 +603,8 @@ public:
         of bytes for the size of the buffer passed in the next call
         to read. The number is determined by the state of the current
         frame and whether or not the permessage-deflate extension is
-        enabled.
+        enabled. For compressed messages, the inflated size is
+        predicted from the messages received recently.
 
         @param buffer The buffer which will be used for reading. The
         implementation will query the buffer to obtain the optimum
@@ -495,6 +638,53 @@ public:
         o = pmd_opts_;
     }
 
+    /** Set the keepalive options
+
+        When any duration is set, the stream is checked by a timer
+        shared by all of the streams using the same `io_service`,
+        instead of needing a timer of its own. The checks only act
+        while an asynchronous read is pending, as it takes a read
+        to receive the pong. When a ping is due and no write is in
+        progress, a ping with an empty payload is sent, just as if
+        @ref async_ping was called. The completion of the pending
+        read waits for this ping to finish sending.
+
+        On timeout, the lowest layer is closed. The pending read
+        completes with @ref error::timeout, and other pending
+        operations with `boost::asio::error::operation_aborted`.
+
+        The lowest layer must provide `close(error_code&)`, as a
+        socket does. Each check is posted to the strand set in
+        the options, or to the `io_service` when no strand is set.
+        When the `io_service` is run by more than one thread, the
+        strand must be set, and the handlers of all operations on
+        the stream must be invoked through it. Otherwise, a check
+        could run concurrently with the stream's operations.
+
+        While any duration is set, the shared timer keeps the
+        `io_service` busy. Setting all durations to zero, or
+        destroying the stream, removes the stream from the timer.
+
+        @par Example
+        Pinging a quiet peer after 30 seconds, and failing the
+        connection when it does not answer within 10 seconds:
+        @code
+            keepalive opt;
+            opt.ping_interval = std::chrono::seconds(30);
+            opt.pong_timeout = std::chrono::seconds(10);
+            ws.set_option(opt);
+        @endcode
+    */
+    void
+    set_option(keepalive const& o);
+
+    /// Get the keepalive options
+    void
+    get_option(keepalive& o)
+    {
+        o = ka_.opt;
+    }
+
     /** Set the automatic fragmentation option.
 
         Determines if outgoing message payloads are broken up into
@@ -527,6 +717,45 @@ public:
         return wr_autofrag_;
     }
 
+    /** Set the automatic fragmentation latency option.
+
+        When set to a non-zero duration, and automatic fragmentation
+        is on, asynchronous writes choose the size of each frame from
+        the time the next layer took to accept the previous frames,
+        so that each frame takes about this long to send. Between
+        frames, pings, pongs and close frames waiting on the stream
+        are sent, so a large message on a congested connection does
+        not hold them back for much longer than the duration.
+
+        Frames grow back to the write buffer size while the next
+        layer accepts them quickly, and are never smaller than 512
+        bytes unless the write buffer is. Compressed messages are
+        fragmented the same way.
+
+        The default setting is zero, which makes every frame as
+        large as the write buffer.
+
+        @par Example
+        Aiming for frames which take 10 milliseconds to send:
+        @code
+            ws.auto_fragment_latency(std::chrono::milliseconds(10));
+        @endcode
+
+        @param budget The time to send one frame, or zero.
+    */
+    void
+    auto_fragment_latency(std::chrono::steady_clock::duration budget)
+    {
+        wr_frag_.budget(budget);
+    }
+
+    /// Returns the automatic fragmentation latency setting.
+    std::chrono::steady_clock::duration
+    auto_fragment_latency() const
+    {
+        return wr_frag_.budget();
+    }
+
     /** Set the binary message option.
 
         This controls whether or not outgoing message opcodes
@@ -607,6 +836,162 @@ public:
         ctrl_cb_ = std::move(cb);
     }
 
+    /** Set the direct read option.
+
+        Determines if the payloads of uncompressed frames are read
+        directly into the caller's memory.
+
+        When the direct read option is turned off, a read operation
+        which finds the read buffer empty first fills the read
+        buffer from the next layer, and then copies payload data
+        out to the caller. This gets more data in fewer I/O calls
+        when the caller's buffers are small.
+
+        When the direct read option is turned on, the read buffer
+        is only used to receive frame headers, along with any
+        payload which arrives with them. The rest of each frame's
+        payload is read from the next layer straight into the
+        caller's buffers, and unmasked in place. This avoids a copy
+        for large frames. Compressed frames are not affected.
+
+        The default setting is to fill the read buffer.
+
+        @par Example
+        Setting the direct read option.
+        @code
+            ws.read_direct(true);
+        @endcode
+
+        @param value `true` if payloads should be read directly.
+    */
+    void
+    read_direct(bool value)
+    {
+        rd_direct_ = value;
+    }
+
+    /// Returns `true` if the direct read option is set.
+    bool
+    read_direct() const
+    {
+        return rd_direct_;
+    }
+
+    /** Set the lean option.
+
+        Determines if the stream gives back its buffers while it
+        is idle, to lower the memory used by connections which
+        spend most of their time waiting.
+
+        When the lean option is turned on, the read buffer is given
+        back to a per-thread pool when a read completes with no
+        received data left in it, and the write buffer is given back
+        when a message has been sent. A read which must wait for
+        the next frame receives its first byte into the stream
+        itself, and takes a read buffer from the pool once the byte
+        arrives. This costs one extra read on the next layer for
+        each frame which does not arrive together with the previous
+        one.
+
+        The state of the permessage-deflate compressor and
+        decompressor is only given back between messages when
+        context takeover is disabled for that direction.
+
+        The default setting is to keep the buffers.
+
+        @par Example
+        Setting the lean option.
+        @code
+            ws.lean(true);
+        @endcode
+
+        @param value `true` if buffers should be given back when idle.
+    */
+    void
+    lean(bool value)
+    {
+        lean_ = value;
+    }
+
+    /// Returns `true` if the lean option is set.
+    bool
+    lean() const
+    {
+        return lean_;
+    }
+
+    /** Set the statistics option.
+
+        Determines if the stream counts the messages, frames and
+        bytes it sends and receives, and measures the time it
+        spends compressing, masking, and waiting on its own
+        operations. The collected values are returned by
+        @ref stats.
+
+        While the option is turned off the stream does not read
+        the clock, and each place which would update a statistic
+        costs a single test of the option. The statistics are
+        stored in memory allocated when the option is first
+        turned on, so a stream which never collects them does not
+        grow. Turning the option off keeps the values collected
+        so far.
+
+        Both halves of a split stream update the same statistics.
+        Each value is kept in a relaxed atomic, so updates from
+        the two halves are never lost, and @ref stats and
+        @ref reset_stats may be called from any thread while
+        operations are pending. A snapshot taken that way may
+        hold values updated at slightly different times. This
+        function itself must not be called while operations are
+        pending.
+
+        The default setting is to not collect statistics.
+
+        @par Example
+        Collecting statistics.
+        @code
+            ws.collect_stats(true);
+            ...
+            std::cout << ws.stats().messages_in << "\n";
+        @endcode
+
+        @param value `true` if statistics should be collected.
+    */
+    void
+    collect_stats(bool value)
+    {
+        st_.enable(value);
+    }
+
+    /// Returns `true` if the statistics option is set.
+    bool
+    collect_stats() const
+    {
+        return st_.enabled();
+    }
+
+    /** Returns the statistics collected so far.
+
+        The values accumulate from the time statistics were
+        turned on, or from the last call to @ref reset_stats.
+        This function may be called from any thread.
+    */
+    stream_stats
+    stats() const
+    {
+        return st_.get();
+    }
+
+    /** Set all collected statistics to zero.
+
+        This function may be called from any thread.
+    */
+    void
+    reset_stats()
+    {
+        st_.reset();
+    }
+
     /** Set the maximum incoming message size option.
 
         Sets the largest permissible incoming message size. Message
@@ -678,6 +1063,69 @@ public:
         return wr_buf_size_;
     }
 
+    /** Set the write coalescing option.
+
+        When set to a non-zero value, a call to @ref async_write
+        made while an earlier call to @ref async_write is still
+        outstanding does not wait for it. Instead, the new message
+        is framed into a shared buffer, and all such messages are
+        sent together with a single write to the next layer once
+        the outstanding write completes. Messages are sent, and
+        handlers are called, in the order of the calls.
+
+        A message is coalesced only if its payload is no larger
+        than `limit`, and if it does not bring the payload of the
+        batch above `max_bytes`. Any other message ends the batch:
+        the batch is sent as it is, then the message is sent from
+        the caller's memory, and later messages start a new batch.
+
+        Coalescing adds no delay of its own. A batch is sent as
+        soon as the write which was outstanding when its first
+        message arrived completes, along with any batches or
+        messages queued ahead of it. So a message waits for at
+        most the writes queued before it, each of which holds at
+        most `max_bytes` of coalesced payload.
+
+        Coalescing is not used when permessage-deflate is active,
+        or for the other write functions, which must not be mixed
+        with coalesced writes.
+
+        The default setting is zero, which disables coalescing.
+
+        @par Example
+        Coalescing messages of up to 512 bytes, in writes of up
+        to 16KB of payload.
+        @code
+            ws.write_coalesce(512, 16384);
+        @endcode
+
+        @param limit The largest payload which may be coalesced.
+
+        @param max_bytes The largest payload of all the messages
+        coalesced into one write.
+    */
+    void
+    write_coalesce(std::size_t limit,
+        std::size_t max_bytes = 64 * 1024)
+    {
+        wr_batch_.limit = limit;
+        wr_batch_.max_bytes = max_bytes;
+    }
+
+    /// Returns the write coalescing limit.
+    std::size_t
+    write_coalesce() const
+    {
+        return wr_batch_.limit;
+    }
+
+    /// Returns the largest payload of a coalesced write.
+    std::size_t
+    write_coalesce_max() const
+    {
+        return wr_batch_.max_bytes;
+    }
+
     /** Set the text message option.
 
         This controls whether or not outgoing message opcodes
@@ -3476,7 +3924,8 @@ public:
         as a <em>composed operation</em>. The program must ensure that
         the stream performs no other write operations (such as
         stream::async_write, stream::async_write_some, or
-        stream::async_close).
+        stream::async_close), except as allowed by the
+        @ref write_coalesce option.
 
         The current setting of the @ref binary option controls
         whether the message opcode is set to text or binary. If the
@@ -3514,6 +3963,236 @@ public:
     async_write(ConstBufferSequence const& buffers,
         WriteHandler&& handler);
 
+    /** Write a prepared message to the stream.
+
+        This function is used to synchronously write a prepared
+        message to the stream. The call blocks until one of the
+        following conditions is met:
+
+        @li The entire message is sent.
+
+        @li An error occurs.
+
+        This operation is implemented in terms of one or more calls to the
+        next layer's `write_some` function.
+
+        The message is sent as a single frame holding the stored
+        payload, using the opcode chosen when the message was
+        prepared. The compressed frame is sent if permessage-deflate
+        is active, the connection negotiated `server_no_context_takeover`,
+        and the negotiated window is large enough.
+
+        @param msg The message to send. The stream must be operating
+        in the server role, and no partial message may be in progress.
+
+        @throws system_error Thrown on failure.
+    */
+    void
+    write(prepared_message const& msg);
+
+    /** Write a prepared message to the stream.
+
+        This function is used to synchronously write a prepared
+        message to the stream. The call blocks until one of the
+        following conditions is met:
+
+        @li The entire message is sent.
+
+        @li An error occurs.
+
+        This operation is implemented in terms of one or more calls to the
+        next layer's `write_some` function.
+
+        The message is sent as a single frame holding the stored
+        payload, using the opcode chosen when the message was
+        prepared. The compressed frame is sent if permessage-deflate
+        is active, the connection negotiated `server_no_context_takeover`,
+        and the negotiated window is large enough.
+
+        @param msg The message to send. The stream must be operating
+        in the server role, and no partial message may be in progress.
+
+        @param ec Set to indicate what error occurred, if any.
+    */
+    void
+    write(prepared_message const& msg, error_code& ec);
+
+    /** Start an asynchronous operation to write a prepared message to the stream.
+
+        This function is used to asynchronously write a prepared
+        message to the stream. The function call always returns
+        immediately. The asynchronous operation will continue until
+        one of the following conditions is true:
+
+        @li The entire message is sent.
+
+        @li An error occurs.
+
+        This operation is implemented in terms of one or more calls
+        to the next layer's `async_write_some` functions, and is known
+        as a <em>composed operation</em>. The program must ensure that
+        the stream performs no other write operations (such as
+        stream::async_write, stream::async_write_some, or
+        stream::async_close).
+
+        The message is sent as a single frame holding the stored
+        payload, using the opcode chosen when the message was
+        prepared. The compressed frame is sent if permessage-deflate
+        is active, the connection negotiated `server_no_context_takeover`,
+        and the negotiated window is large enough.
+
+        @param msg The message to send. The stream must be operating
+        in the server role, and no partial message may be in progress.
+        The operation shares ownership of the stored frames, so `msg`
+        may be destroyed before the handler is called.
+
+        @param handler The handler to be called when the write operation
+        completes. Copies will be made of the handler as required. The
+        function signature of the handler must be:
+        @code
+        void handler(
+            error_code const& ec     // Result of operation
+        );
+        @endcode
+        Regardless of whether the asynchronous operation completes
+        immediately or not, the handler will not be invoked from within
+        this function. Invocation of the handler will be performed in a
+        manner equivalent to using `boost::asio::io_service::post`.
+    */
+    template<class WriteHandler>
+#if BEAST_DOXYGEN
+    void_or_deduced
+#else
+    async_return_type<
+        WriteHandler, void(error_code)>
+#endif
+    async_write(prepared_message const& msg,
+        WriteHandler&& handler);
+
+    /** Write a message to the stream, masking the payload in place.
+
+        This function is used to synchronously write a message to
+        the stream. The call blocks until one of the following conditions
+        is met:
+
+        @li The entire message is sent.
+
+        @li An error occurs.
+
+        This operation is implemented in terms of one or more calls to the
+        next layer's `write_some` function.
+
+        The message is sent as a single frame using the current
+        setting of the @ref binary option, regardless of the
+        @ref auto_fragment option. In the client role, the mask is
+        applied to the caller's buffers in place and the frame is
+        sent with one gather write, without copying the payload.
+        In the server role, or when permessage-deflate is active,
+        the message is sent as if by @ref write.
+
+        @param buffers The buffers containing the entire message
+        payload. The contents of the buffers are unspecified after
+        the call returns. If a message is in progress, the buffers
+        are sent as its final frame.
+
+        @throws system_error Thrown on failure.
+    */
+    template<class MutableBufferSequence>
+    void
+    write_inplace(MutableBufferSequence const& buffers);
+
+    /** Write a message to the stream, masking the payload in place.
+
+        This function is used to synchronously write a message to
+        the stream. The call blocks until one of the following conditions
+        is met:
+
+        @li The entire message is sent.
+
+        @li An error occurs.
+
+        This operation is implemented in terms of one or more calls to the
+        next layer's `write_some` function.
+
+        The message is sent as a single frame using the current
+        setting of the @ref binary option, regardless of the
+        @ref auto_fragment option. In the client role, the mask is
+        applied to the caller's buffers in place and the frame is
+        sent with one gather write, without copying the payload.
+        In the server role, or when permessage-deflate is active,
+        the message is sent as if by @ref write.
+
+        @param buffers The buffers containing the entire message
+        payload. The contents of the buffers are unspecified after
+        the call returns. If a message is in progress, the buffers
+        are sent as its final frame.
+
+        @param ec Set to indicate what error occurred, if any.
+    */
+    template<class MutableBufferSequence>
+    void
+    write_inplace(MutableBufferSequence const& buffers,
+        error_code& ec);
+
+    /** Start an asynchronous operation to write a message to the stream, masking the payload in place.
+
+        This function is used to asynchronously write a message to
+        the stream. The function call always returns immediately.
+        The asynchronous operation will continue until one of the
+        following conditions is true:
+
+        @li The entire message is sent.
+
+        @li An error occurs.
+
+        This operation is implemented in terms of one or more calls
+        to the next layer's `async_write_some` functions, and is known
+        as a <em>composed operation</em>. The program must ensure that
+        the stream performs no other write operations (such as
+        stream::async_write, stream::async_write_some, or
+        stream::async_close).
+
+        The message is sent as a single frame using the current
+        setting of the @ref binary option, regardless of the
+        @ref auto_fragment option. In the client role, the mask is
+        applied to the caller's buffers in place and the frame is
+        sent with one gather write, without copying the payload.
+        In the server role, or when permessage-deflate is active,
+        the message is sent as if by @ref write.
+
+        @param buffers The buffers containing the entire message
+        payload. The implementation will make copies of this object
+        as needed, but ownership of the underlying memory is not
+        transferred. The caller is responsible for ensuring that
+        the memory locations pointed to by buffers remains valid
+        until the completion handler is called. The contents of the
+        buffers are unspecified after the operation starts. If a
+        message is in progress, the buffers are sent as its final
+        frame.
+
+        @param handler The handler to be called when the write operation
+        completes. Copies will be made of the handler as required. The
+        function signature of the handler must be:
+        @code
+        void handler(
+            error_code const& ec     // Result of operation
+        );
+        @endcode
+        Regardless of whether the asynchronous operation completes
+        immediately or not, the handler will not be invoked from within
+        this function. Invocation of the handler will be performed in a
+        manner equivalent to using `boost::asio::io_service::post`.
+    */
+    template<class MutableBufferSequence, class WriteHandler>
+#if BEAST_DOXYGEN
+    void_or_deduced
+#else
+    async_return_type<
+        WriteHandler, void(error_code)>
+#endif
+    async_write_inplace(MutableBufferSequence const& buffers,
+        WriteHandler&& handler);
+
     /** Write partial message data on the stream.
 
         This function is used to write some or all of a message's
@@ -3630,7 +4309,100 @@ public:
     async_write_some(bool fin,
         ConstBufferSequence const& buffers, WriteHandler&& handler);
 
+    //--------------------------------------------------------------------------
+    //
+    // Relaying
+    //
+    //--------------------------------------------------------------------------
+
+    /** Relay a complete message to another stream.
+
+        This function reads the next message from this stream and
+        sends it on `dest`, by calling @ref relay_some until the
+        message is done.
+
+        @param dest The stream to send the message on.
+
+        @throws system_error Thrown on failure.
+    */
+    template<class OtherLayer, class OtherRole>
+    void
+    relay(stream<OtherLayer, OtherRole>& dest);
+
+    /** Relay a complete message to another stream.
+
+        This function reads the next message from this stream and
+        sends it on `dest`, by calling @ref relay_some until the
+        message is done.
+
+        @param dest The stream to send the message on.
+
+        @param ec Set to indicate what error occurred, if any.
+    */
+    template<class OtherLayer, class OtherRole>
+    void
+    relay(stream<OtherLayer, OtherRole>& dest, error_code& ec);
+
+    /** Relay one message frame to another stream.
+
+        This function is used by proxies to forward message data
+        without reassembling it. The call blocks until one data
+        frame received on this stream has been sent on `dest`, or
+        an error occurs. The frame keeps its opcode, length and
+        position in the message. The only transformation is the
+        removal of the mask applied by the peer and the addition
+        of the mask required of `dest`, done together in one pass
+        over the payload. Payloads larger than the read buffer are
+        forwarded in pieces as they arrive. Text payloads are not
+        checked for valid UTF-8.
+
+        A compressed frame is forwarded untouched, including its
+        reserved bit, when the peer of `dest` negotiated a window
+        at least as large as the window used by the peer of this
+        stream, and does not discard its window between messages
+        unless the peer of this stream does too. Otherwise the
+        message is decompressed, and `dest` compresses it again if
+        it can. In that case each call relays some of the message
+        instead of one frame.
+
+        Control frames are not forwarded. Pings are answered and
+        close frames are replied to as in @ref read_some. When the
+        peer closes the connection, the operation completes with
+        @ref error::closed and the application may call close on
+        `dest` with the @ref reason received.
+
+        While a message is being relayed, the application must not
+        write to `dest`. When compressed frames are forwarded and
+        both peers keep their windows between messages, every
+        compressed message received on this stream must be relayed
+        to `dest`, and no other compressed message may be sent on
+        `dest`, otherwise the windows of the peers diverge. After
+        a failure, both streams should be closed.
+
+        @param dest The stream to send the frame on.
+
+        @throws system_error Thrown on failure.
+    */
+    template<class OtherLayer, class OtherRole>
+    void
+    relay_some(stream<OtherLayer, OtherRole>& dest);
+
+    /** Relay one message frame to another stream.
+
+        This function is used by proxies to forward message data
+        without reassembling it. See @ref relay_some for details.
+
+        @param dest The stream to send the frame on.
+
+        @param ec Set to indicate what error occurred, if any.
+    */
+    template<class OtherLayer, class OtherRole>
+    void
+    relay_some(stream<OtherLayer, OtherRole>& dest, error_code& ec);
+
 private:
+    template<class, class> friend class stream;
+
     enum class fail_how
     {
         code        = 1, // send close code, teardown, finish with error::failed
@@ -3649,14 +4421,106 @@ private:
     template<class>         class response_op;
     template<class, class>  class write_some_op;
     template<class, class>  class write_op;
+    template<class>         class write_prepared_op;
+    template<class, class>  class write_inplace_op;
+    template<class>         class write_batch_op;
+    template<class>         class ka_read_op;
+
+    struct ka_ping_handler;
 
     static void default_decorate_req(request_type&) {}
     static void default_decorate_res(response_type&) {}
 
+    template<class Decorator>
+    static
+    bool
+    is_default_decorator(Decorator const&)
+    {
+        return false;
+    }
+
+    static
+    bool
+    is_default_decorator(void(*f)(response_type&))
+    {
+        return f == &default_decorate_res;
+    }
+
     void open(role_type role);
     void close();
     void reset();
     void wr_begin();
+    void rd_release();
+    void wr_release();
+    void rd_append_tail();
+    std::size_t rd_inflated_size() const;
+
+    template<class MutableBuffers, class KeyType>
+    void
+    mask_inplace(MutableBuffers const& bs, KeyType& key)
+    {
+        auto const t = st_.time_mask();
+        detail::mask_inplace(bs, key);
+    }
+
+    std::unique_lock<std::mutex>
+    wr_lock()
+    {
+        if(wr_mutex_)
+            return std::unique_lock<std::mutex>{*wr_mutex_};
+        return {};
+    }
+
+    bool
+    wr_aborted(std::unique_lock<std::mutex> const& lock,
+        error_code& ec)
+    {
+        if(! lock.owns_lock() || ! wr_close_)
+            return false;
+        // The read half replied to a close frame
+        ec = boost::asio::error::operation_aborted;
+        return true;
+    }
+
+    template<class ConstBufferSequence>
+    void wr_compress(ConstBufferSequence const& buffers);
+
+    boost::asio::const_buffers_1
+    wr_prepared(prepared_message const& msg);
+
+    template<class MutableBufferSequence>
+    void wr_inplace(detail::fh_streambuf& fh_buf,
+        MutableBufferSequence const& buffers);
+
+    template<class ConstBufferSequence>
+    std::size_t wr_batch_frame(ConstBufferSequence const& buffers);
+
+    void wr_batch_next();
+
+    static void ka_check(detail::keepalive_hook& h,
+        detail::keepalive_hook::clock_type::time_point now);
+
+    void ka_run(detail::keepalive_hook::clock_type::time_point now);
+
+    void ka_update(detail::keepalive_hook::clock_type::time_point now);
+
+    void ka_timeout();
+
+    template<class MutableBufferSequence, class Handler>
+    void ka_read_some(MutableBufferSequence const& buffers,
+        Handler&& handler);
+
+    template<class OtherLayer, class OtherRole>
+    bool rd_passthrough(
+        stream<OtherLayer, OtherRole> const& dest) const;
+
+    template<class OtherLayer, class OtherRole>
+    void relay_frame(
+        stream<OtherLayer, OtherRole>& dest, error_code& ec);
+
+    template<class OtherLayer, class OtherRole>
+    void relay_inflated(
+        stream<OtherLayer, OtherRole>& dest, error_code& ec);
 
     template<class DynamicBuffer>
     bool
@@ -3696,11 +4560,23 @@ private:
         http::basic_fields<Allocator>> const& req,
             Decorator const& decorator);
 
+    template<class Decorator>
+    bool
+    build_response(detail::upgrade_response_buffer& b,
+        detail::pmd_offer& config,
+            detail::upgrade_parser const& p,
+                Decorator const& decorator);
+
     template<class Decorator>
     void
     do_accept(Decorator const& decorator,
         error_code& ec);
 
+    template<class Decorator>
+    void
+    do_accept(detail::upgrade_parser const& p,
+        Decorator const& decorator, error_code& ec);
+
     template<class Body, class Allocator,
         class Decorator>
     void
@@ -3727,8 +4603,10 @@ private:
 #include <beast/websocket/impl/close.ipp>
 #include <beast/websocket/impl/fail.ipp>
 #include <beast/websocket/impl/handshake.ipp>
+#include <beast/websocket/impl/keepalive.ipp>
 #include <beast/websocket/impl/ping.ipp>
 #include <beast/websocket/impl/read.ipp>
+#include <beast/websocket/impl/relay.ipp>
 #include <beast/websocket/impl/stream.ipp>
 #include <beast/websocket/impl/write.ipp>
 
@@ -0,0 +1,51 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_WEBSOCKET_STREAM_FWD_HPP
+#define BEAST_WEBSOCKET_STREAM_FWD_HPP
+
+#include <beast/config.hpp>
+
+namespace beast {
+namespace websocket {
+
+/** Role tag for a stream which may act as a client or a server.
+
+    The role is chosen at run time by performing either the
+    client handshake or the server handshake.
+*/
+struct any_role {};
+
+/** Role tag for a stream which only acts as a client.
+
+    Such a stream may perform the client handshake but not
+    accept connections. Every frame it sends is masked.
+*/
+struct client_role {};
+
+/** Role tag for a stream which only acts as a server.
+
+    Such a stream may accept connections but not perform the
+    client handshake. It holds no mask key generator.
+*/
+struct server_role {};
+
+template<class NextLayer, class Role = any_role>
+class stream;
+
+/// A WebSocket stream which only acts as a client
+template<class NextLayer>
+using client_stream = stream<NextLayer, client_role>;
+
+/// A WebSocket stream which only acts as a server
+template<class NextLayer>
+using server_stream = stream<NextLayer, server_role>;
+
+} // websocket
+} // beast
+
+#endif
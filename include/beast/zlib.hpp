@@ -10,9 +10,12 @@
 
 #include <beast/config.hpp>
 
+#include <beast/zlib/deflate_parallel.hpp>
 #include <beast/zlib/deflate_stream.hpp>
 #include <beast/zlib/error.hpp>
 #include <beast/zlib/inflate_stream.hpp>
+#include <beast/zlib/static_deflate_stream.hpp>
+#include <beast/zlib/static_inflate_stream.hpp>
 #include <beast/zlib/zlib.hpp>
 
 #endif
@@ -0,0 +1,98 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_ZLIB_DEFLATE_PARALLEL_HPP
+#define BEAST_ZLIB_DEFLATE_PARALLEL_HPP
+
+#include <beast/config.hpp>
+#include <beast/zlib/deflate_stream.hpp>
+#include <cstddef>
+
+namespace beast {
+namespace zlib {
+
+/** Framing written around a compressed stream.
+*/
+enum class Format
+{
+    /// A raw deflate stream, as described in rfc1951.
+    raw,
+
+    /// A zlib stream, as described in rfc1950.
+    zlib,
+
+    /// A gzip stream, as described in rfc1952.
+    gzip
+};
+
+/** Compress data using several threads.
+
+    The input is split into blocks which are compressed concurrently,
+    each with its own @ref deflate_stream. Every block after the first
+    is primed with the 32KB of input preceding it as a preset dictionary,
+    so matches may reach across block boundaries and the compression
+    ratio stays close to that of a single stream. Each block except the
+    last ends with a sync flush, which leaves it on a byte boundary, and
+    the last block finishes the stream. The compressed blocks are then
+    appended in order to form one deflate stream, which may be
+    decompressed by any inflater. When a zlib or gzip format is
+    requested, the checksum of each block is computed alongside its
+    compression and the results are combined for the trailer.
+
+    The work is posted to the executor, and the calling thread
+    compresses blocks as well, so the function makes progress even
+    when the executor has no idle thread. The function returns when
+    every block is compressed; handlers which start afterwards find
+    no work and return immediately.
+
+    This is useful for compressing large message bodies, where a single
+    thread would otherwise dominate the time to send the last byte.
+
+    @param ex The executor to post work to. This must provide a member
+    function `post` accepting a nullary handler, as does
+    `boost::asio::io_service`. It should not be a strand, since that
+    serializes the work.
+
+    @param buffer The dynamic buffer to append the output to.
+
+    @param data A pointer to the input.
+
+    @param size The number of bytes of input.
+
+    @param level The compression level, from 0 to 9.
+
+    @param format The framing to write around the deflate stream.
+
+    @param concurrency The maximum number of blocks compressed at
+    once, including on the calling thread. If this is zero,
+    `std::thread::hardware_concurrency` is used.
+
+    @param block_size The number of bytes of input per block. Smaller
+    blocks allow more parallelism at the cost of compression ratio.
+
+    @throws std::invalid_argument if `block_size` is zero.
+
+    @throws system_error if compression fails.
+*/
+template<class Executor, class DynamicBuffer>
+void
+deflate_parallel(
+    Executor& ex,
+    DynamicBuffer& buffer,
+    void const* data,
+    std::size_t size,
+    int level,
+    Format format = Format::raw,
+    std::size_t concurrency = 0,
+    std::size_t block_size = 128 * 1024);
+
+} // zlib
+} // beast
+
+#include <beast/zlib/impl/deflate_parallel.ipp>
+
+#endif
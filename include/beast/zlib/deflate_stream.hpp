@@ -12,11 +12,13 @@
 #include <beast/zlib/error.hpp>
 #include <beast/zlib/zlib.hpp>
 #include <beast/zlib/detail/deflate_stream.hpp>
+#include <beast/core/detail/empty_base_optimization.hpp>
 #include <algorithm>
 #include <cstdlib>
 #include <cstdint>
 #include <cstring>
 #include <memory>
+#include <utility>
 
 namespace beast {
 namespace zlib {
@@ -52,11 +54,70 @@ namespace zlib {
 /** Raw deflate compressor.
 
     This is a port of zlib's "deflate" functionality to C++.
+
+    The window, hash chains and pending output are obtained from
+    the allocator as a single block the first time they are needed.
+
+    @tparam Allocator The allocator to use for the internal buffers.
 */
-class deflate_stream
+template<class Allocator>
+class basic_deflate_stream
     : private detail::deflate_stream
+#if ! BEAST_DOXYGEN
+    , private beast::detail::empty_base_optimization<
+        typename std::allocator_traits<Allocator>::
+            template rebind_alloc<std::uint8_t>>
+#endif
 {
 public:
+#if BEAST_DOXYGEN
+    /// The type of allocator used.
+    using allocator_type = Allocator;
+#else
+    using allocator_type = typename
+        std::allocator_traits<Allocator>::
+            template rebind_alloc<std::uint8_t>;
+#endif
+
+private:
+    using alloc_traits =
+        std::allocator_traits<allocator_type>;
+
+    std::uint8_t* p_ = nullptr;     // storage, if allocated
+    std::size_t n_ = 0;             // size of p_
+
+    void
+    free()
+    {
+        if(p_)
+        {
+            alloc_traits::deallocate(
+                this->member(), p_, n_);
+            p_ = nullptr;
+            n_ = 0;
+        }
+    }
+
+    // Allocate the internal buffers if needed
+    void
+    maybe_alloc()
+    {
+        auto const n = doStorageSize();
+        if(p_ ? n_ == n : doStorageFits())
+            return;
+        free();
+        p_ = alloc_traits::allocate(this->member(), n);
+        n_ = n;
+        doStorage(p_, n_);
+    }
+
+public:
+    /// Destructor
+    ~basic_deflate_stream()
+    {
+        free();
+    }
+
     /** Construct a default deflate stream.
 
         Upon construction, the stream settings will be set
@@ -74,16 +135,121 @@ public:
         after construction, any required internal buffers are
         not dynamically allocated until needed.
     */
-    deflate_stream()
+    basic_deflate_stream()
+    {
+        reset(6, 15, DEF_MEM_LEVEL, Strategy::normal);
+    }
+
+    /** Construct a default deflate stream.
+
+        The stream settings are the same as for the default
+        constructor.
+
+        @param alloc The allocator to use for the internal buffers.
+    */
+    explicit
+    basic_deflate_stream(Allocator const& alloc)
+        : beast::detail::empty_base_optimization<
+            allocator_type>(alloc)
     {
         reset(6, 15, DEF_MEM_LEVEL, Strategy::normal);
     }
 
+    /** Move constructor.
+
+        The new stream takes over the settings, the internal
+        buffers and any compression in progress. The moved-from
+        object keeps its settings and behaves as if `clear`
+        had been called.
+    */
+    basic_deflate_stream(basic_deflate_stream&& other)
+        : detail::deflate_stream(other)
+        , beast::detail::empty_base_optimization<
+            allocator_type>(std::move(other.member()))
+        , p_(other.p_)
+        , n_(other.n_)
+    {
+        doMoved();
+        other.p_ = nullptr;
+        other.n_ = 0;
+        other.doStorage(nullptr, 0);
+    }
+
+    /** Move assignment.
+
+        Any internal buffers owned by this object are freed,
+        then the settings, buffers and compression in progress
+        are taken over from `other` as with move construction.
+        The allocator is move assigned along with the buffers.
+    */
+    basic_deflate_stream&
+    operator=(basic_deflate_stream&& other)
+    {
+        if(this == &other)
+            return *this;
+        free();
+        detail::deflate_stream::operator=(other);
+        doMoved();
+        this->member() = std::move(other.member());
+        p_ = other.p_;
+        n_ = other.n_;
+        other.p_ = nullptr;
+        other.n_ = 0;
+        other.doStorage(nullptr, 0);
+        return *this;
+    }
+
+    /// Constructor (deleted)
+    basic_deflate_stream(basic_deflate_stream const&) = delete;
+
+    /// Assignment (deleted)
+    basic_deflate_stream& operator=(basic_deflate_stream const&) = delete;
+
+    /// Returns a copy of the allocator used.
+    allocator_type
+    get_allocator() const
+    {
+        return this->member();
+    }
+
+protected:
+    /** Constructor
+
+        The stream uses the caller provided storage for the window,
+        hash chains and pending output, instead of allocating. The
+        storage must be at least @ref storage_size bytes, aligned for
+        `std::uint16_t`, and remain valid for the life of the stream.
+    */
+    basic_deflate_stream(
+        std::uint8_t* p,
+        std::size_t n,
+        int windowBits,
+        int memLevel)
+    {
+        reset(6, windowBits, memLevel, Strategy::normal);
+        doStorage(p, n);
+    }
+
+    /// Returns the number of bytes of storage needed for the settings
+    static
+    constexpr
+    std::size_t
+    storage_size(int windowBits, int memLevel)
+    {
+        return detail::deflate_stream::storage_size(windowBits, memLevel);
+    }
+
+public:
+
     /** Reset the stream and compression settings.
 
         This function initializes the stream to the specified
         compression settings.
 
+        `Strategy::quick` trades some compression ratio for speed
+        by probing the hash table once per input position and
+        emitting static Huffman blocks.
+
         Although the stream is ready to be used immediately
         after a reset, any required internal buffers are not
         dynamically allocated until needed.
@@ -129,6 +295,11 @@ public:
     clear()
     {
         doClear();
+        if(p_)
+        {
+            free();
+            doStorage(nullptr, 0);
+        }
     }
 
     /** Returns the upper limit on the size of a compressed block.
@@ -283,6 +454,7 @@ public:
         Flush flush,
         error_code& ec)
     {
+        maybe_alloc();
         doWrite(zs, flush, ec);
     }
 
@@ -312,9 +484,36 @@ public:
         Strategy strategy,
         error_code& ec)
     {
+        // Only pending input needs the buffers
+        if(zs.total_in != 0)
+            maybe_alloc();
         doParams(zs, level, strategy, ec);
     }
 
+    /** Initialize the compression dictionary.
+
+        This function primes the compressor with a preset dictionary,
+        without producing any compressed output. Matches in the data
+        which follows may refer back into the dictionary. Only the last
+        `1 << windowBits` bytes of the dictionary are used.
+
+        It must be called after construction or @ref reset and before
+        the first call to @ref write. The decompressor must hold the
+        same bytes in its window, for example because the dictionary
+        is the data decompressed just before this stream's output.
+
+        @return `error::stream_error` if input was already provided.
+    */
+    void
+    dictionary(void const* dict, std::size_t size, error_code& ec)
+    {
+        // Only the tail can matter
+        auto const n = (std::min)(size, std::size_t{65536});
+        maybe_alloc();
+        doDictionary(static_cast<Byte const*>(dict) +
+            (size - n), static_cast<uInt>(n), ec);
+    }
+
     /** Return bits pending in the output.
 
         This function returns the number of bytes and bits of output
@@ -351,10 +550,14 @@ public:
     void
     prime(int bits, int value, error_code& ec)
     {
-        return doPrime(bits, value, ec);
+        maybe_alloc();
+        doPrime(bits, value, ec);
     }
 };
 
+/// A raw deflate compressor using the default allocator.
+using deflate_stream = basic_deflate_stream<std::allocator<std::uint8_t>>;
+
 /** Returns the upper limit on the size of a compressed block.
 
     This function makes a conservative estimate of the maximum number
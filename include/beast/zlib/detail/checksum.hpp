@@ -0,0 +1,205 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// This is a derivative work based on Zlib, copyright below:
+/*
+    Copyright (C) 1995-2013 Jean-loup Gailly and Mark Adler
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+
+    Jean-loup Gailly        Mark Adler
+    jloup@gzip.org          madler@alumni.caltech.edu
+
+    The data format used by the zlib library is described by RFCs (Request for
+    Comments) 1950 to 1952 in the files http://tools.ietf.org/html/rfc1950
+    (zlib format), rfc1951 (deflate format) and rfc1952 (gzip format).
+*/
+
+#ifndef BEAST_ZLIB_DETAIL_CHECKSUM_HPP
+#define BEAST_ZLIB_DETAIL_CHECKSUM_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace beast {
+namespace zlib {
+namespace detail {
+
+// Update an Adler-32 checksum, initial value 1
+template<class = void>
+std::uint32_t
+adler32(std::uint32_t adler,
+    std::uint8_t const* p, std::size_t n)
+{
+    std::uint32_t const base = 65521;   // largest prime below 65536
+    std::size_t const nmax = 5552;      // keeps s2 within 32 bits
+    std::uint32_t s1 = adler & 0xffff;
+    std::uint32_t s2 = (adler >> 16) & 0xffff;
+    while(n > 0)
+    {
+        auto k = n < nmax ? n : nmax;
+        n -= k;
+        while(k--)
+        {
+            s1 += *p++;
+            s2 += s1;
+        }
+        s1 %= base;
+        s2 %= base;
+    }
+    return s1 | (s2 << 16);
+}
+
+// Return the Adler-32 of A followed by B,
+// given adler(A), adler(B), and the length of B
+template<class = void>
+std::uint32_t
+adler32_combine(std::uint32_t adler1,
+    std::uint32_t adler2, std::size_t len2)
+{
+    std::uint32_t const base = 65521;
+    std::uint32_t const rem =
+        static_cast<std::uint32_t>(len2 % base);
+    std::uint32_t sum1 = adler1 & 0xffff;
+    std::uint32_t sum2 = (rem * sum1) % base;
+    sum1 += (adler2 & 0xffff) + base - 1;
+    sum2 += ((adler1 >> 16) & 0xffff) +
+        ((adler2 >> 16) & 0xffff) + base - rem;
+    if(sum1 >= base)
+        sum1 -= base;
+    if(sum1 >= base)
+        sum1 -= base;
+    if(sum2 >= (base << 1))
+        sum2 -= (base << 1);
+    if(sum2 >= base)
+        sum2 -= base;
+    return sum1 | (sum2 << 16);
+}
+
+struct crc32_table
+{
+    std::uint32_t v[256];
+
+    crc32_table()
+    {
+        for(std::uint32_t n = 0; n < 256; ++n)
+        {
+            auto c = n;
+            for(int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            v[n] = c;
+        }
+    }
+};
+
+template<class = void>
+crc32_table const&
+get_crc32_table()
+{
+    static crc32_table const tab;
+    return tab;
+}
+
+// Update a CRC-32 checksum, initial value 0
+template<class = void>
+std::uint32_t
+crc32(std::uint32_t crc,
+    std::uint8_t const* p, std::size_t n)
+{
+    auto const& tab = get_crc32_table().v;
+    crc = ~crc;
+    while(n--)
+        crc = tab[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline
+std::uint32_t
+gf2_matrix_times(std::uint32_t const* mat, std::uint32_t vec)
+{
+    std::uint32_t sum = 0;
+    while(vec)
+    {
+        if(vec & 1)
+            sum ^= *mat;
+        vec >>= 1;
+        ++mat;
+    }
+    return sum;
+}
+
+inline
+void
+gf2_matrix_square(std::uint32_t* square, std::uint32_t const* mat)
+{
+    for(int n = 0; n < 32; ++n)
+        square[n] = gf2_matrix_times(mat, mat[n]);
+}
+
+// Return the CRC-32 of A followed by B,
+// given crc(A), crc(B), and the length of B
+template<class = void>
+std::uint32_t
+crc32_combine(std::uint32_t crc1,
+    std::uint32_t crc2, std::size_t len2)
+{
+    if(len2 == 0)
+        return crc1;
+    std::uint32_t even[32];     // even-power-of-two zeros operator
+    std::uint32_t odd[32];      // odd-power-of-two zeros operator
+
+    // put operator for one zero bit in odd
+    odd[0] = 0xedb88320;
+    std::uint32_t row = 1;
+    for(int n = 1; n < 32; ++n)
+    {
+        odd[n] = row;
+        row <<= 1;
+    }
+    // put operator for two zero bits in even
+    gf2_matrix_square(even, odd);
+    // put operator for four zero bits in odd
+    gf2_matrix_square(odd, even);
+
+    // apply len2 zeros to crc1, the first square
+    // puts the operator for one zero byte in even
+    for(;;)
+    {
+        gf2_matrix_square(even, odd);
+        if(len2 & 1)
+            crc1 = gf2_matrix_times(even, crc1);
+        len2 >>= 1;
+        if(len2 == 0)
+            break;
+        gf2_matrix_square(odd, even);
+        if(len2 & 1)
+            crc1 = gf2_matrix_times(odd, crc1);
+        len2 >>= 1;
+        if(len2 == 0)
+            break;
+    }
+    return crc1 ^ crc2;
+}
+
+} // detail
+} // zlib
+} // beast
+
+#endif
@@ -40,7 +40,7 @@
 #include <beast/core/detail/type_traits.hpp>
 #include <boost/assert.hpp>
 #include <boost/config.hpp>
-#include <boost/make_unique.hpp>
+#include <boost/core/ignore_unused.hpp>
 #include <boost/optional.hpp>
 #include <boost/throw_exception.hpp>
 #include <cstdint>
@@ -295,11 +295,11 @@ protected:
 
     //--------------------------------------------------------------------------
 
-    lut_type const& lut_;
+    lut_type const* lut_;
 
     bool inited_ = false;
-    std::size_t buf_size_;
-    std::unique_ptr<std::uint8_t[]> buf_;
+    std::size_t buf_size_ = 0;      // size of storage at buf_
+    std::uint8_t* buf_ = nullptr;   // storage, owned by the caller
 
     int status_;                    // as the name implies
     Byte* pending_buf_;             // output still pending
@@ -469,10 +469,16 @@ protected:
     */
     std::uint32_t high_water_;
 
+    /*  State of the static block emitted incrementally by f_quick:
+        0 if no block is open, 1 if a block is open, or 2 if the
+        open block is the last block.
+    */
+    int block_open_;
+
     //--------------------------------------------------------------------------
 
     deflate_stream()
-        : lut_(get_lut())
+        : lut_(&get_lut())
     {
     }
 
@@ -533,8 +539,8 @@ protected:
     d_code(unsigned dist)
     {
         if(dist < 256)
-            return lut_.dist_code[dist];
-        return lut_.dist_code[256+(dist>>7)];
+            return lut_->dist_code[dist];
+        return lut_->dist_code[256+(dist>>7)];
     }
 
     /*  Update a hash value with the given input byte
@@ -560,6 +566,21 @@ protected:
             (unsigned)(hash_size_-1)*sizeof(*head_));
     }
 
+    /*  Insert string str in the dictionary and set hash_head to the
+        previous head of the hash chain, computing the hash key from
+        the first minMatch bytes of str instead of the running key.
+        This allows f_quick to skip the strings inside a match.
+    */
+    void
+    quick_insert_string(IPos& hash_head)
+    {
+        uInt h = window_[strstart_];
+        update_hash(h, window_[strstart_ + 1]);
+        update_hash(h, window_[strstart_ + 2]);
+        hash_head = prev_[strstart_ & w_mask_] = head_[h];
+        head_[h] = (std::uint16_t)strstart_;
+    }
+
     /*  Compares two subtrees, using the tree depth as tie breaker
         when the subtrees have equal frequency. This minimizes the
         worst case length.
@@ -648,6 +669,57 @@ protected:
             init();
     }
 
+    /*  Returns the number of bytes of storage needed for the
+        window, hash chains, and pending buffer at the given
+        settings. A windowBits of 8 uses a 512 byte window.
+    */
+    static
+    constexpr
+    std::size_t
+    storage_size(int windowBits, int memLevel)
+    {
+        return
+            (std::size_t{1} << (windowBits < 9 ? 9 : windowBits)) *
+                (2 * sizeof(Byte) + sizeof(std::uint16_t)) +
+            (std::size_t{1} << (memLevel + 7)) * sizeof(std::uint16_t) +
+            (std::size_t{1} << (memLevel + 6)) * (sizeof(std::uint16_t) + 2);
+    }
+
+    // Storage needed at the current settings
+    std::size_t
+    doStorageSize() const
+    {
+        return storage_size(w_bits_, hash_bits_ - 7);
+    }
+
+    // Returns `true` if the storage fits the current settings
+    bool
+    doStorageFits() const
+    {
+        return buf_ && buf_size_ >= doStorageSize();
+    }
+
+    // Provide storage, which must outlive its use
+    void
+    doStorage(std::uint8_t* p, std::size_t n)
+    {
+        buf_ = p;
+        buf_size_ = n;
+        inited_ = false;
+    }
+
+    /*  Called after the state was copied from another stream
+        whose storage was handed over, to point the tree
+        descriptors at the trees in this object.
+    */
+    void
+    doMoved()
+    {
+        l_desc_.dyn_tree = dyn_ltree_;
+        d_desc_.dyn_tree = dyn_dtree_;
+        bl_desc_.dyn_tree = bl_tree_;
+    }
+
     template<class Unsigned>
     static
     Unsigned
@@ -706,6 +778,7 @@ protected:
     template<class = void> uInt longest_match       (IPos cur_match);
 
     template<class = void> block_state f_stored     (z_params& zs, Flush flush);
+    template<class = void> block_state f_quick      (z_params& zs, Flush flush);
     template<class = void> block_state f_fast       (z_params& zs, Flush flush);
     template<class = void> block_state f_slow       (z_params& zs, Flush flush);
     template<class = void> block_state f_rle        (z_params& zs, Flush flush);
@@ -717,6 +790,12 @@ protected:
         return f_stored(zs, flush);
     }
 
+    block_state
+    deflate_quick(z_params& zs, Flush flush)
+    {
+        return f_quick(zs, flush);
+    }
+
     block_state
     deflate_fast(z_params& zs, Flush flush)
     {
@@ -896,8 +975,11 @@ doReset(
     if(level == Z_DEFAULT_COMPRESSION)
         level = 6;
 
-    // VFALCO What do we do about this?
-    // until 256-byte window bug fixed
+    /*  A 256 byte window is run as a 512 byte window.
+        Since max_dist() is then 512-kMinLookahead=250, no
+        emitted distance exceeds 256 and the output may be
+        decoded by an inflater with windowBits of 8.
+    */
     if(windowBits == 8)
         windowBits = 9;
 
@@ -939,7 +1021,6 @@ deflate_stream::
 doClear()
 {
     inited_ = false;
-    buf_.reset();
 }
 
 template<class>
@@ -961,6 +1042,10 @@ doUpperBound(std::size_t sourceLen) const
     if(w_bits_ != 15 || hash_bits_ != 8 + 7)
         return complen + wraplen;
 
+    /* static trees never fall back to stored blocks */
+    if(strategy_ == Strategy::quick && level_ != 0)
+        return complen + wraplen;
+
     /* default settings: return tight bound for that case */
     return sourceLen + (sourceLen >> 12) + (sourceLen >> 14) +
            (sourceLen >> 25) + 13 - 6 + wraplen;
@@ -1096,6 +1181,13 @@ doWrite(z_params& zs, boost::optional<Flush> flush, error_code& ec)
         case Strategy::rle:
             bstate = deflate_rle(zs, flush.get());
             break;
+        case Strategy::quick:
+            if(level_ != 0)
+            {
+                bstate = deflate_quick(zs, flush.get());
+                break;
+            }
+            // fall through
         default:
         {
             bstate = (this->*(get_config(level_).func))(zs, flush.get());
@@ -1168,14 +1260,14 @@ void
 deflate_stream::
 doDictionary(Byte const* dict, uInt dictLength, error_code& ec)
 {
+    maybe_init();
+
     if(lookahead_)
     {
         ec = error::stream_error;
         return;
     }
 
-    maybe_init();
-
     /* if dict would fill window, just replace the history */
     if(dictLength >= w_size_)
     {
@@ -1284,23 +1376,19 @@ init()
     auto const noverlay = lit_bufsize_ * (sizeof(std::uint16_t)+2);
     auto const needed   = nwindow + nprev + nhead + noverlay;
 
-    if(! buf_ || buf_size_ != needed)
-    {
-        buf_ = boost::make_unique_noinit<
-            std::uint8_t[]>(needed);
-        buf_size_ = needed;
-    }
+    BOOST_ASSERT(buf_ && buf_size_ >= needed);
+    boost::ignore_unused(needed);
 
-    window_ = reinterpret_cast<Byte*>(buf_.get());
-    prev_   = reinterpret_cast<std::uint16_t*>(buf_.get() + nwindow);
-    head_   = reinterpret_cast<std::uint16_t*>(buf_.get() + nwindow + nprev);
+    window_ = reinterpret_cast<Byte*>(buf_);
+    prev_   = reinterpret_cast<std::uint16_t*>(buf_ + nwindow);
+    head_   = reinterpret_cast<std::uint16_t*>(buf_ + nwindow + nprev);
 
     /*  We overlay pending_buf_ and d_buf_ + l_buf_. This works
         since the average output size for(length, distance)
         codes is <= 24 bits.
     */
     auto overlay = reinterpret_cast<std::uint16_t*>(
-        buf_.get() + nwindow + nprev + nhead);
+        buf_ + nwindow + nprev + nhead);
 
     // nothing written to window_ yet
     high_water_ = 0;
@@ -1792,7 +1880,7 @@ build_bl_tree()
      */
     for(max_blindex = blCodes-1; max_blindex >= 3; max_blindex--)
     {
-        if(bl_tree_[lut_.bl_order[max_blindex]].dl != 0)
+        if(bl_tree_[lut_->bl_order[max_blindex]].dl != 0)
             break;
     }
     // Update opt_len to include the bit length tree and counts
@@ -1821,7 +1909,7 @@ send_all_trees(
     send_bits(dcodes-1,   5);
     send_bits(blcodes-4,  4); // not -3 as stated in appnote.txt
     for(rank = 0; rank < blcodes; rank++)
-        send_bits(bl_tree_[lut_.bl_order[rank]].dl, 3);
+        send_bits(bl_tree_[lut_->bl_order[rank]].dl, 3);
     send_tree((ct_data *)dyn_ltree_, lcodes-1); // literal tree
     send_tree((ct_data *)dyn_dtree_, dcodes-1); // distance tree
 }
@@ -1854,12 +1942,12 @@ compress_block(
             else
             {
                 /* Here, lc is the match length - minMatch */
-                code = lut_.length_code[lc];
+                code = lut_->length_code[lc];
                 send_code(code+literals+1, ltree); /* send the length code */
-                extra = lut_.extra_lbits[code];
+                extra = lut_->extra_lbits[code];
                 if(extra != 0)
                 {
-                    lc -= lut_.base_length[code];
+                    lc -= lut_->base_length[code];
                     send_bits(lc, extra);       /* send the extra length bits */
                 }
                 dist--; /* dist is now the match distance - 1 */
@@ -1867,10 +1955,10 @@ compress_block(
                 BOOST_ASSERT(code < dCodes);
 
                 send_code(code, dtree);       /* send the distance code */
-                extra = lut_.extra_dbits[code];
+                extra = lut_->extra_dbits[code];
                 if(extra != 0)
                 {
-                    dist -= lut_.base_dist[code];
+                    dist -= lut_->base_dist[code];
                     send_bits(dist, extra);   /* send the extra distance bits */
                 }
             } /* literal or match pair ? */
@@ -1996,16 +2084,17 @@ deflate_stream::
 tr_init()
 {
     l_desc_.dyn_tree = dyn_ltree_;
-    l_desc_.stat_desc = &lut_.l_desc;
+    l_desc_.stat_desc = &lut_->l_desc;
 
     d_desc_.dyn_tree = dyn_dtree_;
-    d_desc_.stat_desc = &lut_.d_desc;
+    d_desc_.stat_desc = &lut_->d_desc;
 
     bl_desc_.dyn_tree = bl_tree_;
-    bl_desc_.stat_desc = &lut_.bl_desc;
+    bl_desc_.stat_desc = &lut_->bl_desc;
 
     bi_buf_ = 0;
     bi_valid_ = 0;
+    block_open_ = 0;
 
     // Initialize the first block of the first file:
     init_block();
@@ -2020,7 +2109,7 @@ deflate_stream::
 tr_align()
 {
     send_bits(STATIC_TREES<<1, 3);
-    send_code(END_BLOCK, lut_.ltree);
+    send_code(END_BLOCK, lut_->ltree);
     bi_flush();
 }
 
@@ -2057,7 +2146,7 @@ tr_tally_dist(std::uint16_t dist, std::uint8_t len, bool& flush)
     d_buf_[last_lit_] = dist;
     l_buf_[last_lit_++] = len;
     dist--;
-    dyn_ltree_[lut_.length_code[len]+literals+1].fc++;
+    dyn_ltree_[lut_->length_code[len]+literals+1].fc++;
     dyn_dtree_[d_code(dist)].fc++;
     flush = (last_lit_ == lit_bufsize_-1);
 }
@@ -2156,7 +2245,7 @@ tr_flush_block(
     {
 #endif
         send_bits((STATIC_TREES<<1)+last, 3);
-        compress_block(lut_.ltree, lut_.dtree);
+        compress_block(lut_->ltree, lut_->dtree);
     }
     else
     {
@@ -2704,6 +2793,217 @@ f_fast(z_params& zs, Flush flush) ->
     return block_done;
 }
 
+/*  Compress as much as possible from the input stream, return the current
+    block state.
+    This function probes the hash table once per position, never inserts
+    the strings inside a match, and does not perform lazy evaluation. The
+    symbols are written directly to pending_buf using the static trees as
+    they are found, instead of being tallied for a dynamic tree. It is used
+    for Strategy::quick.
+*/
+template<class>
+inline
+auto
+deflate_stream::
+f_quick(z_params& zs, Flush flush) ->
+    block_state
+{
+    // Largest output of one symbol, plus the end of block code
+    std::uint32_t constexpr margin = 16;
+
+    bool const last = flush == Flush::finish;
+
+    /*  The codes are accumulated in a 64-bit local and stored to
+        pending_buf 32 bits at a time, which is much cheaper than going
+        through send_bits for every literal. The accumulator must be
+        folded back into bi_buf_ before anything else uses the bits.
+    */
+    std::uint64_t bb = bi_buf_;
+    int bv = bi_valid_;
+
+    auto const send =
+        [&](unsigned value, int length)
+        {
+            bb |= std::uint64_t{value} << bv;
+            bv += length;
+            if(bv >= 32)
+            {
+                Byte* const p = pending_buf_ + pending_;
+                p[0] = static_cast<Byte>(bb);
+                p[1] = static_cast<Byte>(bb >> 8);
+                p[2] = static_cast<Byte>(bb >> 16);
+                p[3] = static_cast<Byte>(bb >> 24);
+                pending_ += 4;
+                bb >>= 32;
+                bv -= 32;
+            }
+        };
+
+    auto const save =
+        [&]
+        {
+            while(bv >= 16)
+            {
+                put_short(static_cast<std::uint16_t>(bb));
+                bb >>= 16;
+                bv -= 16;
+            }
+            bi_buf_ = static_cast<std::uint16_t>(bb);
+            bi_valid_ = bv;
+        };
+
+    auto const flush_out =
+        [&]
+        {
+            save();
+            flush_pending(zs);
+            bb = bi_buf_;
+            bv = bi_valid_;
+            return zs.avail_out != 0;
+        };
+
+    auto const start_block =
+        [&]
+        {
+            send((STATIC_TREES<<1) + (last ? 1 : 0), 3);
+            block_open_ = last ? 2 : 1;
+        };
+
+    if(last && block_open_ != 2)
+    {
+        // End the current block and start the last one
+        if(block_open_ != 0)
+        {
+            send(lut_->ltree[END_BLOCK].fc, lut_->ltree[END_BLOCK].dl);
+            block_open_ = 0;
+            block_start_ = strstart_;
+            if(! flush_out())
+                return need_more;
+        }
+        start_block();
+    }
+    else if(block_open_ == 0 && lookahead_ > 0)
+    {
+        start_block();
+    }
+
+    for(;;)
+    {
+        if(pending_ + margin >= pending_buf_size_)
+        {
+            if(! flush_out())
+                return need_more;
+        }
+
+        /* Make sure that we always have enough lookahead, except
+         * at the end of the input file. We need maxMatch bytes
+         * for the next match, plus minMatch bytes to insert the
+         * string following the next match.
+         */
+        if(lookahead_ < kMinLookahead)
+        {
+            fill_window(zs);
+            if(lookahead_ < kMinLookahead && flush == Flush::none)
+            {
+                save();
+                return need_more;
+            }
+            if(lookahead_ == 0)
+                break; /* flush the current block */
+            // Don't start a block until there is data for it
+            if(block_open_ == 0)
+                start_block();
+        }
+
+        if(lookahead_ >= minMatch)
+        {
+            IPos hash_head;
+            quick_insert_string(hash_head);
+            if(hash_head != 0 && strstart_ - hash_head <= max_dist())
+            {
+                Byte const* scan = window_ + strstart_;
+                Byte const* match = window_ + hash_head;
+                Byte const* const strend = scan + maxMatch;
+                if(scan[0] == match[0] && scan[1] == match[1] &&
+                    scan[2] == match[2])
+                {
+                    // Compare eight bytes at a time, then the rest
+                    scan += minMatch;
+                    match += minMatch;
+                    while(scan + 8 <= strend)
+                    {
+                        std::uint64_t a;
+                        std::uint64_t b;
+                        std::memcpy(&a, scan, sizeof(a));
+                        std::memcpy(&b, match, sizeof(b));
+                        if(a != b)
+                            break;
+                        scan += 8;
+                        match += 8;
+                    }
+                    while(scan < strend && *scan == *match)
+                    {
+                        ++scan;
+                        ++match;
+                    }
+                    uInt len = static_cast<uInt>(
+                        scan - (window_ + strstart_));
+                    if(len > lookahead_)
+                        len = lookahead_;
+                    if(len >= minMatch)
+                    {
+                        unsigned dist = strstart_ - hash_head;
+                        unsigned lc = len - minMatch;
+
+                        // Send the length code and extra length bits
+                        unsigned code = lut_->length_code[lc];
+                        ct_data const& lt = lut_->ltree[code+literals+1];
+                        send(lt.fc, lt.dl);
+                        int extra = lut_->extra_lbits[code];
+                        if(extra != 0)
+                            send(lc - lut_->base_length[code], extra);
+
+                        // Send the distance code and extra distance bits
+                        dist--;
+                        code = d_code(dist);
+                        BOOST_ASSERT(code < dCodes);
+                        send(lut_->dtree[code].fc, lut_->dtree[code].dl);
+                        extra = lut_->extra_dbits[code];
+                        if(extra != 0)
+                            send(dist - lut_->base_dist[code], extra);
+
+                        lookahead_ -= len;
+                        strstart_ += len;
+                        continue;
+                    }
+                }
+            }
+        }
+
+        /* No match, output a literal byte */
+        ct_data const& lt = lut_->ltree[window_[strstart_]];
+        send(lt.fc, lt.dl);
+        lookahead_--;
+        strstart_++;
+    }
+    insert_ = strstart_ < minMatch-1 ? strstart_ : minMatch-1;
+    if(block_open_ != 0)
+    {
+        send(lut_->ltree[END_BLOCK].fc, lut_->ltree[END_BLOCK].dl);
+        block_open_ = 0;
+        block_start_ = strstart_;
+        save();
+        if(last)
+            bi_windup();
+        flush_pending(zs);
+        if(zs.avail_out == 0)
+            return last ? finish_started : need_more;
+        return last ? finish_done : block_done;
+    }
+    save();
+    return last ? finish_done : block_done;
+}
+
 /*  Same as above, but achieves better compression. We use a lazy
     evaluation for matches: a match is finally adopted only if there is
     no better match at the next window position.
@@ -44,8 +44,10 @@
 #include <boost/throw_exception.hpp>
 #include <algorithm>
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <functional>
 #include <stdexcept>
 
 namespace beast {
@@ -70,6 +72,59 @@ protected:
         doReset(w_.bits());
     }
 
+    // Storage needed for the window
+    std::size_t
+    doStorageSize() const
+    {
+        return w_.capacity();
+    }
+
+    // Provide window storage, which must outlive its use
+    void
+    doStorage(std::uint8_t* p, std::size_t n)
+    {
+        w_.storage(p, n);
+    }
+
+    /*  Returns `true` if the last write produced output which
+        must be saved in the window, but there was no storage.
+        The caller provides storage and then calls doWindow
+        before the output buffer is modified.
+    */
+    bool
+    doWindowPending() const
+    {
+        return wn_ != 0;
+    }
+
+    void
+    doWindow()
+    {
+        w_.write(wp_, wn_);
+        wn_ = 0;
+    }
+
+    /*  Called after the state was copied from `other`, whose
+        window storage was handed over, to point the code
+        tables at the tables in this object.
+    */
+    void
+    doMoved(inflate_stream const& other)
+    {
+        auto const rebase =
+            [&](code const* p) -> code const*
+            {
+                std::less<code const*> lt;
+                if( lt(p, other.codes_) ||
+                    ! lt(p, other.codes_ + kEnough + 1))
+                    return p;
+                return codes_ + (p - other.codes_);
+            };
+        next_ = codes_ + (next_ - other.codes_);
+        lencode_ = rebase(lencode_);
+        distcode_ = rebase(distcode_);
+    }
+
 private:
     enum Mode
     {
@@ -199,6 +254,8 @@ private:
 
     // sliding window
     window w_;
+    std::uint8_t const* wp_;        // output to save in the window
+    std::size_t wn_ = 0;            // size of output to save
 
     // for string and stored block copying
     unsigned length_;               // literal or length of data to copy
@@ -237,6 +294,7 @@ doReset(int windowBits)
         BOOST_THROW_EXCEPTION(std::domain_error{
             "windowBits out of range"});
     w_.reset(windowBits);
+    wn_ = 0;
 
     bi_.flush();
     mode_ = HEAD;
@@ -253,6 +311,7 @@ void
 inflate_stream::
 doClear()
 {
+    doReset();
 }
 
 template<class>
@@ -284,7 +343,18 @@ doWrite(z_params& zs, Flush flush, error_code& ec)
             // VFALCO TODO Don't allocate update the window unless necessary
             if(/*wsize_ ||*/ (r.out.used() && mode_ < BAD &&
                     (mode_ < CHECK || flush != Flush::finish)))
-                w_.write(r.out.first, r.out.used());
+            {
+                if(w_.ready())
+                {
+                    w_.write(r.out.first, r.out.used());
+                }
+                else
+                {
+                    // Caller provides storage, see doWindow
+                    wp_ = r.out.first;
+                    wn_ = r.out.used();
+                }
+            }
 
             zs.next_in = r.in.next;
             zs.avail_in = r.in.avail();
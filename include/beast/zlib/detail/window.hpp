@@ -36,10 +36,9 @@
 #define BEAST_ZLIB_DETAIL_WINDOW_HPP
 
 #include <boost/assert.hpp>
-#include <boost/make_unique.hpp>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
-#include <memory>
 
 namespace beast {
 namespace zlib {
@@ -47,7 +46,8 @@ namespace detail {
 
 class window
 {
-    std::unique_ptr<std::uint8_t[]> p_;
+    std::uint8_t* p_ = nullptr;     // storage, owned by the caller
+    std::size_t n_ = 0;             // size of storage at p_
     std::uint16_t i_ = 0;
     std::uint16_t size_ = 0;
     std::uint16_t capacity_ = 0;
@@ -72,9 +72,19 @@ public:
         return size_;
     }
 
+    // Returns `true` if there is storage for the capacity
+    bool
+    ready() const
+    {
+        return p_ && n_ >= capacity_;
+    }
+
     void
     reset(int bits);
 
+    void
+    storage(std::uint8_t* p, std::size_t n);
+
     void
     read(std::uint8_t* out, std::size_t pos, std::size_t n);
 
@@ -88,12 +98,19 @@ void
 window::
 reset(int bits)
 {
-    if(bits_ != bits)
-    {
-        p_.reset();
-        bits_ = static_cast<std::uint8_t>(bits);
-        capacity_ = 1U << bits_;
-    }
+    bits_ = static_cast<std::uint8_t>(bits);
+    capacity_ = static_cast<std::uint16_t>(1U << bits_);
+    i_ = 0;
+    size_ = 0;
+}
+
+inline
+void
+window::
+storage(std::uint8_t* p, std::size_t n)
+{
+    p_ = p;
+    n_ = n;
     i_ = 0;
     size_ = 0;
 }
@@ -126,9 +143,7 @@ void
 window::
 write(std::uint8_t const* in, std::size_t n)
 {
-    if(! p_)
-        p_ = boost::make_unique<
-            std::uint8_t[]>(capacity_);
+    BOOST_ASSERT(ready());
     if(n >= capacity_)
     {
         i_ = 0;
@@ -0,0 +1,289 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_ZLIB_IMPL_DEFLATE_PARALLEL_IPP
+#define BEAST_ZLIB_IMPL_DEFLATE_PARALLEL_IPP
+
+#include <beast/core/consuming_buffers.hpp>
+#include <beast/core/error.hpp>
+#include <beast/zlib/detail/checksum.hpp>
+#include <beast/zlib/error.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/make_unique.hpp>
+#include <boost/throw_exception.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace beast {
+namespace zlib {
+
+namespace detail {
+
+struct parallel_block
+{
+    std::unique_ptr<std::uint8_t[]> buf;
+    std::size_t size = 0;
+    std::uint32_t check = 0;
+};
+
+// Compress one block, primed with the input preceding it
+template<class = void>
+void
+deflate_block(
+    zlib::deflate_stream& ds,
+    parallel_block& b,
+    std::uint8_t const* data,
+    std::size_t pos,
+    std::size_t len,
+    int level,
+    Format format,
+    bool last)
+{
+    error_code ec;
+    ds.reset(level, 15, 8, Strategy::normal);
+    if(pos > 0)
+    {
+        auto const n = (std::min)(pos, std::size_t{32768});
+        ds.dictionary(data + pos - n, n, ec);
+        if(ec)
+            BOOST_THROW_EXCEPTION(system_error{ec});
+    }
+    // A sync flush adds at most an empty stored block
+    auto const cap = ds.upper_bound(len) + 16;
+    b.buf = boost::make_unique_noinit<std::uint8_t[]>(cap);
+    z_params zs;
+    zs.next_in = data + pos;
+    zs.avail_in = len;
+    zs.next_out = b.buf.get();
+    zs.avail_out = cap;
+    ds.write(zs, last ? Flush::finish : Flush::sync, ec);
+    if(last && ec == error::end_of_stream)
+        ec.assign(0, ec.category());
+    if(ec)
+        BOOST_THROW_EXCEPTION(system_error{ec});
+    BOOST_ASSERT(zs.avail_in == 0);
+    b.size = zs.total_out;
+    switch(format)
+    {
+    case Format::raw:
+        break;
+    case Format::zlib:
+        b.check = adler32(1, data + pos, len);
+        break;
+    case Format::gzip:
+        b.check = crc32(0, data + pos, len);
+        break;
+    }
+}
+
+// State shared by the caller and the handlers posted to the
+// executor. Handlers which run after every block is claimed
+// touch only the counters, so the caller may return first.
+struct parallel_state
+{
+    std::uint8_t const* data;
+    std::size_t size;
+    std::size_t block_size;
+    std::size_t n;
+    int level;
+    Format format;
+    std::vector<parallel_block> v;
+    std::atomic<std::size_t> next{0};
+    std::size_t active = 0;
+    std::exception_ptr ep;
+    std::mutex m;
+    std::condition_variable cv;
+
+    parallel_state(
+        std::uint8_t const* data_,
+        std::size_t size_,
+        std::size_t block_size_,
+        int level_,
+        Format format_)
+        : data(data_)
+        , size(size_)
+        , block_size(block_size_)
+        , n(size_ == 0 ? 1 :
+            (size_ + block_size_ - 1) / block_size_)
+        , level(level_)
+        , format(format_)
+        , v(n)
+    {
+    }
+
+    // Compress blocks until none are left
+    void
+    run()
+    {
+        try
+        {
+            zlib::deflate_stream ds;
+            for(;;)
+            {
+                auto const i = next++;
+                if(i >= n)
+                    break;
+                auto const pos = i * block_size;
+                deflate_block(ds, v[i], data, pos,
+                    (std::min)(block_size, size - pos),
+                        level, format, i + 1 == n);
+            }
+        }
+        catch(...)
+        {
+            std::lock_guard<std::mutex> lock{m};
+            if(! ep)
+                ep = std::current_exception();
+            next = n;
+        }
+    }
+
+    // Called from a handler posted to the executor
+    void
+    work()
+    {
+        {
+            std::lock_guard<std::mutex> lock{m};
+            if(next >= n)
+                return;
+            ++active;
+        }
+        run();
+        std::lock_guard<std::mutex> lock{m};
+        if(--active == 0)
+            cv.notify_all();
+    }
+
+    // Called from the calling thread
+    void
+    wait()
+    {
+        run();
+        std::unique_lock<std::mutex> lock{m};
+        cv.wait(lock, [&]{ return active == 0; });
+        if(ep)
+            std::rethrow_exception(ep);
+    }
+};
+
+} // detail
+
+template<class Executor, class DynamicBuffer>
+void
+deflate_parallel(
+    Executor& ex,
+    DynamicBuffer& buffer,
+    void const* data,
+    std::size_t size,
+    int level,
+    Format format,
+    std::size_t concurrency,
+    std::size_t block_size)
+{
+    using boost::asio::buffer_copy;
+    using boost::asio::const_buffers_1;
+    if(block_size == 0)
+        BOOST_THROW_EXCEPTION(std::invalid_argument{
+            "block_size must be positive"});
+    auto sp = std::make_shared<detail::parallel_state>(
+        static_cast<std::uint8_t const*>(data),
+            size, block_size, level, format);
+    if(concurrency == 0)
+        concurrency = (std::max)(1U,
+            std::thread::hardware_concurrency());
+    concurrency = (std::min)(concurrency, sp->n);
+    for(std::size_t i = 1; i < concurrency; ++i)
+        ex.post([sp]{ sp->work(); });
+    sp->wait();
+
+    std::uint8_t head[10];
+    std::size_t head_size = 0;
+    std::uint8_t tail[8];
+    std::size_t tail_size = 0;
+    switch(format)
+    {
+    case Format::raw:
+        break;
+
+    case Format::zlib:
+    {
+        // rfc1950: deflate with a 32K window, and
+        // a hint of the level in FLEVEL.
+        unsigned const flevel =
+            level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+        unsigned h = (0x78 << 8) | (flevel << 6);
+        h += 31 - h % 31;
+        head[0] = static_cast<std::uint8_t>(h >> 8);
+        head[1] = static_cast<std::uint8_t>(h);
+        head_size = 2;
+        std::uint32_t check = 1;
+        for(std::size_t i = 0; i < sp->n; ++i)
+            check = detail::adler32_combine(check,
+                sp->v[i].check, (std::min)(block_size,
+                    size - i * block_size));
+        tail[0] = static_cast<std::uint8_t>(check >> 24);
+        tail[1] = static_cast<std::uint8_t>(check >> 16);
+        tail[2] = static_cast<std::uint8_t>(check >> 8);
+        tail[3] = static_cast<std::uint8_t>(check);
+        tail_size = 4;
+        break;
+    }
+
+    case Format::gzip:
+    {
+        // rfc1952: no name or time stamp, unknown OS
+        head[0] = 0x1f;
+        head[1] = 0x8b;
+        head[2] = 8;
+        head[3] = 0;
+        head[4] = head[5] = head[6] = head[7] = 0;
+        head[8] = level == 9 ? 2 : level < 2 ? 4 : 0;
+        head[9] = 255;
+        head_size = 10;
+        std::uint32_t check = 0;
+        for(std::size_t i = 0; i < sp->n; ++i)
+            check = detail::crc32_combine(check,
+                sp->v[i].check, (std::min)(block_size,
+                    size - i * block_size));
+        auto const isize = static_cast<std::uint32_t>(size);
+        for(int i = 0; i < 4; ++i)
+        {
+            tail[i] = static_cast<std::uint8_t>(check >> (8 * i));
+            tail[4 + i] = static_cast<std::uint8_t>(isize >> (8 * i));
+        }
+        tail_size = 8;
+        break;
+    }
+    }
+
+    std::size_t total = head_size + tail_size;
+    for(auto const& b : sp->v)
+        total += b.size;
+    consuming_buffers<typename DynamicBuffer::
+        mutable_buffers_type> cb{buffer.prepare(total)};
+    cb.consume(buffer_copy(cb, const_buffers_1{head, head_size}));
+    for(auto const& b : sp->v)
+        cb.consume(buffer_copy(cb,
+            const_buffers_1{b.buf.get(), b.size}));
+    buffer_copy(cb, const_buffers_1{tail, tail_size});
+    buffer.commit(total);
+    // Late handlers keep the state alive, not the output
+    sp->v.clear();
+}
+
+} // zlib
+} // beast
+
+#endif
@@ -10,6 +10,11 @@
 
 #include <beast/config.hpp>
 #include <beast/zlib/detail/inflate_stream.hpp>
+#include <beast/core/detail/empty_base_optimization.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
 
 // This is a derivative work based on Zlib, copyright below:
 /*
@@ -57,16 +62,153 @@ namespace zlib {
     by repeated calls of the compression function. In the latter case, the
     application must provide more input and/or consume the output (providing
     more output space) before each call.
+
+    The sliding window is obtained from the allocator the first time
+    it is needed.
+
+    @tparam Allocator The allocator to use for the sliding window.
 */
-class inflate_stream
+template<class Allocator>
+class basic_inflate_stream
     : private detail::inflate_stream
+#if ! BEAST_DOXYGEN
+    , private beast::detail::empty_base_optimization<
+        typename std::allocator_traits<Allocator>::
+            template rebind_alloc<std::uint8_t>>
+#endif
 {
 public:
+#if BEAST_DOXYGEN
+    /// The type of allocator used.
+    using allocator_type = Allocator;
+#else
+    using allocator_type = typename
+        std::allocator_traits<Allocator>::
+            template rebind_alloc<std::uint8_t>;
+#endif
+
+private:
+    using alloc_traits =
+        std::allocator_traits<allocator_type>;
+
+    std::uint8_t* buf_ = nullptr;   // window storage, if allocated
+    std::size_t size_ = 0;          // size of buf_
+
+    void
+    free()
+    {
+        if(buf_)
+        {
+            alloc_traits::deallocate(
+                this->member(), buf_, size_);
+            buf_ = nullptr;
+            size_ = 0;
+        }
+    }
+
+public:
+    /// Destructor
+    ~basic_inflate_stream()
+    {
+        free();
+    }
+
+    /** Construct a raw deflate decompression stream.
+
+        The window size is set to the default of 15 bits.
+    */
+    basic_inflate_stream() = default;
+
     /** Construct a raw deflate decompression stream.
 
         The window size is set to the default of 15 bits.
+
+        @param alloc The allocator to use for the sliding window.
     */
-    inflate_stream() = default;
+    explicit
+    basic_inflate_stream(Allocator const& alloc)
+        : beast::detail::empty_base_optimization<
+            allocator_type>(alloc)
+    {
+    }
+
+    /** Move constructor.
+
+        The new stream takes over the window, the window storage
+        and any decompression in progress. The moved-from object
+        keeps its window size and behaves as if `clear` had been
+        called.
+    */
+    basic_inflate_stream(basic_inflate_stream&& other)
+        : detail::inflate_stream(other)
+        , beast::detail::empty_base_optimization<
+            allocator_type>(std::move(other.member()))
+        , buf_(other.buf_)
+        , size_(other.size_)
+    {
+        doMoved(other);
+        other.buf_ = nullptr;
+        other.size_ = 0;
+        other.doClear();
+        other.doStorage(nullptr, 0);
+    }
+
+    /** Move assignment.
+
+        The window storage owned by this object is freed, then
+        the window, storage and decompression in progress are
+        taken over from `other` as with move construction. The
+        allocator is move assigned along with the storage.
+    */
+    basic_inflate_stream&
+    operator=(basic_inflate_stream&& other)
+    {
+        if(this == &other)
+            return *this;
+        free();
+        detail::inflate_stream::operator=(other);
+        doMoved(other);
+        this->member() = std::move(other.member());
+        buf_ = other.buf_;
+        size_ = other.size_;
+        other.buf_ = nullptr;
+        other.size_ = 0;
+        other.doClear();
+        other.doStorage(nullptr, 0);
+        return *this;
+    }
+
+    /// Constructor (deleted)
+    basic_inflate_stream(basic_inflate_stream const&) = delete;
+
+    /// Assignment (deleted)
+    basic_inflate_stream& operator=(basic_inflate_stream const&) = delete;
+
+    /// Returns a copy of the allocator used.
+    allocator_type
+    get_allocator() const
+    {
+        return this->member();
+    }
+
+protected:
+    /** Constructor
+
+        The stream uses the caller provided storage for the sliding
+        window instead of allocating. The storage must be at least
+        `1 << windowBits` bytes and remain valid for the life of the
+        stream.
+    */
+    basic_inflate_stream(
+        std::uint8_t* p,
+        std::size_t n,
+        int windowBits)
+    {
+        doReset(windowBits);
+        doStorage(p, n);
+    }
+
+public:
 
     /** Reset the stream.
 
@@ -100,6 +242,11 @@ public:
     clear()
     {
         doClear();
+        if(buf_)
+        {
+            free();
+            doStorage(nullptr, 0);
+        }
     }
 
     /** Decompress input and produce output.
@@ -207,9 +354,21 @@ public:
     write(z_params& zs, Flush flush, error_code& ec)
     {
         doWrite(zs, flush, ec);
+        if(doWindowPending())
+        {
+            auto const n = doStorageSize();
+            free();
+            buf_ = alloc_traits::allocate(this->member(), n);
+            size_ = n;
+            doStorage(buf_, size_);
+            doWindow();
+        }
     }
 };
 
+/// A raw deflate stream decompressor using the default allocator.
+using inflate_stream = basic_inflate_stream<std::allocator<std::uint8_t>>;
+
 } // zlib
 } // beast
 
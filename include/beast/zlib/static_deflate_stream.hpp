@@ -0,0 +1,99 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_ZLIB_STATIC_DEFLATE_STREAM_HPP
+#define BEAST_ZLIB_STATIC_DEFLATE_STREAM_HPP
+
+#include <beast/config.hpp>
+#include <beast/zlib/deflate_stream.hpp>
+#include <cstdint>
+
+namespace beast {
+namespace zlib {
+
+/** Raw deflate compressor with fixed size internal storage.
+
+    This is a @ref deflate_stream whose window, hash chains and
+    pending output buffer are sized at compile time from the
+    template parameters and stored inline in the object. No
+    memory allocations are performed as long as the settings
+    are not changed through the base class.
+
+    A stream compressing for a peer which accepts a small window,
+    such as a WebSocket connection which negotiated a small value
+    for "permessage-deflate", can use this to shrink its state
+    from several hundred kilobytes to a few kilobytes.
+
+    Objects of this type may not be copied or moved.
+
+    @tparam windowBits The base two logarithm of the window
+    size, from 8 to 15.
+
+    @tparam memLevel The memory level, from 1 to 9.
+*/
+template<int windowBits, int memLevel>
+class static_deflate_stream : public deflate_stream
+{
+    static_assert(windowBits >= 8 && windowBits <= 15,
+        "windowBits out of range");
+
+    static_assert(memLevel >= 1 && memLevel <= 9,
+        "memLevel out of range");
+
+    std::uint16_t buf_[
+        (storage_size(windowBits, memLevel) + 1) / 2];
+
+public:
+    /** Constructor
+
+        The stream is constructed with a compression level of 6
+        and the normal strategy.
+    */
+    static_deflate_stream()
+        : zlib::deflate_stream(
+            reinterpret_cast<std::uint8_t*>(buf_),
+            sizeof(buf_), windowBits, memLevel)
+    {
+    }
+
+    /// Constructor (deleted)
+    static_deflate_stream(static_deflate_stream const&) = delete;
+
+    /// Assignment (deleted)
+    static_deflate_stream& operator=(static_deflate_stream const&) = delete;
+
+    /** Reset the stream and compression settings.
+
+        The window size and memory level are those of the
+        template parameters.
+
+        @note Any unprocessed input or pending output from
+        previous calls are discarded.
+    */
+    void
+    reset(int level, Strategy strategy)
+    {
+        zlib::deflate_stream::reset(level,
+            windowBits, memLevel, strategy);
+    }
+
+    /** Reset the stream without changing the settings.
+
+        @note Any unprocessed input or pending output from
+        previous calls are discarded.
+    */
+    void
+    reset()
+    {
+        zlib::deflate_stream::reset();
+    }
+};
+
+} // zlib
+} // beast
+
+#endif
@@ -0,0 +1,65 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BEAST_ZLIB_STATIC_INFLATE_STREAM_HPP
+#define BEAST_ZLIB_STATIC_INFLATE_STREAM_HPP
+
+#include <beast/config.hpp>
+#include <beast/zlib/inflate_stream.hpp>
+#include <cstdint>
+
+namespace beast {
+namespace zlib {
+
+/** Raw deflate decompressor with a fixed size window.
+
+    This is an @ref inflate_stream whose sliding window is stored
+    inline in the object, sized at compile time. No memory
+    allocations are performed as long as the window size is not
+    increased through the base class.
+
+    Objects of this type may not be copied or moved.
+
+    @tparam windowBits The base two logarithm of the window
+    size, from 8 to 15.
+*/
+template<int windowBits>
+class static_inflate_stream : public inflate_stream
+{
+    static_assert(windowBits >= 8 && windowBits <= 15,
+        "windowBits out of range");
+
+    std::uint8_t buf_[1U << windowBits];
+
+public:
+    /// Constructor
+    static_inflate_stream()
+        : zlib::inflate_stream(buf_, sizeof(buf_), windowBits)
+    {
+    }
+
+    /// Constructor (deleted)
+    static_inflate_stream(static_inflate_stream const&) = delete;
+
+    /// Assignment (deleted)
+    static_inflate_stream& operator=(static_inflate_stream const&) = delete;
+
+    /** Reset the stream.
+
+        This puts the stream in a newly constructed state.
+    */
+    void
+    reset()
+    {
+        zlib::inflate_stream::reset();
+    }
+};
+
+} // zlib
+} // beast
+
+#endif
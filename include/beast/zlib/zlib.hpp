@@ -170,7 +170,21 @@ enum class Strategy
         This strategy prevents the use of dynamic Huffman codes,
         allowing for a simpler decoder for special applications.
     */
-    fixed
+    fixed,
+
+    /** Quick strategy.
+
+        This strategy probes the hash table once per input position,
+        does not insert the strings inside a match, and writes static
+        Huffman blocks as the codes are found. It is faster than the
+        default strategy at the same level, at the cost of a lower
+        compression ratio. At level 0 the input is stored as with
+        the other strategies.
+
+        This strategy is specific to Beast and has no equivalent
+        in zlib.
+    */
+    quick
 };
 
 } // zlib
@@ -0,0 +1,137 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <beast/websocket/stream.hpp>
+#include <beast/websocket/detail/hybi13.hpp>
+#include <beast/test/string_iostream.hpp>
+#include <beast/unit_test/suite.hpp>
+#include <boost/asio/io_service.hpp>
+#include <chrono>
+#include <string>
+
+namespace beast {
+
+class handshake_test : public beast::unit_test::suite
+{
+public:
+    using size_type = std::uint64_t;
+
+    class timer
+    {
+        using clock_type =
+            std::chrono::system_clock;
+
+        clock_type::time_point when_;
+
+    public:
+        using duration =
+            clock_type::duration;
+
+        timer()
+            : when_(clock_type::now())
+        {
+        }
+
+        duration
+        elapsed() const
+        {
+            return clock_type::now() - when_;
+        }
+    };
+
+    static
+    inline
+    size_type
+    throughput(std::chrono::duration<
+        double> const& elapsed, size_type items)
+    {
+        using namespace std::chrono;
+        return static_cast<size_type>(
+            1 / (elapsed/items).count());
+    }
+
+    static std::size_t constexpr N = 100000;
+
+    boost::asio::io_service ios_;
+
+    std::string const req_ =
+        "GET / HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "Sec-WebSocket-Extensions: permessage-deflate; "
+            "client_max_window_bits\r\n"
+        "\r\n";
+
+    // Accept with the default decorator, which writes
+    // the response from a template in a single write.
+    void
+    acceptTemplate()
+    {
+        websocket::permessage_deflate pmd;
+        pmd.server_enable = true;
+        for(std::size_t i = 0; i < N; ++i)
+        {
+            websocket::stream<test::string_iostream> ws{ios_, req_};
+            ws.set_option(pmd);
+            ws.accept();
+        }
+    }
+
+    // Accept with a decorator, which builds
+    // the response as a message.
+    void
+    acceptMessage()
+    {
+        websocket::permessage_deflate pmd;
+        pmd.server_enable = true;
+        for(std::size_t i = 0; i < N; ++i)
+        {
+            websocket::stream<test::string_iostream> ws{ios_, req_};
+            ws.set_option(pmd);
+            ws.accept_ex([](websocket::response_type&){});
+        }
+    }
+
+    // Compute just the Sec-WebSocket-Accept value
+    void
+    acceptKey()
+    {
+        websocket::detail::sec_ws_accept_type acc;
+        for(std::size_t i = 0; i < N; ++i)
+            websocket::detail::make_sec_ws_accept(
+                acc, "dGhlIHNhbXBsZSBub25jZQ==");
+    }
+
+    template<class F>
+    void
+    measure(char const* what, F const& f)
+    {
+        for(int i = 0; i < 5; ++i)
+        {
+            timer t;
+            f();
+            log << what << throughput(
+                t.elapsed(), N) << " handshakes/s" << std::endl;
+        }
+    }
+
+    void
+    run() override
+    {
+        measure("template: ", [&]{ acceptTemplate(); });
+        measure("message:  ", [&]{ acceptMessage(); });
+        measure("key only: ", [&]{ acceptKey(); });
+        pass();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(handshake,benchmarks,beast);
+
+} // beast
@@ -0,0 +1,798 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <beast/zlib/deflate_parallel.hpp>
+#include <beast/zlib/deflate_stream.hpp>
+#include <beast/zlib/inflate_stream.hpp>
+#include <beast/core/flat_buffer.hpp>
+#include <beast/unit_test/suite.hpp>
+#include <test/zlib/ztest.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace beast {
+namespace zlib {
+
+/*  Compares beast::zlib with the reference zlib.
+
+    Each implementation compresses and decompresses the same
+    synthetic corpus of JSON, HTML, log lines and binary records
+    in raw deflate format, as permessage-deflate uses it. The
+    streams are created once per setting and reset between
+    runs, the fastest of several runs is reported, and
+    throughput is always in uncompressed bytes.
+
+    The small message pattern compresses a sequence of JSON
+    messages with Flush::sync and strips the trailing
+    00 00 ff ff, with and without context takeover.
+
+    The parallel pattern times deflate_parallel on a large
+    body at increasing concurrency, using one thread pool.
+*/
+class zlib_bench : public beast::unit_test::suite
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    using duration = std::chrono::duration<double>;
+
+    struct settings
+    {
+        int level;
+        int windowBits;
+        int memLevel;
+        int strategy;
+    };
+
+    struct measurement
+    {
+        std::size_t in = 0;
+        std::size_t out = 0;
+        duration deflate{0};
+        duration inflate{0};
+    };
+
+    using corpus = std::vector<
+        std::pair<char const*, std::string>>;
+
+private:
+    std::mt19937 rng_;
+
+    std::size_t
+    rand(std::size_t n)
+    {
+        return std::uniform_int_distribution<
+            std::size_t>{0, n - 1}(rng_);
+    }
+
+    std::string
+    word()
+    {
+        static char const* const words[] = {
+            "alpha", "bravo", "charlie", "delta", "echo",
+            "foxtrot", "golf", "hotel", "india", "juliet",
+            "kilo", "lima", "mike", "november", "oscar",
+            "papa", "quebec", "romeo", "sierra", "tango",
+            "uniform", "victor", "whiskey", "xray", "yankee",
+            "zulu", "request", "session", "message", "update",
+            "account", "status"
+            };
+        return words[rand(sizeof(words) / sizeof(words[0]))];
+    }
+
+    std::string
+    sentence(std::size_t n)
+    {
+        std::string s = word();
+        s[0] = static_cast<char>(s[0] - 'a' + 'A');
+        while(--n)
+        {
+            s.push_back(' ');
+            s.append(word());
+        }
+        s.push_back('.');
+        return s;
+    }
+
+    std::string
+    make_json(std::size_t n)
+    {
+        std::string s = "[";
+        std::size_t id = 1000;
+        while(s.size() < n)
+        {
+            if(s.size() > 1)
+                s.append(",\n");
+            s.append("{\"id\":");
+            s.append(std::to_string(id++));
+            s.append(",\"name\":\"");
+            s.append(word());
+            s.push_back(' ');
+            s.append(word());
+            s.append("\",\"active\":");
+            s.append(rand(2) ? "true" : "false");
+            s.append(",\"score\":");
+            s.append(std::to_string(rand(100000)));
+            s.append(",\"tags\":[\"");
+            s.append(word());
+            s.append("\",\"");
+            s.append(word());
+            s.append("\"]}");
+        }
+        s.append("]");
+        return s;
+    }
+
+    std::string
+    make_html(std::size_t n)
+    {
+        std::string s =
+            "<!DOCTYPE html>\n<html>\n<head><title>Index</title></head>\n"
+            "<body>\n";
+        while(s.size() < n)
+        {
+            auto const w = word();
+            s.append("<div class=\"item\">\n  <a href=\"/");
+            s.append(w);
+            s.push_back('/');
+            s.append(std::to_string(rand(10000)));
+            s.append("\">");
+            s.append(w);
+            s.append("</a>\n  <p>");
+            s.append(sentence(4 + rand(12)));
+            s.append("</p>\n</div>\n");
+        }
+        s.append("</body>\n</html>\n");
+        return s;
+    }
+
+    std::string
+    make_log(std::size_t n)
+    {
+        static char const* const levels[] = {
+            "INFO ", "INFO ", "INFO ", "DEBUG", "WARN ", "ERROR" };
+        static char const* const methods[] = {
+            "GET", "GET", "GET", "POST", "PUT", "DELETE" };
+        static char const* const codes[] = {
+            "200", "200", "200", "200", "204", "304", "404", "500" };
+        std::string s;
+        std::size_t ms = 0;
+        while(s.size() < n)
+        {
+            ms += rand(250);
+            auto const sec = ms / 1000;
+            char ts[32];
+            std::snprintf(ts, sizeof(ts),
+                "2017-07-19T%02u:%02u:%02u.%03uZ ",
+                static_cast<unsigned>(sec / 3600 % 24),
+                static_cast<unsigned>(sec / 60 % 60),
+                static_cast<unsigned>(sec % 60),
+                static_cast<unsigned>(ms % 1000));
+            s.append(ts);
+            s.append(levels[rand(6)]);
+            s.append(" [worker-");
+            s.append(std::to_string(rand(8)));
+            s.append("] 10.0.");
+            s.append(std::to_string(rand(4)));
+            s.push_back('.');
+            s.append(std::to_string(rand(256)));
+            s.push_back(' ');
+            s.append(methods[rand(6)]);
+            s.append(" /api/");
+            s.append(word());
+            s.push_back('/');
+            s.append(std::to_string(rand(100000)));
+            s.push_back(' ');
+            s.append(codes[rand(8)]);
+            s.push_back(' ');
+            s.append(std::to_string(50 + rand(5000)));
+            s.append("us\n");
+        }
+        return s;
+    }
+
+    // Fixed size records of a counter, a small
+    // value and random bytes, like a serialized table.
+    std::string
+    make_binary(std::size_t n)
+    {
+        std::string s;
+        std::uint32_t counter = 0;
+        while(s.size() < n)
+        {
+            auto const small =
+                static_cast<std::uint32_t>(rand(1024));
+            for(int i = 0; i < 4; ++i)
+                s.push_back(static_cast<char>(
+                    (counter >> (8 * i)) & 0xff));
+            for(int i = 0; i < 4; ++i)
+                s.push_back(static_cast<char>(
+                    (small >> (8 * i)) & 0xff));
+            for(int i = 0; i < 8; ++i)
+                s.push_back(static_cast<char>(rand(256)));
+            counter += 1 + static_cast<std::uint32_t>(rand(3));
+        }
+        return s;
+    }
+
+    std::string
+    make_message()
+    {
+        std::string s = "{\"type\":\"message\",\"id\":";
+        s.append(std::to_string(rand(1000000)));
+        s.append(",\"user\":\"");
+        s.append(word());
+        s.append("\",\"text\":\"");
+        s.append(sentence(1 + rand(rand(4) ? 16 : 200)));
+        s.append("\"}");
+        return s;
+    }
+
+public:
+    corpus
+    make_corpus(std::size_t n)
+    {
+        rng_.seed(42);
+        corpus c;
+        c.emplace_back("json", make_json(n));
+        c.emplace_back("html", make_html(n));
+        c.emplace_back("log", make_log(n));
+        c.emplace_back("binary", make_binary(n));
+        for(auto& e : c)
+            e.second.resize(n);
+        return c;
+    }
+
+    std::vector<std::string>
+    make_messages(std::size_t n)
+    {
+        rng_.seed(42);
+        std::vector<std::string> v;
+        v.reserve(n);
+        while(n--)
+            v.emplace_back(make_message());
+        return v;
+    }
+
+    static
+    Strategy
+    toStrategy(int strategy)
+    {
+        switch(strategy)
+        {
+        default:
+        case 0: return Strategy::normal;
+        case 1: return Strategy::filtered;
+        case 2: return Strategy::huffman;
+        case 3: return Strategy::rle;
+        case 4: return Strategy::fixed;
+        case 5: return Strategy::quick;
+        }
+    }
+
+    // Returns the shortest of `reps` runs of `f`
+    template<class F>
+    static
+    duration
+    fastest(int reps, F const& f)
+    {
+        auto best = (duration::max)();
+        for(int i = 0; i < reps; ++i)
+        {
+            auto const when = clock_type::now();
+            f();
+            best = (std::min)(best,
+                duration(clock_type::now() - when));
+        }
+        return best;
+    }
+
+    //--------------------------------------------------------------------------
+
+    measurement
+    doBeast(settings const& s, std::string const& in, int reps)
+    {
+        measurement m;
+        m.in = in.size();
+        std::string packed;
+        std::string out;
+
+        deflate_stream ds;
+        ds.reset(s.level, s.windowBits,
+            s.memLevel, toStrategy(s.strategy));
+        packed.resize(ds.upper_bound(in.size()));
+        m.deflate = fastest(reps, [&]
+        {
+            ds.reset();
+            z_params zs;
+            zs.next_in = in.data();
+            zs.avail_in = in.size();
+            zs.next_out = &packed[0];
+            zs.avail_out = packed.size();
+            error_code ec;
+            for(;;)
+            {
+                ds.write(zs, Flush::finish, ec);
+                if(ec)
+                    break;
+            }
+            BEAST_EXPECTS(ec == error::end_of_stream, ec.message());
+            m.out = zs.total_out;
+        });
+
+        inflate_stream is;
+        is.reset(s.windowBits);
+        out.resize(in.size() + 1);
+        std::size_t n = 0;
+        m.inflate = fastest(reps, [&]
+        {
+            is.reset();
+            z_params zs;
+            zs.next_in = packed.data();
+            zs.avail_in = m.out;
+            zs.next_out = &out[0];
+            zs.avail_out = out.size();
+            error_code ec;
+            for(;;)
+            {
+                is.write(zs, Flush::sync, ec);
+                if(ec)
+                    break;
+            }
+            // inflate_stream can stop before the end of block
+            // code when it is shorter than lenbits and is the
+            // last thing in the input, see test/zlib/inflate_stream.cpp
+            BEAST_EXPECTS(
+                ec == error::end_of_stream ||
+                ec == error::need_buffers, ec.message());
+            n = zs.total_out;
+        });
+        BEAST_EXPECT(n == in.size() &&
+            out.compare(0, n, in) == 0);
+        return m;
+    }
+
+    measurement
+    doZlib(settings const& s, std::string const& in, int reps)
+    {
+        measurement m;
+        m.in = in.size();
+        std::string packed;
+        std::string out;
+        int result;
+
+        ::z_stream zs;
+        std::memset(&zs, 0, sizeof(zs));
+        result = deflateInit2(&zs, s.level, Z_DEFLATED,
+            -s.windowBits, s.memLevel, s.strategy);
+        if(! BEAST_EXPECT(result == Z_OK))
+            return m;
+        packed.resize(deflateBound(&zs,
+            static_cast<uLong>(in.size())));
+        m.deflate = fastest(reps, [&]
+        {
+            deflateReset(&zs);
+            zs.next_in = (Bytef*)in.data();
+            zs.avail_in = static_cast<uInt>(in.size());
+            zs.next_out = (Bytef*)&packed[0];
+            zs.avail_out = static_cast<uInt>(packed.size());
+            result = ::deflate(&zs, Z_FINISH);
+            BEAST_EXPECT(result == Z_STREAM_END);
+            m.out = zs.total_out;
+        });
+        deflateEnd(&zs);
+
+        std::memset(&zs, 0, sizeof(zs));
+        result = inflateInit2(&zs, -s.windowBits);
+        if(! BEAST_EXPECT(result == Z_OK))
+            return m;
+        out.resize(in.size() + 1);
+        std::size_t n = 0;
+        m.inflate = fastest(reps, [&]
+        {
+            inflateReset(&zs);
+            zs.next_in = (Bytef*)packed.data();
+            zs.avail_in = static_cast<uInt>(m.out);
+            zs.next_out = (Bytef*)&out[0];
+            zs.avail_out = static_cast<uInt>(out.size());
+            result = ::inflate(&zs, Z_SYNC_FLUSH);
+            BEAST_EXPECT(result == Z_STREAM_END);
+            n = zs.total_out;
+        });
+        inflateEnd(&zs);
+        BEAST_EXPECT(n == in.size() &&
+            out.compare(0, n, in) == 0);
+        return m;
+    }
+
+    //--------------------------------------------------------------------------
+
+    static
+    std::size_t
+    largest(std::vector<std::string> const& v)
+    {
+        std::size_t n = 0;
+        for(auto const& s : v)
+            n = (std::max)(n, s.size());
+        return n;
+    }
+
+    measurement
+    doBeastMessages(settings const& s,
+        std::vector<std::string> const& msgs,
+            bool takeover, int reps)
+    {
+        measurement m;
+        for(auto const& msg : msgs)
+            m.in += msg.size();
+        std::vector<std::string> packed(msgs.size());
+        std::string buf;
+
+        deflate_stream ds;
+        ds.reset(s.level, s.windowBits,
+            s.memLevel, toStrategy(s.strategy));
+        buf.resize(ds.upper_bound(largest(msgs)) + 16);
+        m.deflate = fastest(reps, [&]
+        {
+            ds.reset();
+            m.out = 0;
+            for(std::size_t i = 0; i < msgs.size(); ++i)
+            {
+                if(! takeover)
+                    ds.reset();
+                z_params zs;
+                zs.next_in = msgs[i].data();
+                zs.avail_in = msgs[i].size();
+                zs.next_out = &buf[0];
+                zs.avail_out = buf.size();
+                error_code ec;
+                ds.write(zs, Flush::sync, ec);
+                BEAST_EXPECTS(! ec, ec.message());
+                BEAST_EXPECT(zs.avail_in == 0 && zs.total_out >= 4);
+                // remove flush marker
+                packed[i].assign(buf.data(), zs.total_out - 4);
+                m.out += packed[i].size();
+            }
+        });
+
+        inflate_stream is;
+        is.reset(s.windowBits);
+        buf.resize(largest(msgs) + 1);
+        for(auto& p : packed)
+            p.append("\x00\x00\xff\xff", 4);
+        m.inflate = fastest(reps, [&]
+        {
+            is.reset();
+            for(std::size_t i = 0; i < packed.size(); ++i)
+            {
+                if(! takeover)
+                    is.reset();
+                z_params zs;
+                zs.next_in = packed[i].data();
+                zs.avail_in = packed[i].size();
+                zs.next_out = &buf[0];
+                zs.avail_out = buf.size();
+                error_code ec;
+                is.write(zs, Flush::sync, ec);
+                BEAST_EXPECTS(! ec, ec.message());
+                BEAST_EXPECT(zs.total_out == msgs[i].size() &&
+                    buf.compare(0, zs.total_out, msgs[i]) == 0);
+            }
+        });
+        return m;
+    }
+
+    measurement
+    doZlibMessages(settings const& s,
+        std::vector<std::string> const& msgs,
+            bool takeover, int reps)
+    {
+        measurement m;
+        for(auto const& msg : msgs)
+            m.in += msg.size();
+        std::vector<std::string> packed(msgs.size());
+        std::string buf;
+        int result;
+
+        ::z_stream zs;
+        std::memset(&zs, 0, sizeof(zs));
+        result = deflateInit2(&zs, s.level, Z_DEFLATED,
+            -s.windowBits, s.memLevel, s.strategy);
+        if(! BEAST_EXPECT(result == Z_OK))
+            return m;
+        buf.resize(deflateBound(&zs,
+            static_cast<uLong>(largest(msgs))) + 16);
+        m.deflate = fastest(reps, [&]
+        {
+            deflateReset(&zs);
+            m.out = 0;
+            for(std::size_t i = 0; i < msgs.size(); ++i)
+            {
+                if(! takeover)
+                    deflateReset(&zs);
+                zs.next_in = (Bytef*)msgs[i].data();
+                zs.avail_in = static_cast<uInt>(msgs[i].size());
+                zs.next_out = (Bytef*)&buf[0];
+                zs.avail_out = static_cast<uInt>(buf.size());
+                result = ::deflate(&zs, Z_SYNC_FLUSH);
+                BEAST_EXPECT(result == Z_OK);
+                auto const n = buf.size() - zs.avail_out;
+                BEAST_EXPECT(zs.avail_in == 0 && n >= 4);
+                // remove flush marker
+                packed[i].assign(buf.data(), n - 4);
+                m.out += packed[i].size();
+            }
+        });
+        deflateEnd(&zs);
+
+        std::memset(&zs, 0, sizeof(zs));
+        result = inflateInit2(&zs, -s.windowBits);
+        if(! BEAST_EXPECT(result == Z_OK))
+            return m;
+        buf.resize(largest(msgs) + 1);
+        for(auto& p : packed)
+            p.append("\x00\x00\xff\xff", 4);
+        m.inflate = fastest(reps, [&]
+        {
+            inflateReset(&zs);
+            for(std::size_t i = 0; i < packed.size(); ++i)
+            {
+                if(! takeover)
+                    inflateReset(&zs);
+                zs.next_in = (Bytef*)packed[i].data();
+                zs.avail_in = static_cast<uInt>(packed[i].size());
+                zs.next_out = (Bytef*)&buf[0];
+                zs.avail_out = static_cast<uInt>(buf.size());
+                result = ::inflate(&zs, Z_SYNC_FLUSH);
+                BEAST_EXPECT(result == Z_OK);
+                auto const n = buf.size() - zs.avail_out;
+                BEAST_EXPECT(n == msgs[i].size() &&
+                    buf.compare(0, n, msgs[i]) == 0);
+            }
+        });
+        inflateEnd(&zs);
+        return m;
+    }
+
+    measurement
+    doParallel(int level, std::string const& in,
+        test_pool& pool, std::size_t concurrency, int reps)
+    {
+        measurement m;
+        m.in = in.size();
+        flat_buffer b;
+        m.deflate = fastest(reps, [&]
+        {
+            b.consume(b.size());
+            deflate_parallel(pool, b, in.data(), in.size(),
+                level, Format::raw, concurrency);
+        });
+        m.out = b.size();
+
+        inflate_stream is;
+        is.reset(15);
+        std::string out;
+        out.resize(in.size() + 1);
+        std::size_t n = 0;
+        m.inflate = fastest(reps, [&]
+        {
+            is.reset();
+            z_params zs;
+            zs.next_in = boost::asio::buffer_cast<
+                void const*>(b.data());
+            zs.avail_in = b.size();
+            zs.next_out = &out[0];
+            zs.avail_out = out.size();
+            error_code ec;
+            for(;;)
+            {
+                is.write(zs, Flush::sync, ec);
+                if(ec)
+                    break;
+            }
+            BEAST_EXPECTS(
+                ec == error::end_of_stream ||
+                ec == error::need_buffers, ec.message());
+            n = zs.total_out;
+        });
+        BEAST_EXPECT(n == in.size() &&
+            out.compare(0, n, in) == 0);
+        return m;
+    }
+
+    //--------------------------------------------------------------------------
+
+    static
+    double
+    mbps(std::size_t bytes, duration elapsed)
+    {
+        return bytes / elapsed.count() / 1000000;
+    }
+
+    static
+    std::string
+    label(settings const& s)
+    {
+        std::stringstream ss;
+        ss <<
+            "L" << s.level <<
+            " S" << s.strategy <<
+            " W" << s.windowBits <<
+            " M" << s.memLevel;
+        return ss.str();
+    }
+
+    void
+    print_header(std::string const& title)
+    {
+        std::stringstream ss;
+        ss << std::left <<
+            title << "\n" <<
+            std::setw(16) << "settings" <<
+            std::setw(6) << "impl" << std::right <<
+            std::setw(9) << "size" <<
+            std::setw(15) << "deflate" <<
+            std::setw(15) << "inflate";
+        log << ss.str() << std::endl;
+    }
+
+    void
+    print(std::string const& name,
+        char const* impl, measurement const& m)
+    {
+        std::stringstream ss;
+        ss << std::left <<
+            std::setw(16) << name <<
+            std::setw(6) << impl << std::right <<
+            std::fixed << std::setprecision(2) <<
+            std::setw(8) << 100.0 * m.out / m.in << "%" <<
+            std::setw(10) << mbps(m.in, m.deflate) << " MB/s" <<
+            std::setw(10) << mbps(m.in, m.inflate) << " MB/s";
+        log << ss.str() << std::endl;
+    }
+
+    void
+    compare(settings const& s, std::string const& in, int reps)
+    {
+        auto const name = label(s);
+        print(name, "beast", doBeast(s, in, reps));
+        // zlib has no Strategy::quick
+        if(s.strategy != 5)
+            print("", "zlib", doZlib(s, in, reps));
+    }
+
+    // Settings which vary one parameter at a
+    // time away from level 6, windowBits 15,
+    // memLevel 8 and the default strategy,
+    // plus Strategy::quick at the fast levels.
+    static
+    std::vector<settings>
+    sweep()
+    {
+        std::vector<settings> v;
+        for(int level = 0; level <= 9; ++level)
+            v.push_back({level, 15, 8, 0});
+        for(int strategy = 1; strategy <= 4; ++strategy)
+            v.push_back({6, 15, 8, strategy});
+        for(int level = 1; level <= 3; ++level)
+            v.push_back({level, 15, 8, 5});
+        // zlib turns a raw windowBits of 8 into 9
+        for(int windowBits = 9; windowBits < 15; ++windowBits)
+            v.push_back({6, windowBits, 8, 0});
+        for(int memLevel = 1; memLevel <= 9; ++memLevel)
+            if(memLevel != 8)
+                v.push_back({6, 15, memLevel, 0});
+        return v;
+    }
+
+    // Every combination of settings
+    static
+    std::vector<settings>
+    matrix()
+    {
+        std::vector<settings> v;
+        for(int level = 0; level <= 9; ++level)
+            for(int strategy = 0; strategy <= 5; ++strategy)
+                for(int windowBits = 9; windowBits <= 15; ++windowBits)
+                    for(int memLevel = 1; memLevel <= 9; ++memLevel)
+                        v.push_back({level, windowBits, memLevel, strategy});
+        return v;
+    }
+
+    void
+    testCorpus(std::vector<settings> const& v,
+        std::size_t size, int reps)
+    {
+        for(auto const& e : make_corpus(size))
+        {
+            print_header(std::string(e.first) + ", " +
+                std::to_string(e.second.size()) + " bytes");
+            for(auto const& s : v)
+                compare(s, e.second, reps);
+            log << std::endl;
+        }
+    }
+
+    void
+    testMessages(std::size_t count, int reps)
+    {
+        // permessage-deflate defaults
+        settings const s{8, 15, 4, 0};
+        auto const msgs = make_messages(count);
+        for(auto takeover : {true, false})
+        {
+            print_header(std::to_string(count) +
+                " messages, Flush::sync, " +
+                (takeover ? "context takeover" :
+                    "no context takeover"));
+            auto const name = label(s);
+            print(name, "beast",
+                doBeastMessages(s, msgs, takeover, reps));
+            print("", "zlib",
+                doZlibMessages(s, msgs, takeover, reps));
+            log << std::endl;
+        }
+    }
+
+    void
+    testParallel(std::size_t size, int reps)
+    {
+        auto const threads = (std::max)(4U,
+            std::thread::hardware_concurrency());
+        test_pool pool{threads - 1};
+        for(auto const& e : make_corpus(size))
+        {
+            print_header(std::string(e.first) + ", " +
+                std::to_string(e.second.size()) +
+                    " bytes, deflate_parallel");
+            for(std::size_t n = 1; n <= threads; n *= 2)
+                print("L6 x" + std::to_string(n), "beast",
+                    doParallel(6, e.second, pool, n, reps));
+            log << std::endl;
+        }
+    }
+};
+
+class zlib_test : public zlib_bench
+{
+public:
+    void
+    run() override
+    {
+        testCorpus(sweep(), 1024 * 1024, 3);
+        testMessages(10000, 3);
+        testParallel(8 * 1024 * 1024, 3);
+        pass();
+    }
+};
+
+// Run with --suites=zlib_matrix
+class zlib_matrix_test : public zlib_bench
+{
+public:
+    void
+    run() override
+    {
+        testCorpus(matrix(), 256 * 1024, 1);
+        pass();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(zlib,benchmarks,beast);
+BEAST_DEFINE_TESTSUITE_MANUAL(zlib_matrix,benchmarks,beast);
+
+} // zlib
+} // beast
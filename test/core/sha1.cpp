@@ -8,6 +8,7 @@
 #include <beast/core/detail/sha1.hpp>
 #include <beast/unit_test/suite.hpp>
 #include <array>
+#include <cstdint>
 
 namespace beast {
 namespace detail {
@@ -57,9 +58,55 @@ public:
         BEAST_EXPECT(result == digest);
     }
 
+    // Compare each implementation of the block
+    // function against the portable one.
+    void
+    testProcess()
+    {
+        std::uint8_t p[64];
+        std::uint32_t expected[5];
+        std::uint32_t digest[5];
+        std::uint32_t x = 1;
+        for(int n = 0; n < 100; ++n)
+        {
+            for(auto& c : p)
+            {
+                x = x * 1103515245 + 12345;
+                c = static_cast<std::uint8_t>(x >> 16);
+            }
+            for(int i = 0; i < 5; ++i)
+                expected[i] = digest[i] = x + i;
+            std::uint32_t block[sha1::BLOCK_INTS];
+            sha1::make_block(p, block);
+            sha1::transform(expected, block);
+
+            std::uint32_t d[5];
+            std::copy(digest, digest + 5, d);
+            sha1::process(d, p);
+            BEAST_EXPECT(std::equal(d, d + 5, expected));
+
+#if ! BEAST_NO_SHA_INTRINSICS
+            if(get_cpu_info().sha)
+            {
+                std::copy(digest, digest + 5, d);
+                sha1::transform_shani(d, p);
+                BEAST_EXPECT(std::equal(d, d + 5, expected));
+            }
+#endif
+        }
+#if ! BEAST_NO_SHA_INTRINSICS
+        if(! get_cpu_info().sha)
+            log << "SHA extensions not available" << std::endl;
+#else
+        log << "SHA extensions not compiled" << std::endl;
+#endif
+    }
+
     void
     run()
     {
+        testProcess();
+
         // http://www.di-mgt.com.au/sha_testvectors.html
         //
         check("abc",
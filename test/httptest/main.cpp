@@ -0,0 +1,661 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// HTTP server load generator
+//
+// Starts the asynchronous HTTP port of the server-framework example
+// in-process, and drives keep-alive connections against it over the
+// loopback interface from a number of client threads. Each connection
+// writes a batch of pipelined GET and POST requests, then reads the
+// responses. The server answers GET with a body of fixed size and
+// echoes the body of a POST. See `httptest --help`.
+//
+// Reported are requests per second, latency percentiles (corrected
+// for coordinated omission when a target rate is given, as in wstest),
+// and the allocations and CPU time per request spent by the server,
+// that is by every thread other than the client threads.
+
+#include <example/server-framework/http_async_port.hpp>
+#include <example/server-framework/server.hpp>
+
+#include <beast/core.hpp>
+#include <beast/http.hpp>
+#include <beast/test/load_test.hpp>
+#include <beast/version.hpp>
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+namespace asio = boost::asio;
+namespace ip = boost::asio::ip;
+namespace http = beast::http;
+using tcp = boost::asio::ip::tcp;
+namespace ph = std::placeholders;
+using error_code = beast::error_code;
+using clock_type = std::chrono::steady_clock;
+
+//------------------------------------------------------------------------------
+//
+// Allocation counting
+//
+//------------------------------------------------------------------------------
+
+namespace {
+
+struct alignas(64) alloc_counter
+{
+    std::atomic<std::uint64_t> count{0};
+    std::atomic<std::uint64_t> bytes{0};
+};
+
+alloc_counter client_allocs;
+alloc_counter server_allocs;
+
+// Set on the client threads, so that their
+// allocations are not charged to the server.
+thread_local bool is_client_thread = false;
+
+struct alloc_snapshot
+{
+    std::uint64_t count;
+    std::uint64_t bytes;
+
+    explicit
+    alloc_snapshot(alloc_counter const& c)
+        : count(c.count.load())
+        , bytes(c.bytes.load())
+    {
+    }
+};
+
+} // (anon)
+
+void*
+operator new(std::size_t n)
+{
+    auto& c = is_client_thread ?
+        client_allocs : server_allocs;
+    c.count.fetch_add(1, std::memory_order_relaxed);
+    c.bytes.fetch_add(n, std::memory_order_relaxed);
+    if(auto p = std::malloc(n == 0 ? 1 : n))
+        return p;
+    throw std::bad_alloc{};
+}
+
+void
+operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void
+operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+//------------------------------------------------------------------------------
+//
+// CPU time
+//
+//------------------------------------------------------------------------------
+
+using cpu_duration = std::chrono::nanoseconds;
+
+#ifdef _WIN32
+
+inline
+cpu_duration
+to_cpu_duration(FILETIME const& kernel, FILETIME const& user)
+{
+    auto const ticks =
+        [](FILETIME const& t)
+        {
+            return (static_cast<std::uint64_t>(
+                t.dwHighDateTime) << 32) | t.dwLowDateTime;
+        };
+    // FILETIME counts 100 nanosecond intervals
+    return cpu_duration{100 * (ticks(kernel) + ticks(user))};
+}
+
+// Returns the CPU time used by the process
+inline
+cpu_duration
+process_cpu_time()
+{
+    FILETIME c, e, k, u;
+    GetProcessTimes(GetCurrentProcess(), &c, &e, &k, &u);
+    return to_cpu_duration(k, u);
+}
+
+// Returns the CPU time used by a thread
+inline
+cpu_duration
+thread_cpu_time(std::thread& t)
+{
+    FILETIME c, e, k, u;
+    GetThreadTimes(t.native_handle(), &c, &e, &k, &u);
+    return to_cpu_duration(k, u);
+}
+
+#else
+
+inline
+cpu_duration
+to_cpu_duration(timespec const& ts)
+{
+    return std::chrono::seconds{ts.tv_sec} +
+        cpu_duration{ts.tv_nsec};
+}
+
+// Returns the CPU time used by the process
+inline
+cpu_duration
+process_cpu_time()
+{
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return to_cpu_duration(ts);
+}
+
+// Returns the CPU time used by a thread
+inline
+cpu_duration
+thread_cpu_time(std::thread& t)
+{
+    clockid_t id;
+    timespec ts;
+    if(pthread_getcpuclockid(t.native_handle(), &id) != 0 ||
+            clock_gettime(id, &ts) != 0)
+        return cpu_duration::zero();
+    return to_cpu_duration(ts);
+}
+
+#endif
+
+//------------------------------------------------------------------------------
+//
+// Server
+//
+//------------------------------------------------------------------------------
+
+/*  A service for the server-framework which answers GET with a
+    body of fixed size, and POST by sending back the request body.
+
+    Meets the requirements of @b Service
+*/
+class bench_service
+{
+    std::string body_;
+
+public:
+    explicit
+    bench_service(std::size_t size)
+        : body_(size, '*')
+    {
+    }
+
+    void
+    init(error_code& ec)
+    {
+        ec = {};
+    }
+
+    template<
+        class Stream,
+        class Body, class Fields,
+        class Send>
+    bool
+    respond(
+        Stream&&,
+        framework::endpoint_type const&,
+        http::request<Body, Fields>&& req,
+        Send const& send) const
+    {
+        switch(req.method())
+        {
+        case http::verb::get:
+        {
+            // The body refers to storage owned by the
+            // service, to keep copies out of the measurement.
+            http::response<http::span_body<char const>> res;
+            res.version = req.version;
+            res.result(http::status::ok);
+            res.set(http::field::server, BEAST_VERSION_STRING);
+            res.body = {body_.data(), body_.size()};
+            res.prepare_payload();
+            res.keep_alive(req.keep_alive());
+            send(std::move(res));
+            return true;
+        }
+
+        case http::verb::post:
+        {
+            http::response<Body> res;
+            res.version = req.version;
+            res.result(http::status::ok);
+            res.set(http::field::server, BEAST_VERSION_STRING);
+            res.body = std::move(req.body);
+            res.prepare_payload();
+            res.keep_alive(req.keep_alive());
+            send(std::move(res));
+            return true;
+        }
+
+        default:
+            break;
+        }
+        return false;
+    }
+};
+
+//------------------------------------------------------------------------------
+//
+// Client
+//
+//------------------------------------------------------------------------------
+
+struct options
+{
+    std::size_t connections;
+    std::size_t threads;
+    std::size_t depth;          // requests per pipelined batch
+    double rate;                // requests/s for all connections
+    double post;                // fraction of POST requests
+    clock_type::duration warmup;
+    clock_type::duration duration;
+};
+
+// Measurements taken by the connections on one thread
+struct report
+{
+    beast::test::latency lat;
+    std::uint64_t requests = 0;
+    std::uint64_t errors = 0;
+
+    void
+    merge(report const& other)
+    {
+        lat.merge(other.lat);
+        requests += other.requests;
+        errors += other.errors;
+    }
+};
+
+// Serialized requests shared by all connections
+struct requests
+{
+    std::string get;
+    std::string post;
+
+    static
+    std::string
+    make(http::verb v, std::string const& host, std::size_t size)
+    {
+        http::request<http::string_body> req{v, "/", 11};
+        req.set(http::field::host, host);
+        req.set(http::field::user_agent, BEAST_VERSION_STRING);
+        req.body.assign(size, '*');
+        req.prepare_payload();
+        std::ostringstream ss;
+        ss << req;
+        return ss.str();
+    }
+};
+
+class connection
+    : public std::enable_shared_from_this<connection>
+{
+    std::ostream& log_;
+    tcp::socket sock_;
+    tcp::endpoint ep_;
+    options const& opt_;
+    requests const& reqs_;
+    report& rep_;
+    std::bernoulli_distribution post_;
+    asio::steady_timer timer_;
+    beast::flat_buffer buffer_;
+    http::response<http::string_body> res_;
+    std::vector<asio::const_buffer> batch_;
+    std::mt19937_64 rng_;
+    beast::test::schedule sched_;   // one send per batch
+    std::size_t pending_ = 0;
+
+public:
+    connection(
+        std::ostream& log,
+        asio::io_service& ios,
+        tcp::endpoint const& ep,
+        options const& opt,
+        requests const& reqs,
+        report& rep,
+        std::uint64_t seed)
+        : log_(log)
+        , sock_(ios)
+        , ep_(ep)
+        , opt_(opt)
+        , reqs_(reqs)
+        , rep_(rep)
+        , post_(opt.post)
+        , timer_(ios)
+        , rng_(seed)
+        , sched_(opt.rate / (opt.connections * opt.depth))
+    {
+        batch_.reserve(opt.depth);
+    }
+
+    void
+    run(clock_type::time_point start)
+    {
+        sched_.run(start, opt_.warmup, opt_.duration);
+        sock_.async_connect(ep_,
+            std::bind(
+                &connection::on_connect,
+                shared_from_this(),
+                ph::_1));
+    }
+
+private:
+    void
+    fail(beast::string_view what, error_code ec)
+    {
+        if(ec == asio::error::operation_aborted)
+            return;
+        ++rep_.errors;
+        log_ << "[" << ep_ << "] " << what <<
+            ": " << ec.message() << std::endl;
+    }
+
+    void
+    on_connect(error_code ec)
+    {
+        if(ec)
+            return fail("on_connect", ec);
+        sock_.set_option(tcp::no_delay{true});
+        sched_.first(rng_);
+        do_wait();
+    }
+
+    void
+    do_wait()
+    {
+        if(sched_.due())
+            return do_write();
+        timer_.expires_at(sched_.next());
+        timer_.async_wait(
+            std::bind(
+                &connection::on_timer,
+                shared_from_this(),
+                ph::_1));
+    }
+
+    void
+    on_timer(error_code ec)
+    {
+        if(ec)
+            return fail("on_timer", ec);
+        do_write();
+    }
+
+    void
+    do_write()
+    {
+        batch_.clear();
+        for(std::size_t i = 0; i < opt_.depth; ++i)
+        {
+            auto const& s = post_(rng_) ? reqs_.post : reqs_.get;
+            batch_.emplace_back(s.data(), s.size());
+        }
+        pending_ = opt_.depth;
+        sched_.send();
+        asio::async_write(sock_, batch_,
+            std::bind(
+                &connection::on_write,
+                shared_from_this(),
+                ph::_1));
+    }
+
+    void
+    on_write(error_code ec)
+    {
+        if(ec)
+            return fail("on_write", ec);
+        do_read();
+    }
+
+    void
+    do_read()
+    {
+        res_ = http::response<http::string_body>{};
+        http::async_read(sock_, buffer_, res_,
+            std::bind(
+                &connection::on_read,
+                shared_from_this(),
+                ph::_1));
+    }
+
+    void
+    on_read(error_code ec)
+    {
+        if(ec)
+            return fail("on_read", ec);
+        auto const now = clock_type::now();
+        if(sched_.reply(rep_.lat, now))
+        {
+            ++rep_.requests;
+            if(res_.result() != http::status::ok)
+                ++rep_.errors;
+        }
+        if(--pending_ > 0)
+            return do_read();
+        if(sched_.done(now))
+        {
+            sock_.shutdown(tcp::socket::shutdown_both, ec);
+            return;
+        }
+        sched_.advance();
+        do_wait();
+    }
+};
+
+// One thread and the connections it runs
+using worker = beast::test::worker<report>;
+
+int
+main(int argc, char** argv)
+{
+    namespace po = boost::program_options;
+
+    try
+    {
+        po::options_description desc("Options");
+        desc.add_options()
+            ("help,h",          "Show this message")
+            ("server-threads",  po::value<std::size_t>()->default_value(1),
+                                "Threads for the server")
+            ("connections,c",   po::value<std::size_t>()->default_value(16),
+                                "Number of keep-alive connections")
+            ("threads,t",       po::value<std::size_t>()->default_value(1),
+                                "Number of client threads")
+            ("depth",           po::value<std::size_t>()->default_value(1),
+                                "Requests pipelined in each batch")
+            ("duration,d",      po::value<double>()->default_value(10),
+                                "Seconds to measure for")
+            ("warmup,w",        po::value<double>()->default_value(2),
+                                "Seconds to run before measuring")
+            ("rate,r",          po::value<double>()->default_value(0),
+                                "Target requests per second over all connections, "
+                                "0 for as fast as possible")
+            ("post",            po::value<double>()->default_value(0),
+                                "Fraction of requests which are POST, 0 to 1")
+            ("request-body",    po::value<std::size_t>()->default_value(256),
+                                "Body size of POST requests")
+            ("response-body",   po::value<std::size_t>()->default_value(1024),
+                                "Body size of responses to GET")
+            ;
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+        if(vm.count("help"))
+        {
+            std::cerr <<
+                "Usage: " << argv[0] << " [options]\n" << desc;
+            return EXIT_SUCCESS;
+        }
+
+        options opt;
+        opt.connections = vm["connections"].as<std::size_t>();
+        opt.threads = vm["threads"].as<std::size_t>();
+        opt.depth = vm["depth"].as<std::size_t>();
+        opt.rate = vm["rate"].as<double>();
+        opt.post = vm["post"].as<double>();
+        opt.warmup = std::chrono::duration_cast<clock_type::duration>(
+            std::chrono::duration<double>(vm["warmup"].as<double>()));
+        opt.duration = std::chrono::duration_cast<clock_type::duration>(
+            std::chrono::duration<double>(vm["duration"].as<double>()));
+        if( opt.connections == 0 || opt.threads == 0 ||
+            opt.depth == 0 || opt.post < 0 || opt.post > 1 ||
+            opt.rate < 0)
+        {
+            std::cerr << "Invalid options\n" << desc;
+            return EXIT_FAILURE;
+        }
+
+        // Find a free port on the loopback interface
+        tcp::endpoint ep{ip::address_v4::loopback(), 0};
+        {
+            asio::io_service ios;
+            tcp::acceptor a{ios, ep};
+            ep = a.local_endpoint();
+        }
+
+        // Start the server
+        error_code ec;
+        framework::server instance{
+            vm["server-threads"].as<std::size_t>()};
+        auto const port = instance.make_port<
+            framework::http_async_port<bench_service>>(
+                ec, ep, instance, std::cerr);
+        if(ec)
+        {
+            std::cerr << "open: " << ec.message() << std::endl;
+            return EXIT_FAILURE;
+        }
+        port->template init<0>(ec,
+            vm["response-body"].as<std::size_t>());
+        if(ec)
+        {
+            std::cerr << "init: " << ec.message() << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        requests reqs;
+        auto const host = boost::lexical_cast<std::string>(ep);
+        reqs.get = requests::make(http::verb::get, host, 0);
+        reqs.post = requests::make(http::verb::post, host,
+            vm["request-body"].as<std::size_t>());
+
+        // Run the clients
+        std::vector<std::unique_ptr<worker>> workers;
+        workers.reserve(opt.threads);
+        for(std::size_t i = 0; i < opt.threads; ++i)
+            workers.emplace_back(new worker);
+        auto const start = clock_type::now();
+        for(std::size_t i = 0; i < opt.connections; ++i)
+        {
+            auto& w = *workers[i % opt.threads];
+            std::make_shared<connection>(
+                std::cerr, w.ios, ep, opt, reqs, w.rep, i + 1)->run(start);
+        }
+        for(auto& w : workers)
+        {
+            auto& ios = w->ios;
+            w->thread = std::thread{
+                [&ios]
+                {
+                    is_client_thread = true;
+                    ios.run();
+                }};
+        }
+
+        // Sample the counters around the measurement
+        auto const client_cpu =
+            [&]
+            {
+                auto t = cpu_duration::zero();
+                for(auto& w : workers)
+                    t += thread_cpu_time(w->thread);
+                return t;
+            };
+        std::this_thread::sleep_until(start + opt.warmup);
+        alloc_snapshot const a0{server_allocs};
+        auto const p0 = process_cpu_time();
+        auto const c0 = client_cpu();
+        std::this_thread::sleep_until(start + opt.warmup + opt.duration);
+        alloc_snapshot const a1{server_allocs};
+        auto const p1 = process_cpu_time();
+        auto const c1 = client_cpu();
+        for(auto& w : workers)
+            w->thread.join();
+
+        report rep;
+        for(auto const& w : workers)
+            rep.merge(w->rep);
+        auto const seconds =
+            std::chrono::duration<double>(opt.duration).count();
+        auto const n = (std::max)(rep.requests, std::uint64_t{1});
+        auto const server_cpu = (p1 - p0) - (c1 - c0);
+        std::cout <<
+            opt.connections << " connections on " <<
+            opt.threads << " threads, depth " << opt.depth << ", " <<
+            (opt.rate > 0 ? boost::lexical_cast<std::string>(
+                opt.rate) + " req/s target" : "no target rate") <<
+            ", " << opt.post * 100 << "% POST\n\n" <<
+            "requests:   " << rep.requests << " (" <<
+                static_cast<std::uint64_t>(rep.requests / seconds) <<
+                " req/s)\n" <<
+            "errors:     " << rep.errors << "\n\n";
+        beast::test::print_latency(std::cout, rep.lat, opt.rate > 0);
+        std::cout << std::setprecision(2) << "\n"
+            "server allocations per request: " <<
+                static_cast<double>(a1.count - a0.count) / n << " (" <<
+                static_cast<double>(a1.bytes - a0.bytes) / n << " bytes)\n" <<
+            "server CPU per request:         " <<
+                static_cast<double>(server_cpu.count()) / n / 1000 << " us\n" <<
+            "client CPU per request:         " <<
+                static_cast<double>((c1 - c0).count()) / n / 1000 << " us\n";
+    }
+    catch(std::exception const& e)
+    {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,761 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Per-connection memory footprint
+//
+// Reports how much memory a connection costs while it is idle:
+//
+// - The size of the objects a connection is made of.
+//
+// - The heap held by each component after it has handled a request
+//   or a message, measured one component at a time on this thread.
+//
+// - The heap and resident memory per idle session, for many HTTP
+//   keep-alive and WebSocket sessions (with and without
+//   permessage-deflate) opened against the asynchronous ports of the
+//   server-framework example running in-process. Each session is left
+//   idle after one request or one echoed message.
+//
+// Heap is counted by a replacement operator new which charges every
+// allocation to the component active on the allocating thread, and
+// credits it back when freed. The clients use plain sockets on their
+// own thread, and are charged separately. Resident memory includes
+// the clients and is only available on Linux; since freed memory is
+// rarely returned to the system, it is most meaningful when a single
+// mode is measured per process. See `memtest --help`.
+
+#include <example/server-framework/http_async_port.hpp>
+#include <example/server-framework/server.hpp>
+#include <example/server-framework/ws_async_port.hpp>
+
+#include <beast/core.hpp>
+#include <beast/http.hpp>
+#include <beast/test/string_iostream.hpp>
+#include <beast/version.hpp>
+#include <beast/websocket.hpp>
+#include <beast/zlib.hpp>
+#include <boost/asio.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/optional.hpp>
+#include <boost/program_options.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace asio = boost::asio;
+namespace ip = boost::asio::ip;
+namespace http = beast::http;
+namespace ws = beast::websocket;
+namespace ph = std::placeholders;
+using tcp = boost::asio::ip::tcp;
+using error_code = beast::error_code;
+
+//------------------------------------------------------------------------------
+//
+// Heap accounting
+//
+//------------------------------------------------------------------------------
+
+namespace {
+
+// What an allocation is charged to
+enum charge : unsigned
+{
+    charge_server,          // any thread without a charge
+    charge_client,          // the client thread
+    charge_http_buffer,
+    charge_http_fields,
+    charge_ws_handshake,
+    charge_ws_read,
+    charge_ws_write,
+    charge_count
+};
+
+struct alignas(64) live_counter
+{
+    std::atomic<std::int64_t> bytes{0};
+    std::atomic<std::int64_t> blocks{0};
+};
+
+live_counter live[charge_count];
+
+thread_local unsigned current_charge = charge_server;
+
+struct block_header
+{
+    std::size_t size;
+    unsigned charge;
+};
+
+std::size_t constexpr header_size =
+    sizeof(block_header) > alignof(std::max_align_t) ?
+        2 * alignof(std::max_align_t) : alignof(std::max_align_t);
+
+// Charges allocations on this thread while in scope
+class scoped_charge
+{
+    unsigned prev_;
+
+public:
+    explicit
+    scoped_charge(unsigned c)
+        : prev_(current_charge)
+    {
+        current_charge = c;
+    }
+
+    ~scoped_charge()
+    {
+        current_charge = prev_;
+    }
+};
+
+std::int64_t
+live_bytes(unsigned c)
+{
+    return live[c].bytes.load();
+}
+
+} // (anon)
+
+void*
+operator new(std::size_t n)
+{
+    auto const p = static_cast<char*>(
+        std::malloc(n + header_size));
+    if(! p)
+        throw std::bad_alloc{};
+    auto const c = current_charge;
+    ::new(p) block_header{n, c};
+    live[c].bytes.fetch_add(static_cast<
+        std::int64_t>(n), std::memory_order_relaxed);
+    live[c].blocks.fetch_add(1, std::memory_order_relaxed);
+    return p + header_size;
+}
+
+void
+operator delete(void* p) noexcept
+{
+    if(! p)
+        return;
+    auto const b = static_cast<char*>(p) - header_size;
+    auto const& h = *reinterpret_cast<block_header const*>(b);
+    live[h.charge].bytes.fetch_sub(static_cast<
+        std::int64_t>(h.size), std::memory_order_relaxed);
+    live[h.charge].blocks.fetch_sub(1, std::memory_order_relaxed);
+    std::free(b);
+}
+
+void
+operator delete(void* p, std::size_t) noexcept
+{
+    operator delete(p);
+}
+
+// Returns the resident set size, or zero if unknown
+std::int64_t
+resident_bytes()
+{
+#ifdef __linux__
+    std::ifstream is{"/proc/self/statm"};
+    std::int64_t pages = 0;
+    std::int64_t resident = 0;
+    if(! (is >> pages >> resident))
+        return 0;
+    return resident * sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+//------------------------------------------------------------------------------
+//
+// Traffic
+//
+//------------------------------------------------------------------------------
+
+std::string const message =
+    "{\"id\":1,\"type\":\"update\",\"value\":\"the quick brown fox\"}";
+
+std::string
+http_request(std::string const& host)
+{
+    return
+        "GET / HTTP/1.1\r\n"
+        "Host: " + host + "\r\n"
+        "User-Agent: " BEAST_VERSION_STRING "\r\n"
+        "\r\n";
+}
+
+std::string
+ws_request(std::string const& host, bool deflate)
+{
+    return
+        "GET / HTTP/1.1\r\n"
+        "Host: " + host + "\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Sec-WebSocket-Version: 13\r\n" +
+        (deflate ?
+            "Sec-WebSocket-Extensions: permessage-deflate\r\n" : "") +
+        "\r\n";
+}
+
+// Returns a masked client text frame holding `message`,
+// compressed if `deflate` is true. The mask key is zero,
+// so the payload needs no masking.
+std::string
+ws_frame(bool deflate)
+{
+    std::string payload = message;
+    if(deflate)
+    {
+        beast::zlib::deflate_stream zo;
+        char out[512];
+        beast::zlib::z_params zs;
+        zs.next_in = message.data();
+        zs.avail_in = message.size();
+        zs.next_out = out;
+        zs.avail_out = sizeof(out);
+        error_code ec;
+        zo.write(zs, beast::zlib::Flush::sync, ec);
+        if(ec || zs.total_out < 4)
+            throw std::logic_error{"deflate failed"};
+        // Remove the 00 00 ff ff tail, per rfc7692
+        payload.assign(out, zs.total_out - 4);
+    }
+    if(payload.size() > 125)
+        throw std::logic_error{"frame too large"};
+    std::string s;
+    s += static_cast<char>(0x81 | (deflate ? 0x40 : 0));
+    s += static_cast<char>(0x80 | payload.size());
+    s.append(4, '\0');
+    s += payload;
+    return s;
+}
+
+//------------------------------------------------------------------------------
+//
+// Components
+//
+//------------------------------------------------------------------------------
+
+void
+print_row(char const* what, std::int64_t n)
+{
+    std::cout << "  " << std::left << std::setw(44) << what <<
+        std::right << std::setw(10) << n << "\n";
+}
+
+void
+print_sizes()
+{
+    std::cout << "Object sizes\n";
+    print_row("websocket::stream<tcp::socket>",
+        sizeof(ws::stream<tcp::socket>));
+    print_row("http::request_parser<dynamic_body>",
+        sizeof(http::request_parser<http::dynamic_body>));
+    print_row("http::request<dynamic_body>",
+        sizeof(http::request<http::dynamic_body>));
+    print_row("http::fields", sizeof(http::fields));
+    print_row("flat_buffer", sizeof(beast::flat_buffer));
+    print_row("multi_buffer", sizeof(beast::multi_buffer));
+    print_row("zlib::deflate_stream", sizeof(beast::zlib::deflate_stream));
+    print_row("zlib::inflate_stream", sizeof(beast::zlib::inflate_stream));
+    print_row("tcp::socket", sizeof(tcp::socket));
+    std::cout << "\n";
+}
+
+// Measure each component on this thread, and
+// report the heap it holds after one use.
+void
+print_components(ws::permessage_deflate const& pmd)
+{
+    std::cout << "Heap held after one use\n";
+
+    // HTTP, as the server-framework connection does it
+    {
+        auto const req = http_request("localhost");
+        beast::flat_buffer buffer{8192};
+        {
+            scoped_charge c{charge_http_buffer};
+            buffer.commit(asio::buffer_copy(
+                buffer.prepare(beast::read_size_or_throw(
+                    buffer, 65536)), asio::buffer(req)));
+        }
+        http::request_parser<http::dynamic_body> p;
+        {
+            scoped_charge c{charge_http_fields};
+            error_code ec;
+            p.put(buffer.data(), ec);
+            if(ec || ! p.is_done())
+                throw std::logic_error{"parse failed"};
+        }
+        print_row("http read buffer", live_bytes(charge_http_buffer));
+        print_row("http request fields", live_bytes(charge_http_fields));
+    }
+
+    // WebSocket, without and with permessage-deflate
+    for(auto const deflate : {false, true})
+    {
+        auto const base = [&]
+            {
+                std::array<std::int64_t, 3> v;
+                v[0] = live_bytes(charge_ws_handshake);
+                v[1] = live_bytes(charge_ws_read);
+                v[2] = live_bytes(charge_ws_write);
+                return v;
+            }();
+        asio::io_service ios;
+        ws::stream<beast::test::string_iostream> s{ios,
+            ws_request("localhost", deflate) + ws_frame(deflate)};
+        auto opt = pmd;
+        opt.server_enable = deflate;
+        s.set_option(opt);
+        // Keep the output string out of the measurement
+        s.next_layer().str.reserve(4096);
+        {
+            scoped_charge c{charge_ws_handshake};
+            s.accept();
+        }
+        char buf[512];
+        std::size_t n = 0;
+        {
+            scoped_charge c{charge_ws_read};
+            while(! s.is_message_done())
+                n += s.read_some(asio::buffer(buf + n, sizeof(buf) - n));
+        }
+        {
+            scoped_charge c{charge_ws_write};
+            s.write(asio::buffer(buf, n));
+        }
+        print_row(deflate ?
+            "websocket handshake, deflate" :
+            "websocket handshake",
+            live_bytes(charge_ws_handshake) - base[0]);
+        print_row(deflate ?
+            "websocket read, with inflate state" :
+            "websocket read",
+            live_bytes(charge_ws_read) - base[1]);
+        print_row(deflate ?
+            "websocket write, with deflate state" :
+            "websocket write",
+            live_bytes(charge_ws_write) - base[2]);
+    }
+    std::cout << "\n";
+}
+
+//------------------------------------------------------------------------------
+//
+// Idle sessions
+//
+//------------------------------------------------------------------------------
+
+/*  A service for the server-framework which answers GET.
+
+    Meets the requirements of @b Service
+*/
+class hello_service
+{
+public:
+    void
+    init(error_code& ec)
+    {
+        ec = {};
+    }
+
+    template<
+        class Stream,
+        class Body, class Fields,
+        class Send>
+    bool
+    respond(
+        Stream&&,
+        framework::endpoint_type const&,
+        http::request<Body, Fields>&& req,
+        Send const& send) const
+    {
+        if(req.method() != http::verb::get)
+            return false;
+        http::response<http::string_body> res;
+        res.version = req.version;
+        res.result(http::status::ok);
+        res.set(http::field::server, BEAST_VERSION_STRING);
+        res.body = "Hello";
+        res.prepare_payload();
+        res.keep_alive(req.keep_alive());
+        send(std::move(res));
+        return true;
+    }
+};
+
+// A client which sends one request or message and
+// reads until the reply is complete, then stays idle.
+class client
+    : public std::enable_shared_from_this<client>
+{
+    tcp::socket sock_;
+    tcp::endpoint ep_;
+    std::string const& out_;
+    bool ws_;
+    std::atomic<std::size_t>& done_;
+    std::atomic<std::size_t>& errors_;
+    std::array<char, 512> buf_;
+    std::string in_;
+
+public:
+    client(
+        asio::io_service& ios,
+        tcp::endpoint const& ep,
+        std::string const& out,
+        bool ws,
+        std::atomic<std::size_t>& done,
+        std::atomic<std::size_t>& errors)
+        : sock_(ios)
+        , ep_(ep)
+        , out_(out)
+        , ws_(ws)
+        , done_(done)
+        , errors_(errors)
+    {
+    }
+
+    void
+    run()
+    {
+        sock_.async_connect(ep_,
+            std::bind(
+                &client::on_connect,
+                shared_from_this(),
+                ph::_1));
+    }
+
+    void
+    close()
+    {
+        error_code ec;
+        sock_.close(ec);
+    }
+
+private:
+    void
+    fail()
+    {
+        ++errors_;
+        ++done_;
+    }
+
+    void
+    on_connect(error_code ec)
+    {
+        if(ec)
+            return fail();
+        asio::async_write(sock_, asio::buffer(out_),
+            std::bind(
+                &client::on_write,
+                shared_from_this(),
+                ph::_1));
+    }
+
+    void
+    on_write(error_code ec)
+    {
+        if(ec)
+            return fail();
+        do_read();
+    }
+
+    void
+    do_read()
+    {
+        sock_.async_read_some(asio::buffer(buf_),
+            std::bind(
+                &client::on_read,
+                shared_from_this(),
+                ph::_1, ph::_2));
+    }
+
+    // Returns `true` if the whole reply arrived
+    bool
+    complete() const
+    {
+        auto const pos = in_.find("\r\n\r\n");
+        if(pos == std::string::npos)
+            return false;
+        if(! ws_)
+            return true;
+        // The echoed frame follows the 101 response
+        auto const frame = pos + 4;
+        if(in_.size() < frame + 2)
+            return false;
+        auto const len = static_cast<unsigned char>(
+            in_[frame + 1]) & 0x7f;
+        return in_.size() >= frame + 2 + len;
+    }
+
+    void
+    on_read(error_code ec, std::size_t bytes_transferred)
+    {
+        if(ec)
+            return fail();
+        in_.append(buf_.data(), bytes_transferred);
+        if(! complete())
+            return do_read();
+        std::string{}.swap(in_);
+        ++done_;
+    }
+};
+
+// Returns an unused port on the loopback interface
+tcp::endpoint
+free_endpoint()
+{
+    asio::io_service ios;
+    tcp::acceptor a{ios, tcp::endpoint{ip::address_v4::loopback(), 0}};
+    return a.local_endpoint();
+}
+
+template<class Rep, class Period>
+bool
+wait_until(std::function<bool()> const& pred,
+    std::chrono::duration<Rep, Period> timeout)
+{
+    auto const until = std::chrono::steady_clock::now() + timeout;
+    while(! pred())
+    {
+        if(std::chrono::steady_clock::now() >= until)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+// Open idle sessions and report the memory each one holds
+void
+measure_sessions(
+    char const* what,
+    asio::io_service& ios,
+    tcp::endpoint const& ep,
+    std::string const& out,
+    bool is_ws,
+    std::size_t count)
+{
+    std::atomic<std::size_t> done{0};
+    std::atomic<std::size_t> errors{0};
+    std::vector<std::shared_ptr<client>> clients;
+    clients.reserve(count);
+
+    // Let anything left over from a previous run settle
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto const heap0 = live_bytes(charge_server);
+    auto const rss0 = resident_bytes();
+
+    // Clients are created and destroyed on their own thread
+    {
+        std::promise<void> started;
+        ios.post(
+            [&]
+            {
+                for(std::size_t i = 0; i < count; ++i)
+                {
+                    clients.emplace_back(std::make_shared<client>(
+                        ios, ep, out, is_ws, done, errors));
+                    clients.back()->run();
+                }
+                started.set_value();
+            });
+        started.get_future().wait();
+    }
+    if(! wait_until([&]{ return done == count; },
+            std::chrono::seconds(60)))
+        std::cerr << what << ": timed out" << std::endl;
+
+    // Give the server time to finish up after the last reply
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    auto const heap1 = live_bytes(charge_server);
+    auto const rss1 = resident_bytes();
+    auto const n = static_cast<std::int64_t>(
+        count - errors > 0 ? count - errors : 1);
+    std::cout << "  " << std::left << std::setw(24) << what <<
+        std::right <<
+        std::setw(14) << (heap1 - heap0) / n <<
+        std::setw(14) << (rss0 && rss1 ? (rss1 - rss0) / n : 0) <<
+        std::setw(10) << errors << "\n";
+
+    // Close the clients, and wait for the server to notice
+    {
+        std::promise<void> closed;
+        ios.post(
+            [&]
+            {
+                for(auto const& c : clients)
+                    c->close();
+                clients.clear();
+                closed.set_value();
+            });
+        closed.get_future().wait();
+    }
+    wait_until([&]{ return live_bytes(charge_server) <= heap0; },
+        std::chrono::seconds(5));
+}
+
+int
+main(int argc, char** argv)
+{
+    namespace po = boost::program_options;
+
+    try
+    {
+        po::options_description desc("Options");
+        desc.add_options()
+            ("help,h",          "Show this message")
+            ("sessions,n",      po::value<std::size_t>()->default_value(1000),
+                                "Number of idle sessions, each uses two descriptors")
+            ("server-threads",  po::value<std::size_t>()->default_value(1),
+                                "Threads for the server")
+            ("mode,m",          po::value<std::string>()->default_value("all"),
+                                "Sessions to open: http, ws, ws-deflate, or all")
+            ("window-bits",     po::value<int>()->default_value(15),
+                                "permessage-deflate window bits, 8 to 15")
+            ("mem-level",       po::value<int>()->default_value(4),
+                                "permessage-deflate memory level")
+            ;
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+        if(vm.count("help"))
+        {
+            std::cerr <<
+                "Usage: " << argv[0] << " [options]\n" << desc;
+            return EXIT_SUCCESS;
+        }
+        auto const sessions = vm["sessions"].as<std::size_t>();
+        auto const mode = vm["mode"].as<std::string>();
+        if( sessions == 0 || (mode != "all" && mode != "http" &&
+            mode != "ws" && mode != "ws-deflate"))
+        {
+            std::cerr << "Invalid options\n" << desc;
+            return EXIT_FAILURE;
+        }
+
+        ws::permessage_deflate pmd;
+        pmd.client_enable = true;
+        pmd.server_enable = true;
+        pmd.server_max_window_bits = vm["window-bits"].as<int>();
+        pmd.client_max_window_bits = pmd.server_max_window_bits;
+        pmd.memLevel = vm["mem-level"].as<int>();
+
+        print_sizes();
+        print_components(pmd);
+
+        // Start the server. Its log is discarded, since
+        // every session reports an error when closed.
+        std::ostream log{nullptr};
+        error_code ec;
+        framework::server instance{
+            vm["server-threads"].as<std::size_t>()};
+        auto const http_ep = free_endpoint();
+        auto const hp = instance.make_port<
+            framework::http_async_port<hello_service>>(
+                ec, http_ep, instance, log);
+        if(! ec)
+            hp->template init<0>(ec);
+        if(ec)
+        {
+            std::cerr << "http port: " << ec.message() << std::endl;
+            return EXIT_FAILURE;
+        }
+        auto const ws_ep = free_endpoint();
+        instance.make_port<framework::ws_async_port>(
+            ec, ws_ep, instance, log,
+            [](ws::stream<framework::socket_type>& s)
+            {
+                s.auto_fragment(false);
+            });
+        if(ec)
+        {
+            std::cerr << "ws port: " << ec.message() << std::endl;
+            return EXIT_FAILURE;
+        }
+        auto const wsd_ep = free_endpoint();
+        instance.make_port<framework::ws_async_port>(
+            ec, wsd_ep, instance, log,
+            [pmd](ws::stream<framework::socket_type>& s)
+            {
+                s.auto_fragment(false);
+                s.set_option(pmd);
+            });
+        if(ec)
+        {
+            std::cerr << "ws deflate port: " << ec.message() << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        // Start the client thread
+        asio::io_service ios{1};
+        boost::optional<asio::io_service::work> work{ios};
+        std::thread t{
+            [&ios]
+            {
+                current_charge = charge_client;
+                ios.run();
+            }};
+
+        auto const host =
+            [](tcp::endpoint const& ep)
+            {
+                return boost::lexical_cast<std::string>(ep);
+            };
+        std::string const http_out = http_request(host(http_ep));
+        std::string const ws_out =
+            ws_request(host(ws_ep), false) + ws_frame(false);
+        std::string const wsd_out =
+            ws_request(host(wsd_ep), true) + ws_frame(true);
+
+        std::cout <<
+            "Idle sessions (" << sessions << ")" <<
+                "        heap/session   RSS/session    errors\n";
+        if(mode == "all" || mode == "http")
+            measure_sessions("http keep-alive",
+                ios, http_ep, http_out, false, sessions);
+        if(mode == "all" || mode == "ws")
+            measure_sessions("websocket",
+                ios, ws_ep, ws_out, true, sessions);
+        if(mode == "all" || mode == "ws-deflate")
+            measure_sessions("websocket deflate",
+                ios, wsd_ep, wsd_out, true, sessions);
+
+        work = boost::none;
+        t.join();
+    }
+    catch(std::exception const& e)
+    {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
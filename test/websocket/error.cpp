@@ -38,6 +38,7 @@ public:
         check("beast.websocket", error::failed);
         check("beast.websocket", error::handshake_failed);
         check("beast.websocket", error::buffer_overflow);
+        check("beast.websocket", error::timeout);
     }
 };
 
@@ -0,0 +1,107 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Test that header file is self-contained.
+#include <beast/websocket/detail/frag_policy.hpp>
+
+#include <beast/unit_test/suite.hpp>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+class frag_policy_test : public beast::unit_test::suite
+{
+public:
+    using clock_type = frag_policy::clock_type;
+
+    void
+    testDisabled()
+    {
+        frag_policy p;
+        p.limit(4096);
+        BEAST_EXPECT(p.size() == 4096);
+        BEAST_EXPECT(p.start() == clock_type::time_point{});
+        p.stop(clock_type::now() - std::chrono::seconds(1), 100);
+        BEAST_EXPECT(p.size() == 4096);
+        p.limit(1000);
+        BEAST_EXPECT(p.size() == 1000);
+        p.limit(8000);
+        BEAST_EXPECT(p.size() == 8000);
+    }
+
+    void
+    testShrink()
+    {
+        frag_policy p;
+        p.budget(std::chrono::milliseconds(10));
+        p.limit(65536);
+        BEAST_EXPECT(p.size() == 65536);
+
+        // 10000 bytes in one second, about 100 in 10ms
+        p.stop(clock_type::now() -
+            std::chrono::seconds(1), 10000);
+        BEAST_EXPECT(p.size() == 512);
+
+        // 32000 bytes in 100ms, about 3200 in 10ms,
+        // but the size grows by at most double
+        p.stop(clock_type::now() -
+            std::chrono::milliseconds(100), 32000);
+        BEAST_EXPECT(p.size() == 1024);
+
+        // Kept across messages
+        auto const n = p.size();
+        p.limit(65536);
+        BEAST_EXPECT(p.size() == n);
+        p.limit(256);
+        BEAST_EXPECT(p.size() == 256);
+        p.stop(clock_type::now() -
+            std::chrono::seconds(1), 10);
+        BEAST_EXPECT(p.size() == 256);
+    }
+
+    void
+    testGrow()
+    {
+        frag_policy p;
+        p.budget(std::chrono::milliseconds(10));
+        p.limit(65536);
+        p.stop(clock_type::now() -
+            std::chrono::seconds(1), 10000);
+        BEAST_EXPECT(p.size() == 512);
+
+        // A quick write at most doubles the size
+        p.stop(p.start(), 512);
+        BEAST_EXPECT(p.size() == 1024);
+        p.stop(p.start(), 1024);
+        BEAST_EXPECT(p.size() == 2048);
+        for(int i = 0; i < 10; ++i)
+            p.stop(p.start(), p.size());
+        BEAST_EXPECT(p.size() == 65536);
+
+        // Changing the budget starts over
+        p.stop(clock_type::now() -
+            std::chrono::seconds(1), 10000);
+        BEAST_EXPECT(p.size() == 512);
+        p.budget(std::chrono::milliseconds(20));
+        BEAST_EXPECT(p.size() == 65536);
+    }
+
+    void
+    run() override
+    {
+        testDisabled();
+        testShrink();
+        testGrow();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(frag_policy,websocket,beast);
+
+} // detail
+} // websocket
+} // beast
@@ -0,0 +1,155 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Test that header file is self-contained.
+#include <beast/websocket/detail/keepalive.hpp>
+
+#include <beast/unit_test/suite.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <memory>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+class keepalive_test : public beast::unit_test::suite
+{
+public:
+    using clock_type = keepalive_hook::clock_type;
+
+    struct test_hook : keepalive_hook
+    {
+        std::size_t checks = 0;
+
+        test_hook() = default;
+        test_hook(test_hook&&) = default;
+        test_hook& operator=(test_hook&&) = default;
+
+        static
+        void
+        check(keepalive_hook& h, clock_type::time_point)
+        {
+            ++static_cast<test_hook&>(h).checks;
+        }
+
+        void
+        link(boost::asio::io_service& ios,
+            clock_type::duration period)
+        {
+            ka_link(boost::asio::use_service<
+                keepalive_service>(ios), &check, period);
+        }
+
+        void
+        unlink()
+        {
+            ka_unlink();
+        }
+
+        bool
+        linked() const
+        {
+            return ka_linked();
+        }
+    };
+
+    void
+    testPeriods()
+    {
+        using std::chrono::milliseconds;
+        boost::asio::io_service ios;
+        test_hook fast;
+        test_hook slow;
+        fast.link(ios, milliseconds(4));
+        slow.link(ios, milliseconds(2000));
+        boost::asio::steady_timer t1{ios};
+        boost::asio::steady_timer t2{ios};
+        t1.expires_from_now(milliseconds(50));
+        t1.async_wait(
+            [&](error_code)
+            {
+                fast.unlink();
+            });
+        t2.expires_from_now(milliseconds(100));
+        t2.async_wait(
+            [&](error_code)
+            {
+                slow.unlink();
+            });
+        auto const start = clock_type::now();
+        ios.run();
+        // The fast stream is checked about every
+        // millisecond, without checking the slow one.
+        BEAST_EXPECT(fast.checks > 5);
+        BEAST_EXPECT(slow.checks == 0);
+        // Unlinking the last stream stops the timer,
+        // rather than waiting for its next check.
+        BEAST_EXPECT(clock_type::now() - start < milliseconds(400));
+    }
+
+    void
+    testMove()
+    {
+        using std::chrono::milliseconds;
+        boost::asio::io_service ios;
+        test_hook a;
+        test_hook b;
+        test_hook c;
+        a.link(ios, milliseconds(8));
+        b.link(ios, milliseconds(8));
+        c.link(ios, milliseconds(8));
+        // Move the middle of the queue
+        test_hook d{std::move(b)};
+        BEAST_EXPECT(! b.linked());
+        BEAST_EXPECT(d.linked());
+        b = std::move(d);
+        BEAST_EXPECT(b.linked());
+        BEAST_EXPECT(! d.linked());
+        boost::asio::steady_timer t{ios};
+        t.expires_from_now(milliseconds(50));
+        t.async_wait(
+            [&](error_code)
+            {
+                a.unlink();
+                b.unlink();
+                c.unlink();
+            });
+        ios.run();
+        BEAST_EXPECT(a.checks > 0);
+        BEAST_EXPECT(b.checks > 0);
+        BEAST_EXPECT(c.checks > 0);
+        BEAST_EXPECT(d.checks == 0);
+    }
+
+    void
+    testShutdown()
+    {
+        using std::chrono::milliseconds;
+        test_hook h;
+        {
+            boost::asio::io_service ios;
+            h.link(ios, milliseconds(8));
+            BEAST_EXPECT(h.linked());
+        }
+        BEAST_EXPECT(! h.linked());
+        h.unlink();
+    }
+
+    void
+    run() override
+    {
+        testPeriods();
+        testMove();
+        testShutdown();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(keepalive,websocket,beast);
+
+} // detail
+} // websocket
+} // beast
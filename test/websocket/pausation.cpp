@@ -0,0 +1,158 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Test that header file is self-contained.
+#include <beast/websocket/detail/pausation.hpp>
+
+#include <beast/unit_test/suite.hpp>
+#include <cstddef>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+class pausation_test : public beast::unit_test::suite
+{
+public:
+    struct counts
+    {
+        int allocs = 0;
+        int deallocs = 0;
+        int calls = 0;
+        int live = 0;
+    };
+
+    struct test_handler
+    {
+        counts* c;
+
+        void
+        operator()() const
+        {
+            ++c->calls;
+        }
+
+        friend
+        void*
+        asio_handler_allocate(
+            std::size_t size, test_handler* h)
+        {
+            ++h->c->allocs;
+            return ::operator new(size);
+        }
+
+        friend
+        void
+        asio_handler_deallocate(
+            void* p, std::size_t, test_handler* h)
+        {
+            ++h->c->deallocs;
+            ::operator delete(p);
+        }
+    };
+
+    // Stands in for a composed operation
+    class op
+    {
+        test_handler h_;
+
+    public:
+        explicit
+        op(counts& c)
+            : h_{&c}
+        {
+            ++c.live;
+        }
+
+        op(op&& other)
+            : h_(other.h_)
+        {
+            ++h_.c->live;
+        }
+
+        ~op()
+        {
+            --h_.c->live;
+        }
+
+        test_handler&
+        handler()
+        {
+            return h_;
+        }
+
+        void
+        operator()()
+        {
+            h_();
+        }
+    };
+
+    void
+    testSave()
+    {
+        // invoke
+        {
+            counts c;
+            {
+                pausation p;
+                p.save(op{c});
+                BEAST_EXPECT(c.allocs == 1);
+                BEAST_EXPECT(c.live == 1);
+                BEAST_EXPECT(p.maybe_invoke());
+                BEAST_EXPECT(! p.maybe_invoke());
+            }
+            BEAST_EXPECT(c.calls == 1);
+            BEAST_EXPECT(c.deallocs == 1);
+            BEAST_EXPECT(c.live == 0);
+        }
+
+        // destroy without invoking
+        {
+            counts c;
+            {
+                pausation p;
+                p.save(op{c});
+            }
+            BEAST_EXPECT(c.calls == 0);
+            BEAST_EXPECT(c.allocs == 1);
+            BEAST_EXPECT(c.deallocs == 1);
+            BEAST_EXPECT(c.live == 0);
+        }
+
+        // move, then invoke
+        {
+            counts c;
+            {
+                pausation p0;
+                p0.save(op{c});
+                pausation p1{std::move(p0)};
+                BEAST_EXPECT(! p0.maybe_invoke());
+                pausation p2;
+                p2 = std::move(p1);
+                BEAST_EXPECT(! p1.maybe_invoke());
+                BEAST_EXPECT(p2.maybe_invoke());
+            }
+            BEAST_EXPECT(c.calls == 1);
+            BEAST_EXPECT(c.allocs == 1);
+            BEAST_EXPECT(c.deallocs == 1);
+            BEAST_EXPECT(c.live == 0);
+        }
+    }
+
+    void
+    run() override
+    {
+        testSave();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(pausation,websocket,beast);
+
+} // detail
+} // websocket
+} // beast
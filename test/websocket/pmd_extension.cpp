@@ -0,0 +1,271 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Test that header file is self-contained.
+#include <beast/websocket/detail/pmd_extension.hpp>
+
+#include <beast/unit_test/suite.hpp>
+#include <array>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+
+namespace beast {
+namespace websocket {
+namespace detail {
+
+class pmd_extension_test : public beast::unit_test::suite
+{
+public:
+    static
+    std::string
+    random_string(std::size_t n)
+    {
+        std::mt19937 g;
+        std::string s;
+        s.reserve(n);
+        while(n--)
+            s.push_back(static_cast<char>(g()));
+        return s;
+    }
+
+    void
+    testCompressible()
+    {
+        using boost::asio::buffer;
+
+        // text
+        {
+            std::string s;
+            while(s.size() < 4096)
+                s.append("{\"id\":12345,\"name\":\"Hello, world!\"}");
+            BEAST_EXPECT(is_compressible(buffer(s)));
+        }
+
+        // random
+        BEAST_EXPECT(! is_compressible(buffer(random_string(4096))));
+
+        // too small to judge
+        BEAST_EXPECT(is_compressible(buffer(random_string(100))));
+
+        // random, but repeating
+        {
+            auto const r = random_string(200);
+            auto const s = r + r + r + r + r;
+            BEAST_EXPECT(is_compressible(buffer(s)));
+        }
+
+        // split across buffers
+        {
+            auto const s = random_string(4096);
+            std::array<boost::asio::const_buffer, 2> b{{
+                buffer(s.data(), 300),
+                buffer(s.data() + 300, s.size() - 300)}};
+            BEAST_EXPECT(! is_compressible(b));
+        }
+    }
+
+    void
+    testPool()
+    {
+        // Storage is leased back on the same thread
+        pmd_allocator<std::uint8_t> a;
+        auto const p = a.allocate(1000);
+        a.deallocate(p, 1000);
+        auto const p1 = a.allocate(1000);
+        BEAST_EXPECT(p1 == p);
+        auto const p2 = a.allocate(1000);
+        BEAST_EXPECT(p2 != p1);
+        a.deallocate(p1, 1000);
+        a.deallocate(p2, 1000);
+
+        // Storage given back after the pool of the thread
+        // is destroyed goes to the heap, run with a leak
+        // checker or sanitizer to see the difference.
+        struct holder
+        {
+            void* p = nullptr;
+
+            ~holder()
+            {
+                pmd_pool::deallocate(p, 1000);
+                pmd_pool::deallocate(
+                    pmd_pool::allocate(1000), 1000);
+            }
+        };
+        std::thread t{
+            []
+            {
+                // Constructed before the pool, destroyed after it
+                static thread_local holder h;
+                h.p = pmd_pool::allocate(1000);
+            }};
+        t.join();
+
+        // A stream returns its buffers on clear
+        std::string const s(10000, '*');
+        zlib::basic_deflate_stream<
+            pmd_allocator<std::uint8_t>> zo;
+        zo.reset(6, 9, 1, zlib::Strategy::normal);
+        for(int i = 0; i < 2; ++i)
+        {
+            char out[1024];
+            zlib::z_params zs;
+            zs.next_in = s.data();
+            zs.avail_in = s.size();
+            zs.next_out = out;
+            zs.avail_out = sizeof(out);
+            error_code ec;
+            zo.write(zs, zlib::Flush::sync, ec);
+            BEAST_EXPECTS(! ec, ec.message());
+            BEAST_EXPECT(zs.avail_in == 0);
+            zo.clear();
+        }
+    }
+
+    struct fake_deflate_stream
+    {
+        int level = -1;
+
+        void
+        params(zlib::z_params&, int level_,
+            zlib::Strategy, error_code&)
+        {
+            level = level_;
+        }
+    };
+
+    void
+    testPolicy()
+    {
+        using clock_type = pmd_policy::clock_type;
+
+        // pause after messages which do not shrink
+        {
+            pmd_policy p;
+            fake_deflate_stream zo;
+            p.reset(true, 6);
+            for(int i = 0; i < 4; ++i)
+            {
+                BEAST_EXPECT(p.begin());
+                p.stop(p.start(), 1000, 1000);
+                p.end(zo);
+            }
+            for(int i = 0; i < 16; ++i)
+                BEAST_EXPECT(! p.begin());
+            BEAST_EXPECT(p.begin());
+            BEAST_EXPECT(zo.level == -1);
+        }
+
+        // lower the level when it costs too much
+        {
+            pmd_policy p;
+            fake_deflate_stream zo;
+            p.reset(true, 6);
+            p.stop(clock_type::now() -
+                std::chrono::seconds(1), 1000, 500);
+            p.end(zo);
+            BEAST_EXPECT(p.level() == 5);
+            BEAST_EXPECT(zo.level == 5);
+
+            // and raise it when it is cheap
+            p.stop(clock_type::now(), 1000000, 1000);
+            p.end(zo);
+            BEAST_EXPECT(p.level() == 6);
+            BEAST_EXPECT(zo.level == 6);
+
+            // but not past the configured level
+            zo.level = -1;
+            p.stop(clock_type::now(), 1000000, 1000);
+            p.end(zo);
+            BEAST_EXPECT(p.level() == 6);
+            BEAST_EXPECT(zo.level == -1);
+        }
+
+        // disabled
+        {
+            pmd_policy p;
+            fake_deflate_stream zo;
+            p.reset(false, 6);
+            for(int i = 0; i < 8; ++i)
+            {
+                BEAST_EXPECT(p.begin());
+                p.stop(p.start(), 1000, 1000);
+                p.end(zo);
+            }
+            BEAST_EXPECT(zo.level == -1);
+        }
+    }
+
+    void
+    testPredictor()
+    {
+        pmd_predictor p;
+        BEAST_EXPECT(p.size() == 0);
+        BEAST_EXPECT(p.expect(1000) == 4000);
+
+        // ratio rises at most twofold per message
+        p.consume(600);
+        p.consume(400);
+        p.end(10000);
+        BEAST_EXPECT(p.expect(1000) == 8000);
+        BEAST_EXPECT(p.size() == 2500);
+        p.consume(1000);
+        p.end(10000);
+        BEAST_EXPECT(p.expect(1000) == 10000);
+
+        // and falls slowly
+        p.consume(1000);
+        p.end(2000);
+        BEAST_EXPECT(p.expect(1000) == 8000);
+
+        // never below one
+        for(int i = 0; i < 20; ++i)
+        {
+            p.consume(1000);
+            p.end(10);
+        }
+        BEAST_EXPECT(p.expect(1000) == 1000);
+
+        // small messages do not change the ratio
+        p.consume(10);
+        p.end(100000);
+        BEAST_EXPECT(p.expect(1000) == 1000);
+
+        // one message at the deflate limit
+        p.consume(1000);
+        p.end(1032000);
+        BEAST_EXPECT(p.expect(1000) == 2000);
+        for(int i = 0; i < 20; ++i)
+        {
+            p.consume(1000);
+            p.end(1032000);
+        }
+        BEAST_EXPECT(p.expect(1000) == 1032000);
+
+        // no overflow
+        BEAST_EXPECT(p.expect((std::numeric_limits<
+            std::uint64_t>::max)()) == (std::numeric_limits<
+                std::size_t>::max)());
+    }
+
+    void
+    run() override
+    {
+        testCompressible();
+        testPool();
+        testPolicy();
+        testPredictor();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(pmd_extension,websocket,beast);
+
+} // detail
+} // websocket
+} // beast
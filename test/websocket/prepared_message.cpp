@@ -0,0 +1,181 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Test that header file is self-contained.
+#include <beast/websocket/prepared_message.hpp>
+
+#include <beast/websocket/stream.hpp>
+#include <beast/zlib/inflate_stream.hpp>
+#include <beast/test/string_iostream.hpp>
+#include <beast/unit_test/suite.hpp>
+#include <boost/asio/io_service.hpp>
+#include <string>
+
+namespace beast {
+namespace websocket {
+
+class prepared_message_test : public beast::unit_test::suite
+{
+public:
+    boost::asio::io_service ios_;
+
+    static
+    std::string
+    request(bool deflate, bool no_context_takeover)
+    {
+        std::string s =
+            "GET / HTTP/1.1\r\n"
+            "Host: localhost\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 13\r\n";
+        if(deflate)
+        {
+            s += "Sec-WebSocket-Extensions: permessage-deflate";
+            if(no_context_takeover)
+                s += "; server_no_context_takeover";
+            s += "\r\n";
+        }
+        s += "\r\n";
+        return s;
+    }
+
+    static
+    std::string
+    inflate(string_view payload)
+    {
+        std::string in = payload.to_string();
+        in.append("\x00\x00\xff\xff", 4);
+        std::string out;
+        out.resize(65536);
+        zlib::inflate_stream zi;
+        zlib::z_params zs;
+        zs.next_in = in.data();
+        zs.avail_in = in.size();
+        zs.next_out = &out[0];
+        zs.avail_out = out.size();
+        error_code ec;
+        zi.write(zs, zlib::Flush::sync, ec);
+        out.resize(zs.total_out);
+        return out;
+    }
+
+    void
+    testMessage()
+    {
+        using boost::asio::buffer;
+        std::string const s = "Hello, world!";
+
+        prepared_message m0;
+        BEAST_EXPECT(! m0);
+
+        prepared_message m1{buffer(s)};
+        BEAST_EXPECT(m1);
+        BEAST_EXPECT(! m1.binary());
+        BEAST_EXPECT(m1.size() == s.size());
+        BEAST_EXPECT(! m1.compressed());
+
+        permessage_deflate pmd;
+        pmd.server_enable = true;
+
+        // too small to shrink
+        prepared_message m2{buffer(s), true, pmd};
+        BEAST_EXPECT(m2.binary());
+        BEAST_EXPECT(! m2.compressed());
+
+        std::string const big(4096, '*');
+        prepared_message m3{buffer(big), false, pmd};
+        BEAST_EXPECT(m3.compressed());
+
+        // copies share storage
+        auto m4 = m3;
+        BEAST_EXPECT(m4.compressed());
+        BEAST_EXPECT(m4.size() == big.size());
+    }
+
+    void
+    testWrite()
+    {
+        using boost::asio::buffer;
+        std::string const s = "Hello";
+        prepared_message const m{buffer(s)};
+        stream<test::string_iostream> ws{
+            ios_, request(false, false)};
+        ws.accept();
+        ws.next_layer().str.clear();
+        ws.write(m);
+        BEAST_EXPECT(ws.next_layer().str == "\x81\x05Hello");
+
+        ws.next_layer().str.clear();
+        error_code ec;
+        ws.async_write(m,
+            [&](error_code ec_)
+            {
+                ec = ec_;
+            });
+        ios_.run();
+        ios_.reset();
+        BEAST_EXPECTS(! ec, ec.message());
+        BEAST_EXPECT(ws.next_layer().str == "\x81\x05Hello");
+    }
+
+    void
+    testDeflate()
+    {
+        using boost::asio::buffer;
+        std::string s;
+        while(s.size() < 4096)
+            s.append("{\"id\":12345,\"name\":\"Hello, world!\"}");
+        permessage_deflate pmd;
+        pmd.server_enable = true;
+        prepared_message const m{buffer(s), false, pmd};
+        BEAST_EXPECT(m.compressed());
+
+        auto const check =
+            [&](bool no_context_takeover, bool compressed)
+            {
+                stream<test::string_iostream> ws{ios_,
+                    request(true, no_context_takeover)};
+                ws.set_option(pmd);
+                ws.accept();
+                ws.next_layer().str.clear();
+                ws.write(m);
+                auto const& out = ws.next_layer().str;
+                if(! BEAST_EXPECT(out.size() > 4))
+                    return;
+                BEAST_EXPECT(static_cast<unsigned char>(out[0]) ==
+                    (compressed ? 0xc1 : 0x81));
+                auto const n =
+                    (out[1] & 0x7f) == 126 ? 4 : 2;
+                string_view const payload{
+                    out.data() + n, out.size() - n};
+                if(compressed)
+                    BEAST_EXPECT(inflate(payload) == s);
+                else
+                    BEAST_EXPECT(payload == s);
+            };
+
+        check(true, true);
+
+        // compressor context would be out of sync
+        check(false, false);
+    }
+
+    void
+    run() override
+    {
+        testMessage();
+        testWrite();
+        testDeflate();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(prepared_message,websocket,beast);
+
+} // websocket
+} // beast
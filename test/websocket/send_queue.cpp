@@ -0,0 +1,240 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Test that header file is self-contained.
+#include <beast/websocket/send_queue.hpp>
+
+#include <beast/test/fail_stream.hpp>
+#include <beast/test/string_iostream.hpp>
+#include <beast/unit_test/suite.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/optional.hpp>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace beast {
+namespace websocket {
+
+class send_queue_test : public beast::unit_test::suite
+{
+public:
+    static
+    std::string
+    request()
+    {
+        return
+            "GET / HTTP/1.1\r\n"
+            "Host: localhost\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 13\r\n"
+            "\r\n";
+    }
+
+    // Extract the payloads of unmasked frames
+    // following the HTTP response.
+    static
+    std::vector<std::string>
+    payloads(std::string const& s)
+    {
+        std::vector<std::string> v;
+        auto i = s.find("\r\n\r\n");
+        if(i == std::string::npos)
+            return v;
+        i += 4;
+        while(i + 2 <= s.size())
+        {
+            std::size_t len = s[i + 1] & 0x7f;
+            i += 2;
+            if(len == 126)
+            {
+                len =
+                    (static_cast<unsigned char>(s[i]) << 8) +
+                     static_cast<unsigned char>(s[i + 1]);
+                i += 2;
+            }
+            v.emplace_back(s.substr(i, len));
+            i += len;
+        }
+        return v;
+    }
+
+    void
+    testProducers()
+    {
+        std::size_t constexpr threads = 4;
+        std::size_t constexpr count = 200;
+
+        boost::asio::io_service ios;
+        stream<test::string_iostream> ws{ios, request()};
+        ws.accept();
+
+        std::atomic<int> high{0};
+        std::atomic<int> low{0};
+        send_queue<test::string_iostream> q{ws, ios, 1024, 256};
+        q.on_high([&]{ ++high; });
+        q.on_low([&]{ ++low; });
+        q.on_error([&](error_code ec){ fail(ec.message()); });
+
+        boost::optional<boost::asio::io_service::work> work;
+        work.emplace(ios);
+        std::thread writer{[&]{ ios.run(); }};
+        std::vector<std::thread> v;
+        for(std::size_t t = 0; t < threads; ++t)
+            v.emplace_back(
+                [&, t]
+                {
+                    for(std::size_t i = 0; i < count; ++i)
+                    {
+                        auto const s = std::to_string(t) +
+                            ":" + std::to_string(i);
+                        q.push(boost::asio::buffer(s));
+                    }
+                });
+        for(auto& t : v)
+            t.join();
+        work = boost::none;
+        writer.join();
+
+        BEAST_EXPECT(q.size() == 0);
+        BEAST_EXPECT(high == low);
+
+        // Each producer's messages arrive in order
+        auto const m = payloads(ws.next_layer().str);
+        BEAST_EXPECT(m.size() == threads * count);
+        std::vector<std::size_t> next(threads, 0);
+        for(auto const& s : m)
+        {
+            auto const pos = s.find(':');
+            if(! BEAST_EXPECT(pos != std::string::npos))
+                break;
+            auto const t = std::stoul(s.substr(0, pos));
+            auto const i = std::stoul(s.substr(pos + 1));
+            if(! BEAST_EXPECT(t < threads))
+                break;
+            BEAST_EXPECT(i == next[t]);
+            next[t] = i + 1;
+        }
+    }
+
+    void
+    testWatermarks()
+    {
+        boost::asio::io_service ios;
+        stream<test::string_iostream> ws{ios, request()};
+        ws.accept();
+
+        int high = 0;
+        int low = 0;
+        send_queue<test::string_iostream> q{ws, ios, 100, 50};
+        q.on_high([&]{ ++high; });
+        q.on_low([&]{ ++low; });
+        std::string const s(40, '*');
+        BEAST_EXPECT(q.push(boost::asio::buffer(s)));
+        BEAST_EXPECT(q.push(boost::asio::buffer(s), true));
+        BEAST_EXPECT(high == 0);
+        BEAST_EXPECT(q.push(boost::asio::buffer(s)));
+        BEAST_EXPECT(high == 1);
+        BEAST_EXPECT(q.push(boost::asio::buffer(s)));
+        BEAST_EXPECT(high == 1);
+        BEAST_EXPECT(q.size() == 160);
+        ios.run();
+        BEAST_EXPECT(q.size() == 0);
+        BEAST_EXPECT(low == 1);
+        BEAST_EXPECT(payloads(ws.next_layer().str).size() == 4);
+    }
+
+    void
+    testFailure()
+    {
+        using stream_type =
+            test::fail_stream<test::string_iostream>;
+        std::string const s(40, '*');
+        // Fail on the first write after the handshake
+        for(std::size_t n = 1; n < 100; ++n)
+        {
+            boost::asio::io_service ios;
+            stream<stream_type> ws{n, ios, request()};
+            try
+            {
+                ws.accept();
+            }
+            catch(system_error const&)
+            {
+                continue;
+            }
+            int errors = 0;
+            int low = 0;
+            send_queue<stream_type> q{ws, ios, 100, 50};
+            q.on_low([&]{ ++low; });
+            q.on_error(
+                [&](error_code ec)
+                {
+                    ++errors;
+                    BEAST_EXPECT(ec == test::error::fail_error);
+                    // Pending messages are already gone
+                    BEAST_EXPECT(q.size() == 0);
+                });
+            BEAST_EXPECT(q.push(boost::asio::buffer(s)));
+            BEAST_EXPECT(q.push(boost::asio::buffer(s)));
+            BEAST_EXPECT(q.push(boost::asio::buffer(s)));
+            BEAST_EXPECT(q.size() == 120);
+            ios.run();
+            BEAST_EXPECT(errors == 1);
+            BEAST_EXPECT(low == 0);
+            BEAST_EXPECT(q.size() == 0);
+            BEAST_EXPECT(! q.push(boost::asio::buffer(s)));
+            BEAST_EXPECT(q.size() == 0);
+            ios.reset();
+            ios.run();
+            BEAST_EXPECT(errors == 1);
+            return;
+        }
+        fail("accept never succeeded");
+    }
+
+    void
+    testRole()
+    {
+        // A stream with a compile-time role
+        boost::asio::io_service ios;
+        server_stream<test::string_iostream> ws{ios, request()};
+        ws.accept();
+        boost::asio::io_service::strand strand{ios};
+        send_queue<test::string_iostream, server_role,
+            boost::asio::io_service::strand> q{ws, strand, 100, 50};
+        q.on_error([&](error_code ec){ fail(ec.message()); });
+        BEAST_EXPECT(q.push(boost::asio::buffer("Hello", 5)));
+        BEAST_EXPECT(q.push(boost::asio::buffer("World", 5), true));
+        ios.run();
+        BEAST_EXPECT(q.size() == 0);
+        auto const m = payloads(ws.next_layer().str);
+        BEAST_EXPECT(m.size() == 2);
+        if(m.size() == 2)
+        {
+            BEAST_EXPECT(m[0] == "Hello");
+            BEAST_EXPECT(m[1] == "World");
+        }
+    }
+
+    void
+    run() override
+    {
+        testWatermarks();
+        testProducers();
+        testFailure();
+        testRole();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(send_queue,websocket,beast);
+
+} // websocket
+} // beast
@@ -0,0 +1,285 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Test that header file is self-contained.
+#include <beast/websocket/split.hpp>
+
+#include <beast/websocket/stream.hpp>
+#include <beast/core/multi_buffer.hpp>
+#include <beast/test/string_iostream.hpp>
+#include <beast/unit_test/suite.hpp>
+#include <boost/asio/io_service.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace beast {
+namespace websocket {
+
+class split_test : public beast::unit_test::suite
+{
+public:
+    boost::asio::io_service ios_;
+
+    static
+    std::string
+    request()
+    {
+        return
+            "GET / HTTP/1.1\r\n"
+            "Host: localhost\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 13\r\n"
+            "\r\n";
+    }
+
+    // A masked client frame, using a zero key
+    static
+    std::string
+    frame(int op, std::string const& payload)
+    {
+        std::string s;
+        s.push_back(static_cast<char>(0x80 | op));
+        s.push_back(static_cast<char>(0x80 | payload.size()));
+        s.append(4, '\0');
+        s.append(payload);
+        return s;
+    }
+
+    // The opcodes of the unmasked frames following
+    // the HTTP response, or -1 on a malformed frame.
+    static
+    std::vector<int>
+    opcodes(std::string const& s)
+    {
+        std::vector<int> v;
+        auto i = s.find("\r\n\r\n");
+        if(i == std::string::npos)
+            return v;
+        i += 4;
+        while(i < s.size())
+        {
+            if(i + 2 > s.size() || (s[i] & 0x70) != 0 ||
+                (s[i + 1] & 0x80) != 0)
+            {
+                v.push_back(-1);
+                break;
+            }
+            v.push_back(s[i] & 0x0f);
+            std::size_t len = s[i + 1] & 0x7f;
+            i += 2;
+            if(len == 126)
+            {
+                len =
+                    (static_cast<unsigned char>(s[i]) << 8) +
+                     static_cast<unsigned char>(s[i + 1]);
+                i += 2;
+            }
+            i += len;
+        }
+        return v;
+    }
+
+    void
+    testConcurrent()
+    {
+        std::size_t constexpr count = 100;
+        std::string in = request();
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            in += frame(1, "in:" + std::to_string(i));
+            if(i % 10 == 0)
+                in += frame(9, "ping");
+        }
+        in += frame(8, "\x03\xe8");
+
+        stream<test::string_iostream> ws{ios_, in};
+        ws.accept();
+        ws.collect_stats(true);
+        auto halves = ws.split();
+        auto r = halves.first;
+        auto w = halves.second;
+
+        std::size_t received = 0;
+        error_code rec;
+        std::thread reader{
+            [&]
+            {
+                for(;;)
+                {
+                    multi_buffer b;
+                    r.read(b, rec);
+                    if(rec)
+                        break;
+                    ++received;
+                }
+            }};
+        std::size_t sent = 0;
+        error_code wec;
+        std::thread writer{
+            [&]
+            {
+                for(std::size_t i = 0; i < 10 * count; ++i)
+                {
+                    w.write(boost::asio::buffer(
+                        "out:" + std::to_string(i)), wec);
+                    if(wec)
+                        break;
+                    ++sent;
+                }
+            }};
+        reader.join();
+        writer.join();
+
+        BEAST_EXPECTS(rec == error::closed, rec.message());
+        BEAST_EXPECT(received == count);
+        BEAST_EXPECT(! wec ||
+            wec == boost::asio::error::operation_aborted);
+
+        // No frames were interleaved, and
+        // nothing was sent after the close.
+        auto const v = opcodes(ws.next_layer().str);
+        std::size_t text = 0;
+        std::size_t pong = 0;
+        for(std::size_t i = 0; i < v.size(); ++i)
+        {
+            if(v[i] == 1)
+                ++text;
+            else if(v[i] == 10)
+                ++pong;
+            else
+                BEAST_EXPECT(v[i] == 8 && i == v.size() - 1);
+        }
+        BEAST_EXPECT(text == sent);
+        BEAST_EXPECT(pong == count / 10);
+        BEAST_EXPECT(! v.empty() && v.back() == 8);
+
+        // Both halves counted what they sent
+        auto const st = ws.stats();
+        BEAST_EXPECT(st.messages_in == count);
+        BEAST_EXPECT(st.messages_out == sent);
+        BEAST_EXPECT(st.pings_in == count / 10);
+        BEAST_EXPECT(st.pongs_out == pong);
+        BEAST_EXPECT(st.frames_out == v.size());
+    }
+
+    void
+    testClose()
+    {
+        // close from the write half
+        {
+            stream<test::string_iostream> ws{ios_,
+                request() + frame(8, "\x03\xe8")};
+            ws.accept();
+            auto halves = ws.split();
+            halves.second.close(close_code::normal);
+            multi_buffer b;
+            error_code ec;
+            halves.first.read(b, ec);
+            BEAST_EXPECTS(ec == error::closed, ec.message());
+            BEAST_EXPECT(halves.first.reason().code ==
+                close_code::normal);
+            auto const v = opcodes(ws.next_layer().str);
+            BEAST_EXPECT(v.size() == 1 && v[0] == 8);
+        }
+
+        // close from the peer
+        {
+            stream<test::string_iostream> ws{ios_,
+                request() + frame(8, "\x03\xe8")};
+            ws.accept();
+            auto halves = ws.split();
+            multi_buffer b;
+            error_code ec;
+            halves.first.read(b, ec);
+            BEAST_EXPECTS(ec == error::closed, ec.message());
+            halves.second.write(
+                boost::asio::buffer("*", 1), ec);
+            BEAST_EXPECTS(ec ==
+                boost::asio::error::operation_aborted,
+                    ec.message());
+            halves.second.ping({}, ec);
+            BEAST_EXPECTS(ec ==
+                boost::asio::error::operation_aborted,
+                    ec.message());
+            halves.second.close({}, ec);
+            BEAST_EXPECTS(ec ==
+                boost::asio::error::operation_aborted,
+                    ec.message());
+            auto const v = opcodes(ws.next_layer().str);
+            BEAST_EXPECT(v.size() == 1 && v[0] == 8);
+        }
+    }
+
+    void
+    testCloseWhileWriting()
+    {
+        // The peer's close arrives while the write half
+        // is writing, and then closes on its own.
+        stream<test::string_iostream> ws{ios_,
+            request() + frame(8, "\x03\xe8")};
+        ws.accept();
+        auto halves = ws.split();
+        auto r = halves.first;
+        auto w = halves.second;
+
+        error_code rec;
+        std::thread reader{
+            [&]
+            {
+                multi_buffer b;
+                r.read(b, rec);
+            }};
+        std::size_t sent = 0;
+        error_code wec;
+        error_code cec;
+        std::thread writer{
+            [&]
+            {
+                for(std::size_t i = 0; i < 1000; ++i)
+                {
+                    w.write(boost::asio::buffer(
+                        "out:" + std::to_string(i)), wec);
+                    if(wec)
+                        break;
+                    ++sent;
+                }
+                w.close(close_code::going_away, cec);
+            }};
+        reader.join();
+        writer.join();
+
+        BEAST_EXPECTS(rec == error::closed, rec.message());
+        BEAST_EXPECT(! wec ||
+            wec == boost::asio::error::operation_aborted);
+        BEAST_EXPECT(! cec ||
+            cec == boost::asio::error::operation_aborted);
+
+        // Exactly one close frame, sent last
+        auto const v = opcodes(ws.next_layer().str);
+        if(! BEAST_EXPECT(v.size() == sent + 1))
+            return;
+        for(std::size_t i = 0; i < sent; ++i)
+            BEAST_EXPECT(v[i] == 1);
+        BEAST_EXPECT(v.back() == 8);
+    }
+
+    void
+    run() override
+    {
+        testClose();
+        testConcurrent();
+        testCloseWhileWriting();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(split,websocket,beast);
+
+} // websocket
+} // beast
@@ -14,6 +14,7 @@
 #include <beast/core/ostream.hpp>
 #include <beast/core/multi_buffer.hpp>
 #include <beast/test/fail_stream.hpp>
+#include <beast/test/pipe_stream.hpp>
 #include <beast/test/string_istream.hpp>
 #include <beast/test/string_iostream.hpp>
 #include <beast/test/string_ostream.hpp>
@@ -22,8 +23,12 @@
 #include <boost/asio.hpp>
 #include <boost/asio/spawn.hpp>
 #include <boost/optional.hpp>
+#include <chrono>
 #include <mutex>
 #include <condition_variable>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace beast {
 namespace websocket {
@@ -276,6 +281,15 @@ public:
             ws.write(buffers);
         }
 
+        template<
+            class NextLayer, class MutableBufferSequence>
+        void
+        write_inplace(stream<NextLayer>& ws,
+            MutableBufferSequence const& buffers) const
+        {
+            ws.write_inplace(buffers);
+        }
+
         template<
             class NextLayer, class ConstBufferSequence>
         void
@@ -518,6 +532,18 @@ public:
                 throw system_error{ec};
         }
 
+        template<
+            class NextLayer, class MutableBufferSequence>
+        void
+        write_inplace(stream<NextLayer>& ws,
+            MutableBufferSequence const& buffers) const
+        {
+            error_code ec;
+            ws.async_write_inplace(buffers, yield_[ec]);
+            if(ec)
+                throw system_error{ec};
+        }
+
         template<
             class NextLayer, class ConstBufferSequence>
         void
@@ -552,6 +578,10 @@ public:
         ws.write_buffer_size(2048);
         ws.binary(false);
         ws.read_message_max(1 * 1024 * 1024);
+        ws.read_direct(true);
+        ws.lean(true);
+        BEAST_EXPECT(ws.lean());
+        ws.set_option(keepalive{});
         try
         {
             ws.write_buffer_size(7);
@@ -561,6 +591,250 @@ public:
         {
             pass();
         }
+        try
+        {
+            keepalive opt;
+            opt.pong_timeout = std::chrono::seconds(-1);
+            ws.set_option(opt);
+            fail();
+        }
+        catch(std::exception const&)
+        {
+            pass();
+        }
+    }
+
+    void
+    testRoles()
+    {
+        BOOST_STATIC_ASSERT(
+            sizeof(server_stream<test::string_iostream>) <
+            sizeof(stream<test::string_iostream>));
+
+        // server
+        {
+            std::string in =
+                "GET / HTTP/1.1\r\n"
+                "Host: localhost\r\n"
+                "Upgrade: websocket\r\n"
+                "Connection: upgrade\r\n"
+                "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                "Sec-WebSocket-Version: 13\r\n"
+                "\r\n";
+            // masked with a zero key
+            in.append("\x81\x85\x00\x00\x00\x00Hello", 11);
+            server_stream<test::string_iostream> ws{ios_, in};
+            ws.accept();
+            multi_buffer b;
+            ws.read(b);
+            BEAST_EXPECT(to_string(b.data()) == "Hello");
+            ws.next_layer().str.clear();
+            ws.write(b.data());
+            BEAST_EXPECT(ws.next_layer().str == "\x81\x05Hello");
+        }
+
+        // client
+        {
+            client_stream<test::string_iostream> ws{ios_,
+                "HTTP/1.1 101 Switching Protocols\r\n"
+                "Upgrade: websocket\r\n"
+                "Connection: upgrade\r\n"
+                "\r\n"};
+            error_code ec;
+            ws.handshake("localhost", "/", ec);
+            BEAST_EXPECT(ec == error::handshake_failed);
+            ws.next_layer().str.clear();
+            ws.write(boost::asio::buffer("Hello", 5));
+            auto const& s = ws.next_layer().str;
+            // The key is random so the handshake fails,
+            // but the role does not depend on it.
+            BEAST_EXPECT(s.size() == 2 + 4 + 5);
+            BEAST_EXPECT(s.size() > 1 && (s[1] & 0x80) != 0);
+        }
+    }
+
+    static
+    std::string
+    relay_request(std::string const& ext)
+    {
+        std::string s =
+            "GET / HTTP/1.1\r\n"
+            "Host: localhost\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 13\r\n";
+        if(! ext.empty())
+            s += "Sec-WebSocket-Extensions: " + ext + "\r\n";
+        s += "\r\n";
+        return s;
+    }
+
+    // A masked client frame with a short payload
+    static
+    std::string
+    relay_frame(int b0, string_view payload)
+    {
+        static char constexpr key[] = "\x01\x02\x03\x04";
+        std::string s;
+        s.push_back(static_cast<char>(b0));
+        s.push_back(static_cast<char>(0x80 | payload.size()));
+        s.append(key, 4);
+        for(std::size_t i = 0; i < payload.size(); ++i)
+            s.push_back(payload[i] ^ key[i % 4]);
+        return s;
+    }
+
+    // The output of a stream after its HTTP response
+    static
+    std::string
+    relay_output(std::string const& s)
+    {
+        return s.substr(s.find("\r\n\r\n") + 4);
+    }
+
+    void
+    testRelay()
+    {
+        using boost::asio::buffer;
+
+        // fragments, control frames, close
+        {
+            stream<test::string_iostream> ws{ios_,
+                relay_request("") +
+                relay_frame(0x01, "Hel") +
+                relay_frame(0x89, "ping") +
+                relay_frame(0x80, "lo") +
+                relay_frame(0x82, "*") +
+                relay_frame(0x88, "\x03\xe8")};
+            ws.accept();
+            stream<test::string_iostream> dest{
+                ios_, relay_request("")};
+            dest.accept();
+            ws.relay(dest);
+            BEAST_EXPECT(relay_output(dest.next_layer().str) ==
+                "\x01\x03Hel\x80\x02lo");
+            BEAST_EXPECT(relay_output(ws.next_layer().str) ==
+                "\x8a\x04ping");
+            dest.next_layer().str.clear();
+            ws.relay_some(dest);
+            BEAST_EXPECT(ws.is_message_done());
+            BEAST_EXPECT(dest.next_layer().str == "\x82\x01*");
+            error_code ec;
+            ws.relay(dest, ec);
+            BEAST_EXPECTS(ec == error::closed, ec.message());
+            BEAST_EXPECT(ws.reason().code == close_code::normal);
+        }
+
+        // masked by the destination
+        {
+            stream<test::string_iostream> ws{ios_,
+                relay_request("") + relay_frame(0x81, "Hello")};
+            ws.accept();
+            stream<test::string_ostream> dest{ios_};
+            dest.open(decltype(dest)::role_type::client);
+            ws.relay(dest);
+            auto const& s = dest.next_layer().str;
+            if(BEAST_EXPECT(s.size() == 2 + 4 + 5))
+            {
+                BEAST_EXPECT(s.substr(0, 2) == "\x81\x85");
+                std::string payload;
+                for(std::size_t i = 0; i < 5; ++i)
+                    payload.push_back(s[6 + i] ^ s[2 + i % 4]);
+                BEAST_EXPECT(payload == "Hello");
+            }
+        }
+
+        std::string const text =
+            "Hello, world! Hello, world! Hello, world! "
+            "Hello, world! Hello, world! Hello, world!";
+        std::string deflated;
+        {
+            deflated.resize(256);
+            zlib::deflate_stream zo;
+            zlib::z_params zs;
+            zs.next_in = text.data();
+            zs.avail_in = text.size();
+            zs.next_out = &deflated[0];
+            zs.avail_out = deflated.size();
+            error_code ec;
+            zo.write(zs, zlib::Flush::sync, ec);
+            BEAST_EXPECTS(! ec, ec.message());
+            // remove the empty block
+            deflated.resize(zs.total_out - 4);
+        }
+        permessage_deflate pmd;
+        pmd.server_enable = true;
+
+        // compressed frames pass through
+        {
+            stream<test::string_iostream> ws{ios_,
+                relay_request("permessage-deflate") +
+                relay_frame(0xc1, deflated)};
+            ws.set_option(pmd);
+            ws.accept();
+            stream<test::string_iostream> dest{ios_,
+                relay_request("permessage-deflate")};
+            dest.set_option(pmd);
+            dest.accept();
+            ws.relay(dest);
+            std::string s = "\xc1";
+            s.push_back(static_cast<char>(deflated.size()));
+            s += deflated;
+            BEAST_EXPECT(relay_output(dest.next_layer().str) == s);
+        }
+
+        // compressed again when the windows differ
+        {
+            stream<test::string_iostream> ws{ios_,
+                relay_request("permessage-deflate") +
+                relay_frame(0xc1, deflated)};
+            ws.set_option(pmd);
+            ws.accept();
+            stream<test::string_iostream> dest{ios_,
+                relay_request("permessage-deflate; "
+                    "server_no_context_takeover")};
+            dest.set_option(pmd);
+            dest.accept();
+            ws.relay(dest);
+            auto const s = relay_output(dest.next_layer().str);
+            if(BEAST_EXPECT(s.size() > 2 &&
+                static_cast<std::size_t>(s[1]) == s.size() - 2))
+            {
+                BEAST_EXPECT(s[0] == '\xc1');
+                std::string in = s.substr(2);
+                in.append("\x00\x00\xff\xff", 4);
+                std::string out;
+                out.resize(256);
+                zlib::inflate_stream zi;
+                zlib::z_params zs;
+                zs.next_in = in.data();
+                zs.avail_in = in.size();
+                zs.next_out = &out[0];
+                zs.avail_out = out.size();
+                error_code ec;
+                zi.write(zs, zlib::Flush::sync, ec);
+                out.resize(zs.total_out);
+                BEAST_EXPECT(out == text);
+            }
+        }
+
+        // decompressed for a destination without deflate
+        {
+            stream<test::string_iostream> ws{ios_,
+                relay_request("permessage-deflate") +
+                relay_frame(0xc1, deflated)};
+            ws.set_option(pmd);
+            ws.accept();
+            stream<test::string_iostream> dest{
+                ios_, relay_request("")};
+            dest.accept();
+            ws.relay(dest);
+            std::string s = "\x81";
+            s.push_back(static_cast<char>(text.size()));
+            s += text;
+            BEAST_EXPECT(relay_output(dest.next_layer().str) == s);
+        }
     }
 
     //--------------------------------------------------------------------------
@@ -864,14 +1138,92 @@ public:
         BEAST_EXPECT(n < limit);
     }
 
+    // The response written from a template for the default
+    // decorator must match the one built as a message.
+    template<class Client>
+    void
+    testAcceptResponse(Client const& c)
+    {
+        auto const check =
+            [&](permessage_deflate const& pmd, std::string const& req)
+            {
+                stream<test::string_iostream> ws1{ios_, req};
+                ws1.set_option(pmd);
+                error_code ec1;
+                try
+                {
+                    c.accept(ws1);
+                }
+                catch(system_error const& e)
+                {
+                    ec1 = e.code();
+                }
+                stream<test::string_iostream> ws2{ios_, req};
+                ws2.set_option(pmd);
+                error_code ec2;
+                try
+                {
+                    c.accept_ex(ws2, [](response_type&){});
+                }
+                catch(system_error const& e)
+                {
+                    ec2 = e.code();
+                }
+                BEAST_EXPECT(ec1 == ec2);
+                BEAST_EXPECT(! ws1.next_layer().str.empty());
+                BEAST_EXPECT(ws1.next_layer().str ==
+                    ws2.next_layer().str);
+            };
+        permessage_deflate pmd;
+        pmd.server_enable = false;
+        check(pmd,
+            "GET / HTTP/1.1\r\n"
+            "Host: localhost\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: keep-alive, Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 13\r\n"
+            "\r\n");
+        check(pmd,
+            "GET / HTTP/1.1\r\n"
+            "Host: localhost\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 12\r\n"
+            "\r\n");
+        check(pmd,
+            "GET / HTTP/1.1\r\n"
+            "Host: localhost\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==dGhl\r\n"
+            "Sec-WebSocket-Version: 13\r\n"
+            "\r\n");
+        pmd.server_enable = true;
+        pmd.server_max_window_bits = 10;
+        check(pmd,
+            "GET / HTTP/1.1\r\n"
+            "Host: localhost\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 13\r\n"
+            "Sec-WebSocket-Extensions: permessage-deflate; "
+                "client_max_window_bits\r\n"
+            "\r\n");
+    }
+
     void
     testAccept()
     {
         testAccept(SyncClient{});
+        testAcceptResponse(SyncClient{});
         yield_to(
             [&](yield_context yield)
             {
                 testAccept(AsyncClient{yield});
+                testAcceptResponse(AsyncClient{yield});
             });
     }
 
@@ -1416,7 +1768,7 @@ public:
                     });
             });
         if(! BEAST_EXPECT(run_until(ios, 100,
-                [&]{ return ws.wr_close_; })))
+                [&]() -> bool { return ws.wr_close_; })))
             return;
         // Try to ping
         ws.async_ping("payload",
@@ -1578,6 +1930,678 @@ public:
         }
     }
 
+    void
+    testWriteCoalesce(endpoint_type const& ep)
+    {
+        using boost::asio::buffer;
+        boost::asio::io_service ios;
+        error_code ec;
+        socket_type sock(ios);
+        sock.connect(ep, ec);
+        if(! BEAST_EXPECTS(! ec, ec.message()))
+            return;
+        stream<socket_type&> ws(sock);
+        ws.handshake("localhost", "/", ec);
+        if(! BEAST_EXPECTS(! ec, ec.message()))
+            return;
+        ws.write_coalesce(100);
+        std::vector<std::string> v;
+        for(std::size_t i = 0; i < 20; ++i)
+            v.emplace_back(i == 5 ? 5000 : 10 + i,
+                static_cast<char>('a' + i));
+        std::vector<std::size_t> order;
+        for(std::size_t i = 0; i < v.size(); ++i)
+            ws.async_write(buffer(v[i]),
+                [&, i](error_code ec)
+                {
+                    BEAST_EXPECTS(! ec, ec.message());
+                    order.push_back(i);
+                });
+        ios.run();
+        BEAST_EXPECT(order.size() == v.size());
+        for(std::size_t i = 0; i < order.size(); ++i)
+            BEAST_EXPECT(order[i] == i);
+        for(std::size_t i = 0; i < v.size(); ++i)
+        {
+            multi_buffer b;
+            ws.read(b, ec);
+            if(! BEAST_EXPECTS(! ec, ec.message()))
+                return;
+            BEAST_EXPECT(to_string(b.data()) == v[i]);
+        }
+    }
+
+    // Records the size of each write to the next layer
+    class write_log_stream : public test::string_ostream
+    {
+    public:
+        std::vector<std::size_t> writes;
+
+        explicit
+        write_log_stream(boost::asio::io_service& ios)
+            : string_ostream(ios)
+        {
+        }
+
+        template<class ConstBufferSequence, class WriteHandler>
+        async_return_type<
+            WriteHandler, void(error_code, std::size_t)>
+        async_write_some(ConstBufferSequence const& buffers,
+            WriteHandler&& handler)
+        {
+            writes.push_back(boost::asio::buffer_size(buffers));
+            return string_ostream::async_write_some(buffers,
+                std::forward<WriteHandler>(handler));
+        }
+    };
+
+    void
+    testWriteCoalesceCap()
+    {
+        using boost::asio::buffer;
+        boost::asio::io_service ios;
+        stream<write_log_stream> ws{ios};
+        ws.open(decltype(ws)::role_type::server);
+        ws.write_coalesce(100, 200);
+        BEAST_EXPECT(ws.write_coalesce_max() == 200);
+        std::vector<std::string> v;
+        for(std::size_t i = 0; i < 12; ++i)
+            v.emplace_back(i == 7 ? 150 : 40,
+                static_cast<char>('a' + i));
+        std::vector<std::size_t> order;
+        for(std::size_t i = 0; i < v.size(); ++i)
+            ws.async_write(buffer(v[i]),
+                [&, i](error_code ec)
+                {
+                    BEAST_EXPECTS(! ec, ec.message());
+                    order.push_back(i);
+                });
+        ios.run();
+        // 0 is sent at once, 1 to 5 fill a batch up to the
+        // cap, 6 would exceed it and 7 exceeds the limit, so
+        // both are sent on their own, then 8 to 11 coalesce.
+        std::vector<std::size_t> const writes{
+            42, 5 * 42, 42, 2 + 2 + 150, 4 * 42};
+        BEAST_EXPECT(ws.next_layer().writes == writes);
+        BEAST_EXPECT(order.size() == v.size());
+        for(std::size_t i = 0; i < order.size(); ++i)
+            BEAST_EXPECT(order[i] == i);
+        std::string expected;
+        for(auto const& m : v)
+        {
+            expected.push_back('\x81');
+            if(m.size() < 126)
+            {
+                expected.push_back(static_cast<char>(m.size()));
+            }
+            else
+            {
+                expected.push_back('\x7e');
+                expected.push_back(static_cast<char>(m.size() >> 8));
+                expected.push_back(static_cast<char>(m.size() & 0xff));
+            }
+            expected.append(m);
+        }
+        BEAST_EXPECT(ws.next_layer().str == expected);
+    }
+
+    // A frame parsed from the output of a stream
+    struct out_frame
+    {
+        int b0;                 // fin, rsv and opcode bits
+        std::string payload;    // unmasked
+    };
+
+    // Returns the frames written to `out`, or an empty
+    // list if the last one is incomplete.
+    static
+    std::vector<out_frame>
+    parse_frames(std::string const& out)
+    {
+        std::vector<out_frame> v;
+        std::size_t i = 0;
+        auto const byte =
+            [&](std::size_t n)
+            {
+                return static_cast<unsigned char>(out[n]);
+            };
+        while(i + 2 <= out.size())
+        {
+            out_frame f;
+            f.b0 = byte(i);
+            auto const masked = (byte(i + 1) & 0x80) != 0;
+            std::size_t len = byte(i + 1) & 0x7f;
+            i += 2;
+            if(len == 126)
+            {
+                if(i + 2 > out.size())
+                    return {};
+                len = (byte(i) << 8) + byte(i + 1);
+                i += 2;
+            }
+            unsigned char key[4] = {0, 0, 0, 0};
+            if(masked)
+            {
+                if(i + 4 > out.size())
+                    return {};
+                for(std::size_t j = 0; j < 4; ++j)
+                    key[j] = byte(i + j);
+                i += 4;
+            }
+            if(i + len > out.size())
+                return {};
+            f.payload = out.substr(i, len);
+            for(std::size_t j = 0; j < len; ++j)
+                f.payload[j] = static_cast<char>(
+                    f.payload[j] ^ key[j % 4]);
+            i += len;
+            v.push_back(std::move(f));
+        }
+        if(i != out.size())
+            return {};
+        return v;
+    }
+
+    void
+    testWriteInplaceCont()
+    {
+        // Writing in place while a message is in progress
+        // sends the buffers as its final frame.
+        using boost::asio::buffer;
+        {
+            boost::asio::io_service ios;
+            stream<test::string_ostream> ws{ios};
+            ws.open(decltype(ws)::role_type::client);
+            ws.write_some(false, buffer("Hello, ", 7));
+            std::string m = "World";
+            ws.write_inplace(buffer(&m[0], m.size()));
+            auto const v = parse_frames(ws.next_layer().str);
+            BEAST_EXPECT(v.size() == 2);
+            if(v.size() == 2)
+            {
+                BEAST_EXPECT(v[0].b0 == 0x01);
+                BEAST_EXPECT(v[1].b0 == 0x80);
+                BEAST_EXPECT(v[0].payload + v[1].payload ==
+                    "Hello, World");
+            }
+            // The next message starts with its own opcode
+            ws.next_layer().str.clear();
+            m = "!";
+            ws.write_inplace(buffer(&m[0], m.size()));
+            auto const v2 = parse_frames(ws.next_layer().str);
+            BEAST_EXPECT(v2.size() == 1 && v2[0].b0 == 0x81);
+        }
+        {
+            boost::asio::io_service ios;
+            stream<test::string_ostream> ws{ios};
+            ws.open(decltype(ws)::role_type::client);
+            std::string m = "World";
+            std::size_t n = 0;
+            ws.async_write_some(false, buffer("Hello, ", 7),
+                [&](error_code ec)
+                {
+                    BEAST_EXPECTS(! ec, ec.message());
+                    ++n;
+                    ws.async_write_inplace(buffer(&m[0], m.size()),
+                        [&](error_code ec)
+                        {
+                            BEAST_EXPECTS(! ec, ec.message());
+                            ++n;
+                        });
+                });
+            ios.run();
+            BEAST_EXPECT(n == 2);
+            auto const v = parse_frames(ws.next_layer().str);
+            BEAST_EXPECT(v.size() == 2);
+            if(v.size() == 2)
+            {
+                BEAST_EXPECT(v[0].b0 == 0x01);
+                BEAST_EXPECT(v[1].b0 == 0x80);
+                BEAST_EXPECT(v[0].payload + v[1].payload ==
+                    "Hello, World");
+            }
+        }
+    }
+
+    // Takes a fixed time to accept each write
+    class slow_stream : public test::string_iostream
+    {
+    public:
+        explicit
+        slow_stream(boost::asio::io_service& ios,
+                std::string s = {})
+            : string_iostream(ios, std::move(s))
+        {
+        }
+
+        template<class ConstBufferSequence, class WriteHandler>
+        async_return_type<
+            WriteHandler, void(error_code, std::size_t)>
+        async_write_some(ConstBufferSequence const& buffers,
+            WriteHandler&& handler)
+        {
+            std::this_thread::sleep_for(
+                std::chrono::milliseconds(5));
+            return string_iostream::async_write_some(buffers,
+                std::forward<WriteHandler>(handler));
+        }
+    };
+
+    void
+    testFragLatency()
+    {
+        // Frames shrink once the next layer takes longer
+        // than the latency budget to accept them.
+        using boost::asio::buffer;
+        std::string m;
+        m.reserve(32768);
+        std::uint32_t seed = 1;
+        while(m.size() < 32768)
+        {
+            seed = seed * 1103515245 + 12345;
+            m.push_back(static_cast<char>(
+                'a' + ((seed >> 16) & 15)));
+        }
+        auto const run =
+            [&](stream<slow_stream>& ws)
+            {
+                ws.next_layer().str.clear();
+                ws.auto_fragment(true);
+                ws.auto_fragment_latency(
+                    std::chrono::milliseconds(1));
+                bool done = false;
+                ws.async_write(buffer(m),
+                    [&](error_code ec)
+                    {
+                        BEAST_EXPECTS(! ec, ec.message());
+                        done = true;
+                    });
+                ws.get_io_service().run();
+                BEAST_EXPECT(done);
+                auto const v = parse_frames(ws.next_layer().str);
+                BEAST_EXPECT(v.size() > 2);
+                std::string s;
+                for(std::size_t i = 0; i < v.size(); ++i)
+                {
+                    BEAST_EXPECT((v[i].b0 & 0x80) ==
+                        (i + 1 == v.size() ? 0x80 : 0));
+                    if(i > 0)
+                    {
+                        BEAST_EXPECT((v[i].b0 & 0x0f) == 0);
+                        BEAST_EXPECT(v[i].payload.size() <= 2048);
+                    }
+                    s += v[i].payload;
+                }
+                if(! v.empty())
+                    BEAST_EXPECT(v[0].payload.size() == 8192);
+                return std::make_pair(
+                    v.empty() ? 0 : v[0].b0, s);
+            };
+
+        // nomask
+        {
+            boost::asio::io_service ios;
+            stream<slow_stream> ws{ios};
+            ws.write_buffer_size(8192);
+            ws.open(decltype(ws)::role_type::server);
+            auto const r = run(ws);
+            BEAST_EXPECT(r.first == 0x01);
+            BEAST_EXPECT(r.second == m);
+        }
+
+        // mask
+        {
+            boost::asio::io_service ios;
+            stream<slow_stream> ws{ios};
+            ws.write_buffer_size(8192);
+            ws.open(decltype(ws)::role_type::client);
+            auto const r = run(ws);
+            BEAST_EXPECT(r.first == 0x01);
+            BEAST_EXPECT(r.second == m);
+        }
+
+        // deflate
+        {
+            boost::asio::io_service ios;
+            stream<slow_stream> ws{ios,
+                relay_request("permessage-deflate")};
+            permessage_deflate pmd;
+            pmd.server_enable = true;
+            ws.set_option(pmd);
+            ws.write_buffer_size(8192);
+            ws.accept();
+            auto const r = run(ws);
+            BEAST_EXPECT(r.first == 0x41);
+            std::string in = r.second;
+            in.append("\x00\x00\xff\xff", 4);
+            std::string out;
+            out.resize(2 * m.size());
+            zlib::inflate_stream zi;
+            zlib::z_params zs;
+            zs.next_in = in.data();
+            zs.avail_in = in.size();
+            zs.next_out = &out[0];
+            zs.avail_out = out.size();
+            error_code ec;
+            zi.write(zs, zlib::Flush::sync, ec);
+            BEAST_EXPECTS(! ec, ec.message());
+            out.resize(zs.total_out);
+            BEAST_EXPECT(out == m);
+        }
+    }
+
+    void
+    testStats()
+    {
+        using boost::asio::buffer;
+        boost::asio::io_service ios;
+        stream<test::string_ostream> ws{ios};
+        ws.open(decltype(ws)::role_type::server);
+        BEAST_EXPECT(! ws.collect_stats());
+        ws.write(buffer("Hello", 5));
+        BEAST_EXPECT(ws.stats().messages_out == 0);
+        BEAST_EXPECT(ws.stats().frames_out == 0);
+
+        ws.collect_stats(true);
+        BEAST_EXPECT(ws.collect_stats());
+        ws.next_layer().str.clear();
+        ws.write(buffer("Hello", 5));
+        auto st = ws.stats();
+        BEAST_EXPECT(st.messages_out == 1);
+        BEAST_EXPECT(st.frames_out == 1);
+        BEAST_EXPECT(st.payload_bytes_out == 5);
+        BEAST_EXPECT(st.wire_bytes_out ==
+            ws.next_layer().str.size());
+
+        // Turning the option off keeps what was collected
+        ws.collect_stats(false);
+        ws.write(buffer("Hello", 5));
+        BEAST_EXPECT(ws.stats().messages_out == 1);
+        ws.reset_stats();
+        BEAST_EXPECT(ws.stats().messages_out == 0);
+        BEAST_EXPECT(ws.stats().wire_bytes_out == 0);
+    }
+
+    void
+    testFragPing()
+    {
+        // A ping started during a large auto-fragmented
+        // write is sent in between its frames.
+        using boost::asio::buffer;
+        boost::asio::io_service ios;
+        stream<test::string_ostream> ws{ios};
+        ws.open(decltype(ws)::role_type::server);
+        ws.auto_fragment(true);
+        ws.write_buffer_size(1024);
+        std::string const s(4000, '*');
+        bool wrote = false;
+        bool pinged = false;
+        ws.async_write(buffer(s),
+            [&](error_code ec)
+            {
+                BEAST_EXPECTS(! ec, ec.message());
+                wrote = true;
+            });
+        ws.async_ping({},
+            [&](error_code ec)
+            {
+                BEAST_EXPECTS(! ec, ec.message());
+                BEAST_EXPECT(! wrote);
+                pinged = true;
+            });
+        ios.run();
+        BEAST_EXPECT(wrote);
+        BEAST_EXPECT(pinged);
+
+        // Opcode and fin bit of each frame in the output
+        std::vector<int> ops;
+        std::string payload;
+        auto const& out = ws.next_layer().str;
+        std::size_t i = 0;
+        while(i + 2 <= out.size())
+        {
+            auto const b0 = static_cast<unsigned char>(out[i]);
+            std::size_t len =
+                static_cast<unsigned char>(out[i + 1]) & 0x7f;
+            i += 2;
+            if(len == 126)
+            {
+                len = (static_cast<unsigned char>(out[i]) << 8) +
+                    static_cast<unsigned char>(out[i + 1]);
+                i += 2;
+            }
+            ops.push_back(b0);
+            if((b0 & 0x0f) != 9)
+                payload.append(out, i, len);
+            i += len;
+        }
+        BEAST_EXPECT(i == out.size());
+        std::vector<int> const expected{
+            0x01, 0x89, 0x00, 0x00, 0x80};
+        BEAST_EXPECT(ops == expected);
+        BEAST_EXPECT(payload == s);
+    }
+
+    void
+    testLeanPeek()
+    {
+        // An asynchronous read waits for the next
+        // frame on a single byte, without a buffer.
+        boost::asio::io_service ios;
+        test::pipe p{ios};
+        stream<test::pipe::stream&> ws{p.server};
+        ws.open(decltype(ws)::role_type::server);
+        ws.lean(true);
+        bool done = false;
+        multi_buffer b;
+        ws.async_read(b,
+            [&](error_code ec)
+            {
+                BEAST_EXPECTS(! ec, ec.message());
+                done = true;
+            });
+        ios.poll();
+        BEAST_EXPECT(! done);
+        BEAST_EXPECT(! ws.rd_.buf.leased());
+
+        // A masked text frame, using a zero key
+        std::string const frame("\x81\x85\0\0\0\0Hello", 11);
+        p.client.write_some(boost::asio::buffer(frame));
+        ios.reset();
+        ios.run();
+        BEAST_EXPECT(done);
+        BEAST_EXPECT(to_string(b.data()) == "Hello");
+        BEAST_EXPECT(! ws.rd_.buf.leased());
+    }
+
+    // A pipe endpoint which can be closed like a socket
+    class closing_stream : public test::pipe::stream
+    {
+    public:
+        explicit
+        closing_stream(test::pipe::stream&& s)
+            : test::pipe::stream(std::move(s))
+        {
+        }
+
+        using lowest_layer_type = closing_stream;
+
+        lowest_layer_type&
+        lowest_layer()
+        {
+            return *this;
+        }
+
+        void
+        close(error_code& ec)
+        {
+            test::pipe::stream::close();
+            ec.assign(0, ec.category());
+        }
+
+        friend
+        void
+        teardown(teardown_tag,
+            closing_stream&, error_code& ec)
+        {
+            ec.assign(0, ec.category());
+        }
+
+        template<class TeardownHandler>
+        friend
+        void
+        async_teardown(teardown_tag,
+            closing_stream& s, TeardownHandler&& handler)
+        {
+            s.get_io_service().post(
+                bind_handler(std::move(handler),
+                    error_code{}));
+        }
+    };
+
+    void
+    testKeepaliveStrand()
+    {
+        using std::chrono::milliseconds;
+
+        // Several threads run the io_service, the checks
+        // are serialized with the read by the strand. The
+        // peer never answers the pings.
+        boost::asio::io_service ios;
+        boost::asio::io_service::strand strand{ios};
+        test::pipe p{ios};
+        stream<closing_stream> ws{std::move(p.client)};
+        ws.open(decltype(ws)::role_type::client);
+        keepalive opt;
+        opt.ping_interval = milliseconds(10);
+        opt.pong_timeout = milliseconds(30);
+        opt.strand = &strand;
+        ws.set_option(opt);
+
+        // Once the stream closes its end of the pipe, the
+        // peer closes the other end, completing the read.
+        std::size_t received = 0;
+        char buf[64];
+        std::function<void(error_code, std::size_t)> on_peer =
+            [&](error_code ec, std::size_t n)
+            {
+                received += n;
+                if(ec)
+                    return p.server.close();
+                p.server.async_read_some(
+                    boost::asio::buffer(buf), on_peer);
+            };
+        p.server.async_read_some(
+            boost::asio::buffer(buf), on_peer);
+
+        error_code result;
+        multi_buffer b;
+        ws.async_read(b, strand.wrap(
+            [&](error_code ec)
+            {
+                result = ec;
+                // Lets io_service::run return
+                ws.set_option(keepalive{});
+            }));
+        std::vector<std::thread> v;
+        for(int i = 0; i < 4; ++i)
+            v.emplace_back([&]{ ios.run(); });
+        for(auto& t : v)
+            t.join();
+        BEAST_EXPECTS(result == error::timeout, result.message());
+        // At least one masked, empty ping was sent
+        BEAST_EXPECT(received >= 6);
+    }
+
+    void
+    testKeepalive(endpoint_type const& ep)
+    {
+        using clock_type = std::chrono::steady_clock;
+        using std::chrono::milliseconds;
+
+        // The echo server answers the pings, but the
+        // connection fails once it stays idle for too long
+        {
+            boost::asio::io_service ios;
+            stream<socket_type> ws(ios);
+            error_code ec;
+            ws.next_layer().connect(ep, ec);
+            if(! BEAST_EXPECTS(! ec, ec.message()))
+                return;
+            ws.handshake("localhost", "/", ec);
+            if(! BEAST_EXPECTS(! ec, ec.message()))
+                return;
+            std::size_t pongs = 0;
+            ws.control_callback(
+                [&](frame_type kind, string_view)
+                {
+                    if(kind == frame_type::pong)
+                        ++pongs;
+                });
+            keepalive opt;
+            opt.idle_timeout = milliseconds(300);
+            opt.ping_interval = milliseconds(20);
+            opt.pong_timeout = milliseconds(100);
+            ws.set_option(opt);
+            auto const start = clock_type::now();
+            multi_buffer b;
+            ws.async_read(b,
+                [&](error_code ec_)
+                {
+                    ec = ec_;
+                    // Lets io_service::run return
+                    ws.set_option(keepalive{});
+                });
+            ios.run();
+            BEAST_EXPECTS(ec == error::timeout, ec.message());
+            BEAST_EXPECT(clock_type::now() - start >=
+                milliseconds(300));
+            BEAST_EXPECT(pongs >= 2);
+            BEAST_EXPECT(! ws.lowest_layer().is_open());
+        }
+
+        // A peer which stops reading does not answer
+        {
+            boost::asio::io_service ios;
+            boost::asio::ip::tcp::acceptor acceptor(ios,
+                endpoint_type{address_type::from_string(
+                    "127.0.0.1"), 0});
+            stream<socket_type> peer(ios);
+            stream<socket_type> ws(ios);
+            ws.next_layer().connect(acceptor.local_endpoint());
+            acceptor.accept(peer.next_layer());
+            peer.async_accept(
+                [&](error_code ec)
+                {
+                    BEAST_EXPECTS(! ec, ec.message());
+                });
+            ws.async_handshake("localhost", "/",
+                [&](error_code ec)
+                {
+                    BEAST_EXPECTS(! ec, ec.message());
+                });
+            ios.run();
+            ios.reset();
+            keepalive opt;
+            opt.ping_interval = milliseconds(20);
+            opt.pong_timeout = milliseconds(50);
+            ws.set_option(opt);
+            auto const start = clock_type::now();
+            error_code ec;
+            multi_buffer b;
+            ws.async_read(b,
+                [&](error_code ec_)
+                {
+                    ec = ec_;
+                    ws.set_option(keepalive{});
+                });
+            ios.run();
+            BEAST_EXPECTS(ec == error::timeout, ec.message());
+            BEAST_EXPECT(clock_type::now() - start >=
+                milliseconds(70));
+        }
+    }
+
     struct abort_test
     {
     };
@@ -1727,6 +2751,77 @@ public:
                     }
                 }
 
+                // receive large message directly
+                {
+                    std::string s(100000, '*');
+                    ws.read_direct(true);
+                    c.write(ws, buffer(s.data(), s.size()));
+                    {
+                        // receive echoed message
+                        multi_buffer db;
+                        c.read(ws, db);
+                        BEAST_EXPECT(to_string(db.data()) == s);
+                    }
+                    ws.read_direct(false);
+                }
+
+                // give back buffers between messages
+                {
+                    ws.lean(true);
+                    for(int i = 0; i < 3; ++i)
+                    {
+                        std::string const s(5000, '*');
+                        c.write(ws, buffer(s.data(), s.size()));
+                        BEAST_EXPECT(! ws.wr_.buf);
+                        multi_buffer db;
+                        c.read(ws, db);
+                        BEAST_EXPECT(to_string(db.data()) == s);
+                        BEAST_EXPECT(! ws.rd_.buf.leased());
+                        BEAST_EXPECT(! ws.wr_.buf);
+                    }
+                    ws.lean(false);
+                }
+
+                // collect statistics
+                {
+                    ws.collect_stats(true);
+                    BEAST_EXPECT(ws.collect_stats());
+                    ws.reset_stats();
+                    std::string const s(5000, '*');
+                    c.write(ws, buffer(s.data(), s.size()));
+                    multi_buffer db;
+                    c.read(ws, db);
+                    BEAST_EXPECT(to_string(db.data()) == s);
+                    auto const st = ws.stats();
+                    BEAST_EXPECT(st.messages_out == 1);
+                    BEAST_EXPECT(st.messages_in == 1);
+                    BEAST_EXPECT(st.payload_bytes_out == s.size());
+                    BEAST_EXPECT(st.payload_bytes_in == s.size());
+                    BEAST_EXPECT(st.frames_out >= 1);
+                    BEAST_EXPECT(st.frames_in >= 1);
+                    BEAST_EXPECT(st.wire_bytes_out > 0);
+                    BEAST_EXPECT(st.wire_bytes_in > 0);
+                    ws.collect_stats(false);
+                    ws.reset_stats();
+                    c.write(ws, buffer(s.data(), s.size()));
+                    c.read(ws, db);
+                    BEAST_EXPECT(ws.stats().messages_out == 0);
+                    BEAST_EXPECT(ws.stats().frames_in == 0);
+                }
+
+                // send message masked in place
+                {
+                    std::string const s(10000, '*');
+                    std::string m = s;
+                    c.write_inplace(ws, buffer(&m[0], m.size()));
+                    {
+                        // receive echoed message
+                        multi_buffer db;
+                        c.read(ws, db);
+                        BEAST_EXPECT(to_string(db.data()) == s);
+                    }
+                }
+
                 // cause ping
                 ws.binary(true);
                 c.write(ws, sbuf("PING"));
@@ -1833,13 +2928,24 @@ public:
 
         log << "sizeof(websocket::stream) == " <<
             sizeof(websocket::stream<boost::asio::ip::tcp::socket&>) << std::endl;
+        log << "sizeof(websocket::server_stream) == " <<
+            sizeof(websocket::server_stream<boost::asio::ip::tcp::socket&>) << std::endl;
 
         auto const any = endpoint_type{
             address_type::from_string("127.0.0.1"), 0};
 
         testOptions();
+        testRoles();
+        testRelay();
         testAccept();
         testHandshake();
+        testWriteCoalesceCap();
+        testKeepaliveStrand();
+        testLeanPeek();
+        testStats();
+        testFragPing();
+        testWriteInplaceCont();
+        testFragLatency();
         testBadHandshakes();
         testBadResponses();
 
@@ -1861,6 +2967,8 @@ public:
             //testPausation5(ep);
             testWriteFrames(ep);
             testAsyncWriteFrame(ep);
+            testWriteCoalesce(ep);
+            testKeepalive(ep);
         }
 
         {
@@ -1923,6 +3031,13 @@ public:
         pmd.client_max_window_bits = 10;
         pmd.client_no_context_takeover = true;
         doClientTests(pmd);
+
+        pmd.client_enable = true;
+        pmd.server_enable = true;
+        pmd.server_max_window_bits = 8;
+        pmd.client_max_window_bits = 8;
+        pmd.client_no_context_takeover = false;
+        doClientTests(pmd);
     #endif
     }
 };
@@ -5,22 +5,47 @@
 // file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
 //
 
+// WebSocket load generator
+//
+// Drives a number of client connections, spread over a number of
+// threads, against an echo server. Each connection writes a message,
+// waits for the echo, and records the round trip time. The sizes of
+// messages, the mix of text and binary messages, permessage-deflate,
+// and the send rate are configurable; see `wstest --help`.
+//
+// When a target rate is given each message has an intended send time
+// on a fixed schedule, and its latency is measured from that time
+// rather than from when it was actually written. A stall on the
+// server then shows up in the latency of every message which should
+// have been sent during the stall, instead of only the one which was
+// in flight ("coordinated omission"). Both the corrected and the
+// uncorrected distributions are reported.
+//
+// Without a port, a Beast echo server is started in-process on the
+// loopback interface.
+
 #include <example/common/helpers.hpp>
 #include <example/common/session_alloc.hpp>
+#include <test/websocket/websocket_async_echo_server.hpp>
 
 #include <beast/core.hpp>
 #include <beast/websocket.hpp>
+#include <beast/test/load_test.hpp>
 #include <beast/unit_test/dstream.hpp>
 #include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/lexical_cast.hpp>
-#include <atomic>
+#include <boost/program_options.hpp>
+#include <algorithm>
 #include <chrono>
 #include <cstdlib>
 #include <functional>
+#include <iomanip>
 #include <iostream>
 #include <memory>
-#include <mutex>
 #include <random>
+#include <stdexcept>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -30,64 +55,262 @@ using tcp = boost::asio::ip::tcp;
 namespace ws = beast::websocket;
 namespace ph = std::placeholders;
 using error_code = beast::error_code;
+using clock_type = std::chrono::steady_clock;
 
-class test_buffer : public asio::const_buffers_1
+//------------------------------------------------------------------------------
+
+/*  A distribution of message sizes, parsed from a string:
+
+        N                       Every message is N bytes
+        uniform:A:B             Uniform between A and B inclusive
+        geometric:M             Geometric with mean M, at most 16*M
+        choice:N@W,N@W,...      N bytes with relative weight W
+*/
+class size_distribution
 {
-    char data_[4096];
+    enum class kind
+    {
+        fixed,
+        uniform,
+        geometric,
+        choice
+    };
+
+    kind kind_;
+    std::size_t max_;
+    std::uniform_int_distribution<std::size_t> uniform_;
+    std::geometric_distribution<std::size_t> geometric_;
+    std::discrete_distribution<std::size_t> choice_;
+    std::vector<std::size_t> sizes_;
+
+    static
+    std::size_t
+    to_size(std::string const& s)
+    {
+        return boost::lexical_cast<std::size_t>(s);
+    }
+
+    static
+    std::vector<std::string>
+    split(std::string const& s, char c)
+    {
+        std::vector<std::string> v;
+        std::string::size_type pos = 0;
+        for(;;)
+        {
+            auto const next = s.find(c, pos);
+            v.emplace_back(s.substr(pos, next - pos));
+            if(next == std::string::npos)
+                break;
+            pos = next + 1;
+        }
+        return v;
+    }
 
 public:
-    test_buffer()
-        : asio::const_buffers_1(data_, sizeof(data_))
+    explicit
+    size_distribution(std::string const& spec)
     {
-        std::mt19937_64 rng;
-        std::uniform_int_distribution<unsigned short> dist;
-        for(auto& c : data_)
-            c = static_cast<unsigned char>(dist(rng));
+        auto const v = split(spec, ':');
+        if(v.size() == 1)
+        {
+            kind_ = kind::fixed;
+            max_ = to_size(v[0]);
+        }
+        else if(v[0] == "uniform" && v.size() == 3)
+        {
+            kind_ = kind::uniform;
+            uniform_ = std::uniform_int_distribution<
+                std::size_t>{to_size(v[1]), to_size(v[2])};
+            max_ = uniform_.max();
+        }
+        else if(v[0] == "geometric" && v.size() == 2)
+        {
+            kind_ = kind::geometric;
+            auto const mean = to_size(v[1]);
+            if(mean == 0)
+                throw std::invalid_argument{"bad size: " + spec};
+            geometric_ = std::geometric_distribution<
+                std::size_t>{1. / (mean + 1)};
+            max_ = 16 * mean;
+        }
+        else if(v[0] == "choice" && v.size() == 2)
+        {
+            kind_ = kind::choice;
+            std::vector<double> weights;
+            for(auto const& item : split(v[1], ','))
+            {
+                auto const p = split(item, '@');
+                if(p.size() != 2)
+                    throw std::invalid_argument{"bad size: " + spec};
+                sizes_.push_back(to_size(p[0]));
+                weights.push_back(boost::lexical_cast<double>(p[1]));
+            }
+            choice_ = std::discrete_distribution<std::size_t>(
+                weights.begin(), weights.end());
+            max_ = *std::max_element(sizes_.begin(), sizes_.end());
+        }
+        else
+        {
+            throw std::invalid_argument{"bad size: " + spec};
+        }
+    }
+
+    /// Returns the largest size the distribution produces
+    std::size_t
+    max() const
+    {
+        return max_;
+    }
+
+    template<class Engine>
+    std::size_t
+    operator()(Engine& g)
+    {
+        switch(kind_)
+        {
+        case kind::fixed:
+            return max_;
+        case kind::uniform:
+            return uniform_(g);
+        case kind::geometric:
+            return (std::min)(geometric_(g), max_);
+        case kind::choice:
+        default:
+            return sizes_[choice_(g)];
+        }
     }
 };
 
-class report
+// Payloads shared by all connections
+class payload
 {
-    std::mutex m_;
-    std::size_t bytes_ = 0;
-    std::size_t messages_ = 0;
+    std::string text_;
+    std::string binary_;
 
 public:
-    void
-    insert(std::size_t messages, std::size_t bytes)
+    explicit
+    payload(std::size_t size)
+        : text_(size, ' ')
+        , binary_(size, 0)
     {
-        std::lock_guard<std::mutex> lock(m_);
-        bytes_ += bytes;
-        messages_ += messages;
+        // Text looks like prose, so that it compresses
+        // about as well as typical text messages do.
+        static char const* const words[] = {
+            "the", "quick", "brown", "fox", "jumps", "over",
+            "lazy", "dog", "lorem", "ipsum", "dolor", "sit",
+            "amet", "websocket", "message", "frame", "beast",
+            "{\"id\":", "\"value\":", "[1,2,3]", "}", "\n" };
+        std::mt19937_64 rng;
+        std::uniform_int_distribution<std::size_t> pick{
+            0, sizeof(words) / sizeof(words[0]) - 1};
+        std::size_t i = 0;
+        while(i < size)
+        {
+            for(auto p = words[pick(rng)]; *p && i < size; ++p)
+                text_[i++] = *p;
+            if(i < size)
+                text_[i++] = ' ';
+        }
+        std::uniform_int_distribution<unsigned short> byte;
+        for(auto& c : binary_)
+            c = static_cast<char>(byte(rng));
+        // The echo server treats messages starting
+        // with certain words as commands.
+        if(size > 0)
+            binary_[0] = 0;
     }
 
-    std::size_t
-    bytes() const
+    asio::const_buffers_1
+    text(std::size_t n) const
     {
-        return bytes_;
+        return asio::const_buffers_1{text_.data(), n};
     }
 
-    std::size_t
-    messages() const
+    asio::const_buffers_1
+    binary(std::size_t n) const
     {
-        return messages_;
+        return asio::const_buffers_1{binary_.data(), n};
     }
 };
 
+struct options
+{
+    std::size_t connections;
+    std::size_t threads;
+    double rate;                // messages/s for all connections
+    double text;                // fraction of text messages
+    clock_type::duration warmup;
+    clock_type::duration duration;
+    ws::permessage_deflate pmd;
+    bool stats;
+};
+
+// Measurements taken by the connections on one thread
+struct report
+{
+    beast::test::latency lat;
+    std::uint64_t messages = 0;
+    std::uint64_t bytes = 0;
+    std::uint64_t errors = 0;
+    ws::stream_stats stats;
+
+    void
+    merge(report const& other)
+    {
+        lat.merge(other.lat);
+        messages += other.messages;
+        bytes += other.bytes;
+        errors += other.errors;
+        add(stats, other.stats);
+    }
+
+    static
+    void
+    add(ws::stream_stats& s, ws::stream_stats const& o)
+    {
+        s.messages_in += o.messages_in;
+        s.messages_out += o.messages_out;
+        s.frames_in += o.frames_in;
+        s.frames_out += o.frames_out;
+        s.wire_bytes_in += o.wire_bytes_in;
+        s.wire_bytes_out += o.wire_bytes_out;
+        s.payload_bytes_in += o.payload_bytes_in;
+        s.payload_bytes_out += o.payload_bytes_out;
+        s.inflate_bytes_in += o.inflate_bytes_in;
+        s.inflate_bytes_out += o.inflate_bytes_out;
+        s.deflate_bytes_in += o.deflate_bytes_in;
+        s.deflate_bytes_out += o.deflate_bytes_out;
+        s.pings_in += o.pings_in;
+        s.pings_out += o.pings_out;
+        s.pongs_in += o.pongs_in;
+        s.pongs_out += o.pongs_out;
+        s.inflate_time += o.inflate_time;
+        s.deflate_time += o.deflate_time;
+        s.mask_time += o.mask_time;
+        s.read_wait_time += o.read_wait_time;
+        s.write_wait_time += o.write_wait_time;
+    }
+};
+
+//------------------------------------------------------------------------------
+
 class connection
     : public std::enable_shared_from_this<connection>
 {
     std::ostream& log_;
     ws::stream<tcp::socket> ws_;
     tcp::endpoint ep_;
-    std::size_t messages_;
+    options const& opt_;
+    payload const& pl_;
     report& rep_;
-    test_buffer const& tb_;
-    asio::io_service::strand strand_;
+    size_distribution size_;
+    std::bernoulli_distribution text_;
+    asio::steady_timer timer_;
     beast::multi_buffer buffer_;
     std::mt19937_64 rng_;
-    std::size_t count_ = 0;
-    std::size_t bytes_ = 0;
+    beast::test::schedule sched_;
+    std::size_t n_ = 0;
     session_alloc<char> alloc_;
 
 public:
@@ -95,34 +318,39 @@ public:
         std::ostream& log,
         asio::io_service& ios,
         tcp::endpoint const& ep,
-        std::size_t messages,
-        bool deflate,
+        options const& opt,
+        size_distribution const& size,
+        payload const& pl,
         report& rep,
-        test_buffer const& tb)
+        std::uint64_t seed)
         : log_(log)
         , ws_(ios)
         , ep_(ep)
-        , messages_(messages)
+        , opt_(opt)
+        , pl_(pl)
         , rep_(rep)
-        , tb_(tb)
-        , strand_(ios)
+        , size_(size)
+        , text_(opt.text)
+        , timer_(ios)
+        , rng_(seed)
+        , sched_(opt.rate / opt.connections)
     {
-        ws::permessage_deflate pmd;
-        pmd.client_enable = deflate;
-        ws_.set_option(pmd);
-        ws_.binary(true);
+        ws_.set_option(opt.pmd);
         ws_.auto_fragment(false);
         ws_.write_buffer_size(64 * 1024);
+        ws_.read_message_max(0);
+        ws_.collect_stats(opt.stats);
     }
 
     ~connection()
     {
-        rep_.insert(count_, bytes_);
+        report::add(rep_.stats, ws_.stats());
     }
 
     void
-    run()
+    run(clock_type::time_point start)
     {
+        sched_.run(start, opt_.warmup, opt_.duration);
         ws_.next_layer().async_connect(ep_,
             alloc_.wrap(std::bind(
                 &connection::on_connect,
@@ -137,6 +365,7 @@ private:
         if( ec == asio::error::operation_aborted ||
             ec == ws::error::closed)
             return;
+        ++rep_.errors;
         print(log_, "[", ep_, "] ", what, ": ", ec.message());
     }
 
@@ -145,6 +374,7 @@ private:
     {
         if(ec)
             return fail("on_connect", ec);
+        ws_.next_layer().set_option(tcp::no_delay{true});
         ws_.async_handshake(
             boost::lexical_cast<std::string>(ep_),
             "/",
@@ -158,40 +388,51 @@ private:
     on_handshake(error_code ec)
     {
         if(ec)
-            return fail("on_connect", ec);
-        do_write();
+            return fail("on_handshake", ec);
+        sched_.first(rng_);
+        do_wait();
     }
 
     void
-    do_write()
+    do_wait()
     {
-        std::geometric_distribution<std::size_t> dist{
-            double(4) / boost::asio::buffer_size(tb_)};
-        ws_.async_write_some(true,
-            beast::buffer_prefix(dist(rng_), tb_),
+        if(sched_.due())
+            return do_write();
+        timer_.expires_at(sched_.next());
+        timer_.async_wait(
             alloc_.wrap(std::bind(
-                &connection::on_write,
+                &connection::on_timer,
                 shared_from_this(),
                 ph::_1)));
     }
 
     void
-    on_write(error_code ec)
+    on_timer(error_code ec)
     {
         if(ec)
-            return fail("on_read", ec);
-        if(messages_--)
-            return do_read();
-        ws_.async_close({},
+            return fail("on_timer", ec);
+        do_write();
+    }
+
+    void
+    do_write()
+    {
+        n_ = size_(rng_);
+        auto const text = text_(rng_);
+        ws_.binary(! text);
+        sched_.send();
+        ws_.async_write(text ? pl_.text(n_) : pl_.binary(n_),
             alloc_.wrap(std::bind(
-                &connection::on_close,
+                &connection::on_write,
                 shared_from_this(),
                 ph::_1)));
     }
 
     void
-    do_read()
+    on_write(error_code ec)
     {
+        if(ec)
+            return fail("on_write", ec);
         ws_.async_read(buffer_,
             alloc_.wrap(std::bind(
                 &connection::on_read,
@@ -204,10 +445,27 @@ private:
     {
         if(ec)
             return fail("on_read", ec);
-        ++count_;
-        bytes_ += buffer_.size();
+        auto const now = clock_type::now();
+        if(sched_.reply(rep_.lat, now))
+        {
+            ++rep_.messages;
+            rep_.bytes += n_;
+        }
         buffer_.consume(buffer_.size());
-        do_write();
+        if(sched_.done(now))
+            return do_close();
+        sched_.advance();
+        do_wait();
+    }
+
+    void
+    do_close()
+    {
+        ws_.async_close({},
+            alloc_.wrap(std::bind(
+                &connection::on_close,
+                shared_from_this(),
+                ph::_1)));
     }
 
     void
@@ -235,103 +493,189 @@ private:
             return fail("on_drain", ec);
         do_drain();
     }
-
 };
 
-class timer
-{
-    using clock_type =
-        std::chrono::system_clock;
-
-    clock_type::time_point when_;
+//------------------------------------------------------------------------------
 
-public:
-    using duration =
-        clock_type::duration;
-
-    timer()
-        : when_(clock_type::now())
-    {
-    }
+// One thread and the connections it runs
+using worker = beast::test::worker<report>;
 
-    duration
-    elapsed() const
+void
+print_report(std::ostream& os, options const& opt,
+    report const& rep, double seconds)
+{
+    os <<
+        "messages:   " << rep.messages << " (" <<
+            static_cast<std::uint64_t>(rep.messages / seconds) <<
+            " msg/s)\n" <<
+        "payload:    " << std::fixed << std::setprecision(2) <<
+            (2. * rep.bytes / seconds / (1024 * 1024)) <<
+            " MB/s both ways\n" <<
+        "errors:     " << rep.errors << "\n\n";
+    beast::test::print_latency(os, rep.lat, opt.rate > 0);
+
+    if(opt.stats)
     {
-        return clock_type::now() - when_;
+        auto const& s = rep.stats;
+        auto const per_msg =
+            [&](ws::stream_stats::duration d)
+            {
+                using ns = std::chrono::nanoseconds;
+                return s.messages_out == 0 ? 0. :
+                    static_cast<double>(std::chrono::duration_cast<
+                        ns>(d).count()) / s.messages_out;
+            };
+        os << std::setprecision(2) << "\n"
+            "client frames:      " << s.frames_out << " out, " <<
+                s.frames_in << " in\n" <<
+            "client wire bytes:  " << s.wire_bytes_out << " out, " <<
+                s.wire_bytes_in << " in\n" <<
+            "deflate ratio:      " << s.deflate_ratio() << "\n" <<
+            "inflate ratio:      " << s.inflate_ratio() << "\n" <<
+            std::setprecision(0) <<
+            "ns per message:     " <<
+                per_msg(s.deflate_time) << " deflate, " <<
+                per_msg(s.inflate_time) << " inflate, " <<
+                per_msg(s.mask_time) << " mask\n";
     }
-};
-
-inline
-std::uint64_t
-throughput(
-    std::chrono::duration<double> const& elapsed,
-    std::uint64_t items)
-{
-    using namespace std::chrono;
-    return static_cast<std::uint64_t>(
-        1 / (elapsed/items).count());
 }
 
 int
 main(int argc, char** argv)
 {
+    namespace po = boost::program_options;
     beast::unit_test::dstream dout(std::cerr);
 
     try
     {
-        // Check command line arguments.
-        if(argc != 8)
+        po::options_description desc("Options");
+        desc.add_options()
+            ("help,h",          "Show this message")
+            ("address",         po::value<std::string>()->default_value("127.0.0.1"),
+                                "Address of the echo server")
+            ("port,p",          po::value<unsigned short>()->default_value(0),
+                                "Port of the echo server, 0 to start one in-process")
+            ("server-threads",  po::value<std::size_t>()->default_value(1),
+                                "Threads for the in-process server")
+            ("connections,c",   po::value<std::size_t>()->default_value(16),
+                                "Number of connections")
+            ("threads,t",       po::value<std::size_t>()->default_value(1),
+                                "Number of client threads")
+            ("duration,d",      po::value<double>()->default_value(10),
+                                "Seconds to measure for")
+            ("warmup,w",        po::value<double>()->default_value(2),
+                                "Seconds to run before measuring")
+            ("rate,r",          po::value<double>()->default_value(0),
+                                "Target messages per second over all connections, "
+                                "0 for as fast as possible")
+            ("size,s",          po::value<std::string>()->default_value("1024"),
+                                "Message sizes: N, uniform:A:B, geometric:MEAN, "
+                                "or choice:N@WEIGHT,N@WEIGHT,...")
+            ("text",            po::value<double>()->default_value(0),
+                                "Fraction of messages sent as text, 0 to 1")
+            ("deflate",         po::value<bool>()->default_value(false),
+                                "Enable permessage-deflate")
+            ("window-bits",     po::value<int>()->default_value(15),
+                                "permessage-deflate window bits, 8 to 15")
+            ("level",           po::value<int>()->default_value(8),
+                                "permessage-deflate compression level")
+            ("mem-level",       po::value<int>()->default_value(4),
+                                "permessage-deflate memory level")
+            ("no-context-takeover", po::value<bool>()->default_value(false),
+                                "Disable context takeover in both directions")
+            ("threshold",       po::value<std::size_t>()->default_value(0),
+                                "Send messages smaller than this uncompressed")
+            ("stats",           po::value<bool>()->default_value(false),
+                                "Collect and report client stream statistics")
+            ;
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+        if(vm.count("help"))
         {
             std::cerr <<
-                "Usage: " << argv[0] <<
-                " <address> <port> <trials> <messages> <workers> <threads> <compression:0|1>";
+                "Usage: " << argv[0] << " [options]\n" << desc;
+            return EXIT_SUCCESS;
+        }
+
+        options opt;
+        opt.connections = vm["connections"].as<std::size_t>();
+        opt.threads = vm["threads"].as<std::size_t>();
+        opt.rate = vm["rate"].as<double>();
+        opt.text = vm["text"].as<double>();
+        opt.warmup = std::chrono::duration_cast<clock_type::duration>(
+            std::chrono::duration<double>(vm["warmup"].as<double>()));
+        opt.duration = std::chrono::duration_cast<clock_type::duration>(
+            std::chrono::duration<double>(vm["duration"].as<double>()));
+        opt.stats = vm["stats"].as<bool>();
+        opt.pmd.client_enable = vm["deflate"].as<bool>();
+        opt.pmd.server_enable = opt.pmd.client_enable;
+        opt.pmd.client_max_window_bits = vm["window-bits"].as<int>();
+        opt.pmd.server_max_window_bits = opt.pmd.client_max_window_bits;
+        opt.pmd.compLevel = vm["level"].as<int>();
+        opt.pmd.memLevel = vm["mem-level"].as<int>();
+        opt.pmd.client_no_context_takeover =
+            vm["no-context-takeover"].as<bool>();
+        opt.pmd.server_no_context_takeover =
+            opt.pmd.client_no_context_takeover;
+        opt.pmd.msg_size_threshold = vm["threshold"].as<std::size_t>();
+        if( opt.connections == 0 || opt.threads == 0 ||
+            opt.text < 0 || opt.text > 1 || opt.rate < 0)
+        {
+            std::cerr << "Invalid options\n" << desc;
             return EXIT_FAILURE;
         }
+        size_distribution const size{vm["size"].as<std::string>()};
+        payload const pl{size.max()};
+
+        // Start the in-process server if needed
+        tcp::endpoint ep{
+            ip::address::from_string(vm["address"].as<std::string>()),
+            vm["port"].as<unsigned short>()};
+        std::unique_ptr<websocket::async_echo_server> server;
+        if(ep.port() == 0)
+        {
+            server.reset(new websocket::async_echo_server{
+                &dout, vm["server-threads"].as<std::size_t>()});
+            server->set_option(opt.pmd);
+            error_code ec;
+            server->open(ep, ec);
+            if(ec)
+                return EXIT_FAILURE;
+            ep = server->local_endpoint();
+        }
 
-        auto const address = ip::address::from_string(argv[1]);
-        auto const port    = static_cast<unsigned short>(std::atoi(argv[2]));
-        auto const trials  = static_cast<std::size_t>(std::atoi(argv[3]));
-        auto const messages= static_cast<std::size_t>(std::atoi(argv[4]));
-        auto const workers = static_cast<std::size_t>(std::atoi(argv[5]));
-        auto const threads = static_cast<std::size_t>(std::atoi(argv[6]));
-        auto const deflate = static_cast<bool>(std::atoi(argv[7]));
-        auto const work = (messages + workers - 1) / workers;
-        test_buffer tb;
-        for(auto i = trials; i; --i)
+        std::vector<std::unique_ptr<worker>> workers;
+        workers.reserve(opt.threads);
+        for(std::size_t i = 0; i < opt.threads; ++i)
+            workers.emplace_back(new worker);
+        auto const start = clock_type::now();
+        for(std::size_t i = 0; i < opt.connections; ++i)
         {
-            report rep;
-            boost::asio::io_service ios{1};
-            for(auto j = workers; j; --j)
-            {
-                auto sp =
-                std::make_shared<connection>(
-                    dout,
-                    ios,
-                    tcp::endpoint{address, port},
-                    work,
-                    deflate,
-                    rep,
-                    tb);
-                sp->run();
-            }
-            timer clock;
-            std::vector<std::thread> tv;
-            if(threads > 1)
-            {
-                tv.reserve(threads);
-                tv.emplace_back([&ios]{ ios.run(); });
-            }
-            ios.run();
-            for(auto& t : tv)
-                t.join();
-            auto const elapsed = clock.elapsed();
-            dout <<
-                throughput(elapsed, rep.bytes()) << " bytes/s in " <<
-                (std::chrono::duration_cast<
-                    std::chrono::milliseconds>(
-                    elapsed).count() / 1000.) << "ms and " <<
-                rep.bytes() << " bytes" << std::endl;
+            auto& w = *workers[i % opt.threads];
+            std::make_shared<connection>(
+                dout, w.ios, ep, opt, size, pl, w.rep, i + 1)->run(start);
+        }
+        for(auto& w : workers)
+        {
+            auto& ios = w->ios;
+            w->thread = std::thread{[&ios]{ ios.run(); }};
         }
+        for(auto& w : workers)
+            w->thread.join();
+
+        report rep;
+        for(auto const& w : workers)
+            rep.merge(w->rep);
+        std::cout <<
+            opt.connections << " connections on " <<
+            opt.threads << " threads to " << ep << ", " <<
+            vm["size"].as<std::string>() << " bytes, " <<
+            (opt.rate > 0 ? boost::lexical_cast<std::string>(
+                opt.rate) + " msg/s target" : "no target rate") <<
+            (opt.pmd.client_enable ? ", deflate" : "") << "\n\n";
+        print_report(std::cout, opt, rep,
+            std::chrono::duration<double>(opt.duration).count());
     }
     catch(std::exception const& e)
     {
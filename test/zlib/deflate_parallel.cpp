@@ -0,0 +1,198 @@
+//
+// Copyright (c) 2013-2017 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Test that header file is self-contained.
+#include <beast/zlib/deflate_parallel.hpp>
+
+#include "ztest.hpp"
+#include <beast/core/flat_buffer.hpp>
+#include <beast/unit_test/suite.hpp>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace beast {
+namespace zlib {
+
+class deflate_parallel_test : public beast::unit_test::suite
+{
+public:
+    // Holds posted handlers until invoked
+    struct deferred
+    {
+        std::vector<std::function<void()>> v;
+
+        template<class F>
+        void
+        post(F&& f)
+        {
+            v.emplace_back(std::forward<F>(f));
+        }
+
+        void
+        run()
+        {
+            for(auto& f : v)
+                f();
+            v.clear();
+        }
+    };
+
+    static
+    std::string
+    to_string(flat_buffer const& b)
+    {
+        using boost::asio::buffer_cast;
+        return {buffer_cast<char const*>(b.data()), b.size()};
+    }
+
+    // Inflate with the reference zlib, which
+    // verifies the header and trailer if any.
+    static
+    std::string
+    inflate(std::string const& in, Format format)
+    {
+        z_inflator zi;
+        switch(format)
+        {
+        case Format::raw:  break;
+        // z_inflator negates windowBits
+        case Format::zlib: zi.windowBits(-15); break;
+        case Format::gzip: zi.windowBits(-31); break;
+        }
+        return zi(in);
+    }
+
+    template<class Executor>
+    void
+    doCheck(Executor& ex, std::string const& check,
+        int level, Format format, std::size_t concurrency,
+            std::size_t block_size)
+    {
+        flat_buffer b;
+        deflate_parallel(ex, b, check.data(), check.size(),
+            level, format, concurrency, block_size);
+        try
+        {
+            BEAST_EXPECT(inflate(to_string(b), format) == check);
+        }
+        catch(std::logic_error const&)
+        {
+            fail("inflate failed", __FILE__, __LINE__);
+        }
+    }
+
+    void
+    testChecksum()
+    {
+        auto const s = corpus3(100000);
+        auto const p = reinterpret_cast<
+            std::uint8_t const*>(s.data());
+        auto const bp = reinterpret_cast<Bytef const*>(s.data());
+        BEAST_EXPECT(detail::adler32(1, p, s.size()) ==
+            ::adler32(1, bp, static_cast<uInt>(s.size())));
+        BEAST_EXPECT(detail::crc32(0, p, s.size()) ==
+            ::crc32(0, bp, static_cast<uInt>(s.size())));
+        for(std::size_t i : {0, 1, 5552, 5553, 65521, 99999, 100000})
+        {
+            auto const n = s.size() - i;
+            BEAST_EXPECT(detail::adler32_combine(
+                detail::adler32(1, p, i),
+                detail::adler32(1, p + i, n), n) ==
+                    detail::adler32(1, p, s.size()));
+            BEAST_EXPECT(detail::crc32_combine(
+                detail::crc32(0, p, i),
+                detail::crc32(0, p + i, n), n) ==
+                    detail::crc32(0, p, s.size()));
+        }
+    }
+
+    void
+    testParallel()
+    {
+        test_pool pool{3};
+        for(auto format : {Format::raw, Format::zlib, Format::gzip})
+        {
+            doCheck(pool, "", 6, format, 4, 1024);
+            doCheck(pool, "Hello, world!", 6, format, 4, 1024);
+            for(int level = 0; level <= 9; ++level)
+                doCheck(pool, corpus1(100000), level, format, 4, 16384);
+            doCheck(pool, corpus1(100000), 6, format, 1, 16384);
+            doCheck(pool, corpus2(100000), 6, format, 3, 10000);
+            doCheck(pool, corpus3(100000), 1, format, 8, 1000);
+        }
+
+        try
+        {
+            flat_buffer b;
+            deflate_parallel(pool, b, "x", 1, 6, Format::raw, 1, 0);
+            fail("", __FILE__, __LINE__);
+        }
+        catch(std::invalid_argument const&)
+        {
+            pass();
+        }
+    }
+
+    void
+    testDeferred()
+    {
+        // The calling thread does all the work when the
+        // executor runs nothing, and handlers that run
+        // after the function returns find nothing to do.
+        deferred ex;
+        auto const check = corpus3(100000);
+        for(auto format : {Format::raw, Format::zlib, Format::gzip})
+            doCheck(ex, check, 6, format, 4, 10000);
+        BEAST_EXPECT(ex.v.size() == 9);
+        ex.run();
+    }
+
+    void
+    testHeader()
+    {
+        test_pool pool{1};
+        {
+            flat_buffer b;
+            deflate_parallel(pool, b, "", 0, 6, Format::zlib);
+            auto const s = to_string(b);
+            BEAST_EXPECT(s.size() > 6);
+            BEAST_EXPECT(s[0] == '\x78');
+            BEAST_EXPECT(((static_cast<unsigned char>(s[0]) << 8) |
+                static_cast<unsigned char>(s[1])) % 31 == 0);
+            // adler32 of nothing is 1
+            BEAST_EXPECT(s.substr(s.size() - 4) ==
+                std::string("\0\0\0\1", 4));
+        }
+        {
+            flat_buffer b;
+            deflate_parallel(pool, b, "", 0, 6, Format::gzip);
+            auto const s = to_string(b);
+            BEAST_EXPECT(s.size() > 18);
+            BEAST_EXPECT(s.substr(0, 4) ==
+                std::string("\x1f\x8b\x08\x00", 4));
+            // crc32 and size of nothing are 0
+            BEAST_EXPECT(s.substr(s.size() - 8) ==
+                std::string(8, '\0'));
+        }
+    }
+
+    void
+    run() override
+    {
+        testChecksum();
+        testParallel();
+        testDeferred();
+        testHeader();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(deflate_parallel,zlib,beast);
+
+} // zlib
+} // beast
@@ -7,9 +7,12 @@
 
 // Test that header file is self-contained.
 #include <beast/zlib/deflate_stream.hpp>
+#include <beast/zlib/static_deflate_stream.hpp>
 
 #include "ztest.hpp"
 #include <beast/unit_test/suite.hpp>
+#include <chrono>
+#include <memory>
 
 namespace beast {
 namespace zlib {
@@ -34,6 +37,7 @@ public:
         case 2: return Strategy::huffman;
         case 3: return Strategy::rle;
         case 4: return Strategy::fixed;
+        case 5: return Strategy::quick;
         }
     }
 
@@ -324,14 +328,233 @@ public:
     #endif
     }
 
+    //--------------------------------------------------------------------------
+
+    // Compress check in one call
+    std::string
+    doOneShot(int level, Strategy strategy, std::string const& check)
+    {
+        std::string out;
+        z_params zs;
+        deflate_stream ds;
+        ds.reset(level, 15, 8, strategy);
+        out.resize(ds.upper_bound(check.size()));
+        zs.next_in = check.data();
+        zs.avail_in = check.size();
+        zs.next_out = &out[0];
+        zs.avail_out = out.size();
+        error_code ec;
+        ds.write(zs, Flush::finish, ec);
+        BEAST_EXPECTS(ec == error::end_of_stream, ec.message());
+        out.resize(zs.total_out);
+        return out;
+    }
+
+    void
+    testQuick()
+    {
+        // Strategy::quick uses static trees and a single hash probe
+        for(int level = 0; level <= 9; ++level)
+        {
+            doDeflate1_beast(level, 15, 5, "Hello, world!");
+            doDeflate2_beast(level, 9, 5, "Hello, world!");
+        }
+        for(int level = 1; level <= 3; ++level)
+        {
+            z_inflator zi;
+            for(auto const& check : {
+                corpus2(16 * 1024),
+                corpus3(64 * 1024),
+                corpus4(64 * 1024)})
+            {
+                auto const quick =
+                    doOneShot(level, Strategy::quick, check);
+                BEAST_EXPECT(zi(quick) == check);
+            }
+        }
+
+        // Levels 1 and 2 are unchanged unless quick is requested
+        {
+            auto const check = corpus3(64 * 1024);
+            auto const normal =
+                doOneShot(1, Strategy::normal, check);
+            auto const quick =
+                doOneShot(1, Strategy::quick, check);
+            BEAST_EXPECT(normal.size() < quick.size());
+        }
+
+        // The block must be closed across a change of strategy
+        {
+            auto const check = corpus3(64 * 1024);
+            std::string out;
+            out.resize(2 * check.size());
+            z_params zs;
+            deflate_stream ds;
+            ds.reset(1, 15, 8, Strategy::quick);
+            zs.next_in = check.data();
+            zs.avail_in = check.size() / 2;
+            zs.next_out = &out[0];
+            zs.avail_out = out.size();
+            error_code ec;
+            ds.write(zs, Flush::none, ec);
+            BEAST_EXPECTS(! ec, ec.message());
+            ds.params(zs, 6, Strategy::normal, ec);
+            BEAST_EXPECTS(! ec, ec.message());
+            zs.avail_in = check.size() - zs.total_in;
+            ds.write(zs, Flush::sync, ec);
+            BEAST_EXPECTS(! ec, ec.message());
+            out.resize(zs.total_out);
+            z_inflator zi;
+            BEAST_EXPECT(zi(out) == check);
+        }
+    }
+
+    template<class Stream>
+    std::string
+    doStream(Stream& ds, std::string const& check)
+    {
+        std::string out;
+        out.resize(ds.upper_bound(check.size()));
+        z_params zs;
+        zs.next_in = check.data();
+        zs.avail_in = check.size();
+        zs.next_out = &out[0];
+        zs.avail_out = out.size();
+        error_code ec;
+        ds.write(zs, Flush::finish, ec);
+        BEAST_EXPECTS(ec == error::end_of_stream, ec.message());
+        out.resize(zs.total_out);
+        return out;
+    }
+
+    void
+    testStatic()
+    {
+        auto const check = corpus3(256 * 1024);
+
+        // windowBits 8 output must decode with a 256 byte window
+        for(int level = 0; level <= 9; ++level)
+        {
+            static_deflate_stream<8, 1> ds;
+            ds.reset(level, Strategy::normal);
+            z_inflator zi;
+            zi.windowBits(8);
+            BEAST_EXPECT(zi(doStream(ds, check)) == check);
+        }
+        {
+            static_deflate_stream<9, 4> ds;
+            z_inflator zi;
+            zi.windowBits(9);
+            BEAST_EXPECT(zi(doStream(ds, check)) == check);
+            ds.reset();
+            BEAST_EXPECT(zi(doStream(ds, check)) == check);
+            ds.clear();
+            BEAST_EXPECT(zi(doStream(ds, check)) == check);
+        }
+        {
+            deflate_stream ds;
+            ds.reset(6, 8, 8, Strategy::normal);
+            z_inflator zi;
+            zi.windowBits(8);
+            BEAST_EXPECT(zi(doStream(ds, check)) == check);
+            ds.clear();
+            BEAST_EXPECT(zi(doStream(ds, check)) == check);
+        }
+    }
+
+    void
+    testAllocator()
+    {
+        auto const check = corpus3(64 * 1024);
+        std::size_t bytes = 0;
+        {
+            counting_allocator<char> alloc{bytes};
+            basic_deflate_stream<counting_allocator<char>> ds{alloc};
+            BEAST_EXPECT(bytes == 0);
+            ds.reset(6, 9, 1, Strategy::normal);
+            z_inflator zi;
+            BEAST_EXPECT(zi(doStream(ds, check)) == check);
+            BEAST_EXPECT(bytes > 0 && bytes < 4096);
+            ds.reset(6, 15, 8, Strategy::normal);
+            BEAST_EXPECT(zi(doStream(ds, check)) == check);
+            BEAST_EXPECT(bytes > 4096);
+            ds.clear();
+            BEAST_EXPECT(bytes == 0);
+            BEAST_EXPECT(zi(doStream(ds, check)) == check);
+        }
+        BEAST_EXPECT(bytes == 0);
+
+        // static storage never uses the allocator
+        static_deflate_stream<9, 1> ds;
+        z_inflator zi;
+        BEAST_EXPECT(zi(doStream(ds, check)) == check);
+    }
+
+    void
+    testMove()
+    {
+        using stream_type =
+            basic_deflate_stream<counting_allocator<char>>;
+        auto const check = corpus3(256 * 1024);
+        std::size_t bytes = 0;
+        for(int level : {1, 6})
+        {
+            counting_allocator<char> alloc{bytes};
+            std::string out;
+            z_params zs;
+            std::unique_ptr<stream_type> ds0{new stream_type{alloc}};
+            ds0->reset(level, 15, 8, Strategy::normal);
+            out.resize(ds0->upper_bound(check.size()));
+            zs.next_in = check.data();
+            zs.avail_in = check.size() / 4;
+            zs.next_out = &out[0];
+            zs.avail_out = out.size();
+            error_code ec;
+            z_inflator zi;
+            ds0->write(zs, Flush::none, ec);
+            BEAST_EXPECTS(! ec, ec.message());
+
+            // move construct in the middle of the compression,
+            // then destroy the source
+            stream_type ds1{std::move(*ds0)};
+            BEAST_EXPECT(zi(doStream(*ds0, check)) == check);
+            ds0.reset();
+            zs.avail_in = check.size() / 2 - zs.total_in;
+            ds1.write(zs, Flush::none, ec);
+            BEAST_EXPECTS(! ec, ec.message());
+
+            // move assign over a stream which owns buffers
+            stream_type ds2{alloc};
+            BEAST_EXPECT(zi(doStream(ds2, check)) == check);
+            ds2 = std::move(ds1);
+            zs.avail_in = check.size() - zs.total_in;
+            ds2.write(zs, Flush::finish, ec);
+            BEAST_EXPECTS(ec == error::end_of_stream, ec.message());
+            out.resize(zs.total_out);
+            BEAST_EXPECT(zi(out) == check);
+
+            // moved-from streams keep their settings and work
+            BEAST_EXPECT(zi(doStream(ds1, check)) == check);
+        }
+        BEAST_EXPECT(bytes == 0);
+    }
+
     void
     run() override
     {
         log <<
             "sizeof(deflate_stream) == " <<
-            sizeof(deflate_stream) << std::endl;
+            sizeof(deflate_stream) << "\n" <<
+            "sizeof(static_deflate_stream<9, 1>) == " <<
+            sizeof(static_deflate_stream<9, 1>) << "\n" <<
+            "sizeof(static_deflate_stream<15, 8>) == " <<
+            sizeof(static_deflate_stream<15, 8>) << std::endl;
 
         testDeflate();
+        testQuick();
+        testStatic();
+        testAllocator();
+        testMove();
     }
 };
 
@@ -7,10 +7,13 @@
 
 // Test that header file is self-contained.
 #include <beast/zlib/inflate_stream.hpp>
+#include <beast/zlib/static_inflate_stream.hpp>
 
+#include <beast/zlib/deflate_stream.hpp>
 #include "ztest.hpp"
 #include <beast/unit_test/suite.hpp>
 #include <chrono>
+#include <memory>
 #include <random>
 
 namespace beast {
@@ -399,13 +402,179 @@ public:
 #endif
     }
 
+    // Inflate in pieces, so the window is used
+    template<class Stream>
+    std::string
+    doPieces(Stream& is, std::string const& in)
+    {
+        std::string out;
+        z_params zs;
+        zs.next_in = in.data();
+        zs.avail_in = in.size();
+        for(;;)
+        {
+            out.resize(zs.total_out + 100);
+            zs.next_out = &out[zs.total_out];
+            zs.avail_out = out.size() - zs.total_out;
+            error_code ec;
+            is.write(zs, Flush::sync, ec);
+            if(ec == error::need_buffers ||
+                ec == error::end_of_stream)
+                break;
+            if(! BEAST_EXPECTS(! ec, ec.message()))
+                break;
+        }
+        out.resize(zs.total_out);
+        return out;
+    }
+
+    void
+    testStatic()
+    {
+        auto const check = corpus1(20000);
+        z_deflator zd;
+        zd.level(6);
+        zd.windowBits(9);
+        auto const in = zd(check);
+        {
+            static_inflate_stream<9> is;
+            BEAST_EXPECT(doPieces(is, in) == check);
+            is.reset();
+            BEAST_EXPECT(doPieces(is, in) == check);
+            is.clear();
+            BEAST_EXPECT(doPieces(is, in) == check);
+        }
+        {
+            static_inflate_stream<15> is;
+            BEAST_EXPECT(doPieces(is, in) == check);
+        }
+        {
+            inflate_stream is;
+            is.reset(9);
+            BEAST_EXPECT(doPieces(is, in) == check);
+            is.clear();
+            BEAST_EXPECT(doPieces(is, in) == check);
+        }
+    }
+
+    void
+    testAllocator()
+    {
+        auto const check = corpus1(20000);
+        z_deflator zd;
+        zd.windowBits(9);
+        auto const in = zd(check);
+        std::size_t bytes = 0;
+        {
+            counting_allocator<char> alloc{bytes};
+            basic_inflate_stream<counting_allocator<char>> is{alloc};
+            is.reset(9);
+            BEAST_EXPECT(bytes == 0);
+            BEAST_EXPECT(doPieces(is, in) == check);
+            BEAST_EXPECT(bytes == 512);
+            is.clear();
+            BEAST_EXPECT(bytes == 0);
+            is.reset(15);
+            BEAST_EXPECT(doPieces(is, in) == check);
+            BEAST_EXPECT(bytes == 32768);
+        }
+        BEAST_EXPECT(bytes == 0);
+
+        // The window is not needed for a one-shot finish
+        {
+            std::string in2;
+            {
+                deflate_stream ds;
+                in2.resize(ds.upper_bound(check.size()));
+                z_params zs;
+                zs.next_in = check.data();
+                zs.avail_in = check.size();
+                zs.next_out = &in2[0];
+                zs.avail_out = in2.size();
+                error_code ec;
+                ds.write(zs, Flush::finish, ec);
+                BEAST_EXPECTS(ec == error::end_of_stream, ec.message());
+                in2.resize(zs.total_out);
+            }
+            counting_allocator<char> alloc{bytes};
+            basic_inflate_stream<counting_allocator<char>> is{alloc};
+            std::string out(check.size(), 0);
+            z_params zs;
+            zs.next_in = in2.data();
+            zs.avail_in = in2.size();
+            zs.next_out = &out[0];
+            zs.avail_out = out.size();
+            error_code ec;
+            is.write(zs, Flush::finish, ec);
+            BEAST_EXPECT(out == check);
+            BEAST_EXPECT(bytes == 0);
+        }
+    }
+
+    void
+    testMove()
+    {
+        using stream_type =
+            basic_inflate_stream<counting_allocator<char>>;
+        auto const check = corpus1(200000);
+        z_deflator zd;
+        auto const in = zd(check);
+        std::size_t bytes = 0;
+        {
+            counting_allocator<char> alloc{bytes};
+            std::string out(check.size(), 0);
+            z_params zs;
+            std::unique_ptr<stream_type> is0{new stream_type{alloc}};
+            zs.next_in = in.data();
+            zs.avail_in = in.size() / 3;
+            zs.next_out = &out[0];
+            zs.avail_out = out.size();
+            error_code ec;
+            is0->write(zs, Flush::none, ec);
+            BEAST_EXPECTS(! ec, ec.message());
+            BEAST_EXPECT(bytes > 0);
+
+            // move construct in the middle of the decompression,
+            // then destroy the source
+            stream_type is1{std::move(*is0)};
+            BEAST_EXPECT(doPieces(*is0, in) == check);
+            is0.reset();
+            zs.avail_in = 2 * in.size() / 3 - zs.total_in;
+            is1.write(zs, Flush::none, ec);
+            BEAST_EXPECTS(! ec, ec.message());
+
+            // move assign over a stream which owns a window
+            stream_type is2{alloc};
+            BEAST_EXPECT(doPieces(is2, in) == check);
+            is2 = std::move(is1);
+            zs.avail_in = in.size() - zs.total_in;
+            is2.write(zs, Flush::sync, ec);
+            BEAST_EXPECT(! ec ||
+                ec == error::need_buffers ||
+                ec == error::end_of_stream);
+            BEAST_EXPECT(zs.total_out == check.size());
+            BEAST_EXPECT(out == check);
+
+            // moved-from streams are usable
+            BEAST_EXPECT(doPieces(is1, in) == check);
+        }
+        BEAST_EXPECT(bytes == 0);
+    }
+
     void
     run() override
     {
         log <<
             "sizeof(inflate_stream) == " <<
-            sizeof(inflate_stream) << std::endl;
+            sizeof(inflate_stream) << "\n" <<
+            "sizeof(static_inflate_stream<9>) == " <<
+            sizeof(static_inflate_stream<9>) << "\n" <<
+            "sizeof(static_inflate_stream<15>) == " <<
+            sizeof(static_inflate_stream<15>) << std::endl;
         testInflate();
+        testStatic();
+        testAllocator();
+        testMove();
     }
 };
 
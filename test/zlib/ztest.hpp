@@ -9,9 +9,18 @@
 #define BEAST_ZTEST_HPP
 
 #include "zlib-1.2.11/zlib.h"
+#include <condition_variable>
+#include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <new>
 #include <random>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 class z_deflator
 {
@@ -80,9 +89,73 @@ public:
     }
 };
 
+// Allocator which tracks the number of bytes outstanding
+template<class T>
+class counting_allocator
+{
+    template<class>
+    friend class counting_allocator;
+
+    std::size_t* bytes_;
+
+public:
+    using value_type = T;
+
+    explicit
+    counting_allocator(std::size_t& bytes)
+        : bytes_(&bytes)
+    {
+    }
+
+    template<class U>
+    counting_allocator(counting_allocator<U> const& other)
+        : bytes_(other.bytes_)
+    {
+    }
+
+    T*
+    allocate(std::size_t n)
+    {
+        *bytes_ += n * sizeof(T);
+        return static_cast<T*>(
+            ::operator new(n * sizeof(T)));
+    }
+
+    void
+    deallocate(T* p, std::size_t n)
+    {
+        *bytes_ -= n * sizeof(T);
+        ::operator delete(p);
+    }
+
+    friend
+    bool
+    operator==(counting_allocator const& lhs,
+        counting_allocator const& rhs)
+    {
+        return lhs.bytes_ == rhs.bytes_;
+    }
+
+    friend
+    bool
+    operator!=(counting_allocator const& lhs,
+        counting_allocator const& rhs)
+    {
+        return lhs.bytes_ != rhs.bytes_;
+    }
+};
+
 class z_inflator
 {
+    int windowBits_ = 15;
+
 public:
+    void
+    windowBits(int n)
+    {
+        windowBits_ = n;
+    }
+
     std::string
     operator()(std::string const& in)
     {
@@ -90,7 +163,7 @@ public:
         std::string out;
         z_stream zs;
         memset(&zs, 0, sizeof(zs));
-        result = inflateInit2(&zs, -15);
+        result = inflateInit2(&zs, -windowBits_);
         try
         {
             zs.next_in = (Bytef*)in.data();
@@ -125,6 +198,67 @@ public:
     }
 };
 
+// Runs posted handlers on its own threads,
+// for passing to deflate_parallel
+class test_pool
+{
+    std::mutex m_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> q_;
+    std::vector<std::thread> threads_;
+    bool stop_ = false;
+
+public:
+    explicit
+    test_pool(std::size_t n)
+    {
+        while(n--)
+            threads_.emplace_back([this]{ loop(); });
+    }
+
+    // Runs the remaining handlers, then joins
+    ~test_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock{m_};
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for(auto& t : threads_)
+            t.join();
+    }
+
+    template<class F>
+    void
+    post(F&& f)
+    {
+        {
+            std::lock_guard<std::mutex> lock{m_};
+            q_.emplace_back(std::forward<F>(f));
+        }
+        cv_.notify_one();
+    }
+
+private:
+    void
+    loop()
+    {
+        for(;;)
+        {
+            std::function<void()> f;
+            {
+                std::unique_lock<std::mutex> lock{m_};
+                cv_.wait(lock, [&]{ return stop_ || ! q_.empty(); });
+                if(q_.empty())
+                    return;
+                f = std::move(q_.front());
+                q_.pop_front();
+            }
+            f();
+        }
+    }
+};
+
 // Lots of repeats, limited char range
 inline
 std::string
@@ -164,4 +298,75 @@ corpus2(std::size_t n)
     return s;
 }
 
+// JSON-like text, repeated keys with varying values
+inline
+std::string
+corpus3(std::size_t n)
+{
+    static char const* const names[] = {
+        "Alice", "Bob", "Carol", "Dave", "Eve", "Mallory", "Trent" };
+    static char const* const states[] = {
+        "online", "away", "busy", "offline" };
+    std::string s;
+    s.reserve(n + 256);
+    std::mt19937 g;
+    std::uniform_int_distribution<std::uint32_t> d0{0, 6};
+    std::uniform_int_distribution<std::uint32_t> d1{0, 3};
+    std::uniform_int_distribution<std::uint32_t> d2{0, 999999};
+    s.append("[");
+    while(s.size() < n)
+    {
+        s.append("{\"id\":");
+        s.append(std::to_string(d2(g)));
+        s.append(",\"name\":\"");
+        s.append(names[d0(g)]);
+        s.append("\",\"status\":\"");
+        s.append(states[d1(g)]);
+        s.append("\",\"score\":");
+        s.append(std::to_string(d2(g) % 1000));
+        s.append(",\"tags\":[\"");
+        s.append(states[d1(g)]);
+        s.append("\",\"");
+        s.append(names[d0(g)]);
+        s.append("\"]},\n");
+    }
+    s.resize(n);
+    return s;
+}
+
+// HTML-like markup, nested tags with varying text
+inline
+std::string
+corpus4(std::size_t n)
+{
+    static char const* const words[] = {
+        "the", "quick", "brown", "fox", "jumps", "over", "lazy",
+        "dog", "lorem", "ipsum", "dolor", "sit", "amet", "beast" };
+    std::string s;
+    s.reserve(n + 256);
+    std::mt19937 g;
+    std::uniform_int_distribution<std::uint32_t> d0{0, 13};
+    std::uniform_int_distribution<std::uint32_t> d1{1, 12};
+    std::uniform_int_distribution<std::uint32_t> d2{0, 9999};
+    s.append("<!DOCTYPE html>\n<html>\n<body>\n");
+    while(s.size() < n)
+    {
+        s.append("<div class=\"item\" id=\"item-");
+        s.append(std::to_string(d2(g)));
+        s.append("\">\n  <a href=\"/items/");
+        s.append(std::to_string(d2(g)));
+        s.append("\">");
+        s.append(words[d0(g)]);
+        s.append("</a>\n  <p>");
+        for(auto i = d1(g); i--;)
+        {
+            s.append(words[d0(g)]);
+            s.push_back(' ');
+        }
+        s.append("</p>\n</div>\n");
+    }
+    s.resize(n);
+    return s;
+}
+
 #endif